@@ -0,0 +1,172 @@
+#include <benchmark/benchmark.h>
+#include "corpus_generator.h"
+#include "file_scanner.h"
+#include "grouping_engine.h"
+#include "hash_calculator.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Corpora and sample files live here for the whole run; DFF_BENCH_DIR puts them on a chosen disk
+fs::path scratchRoot() {
+    static const fs::path root = [] {
+        const char* configured = std::getenv("DFF_BENCH_DIR");
+        fs::path base = configured ? fs::path(configured) : fs::temp_directory_path();
+#ifndef _WIN32
+        base /= "dff_bench_" + std::to_string(::getpid());
+#else
+        base /= "dff_bench";
+#endif
+        fs::create_directories(base);
+        return base;
+    }();
+    return root;
+}
+
+std::string sampleFile(std::uintmax_t size) {
+    static std::map<std::uintmax_t, std::string> files;
+    auto it = files.find(size);
+    if (it != files.end()) {
+        return it->second;
+    }
+    const fs::path path = scratchRoot() / ("sample_" + std::to_string(size) + ".bin");
+    std::ofstream out(path, std::ios::binary);
+    std::mt19937_64 rng(size);
+    std::vector<std::uint64_t> block(8192);
+    for (std::uintmax_t written = 0; written < size;) {
+        for (auto& word : block) {
+            word = rng();
+        }
+        const std::uintmax_t length = std::min<std::uintmax_t>(block.size() * sizeof(std::uint64_t), size - written);
+        out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(length));
+        written += length;
+    }
+    return files.emplace(size, path.string()).first->second;
+}
+
+// Trees for the end-to-end scans, one per (file count, duplicate percent)
+std::string corpus(size_t fileCount, int duplicatePercent) {
+    static std::map<std::pair<size_t, int>, std::string> roots;
+    auto key = std::make_pair(fileCount, duplicatePercent);
+    auto it = roots.find(key);
+    if (it != roots.end()) {
+        return it->second;
+    }
+    CorpusSpec spec;
+    spec.root = (scratchRoot() / ("corpus_" + std::to_string(fileCount) + "_" + std::to_string(duplicatePercent))).string();
+    spec.fileCount = fileCount;
+    spec.duplicateFraction = duplicatePercent / 100.0;
+    spec.nearDuplicateFraction = 0.05;
+    spec.minSize = 512;
+    spec.maxSize = 64 * 1024;
+    generateCorpus(spec);
+    return roots.emplace(key, spec.root).first->second;
+}
+
+void BM_CalculateHash(benchmark::State& state, HashAlgorithm algorithm) {
+    const std::uintmax_t size = static_cast<std::uintmax_t>(state.range(0));
+    const std::string path = sampleFile(size);
+    for (auto _ : state) {
+        Digest digest = HashCalculator::calculateHash(path, algorithm);
+        benchmark::DoNotOptimize(digest);
+    }
+    state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * size));
+}
+
+// The grouping stage behind FileScanner::findDuplicateGroups, on an in-memory table of
+// synthetic (size, digest) rows so no disk time is included
+void BM_GroupFiles(benchmark::State& state) {
+    const size_t fileCount = static_cast<size_t>(state.range(0));
+    const double duplicateFraction = state.range(1) / 100.0;
+
+    FileTable files;
+    std::mt19937_64 rng(fileCount);
+    for (size_t i = 0; i < fileCount; ++i) {
+        size_t index;
+        if (i > 0 && static_cast<double>(rng() >> 11) / 9007199254740992.0 < duplicateFraction) {
+            size_t source = static_cast<size_t>(rng() % i);
+            index = files.add("/bench/d" + std::to_string(i % 64) + "/f" + std::to_string(i), files.fileSize(source),
+                              0, 1, i + 1);
+            files.hash(index) = files.hash(source);
+        } else {
+            index = files.add("/bench/d" + std::to_string(i % 64) + "/f" + std::to_string(i), 1 + rng() % (1 << 20),
+                              0, 1, i + 1);
+            std::uint64_t words[4] = { rng(), rng(), rng(), rng() };
+            files.hash(index) = Digest::fromBytes(words, sizeof(words));
+        }
+    }
+
+    WorkerPool pool;
+    for (auto _ : state) {
+        GroupingEngine engine(pool, 256 * 1024 * 1024);
+        GroupList groups;
+        engine.group(files, groups);
+        benchmark::DoNotOptimize(groups.size());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * fileCount));
+}
+
+// Whole pipeline on a generated tree; after the first iteration the tree is in the page cache
+void BM_FindDuplicates(benchmark::State& state) {
+    const size_t fileCount = static_cast<size_t>(state.range(0));
+    const std::string root = corpus(fileCount, static_cast<int>(state.range(1)));
+    std::ostream quiet(nullptr);
+    for (auto _ : state) {
+        FileScanner scanner;
+        scanner.setLogStream(quiet);
+        const GroupList& groups = scanner.findDuplicates(root);
+        benchmark::DoNotOptimize(groups.size());
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * fileCount));
+}
+
+void registerBenchmarks() {
+    for (HashAlgorithm algorithm : { HashAlgorithm::MD5, HashAlgorithm::SHA256, HashAlgorithm::XXH3_128,
+                                     HashAlgorithm::BLAKE3 }) {
+        if (!HashCalculator::isAvailable(algorithm)) {
+            continue;
+        }
+        benchmark::RegisterBenchmark((std::string("CalculateHash/") + HashCalculator::algorithmName(algorithm)).c_str(),
+                                     BM_CalculateHash, algorithm)
+            ->Arg(4 * 1024)
+            ->Arg(1024 * 1024)
+            ->Arg(64 * 1024 * 1024);
+    }
+    benchmark::RegisterBenchmark("GroupFiles", BM_GroupFiles)
+        ->ArgNames({ "files", "dup_pct" })
+        ->ArgsProduct({ { 10000, 100000, 1000000 }, { 10, 50 } })
+        ->Unit(benchmark::kMillisecond);
+    benchmark::RegisterBenchmark("FindDuplicates", BM_FindDuplicates)
+        ->ArgNames({ "files", "dup_pct" })
+        ->ArgsProduct({ { 1000, 10000 }, { 10, 50 } })
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    registerBenchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    std::error_code ec;
+    fs::remove_all(scratchRoot(), ec);
+    return 0;
+}
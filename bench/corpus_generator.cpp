@@ -0,0 +1,163 @@
+#include "corpus_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::uintmax_t NO_FLIP = static_cast<std::uintmax_t>(-1);
+
+// Everything needed to write one file's bytes again
+struct Content {
+    std::uint64_t seed;
+    std::uintmax_t size;
+    std::uintmax_t flipOffset = NO_FLIP;
+    std::uint8_t flipMask = 0;
+};
+
+// The standard distributions may differ between libraries; mt19937_64 itself does not
+std::uint64_t below(std::mt19937_64& rng, std::uint64_t bound) {
+    return bound > 0 ? rng() % bound : 0;
+}
+
+double unit(std::mt19937_64& rng) {
+    return static_cast<double>(rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+std::uintmax_t drawSize(std::mt19937_64& rng, const CorpusSpec& spec) {
+    const std::uintmax_t low = spec.minSize;
+    const std::uintmax_t high = spec.maxSize < low ? low : spec.maxSize;
+    switch (spec.distribution) {
+        case SizeDistribution::FIXED:
+            return low;
+        case SizeDistribution::UNIFORM:
+            return low + below(rng, high - low + 1);
+        case SizeDistribution::LOG_UNIFORM: {
+            const double lowLog = std::log2(static_cast<double>(low) + 1.0);
+            const double highLog = std::log2(static_cast<double>(high) + 1.0);
+            const double size = std::exp2(lowLog + (highLog - lowLog) * unit(rng)) - 1.0;
+            return std::min(high, std::max(low, static_cast<std::uintmax_t>(size)));
+        }
+    }
+    return low;
+}
+
+void writeContent(const fs::path& path, const Content& content) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Unable to create " + path.string());
+    }
+    std::mt19937_64 bytes(content.seed);
+    std::vector<char> block(64 * 1024);
+    for (std::uintmax_t offset = 0; offset < content.size; offset += block.size()) {
+        const size_t length = static_cast<size_t>(std::min<std::uintmax_t>(block.size(), content.size - offset));
+        for (size_t i = 0; i < length; i += 8) {
+            std::uint64_t word = bytes();
+            for (size_t b = 0; b < 8 && i + b < length; ++b) {
+                block[i + b] = static_cast<char>(word >> (8 * b));
+            }
+        }
+        if (content.flipOffset >= offset && content.flipOffset < offset + length) {
+            block[static_cast<size_t>(content.flipOffset - offset)] ^= static_cast<char>(content.flipMask);
+        }
+        out.write(block.data(), static_cast<std::streamsize>(length));
+    }
+    if (!out) {
+        throw std::runtime_error("Unable to write " + path.string());
+    }
+}
+
+} // namespace
+
+CorpusSummary generateCorpus(const CorpusSpec& spec) {
+    if (fs::exists(spec.root)) {
+        throw std::runtime_error("Corpus root already exists: " + spec.root);
+    }
+    fs::create_directories(spec.root);
+
+    std::mt19937_64 rng(spec.seed);
+    std::vector<Content> written;
+    std::set<std::string> directories;
+    CorpusSummary summary;
+    for (size_t i = 0; i < spec.fileCount; ++i) {
+        fs::path directory(spec.root);
+        const unsigned levels = static_cast<unsigned>(below(rng, spec.depth + 1));
+        for (unsigned level = 0; level < levels; ++level) {
+            directory /= "d" + std::to_string(below(rng, spec.fanout > 0 ? spec.fanout : 1));
+        }
+        if (directories.insert(directory.string()).second) {
+            fs::create_directories(directory);
+        }
+
+        const double kind = unit(rng);
+        Content content;
+        if (!written.empty() && kind < spec.duplicateFraction) {
+            content = written[below(rng, written.size())];
+            summary.duplicates++;
+            summary.duplicateBytes += content.size;
+        } else if (!written.empty() && kind < spec.duplicateFraction + spec.nearDuplicateFraction) {
+            content = written[below(rng, written.size())];
+            if (content.size > 0) {
+                content.flipOffset = content.size / 2;
+                content.flipMask = static_cast<std::uint8_t>(1 + below(rng, 255));
+                summary.nearDuplicates++;
+            }
+            written.push_back(content);
+        } else {
+            content.seed = rng();
+            content.size = drawSize(rng, spec);
+            written.push_back(content);
+        }
+
+        writeContent(directory / ("f" + std::to_string(i) + ".bin"), content);
+        summary.files++;
+        summary.bytes += content.size;
+    }
+    summary.directories = directories.size();
+    return summary;
+}
+
+bool parseDistribution(const std::string& name, SizeDistribution& distribution) {
+    if (name == "fixed") {
+        distribution = SizeDistribution::FIXED;
+    } else if (name == "uniform") {
+        distribution = SizeDistribution::UNIFORM;
+    } else if (name == "log") {
+        distribution = SizeDistribution::LOG_UNIFORM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* distributionName(SizeDistribution distribution) {
+    switch (distribution) {
+        case SizeDistribution::FIXED: return "fixed";
+        case SizeDistribution::UNIFORM: return "uniform";
+        case SizeDistribution::LOG_UNIFORM: return "log";
+    }
+    return "log";
+}
+
+std::string corpusJson(const CorpusSpec& spec, const CorpusSummary& summary) {
+    // Root paths are written as given; the generator is only pointed at plain scratch paths
+    std::ostringstream out;
+    out << "{\"root\":\"" << spec.root << "\",\"seed\":" << spec.seed
+        << ",\"distribution\":\"" << distributionName(spec.distribution) << "\""
+        << ",\"min_size\":" << spec.minSize << ",\"max_size\":" << spec.maxSize
+        << ",\"duplicate_fraction\":" << spec.duplicateFraction
+        << ",\"near_duplicate_fraction\":" << spec.nearDuplicateFraction
+        << ",\"depth\":" << spec.depth << ",\"fanout\":" << spec.fanout
+        << ",\"files\":" << summary.files << ",\"directories\":" << summary.directories
+        << ",\"duplicates\":" << summary.duplicates << ",\"near_duplicates\":" << summary.nearDuplicates
+        << ",\"bytes\":" << summary.bytes << ",\"duplicate_bytes\":" << summary.duplicateBytes << "}";
+    return out.str();
+}
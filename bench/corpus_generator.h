@@ -0,0 +1,48 @@
+#ifndef CORPUS_GENERATOR_H
+#define CORPUS_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+// How file sizes are drawn between minSize and maxSize
+enum class SizeDistribution {
+    FIXED,          // Every file has minSize bytes
+    UNIFORM,
+    LOG_UNIFORM     // Each power of two is equally likely, like real trees: many small, few large
+};
+
+// Shape of a synthetic scan tree. Sizes, contents and paths all come from one seeded
+// mt19937_64, so the same spec rebuilds the same tree byte for byte.
+struct CorpusSpec {
+    std::string root;
+    size_t fileCount = 1000;
+    double duplicateFraction = 0.2;     // Share of files that copy an earlier file
+    double nearDuplicateFraction = 0.1; // Share of files that copy an earlier file with one middle byte changed,
+                                        // so only a full hash tells them apart
+    std::uintmax_t minSize = 1024;
+    std::uintmax_t maxSize = 1024 * 1024;
+    SizeDistribution distribution = SizeDistribution::LOG_UNIFORM;
+    unsigned depth = 3;                 // Directory levels below root
+    unsigned fanout = 4;                // Subdirectories per level
+    std::uint64_t seed = 1;
+};
+
+struct CorpusSummary {
+    size_t files = 0;
+    size_t duplicates = 0;              // Files whose content appeared earlier in the tree
+    size_t nearDuplicates = 0;
+    size_t directories = 0;
+    std::uintmax_t bytes = 0;
+    std::uintmax_t duplicateBytes = 0;
+};
+
+// Write the tree under spec.root, which must not exist yet; throws std::runtime_error
+CorpusSummary generateCorpus(const CorpusSpec& spec);
+
+bool parseDistribution(const std::string& name, SizeDistribution& distribution);
+const char* distributionName(SizeDistribution distribution);
+
+// One JSON object with the spec and what was generated
+std::string corpusJson(const CorpusSpec& spec, const CorpusSummary& summary);
+
+#endif // CORPUS_GENERATOR_H
@@ -0,0 +1,86 @@
+#include "corpus_generator.h"
+#include <exception>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options] <new directory>\n"
+              << "Builds a reproducible synthetic tree for benchmarks and prints a JSON summary.\n\n"
+              << "Options:\n"
+              << "  --files N              Number of files (1000)\n"
+              << "  --duplicates F         Fraction of files copying an earlier file (0.2)\n"
+              << "  --near-duplicates F    Fraction copying an earlier file with one byte changed (0.1)\n"
+              << "  --min-size BYTES       Smallest file (1024)\n"
+              << "  --max-size BYTES       Largest file (1048576)\n"
+              << "  --distribution NAME    fixed, uniform or log (default)\n"
+              << "  --depth N              Directory levels (3)\n"
+              << "  --fanout N             Subdirectories per level (4)\n"
+              << "  --seed N               Random seed (1)\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    CorpusSpec spec;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            }
+            if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+                if (i + 1 >= argc) {
+                    std::cerr << "Missing value for " << arg << std::endl;
+                    return 2;
+                }
+                const std::string value = argv[++i];
+                if (arg == "--files") {
+                    spec.fileCount = std::stoul(value);
+                } else if (arg == "--duplicates") {
+                    spec.duplicateFraction = std::stod(value);
+                } else if (arg == "--near-duplicates") {
+                    spec.nearDuplicateFraction = std::stod(value);
+                } else if (arg == "--min-size") {
+                    spec.minSize = std::stoull(value);
+                } else if (arg == "--max-size") {
+                    spec.maxSize = std::stoull(value);
+                } else if (arg == "--distribution") {
+                    if (!parseDistribution(value, spec.distribution)) {
+                        std::cerr << "Unknown distribution: " << value << std::endl;
+                        return 2;
+                    }
+                } else if (arg == "--depth") {
+                    spec.depth = static_cast<unsigned>(std::stoul(value));
+                } else if (arg == "--fanout") {
+                    spec.fanout = static_cast<unsigned>(std::stoul(value));
+                } else if (arg == "--seed") {
+                    spec.seed = std::stoull(value);
+                } else {
+                    std::cerr << "Unknown option: " << arg << std::endl;
+                    return 2;
+                }
+            } else {
+                spec.root = arg;
+            }
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Invalid option value" << std::endl;
+        return 2;
+    }
+    if (spec.root.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    try {
+        CorpusSummary summary = generateCorpus(spec);
+        std::cout << corpusJson(spec, summary) << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
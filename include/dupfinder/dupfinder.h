@@ -0,0 +1,153 @@
+#ifndef DUPFINDER_DUPFINDER_H
+#define DUPFINDER_DUPFINDER_H
+
+// Public interface of libdupfinder: configure a scan, receive duplicate groups and similar
+// pairs through callbacks, and stop a scan from another thread. Nothing here exposes the
+// pipeline's internal headers, so programs embedding the library only need this file.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace dupfinder {
+
+enum class Algorithm {
+    MD5,
+    SHA256,
+    XXH3_128,   // Non-cryptographic; only when the library was built with libxxhash
+    BLAKE3      // Only when the library was built with libblake3
+};
+
+// Confirmation of the final groups when the algorithm is not collision resistant
+enum class Verification {
+    NONE,
+    SHA256,
+    BYTE_COMPARE
+};
+
+// How the walk treats symbolic links
+enum class Symlinks {
+    FILES,      // Links to regular files are scanned, linked directories are not entered
+    NONE,       // Every link is skipped
+    ALL         // Linked directories are entered too, each directory once
+};
+
+struct ScanConfig {
+    std::vector<std::string> roots;     // Scanned as one file set
+    Algorithm algorithm = Algorithm::SHA256;
+    bool recursive = true;
+
+    // Left out of the walk; excluded directories are never opened. Patterns take *, ?, ** and
+    // [...]; without a slash they match names at any depth, with one the path below the root.
+    // A malformed pattern makes scan throw std::invalid_argument.
+    std::uintmax_t minFileSize = 0;     // 1 skips empty files
+    std::uintmax_t maxFileSize = 0;     // 0 means no limit
+    std::vector<std::string> includeGlobs;      // When any is given, files must match one
+    std::vector<std::string> excludeGlobs;
+    std::vector<std::string> excludeDirectories;
+    bool sameFilesystem = false;        // Stay on the filesystem of each root
+    Symlinks symlinks = Symlinks::FILES;
+
+    size_t threads = 0;                 // Hashing threads; 0 uses one per hardware thread
+    size_t walkThreads = 1;             // Above 1, group members are listed in path order
+    size_t deviceReadLimit = 0;         // Concurrent reads per device; 0 lets every thread read
+    std::size_t partialHashWindow = 4096;   // Head and tail bytes hashed first; 0 disables it
+    size_t compareBucketLimit = 3;      // Candidate sets this small are compared, not hashed
+    Verification verification = Verification::NONE;
+
+    std::string hashCachePath;          // Persistent digest cache; empty disables it
+    std::string snapshotPath;           // Previous scan for incremental rescans; empty disables it
+    std::size_t streamingMemoryBudget = 0;  // Above 0, deduplicate size partitions within it
+
+    // Files of at least this size are also compared by content-defined chunks; 0 disables it
+    std::uintmax_t similarityMinSize = 0;
+    std::size_t chunkAverageSize = 64 * 1024;
+    double similarityThreshold = 0.5;
+
+    bool useIoUring = false;
+    // Progress messages go here; null discards them. Errors always go to stderr.
+    std::ostream* log = nullptr;
+    // Above 0, a progress line goes to stderr at most this often
+    unsigned progressIntervalMs = 0;
+};
+
+// Files with identical contents
+struct DuplicateGroup {
+    size_t id = 0;                      // 1-based, in the order groups were delivered
+    std::uintmax_t size = 0;            // Bytes per member
+    std::string digest;                 // Hex digest of the contents in the scan's algorithm
+    std::vector<std::string> paths;     // The first is the file to keep
+};
+
+// Two files that are not identical but share content-defined chunks
+struct SimilarFiles {
+    std::string first;
+    std::string second;
+    std::uintmax_t firstSize = 0;
+    std::uintmax_t secondSize = 0;
+    std::uintmax_t sharedBytes = 0;
+    double ratio = 0;                   // Shared bytes over the size of the larger file
+};
+
+struct ScanSummary {
+    size_t filesScanned = 0;
+    std::uintmax_t bytesScanned = 0;
+    size_t duplicateGroups = 0;
+    std::uintmax_t duplicateBytes = 0;      // Every group member but the first
+    std::uintmax_t reclaimableBytes = 0;    // Same, counting each extra inode once
+    size_t similarPairs = 0;
+    double seconds = 0;
+    bool cancelled = false;             // Stopped early; groups delivered by then are complete, no others follow
+};
+
+// Called on the thread that runs the scan, once per group or pair. A group is delivered as
+// soon as it is final, often while other files are still being hashed, so its files can be
+// acted on right away; its members never change afterwards. Pairs come after the groups.
+struct ScanCallbacks {
+    std::function<void(const DuplicateGroup&)> onGroup;
+    std::function<void(const SimilarFiles&)> onSimilar;
+};
+
+// Stop flag shared by its copies: keep one, hand another to the scan, and cancel() from any
+// thread. A scan started with a cancelled token returns at once.
+class CancellationToken {
+public:
+    CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { flag->store(true); }
+    bool cancelled() const { return flag->load(); }
+
+private:
+    friend class Scanner;
+    std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Runs scans one at a time; a Scanner may be reused, and separate Scanners may run at once
+class Scanner {
+public:
+    Scanner();
+    ~Scanner();
+
+    Scanner(const Scanner&) = delete;
+    Scanner& operator=(const Scanner&) = delete;
+
+    // Scan the configured roots and report what was found through callbacks
+    ScanSummary scan(const ScanConfig& config, const ScanCallbacks& callbacks = ScanCallbacks(),
+                     const CancellationToken& token = CancellationToken());
+
+    // Whether this build of the library supports the algorithm
+    static bool isAvailable(Algorithm algorithm);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+} // namespace dupfinder
+
+#endif // DUPFINDER_DUPFINDER_H
@@ -0,0 +1,681 @@
+#include "batch_mode.h"
+#include "watch_daemon.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+bool parseAlgorithm(const std::string& name, HashAlgorithm& algorithm) {
+    if (name == "md5") {
+        algorithm = HashAlgorithm::MD5;
+    } else if (name == "sha256") {
+        algorithm = HashAlgorithm::SHA256;
+    } else if (name == "xxh3") {
+        algorithm = HashAlgorithm::XXH3_128;
+    } else if (name == "blake3") {
+        algorithm = HashAlgorithm::BLAKE3;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parseAction(const std::string& name, DuplicateAction& action) {
+    if (name == "show") {
+        action = DuplicateAction::SHOW_ONLY;
+    } else if (name == "delete") {
+        action = DuplicateAction::DELETE;
+    } else if (name == "move") {
+        action = DuplicateAction::MOVE;
+    } else if (name == "hardlink") {
+        action = DuplicateAction::HARD_LINK;
+    } else if (name == "relink") {
+        action = DuplicateAction::HARD_LINK_IN_PLACE;
+    } else if (name == "reflink") {
+        action = DuplicateAction::REFLINK;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* actionName(DuplicateAction action) {
+    switch (action) {
+        case DuplicateAction::DELETE: return "delete";
+        case DuplicateAction::MOVE: return "move";
+        case DuplicateAction::HARD_LINK: return "hardlink";
+        case DuplicateAction::HARD_LINK_IN_PLACE: return "relink";
+        case DuplicateAction::REFLINK: return "reflink";
+        case DuplicateAction::SHOW_ONLY: return "duplicate";
+    }
+    return "duplicate";
+}
+
+bool parseCount(const std::string& text, size_t& value) {
+    try {
+        size_t used = 0;
+        unsigned long long parsed = std::stoull(text, &used);
+        if (used != text.size()) {
+            return false;
+        }
+        value = static_cast<size_t>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Bytes, optionally with a K, M or G suffix (powers of 1024)
+bool parseSize(const std::string& text, std::uintmax_t& value) {
+    std::string digits = text;
+    std::uintmax_t unit = 1;
+    if (!digits.empty()) {
+        switch (digits.back()) {
+            case 'K': case 'k': unit = 1024; break;
+            case 'M': case 'm': unit = 1024 * 1024; break;
+            case 'G': case 'g': unit = 1024 * 1024 * 1024; break;
+            default: break;
+        }
+        if (unit > 1) {
+            digits.pop_back();
+        }
+    }
+    size_t count = 0;
+    if (digits.empty() || !parseCount(digits, count)) {
+        return false;
+    }
+    value = static_cast<std::uintmax_t>(count) * unit;
+    return true;
+}
+
+bool parseSymlinkPolicy(const std::string& name, SymlinkPolicy& policy) {
+    if (name == "files") {
+        policy = SymlinkPolicy::FILES;
+    } else if (name == "none") {
+        policy = SymlinkPolicy::NONE;
+    } else if (name == "all") {
+        policy = SymlinkPolicy::ALL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Merge the agents' scans and write their groups; false when an agent failed
+bool runCoordinator(const BatchOptions& options, std::FILE* out, bool& written) {
+    CoordinatorOptions coordinatorOptions;
+    coordinatorOptions.agents = options.remoteAgents;
+    coordinatorOptions.algorithm = options.algorithm;
+    coordinatorOptions.partialHashWindow = options.scanOptions.partialHashWindow;
+    coordinatorOptions.groupOrder = options.scanOptions.groupOrder;
+    coordinatorOptions.groupingMemoryBudget = options.scanOptions.groupingMemoryBudget;
+    coordinatorOptions.threadCount = options.scanOptions.threadCount;
+    coordinatorOptions.token = options.token;
+    ScanCoordinator coordinator(coordinatorOptions);
+    if (!coordinator.run()) {
+        return false;
+    }
+
+    const ScanStatistics& statistics = coordinator.getStatistics();
+    std::cerr << "Merged " << statistics.filesWalked << " files from " << options.remoteAgents.size()
+              << " agents into " << statistics.duplicateGroups << " duplicate groups" << std::endl;
+    if (!options.statsPath.empty()) {
+        StatsWriter::write(options.statsPath, statistics, options.statsFormat);
+    }
+
+    const FileTable& files = coordinator.getFiles();
+    const GroupList& groups = coordinator.getGroups();
+    ResultWriter writer(out, options.format);
+    for (size_t i = 0; i < groups.size(); ++i) {
+        const FileGroup group = groups[i];
+        ResultGroup record;
+        record.id = i + 1;
+        record.size = groups.fileSize(i);
+        record.hash = files.hash(group[0]).toHex();
+        record.files.push_back(ResultFile{ files.path(group[0]), "keep", "" });
+        for (size_t j = 1; j < group.size(); ++j) {
+            record.files.push_back(ResultFile{ files.path(group[j]), actionName(DuplicateAction::SHOW_ONLY), "" });
+        }
+        writer.writeGroup(record);
+    }
+    written = writer.flush();
+    return true;
+}
+
+} // namespace
+
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options, std::string& error) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        // Options taking a value accept it as the next argument
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) {
+                error = "Missing value for " + arg;
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+        std::string text;
+        size_t count = 0;
+
+        if (arg == "-a" || arg == "--algorithm") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseAlgorithm(text, options.algorithm)) {
+                error = "Unknown algorithm: " + text;
+                return false;
+            }
+            if (!HashCalculator::isAvailable(options.algorithm)) {
+                error = std::string(HashCalculator::algorithmName(options.algorithm)) + " support was not compiled in";
+                return false;
+            }
+        } else if (arg == "-x" || arg == "--action") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseAction(text, options.action)) {
+                error = "Unknown action: " + text;
+                return false;
+            }
+        } else if (arg == "-t" || arg == "--target") {
+            if (!value(options.targetDirectory)) {
+                return false;
+            }
+        } else if (arg == "-j" || arg == "--threads") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, options.scanOptions.threadCount)) {
+                error = "Invalid thread count: " + text;
+                return false;
+            }
+        } else if (arg == "--walk-threads") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count) || count == 0) {
+                error = "Invalid walker thread count: " + text;
+                return false;
+            }
+            options.scanOptions.walkThreads = count;
+        } else if (arg == "--min-size" || arg == "--max-size") {
+            if (!value(text)) {
+                return false;
+            }
+            FilterRules& filters = options.scanOptions.filters;
+            if (!parseSize(text, arg == "--min-size" ? filters.minSize : filters.maxSize)) {
+                error = "Invalid file size: " + text;
+                return false;
+            }
+        } else if (arg == "--include") {
+            if (!value(text)) {
+                return false;
+            }
+            options.scanOptions.filters.includeGlobs.push_back(text);
+        } else if (arg == "--exclude") {
+            if (!value(text)) {
+                return false;
+            }
+            options.scanOptions.filters.excludeGlobs.push_back(text);
+        } else if (arg == "--exclude-dir") {
+            if (!value(text)) {
+                return false;
+            }
+            options.scanOptions.filters.excludeDirectories.push_back(text);
+        } else if (arg == "--one-file-system") {
+            options.scanOptions.filters.sameFilesystem = true;
+        } else if (arg == "--symlinks") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseSymlinkPolicy(text, options.scanOptions.filters.symlinks)) {
+                error = "Unknown symlink policy: " + text;
+                return false;
+            }
+        } else if (arg == "--partial-window") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, options.scanOptions.partialHashWindow)) {
+                error = "Invalid partial hash window: " + text;
+                return false;
+            }
+        } else if (arg == "--sort") {
+            if (!value(text)) {
+                return false;
+            }
+            if (text == "wasted") {
+                options.scanOptions.groupOrder = GroupOrder::WASTED_BYTES;
+            } else if (text == "count") {
+                options.scanOptions.groupOrder = GroupOrder::MEMBER_COUNT;
+            } else {
+                error = "Unknown group order: " + text;
+                return false;
+            }
+        } else if (arg == "--grouping-memory") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count)) {
+                error = "Invalid grouping memory: " + text;
+                return false;
+            }
+            options.scanOptions.groupingMemoryBudget = count * 1024 * 1024;
+        } else if (arg == "--memory-budget") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count)) {
+                error = "Invalid memory budget: " + text;
+                return false;
+            }
+            options.scanOptions.streamingMemoryBudget = count * 1024 * 1024;
+        } else if (arg == "--similar") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count) || count == 0) {
+                error = "Invalid similarity size: " + text;
+                return false;
+            }
+            options.scanOptions.similarityMinSize = static_cast<std::uintmax_t>(count) * 1024 * 1024;
+        } else if (arg == "--similar-ratio") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count) || count > 100) {
+                error = "Invalid similarity ratio: " + text;
+                return false;
+            }
+            options.scanOptions.similarityThreshold = static_cast<double>(count) / 100;
+        } else if (arg == "--chunk-size") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count) || count == 0) {
+                error = "Invalid chunk size: " + text;
+                return false;
+            }
+            options.scanOptions.chunkAverageSize = count * 1024;
+        } else if (arg == "--cache") {
+            if (!value(options.scanOptions.hashCachePath)) {
+                return false;
+            }
+        } else if (arg == "--compare-limit") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, options.scanOptions.compareBucketLimit)) {
+                error = "Invalid compare limit: " + text;
+                return false;
+            }
+        } else if (arg == "--watch") {
+            if (!value(options.watchSocket)) {
+                return false;
+            }
+        } else if (arg == "--agent") {
+            if (!value(options.agentAddress)) {
+                return false;
+            }
+        } else if (arg == "--remote") {
+            if (!value(text)) {
+                return false;
+            }
+            options.remoteAgents.push_back(text);
+        } else if (arg == "--token") {
+            if (!value(text)) {
+                return false;
+            }
+            // Read from a file so the secret stays out of the process list
+            std::ifstream tokenFile(text);
+            if (!tokenFile || !std::getline(tokenFile, options.token) || options.token.empty()) {
+                error = "Unable to read a token from " + text;
+                return false;
+            }
+            if (options.token.back() == '\r') {
+                options.token.pop_back();
+            }
+        } else if (arg == "--debounce") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count)) {
+                error = "Invalid debounce interval: " + text;
+                return false;
+            }
+            options.debounceMs = static_cast<unsigned>(count);
+        } else if (arg == "--device-limit") {
+            if (!value(text)) {
+                return false;
+            }
+            // Either N for every device or DIR=N for the device holding DIR
+            const size_t separator = text.rfind('=');
+            const std::string number = separator == std::string::npos ? text : text.substr(separator + 1);
+            if (!parseCount(number, count) || (separator != std::string::npos && (separator == 0 || count == 0))) {
+                error = "Invalid device read limit: " + text;
+                return false;
+            }
+            if (separator == std::string::npos) {
+                options.scanOptions.deviceReadLimit = count;
+            } else {
+                options.scanOptions.rootReadLimits.emplace_back(text.substr(0, separator), count);
+            }
+        } else if (arg == "--action-jobs") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count) || count == 0) {
+                error = "Invalid action job count: " + text;
+                return false;
+            }
+            options.actionJobs = count;
+        } else if (arg == "--snapshot") {
+            if (!value(options.scanOptions.snapshotPath)) {
+                return false;
+            }
+        } else if (arg == "-f" || arg == "--format") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!ResultWriter::parseFormat(text, options.format)) {
+                error = "Unknown output format: " + text;
+                return false;
+            }
+        } else if (arg == "--progress") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!parseCount(text, count)) {
+                error = "Invalid progress interval: " + text;
+                return false;
+            }
+            options.scanOptions.progressIntervalMs = static_cast<unsigned>(count);
+        } else if (arg == "--stats") {
+            if (!value(options.statsPath)) {
+                return false;
+            }
+        } else if (arg == "--stats-format") {
+            if (!value(text)) {
+                return false;
+            }
+            if (!StatsWriter::parseFormat(text, options.statsFormat)) {
+                error = "Unknown statistics format: " + text;
+                return false;
+            }
+        } else if (arg == "-o" || arg == "--output") {
+            if (!value(options.outputPath)) {
+                return false;
+            }
+        } else if (arg == "--no-recursive") {
+            options.recursive = false;
+        } else if (arg == "--io-uring") {
+            options.scanOptions.useIoUring = true;
+        } else if (arg == "-h" || arg == "--help") {
+            options.showHelp = true;
+            return true;
+        } else if (arg == "-v" || arg == "--verbose") {
+            options.scanOptions.verbose = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            error = "Unknown option: " + arg;
+            return false;
+        } else {
+            options.paths.push_back(arg);
+        }
+    }
+
+    const FilterRules& filters = options.scanOptions.filters;
+    if (filters.maxSize > 0 && filters.minSize > filters.maxSize) {
+        error = "--min-size is larger than --max-size";
+        return false;
+    }
+    try {
+        WalkFilter compiled(filters);
+    } catch (const std::invalid_argument& e) {
+        error = e.what();
+        return false;
+    }
+
+    if (!options.remoteAgents.empty()) {
+        // The coordinator reads no files itself, so only the report options apply
+        if (!options.paths.empty()) {
+            error = "Directories are scanned by the agents; --remote takes no directory";
+            return false;
+        }
+        if (!options.watchSocket.empty() || !options.agentAddress.empty()) {
+            error = "--remote cannot be combined with --watch or --agent";
+            return false;
+        }
+        if (options.action != DuplicateAction::SHOW_ONLY) {
+            error = "Distributed scans only report duplicates; --action cannot be used with --remote";
+            return false;
+        }
+        if (options.scanOptions.similarityMinSize > 0) {
+            error = "Distributed scans only find exact duplicates; --similar cannot be used with --remote";
+            return false;
+        }
+        if (filters.active()) {
+            error = "Each agent walks its own disks; give the filter options to the agents, not to --remote";
+            return false;
+        }
+        return true;
+    }
+    if (!options.token.empty() && options.agentAddress.empty()) {
+        error = "--token is only used with --agent or --remote";
+        return false;
+    }
+    if (options.paths.empty()) {
+        error = "No directory given";
+        return false;
+    }
+    if (!options.agentAddress.empty()) {
+        if (!options.watchSocket.empty()) {
+            error = "--agent cannot be combined with --watch";
+            return false;
+        }
+        if (options.action != DuplicateAction::SHOW_ONLY) {
+            error = "An agent only scans; --action cannot be used with --agent";
+            return false;
+        }
+        if (options.scanOptions.streamingMemoryBudget > 0) {
+            error = "An agent sends a record for every file; --memory-budget cannot be used with --agent";
+            return false;
+        }
+        if (options.scanOptions.similarityMinSize > 0) {
+            error = "An agent only reports exact duplicates; --similar cannot be used with --agent";
+            return false;
+        }
+    }
+    if ((options.action == DuplicateAction::MOVE || options.action == DuplicateAction::HARD_LINK) &&
+        options.targetDirectory.empty()) {
+        error = "--target is required for the move and hardlink actions";
+        return false;
+    }
+    if (!options.watchSocket.empty() && options.scanOptions.streamingMemoryBudget > 0) {
+        error = "Watch mode keeps every file in memory; --memory-budget cannot be used with --watch";
+        return false;
+    }
+    if (!options.watchSocket.empty() && options.scanOptions.similarityMinSize > 0) {
+        error = "Watch mode only answers duplicate queries; --similar cannot be used with --watch";
+        return false;
+    }
+    if (!options.watchSocket.empty() && filters.symlinks == SymlinkPolicy::ALL) {
+        error = "Watch mode does not watch through directory links; --symlinks all cannot be used with --watch";
+        return false;
+    }
+    if (!options.watchSocket.empty() && options.action != DuplicateAction::SHOW_ONLY) {
+        error = "Watch mode only reports duplicates; --action cannot be used with --watch";
+        return false;
+    }
+    return true;
+}
+
+void printBatchUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <directory>...\n"
+              << "Without arguments the interactive menu is started.\n\n"
+              << "Options:\n"
+              << "  -a, --algorithm NAME   md5, sha256 (default), xxh3 or blake3\n"
+              << "  -x, --action NAME      show (default), delete, move, hardlink, relink or reflink\n"
+              << "  -t, --target DIR       Target directory for move and hardlink\n"
+              << "      --action-jobs N    File operations the action keeps in flight (16)\n"
+              << "  -j, --threads N        Hashing threads (0 = one per hardware thread)\n"
+              << "      --walk-threads N   Directory walker threads\n"
+              << "      --min-size SIZE    Skip files smaller than SIZE bytes (K, M, G suffixes; 1 skips empty files)\n"
+              << "      --max-size SIZE    Skip files larger than SIZE bytes\n"
+              << "      --include GLOB     Only scan files matching GLOB (repeatable)\n"
+              << "      --exclude GLOB     Skip files matching GLOB (repeatable)\n"
+              << "      --exclude-dir GLOB Never enter directories matching GLOB, e.g. .git or /mnt/snapshots (repeatable)\n"
+              << "      --one-file-system  Stay on the filesystem of each directory\n"
+              << "      --symlinks POLICY  files (follow links to files, default), none or all (also linked directories)\n"
+              << "      --device-limit [DIR=]N  Reads in flight per device, or on DIR's device (0 = thread count; rotational disks default to 1)\n"
+              << "      --partial-window N Head/tail bytes hashed before the full hash (0 disables)\n"
+              << "      --compare-limit N  Compare candidate sets of up to N files block by block instead of hashing (3, 0 disables)\n"
+              << "      --sort ORDER       wasted (bytes a group would free, default) or count\n"
+              << "      --grouping-memory MB  Sort memory before grouping spills runs to disk (0 = never)\n"
+              << "      --memory-budget MB Stream the scan through size partitions of about MB of file state each\n"
+              << "      --similar MB       Also report files of at least MB that share content-defined chunks\n"
+              << "      --similar-ratio PCT  Percent of the larger file a similar pair must share (50)\n"
+              << "      --chunk-size KB    Average content-defined chunk size (64)\n"
+              << "      --cache FILE       Persistent hash cache file\n"
+              << "      --snapshot FILE    Rescan incrementally from the snapshot in FILE and update it\n"
+              << "      --watch SOCKET     Keep watching the directories and answer queries on SOCKET\n"
+              << "      --debounce MS      Quiet time before a changed file is re-hashed in watch mode (500)\n"
+              << "      --agent [HOST:]PORT  Serve scans of the directories to a distributed scan coordinator (PORT alone: loopback only)\n"
+              << "      --remote HOST:PORT Merge the scans of the agent at HOST:PORT into one report (repeatable, no directories)\n"
+              << "      --token FILE       Shared secret agents require of coordinators, from the first line of FILE\n"
+              << "      --io-uring         Read full hashes through io_uring when supported\n"
+              << "      --no-recursive     Only scan the top level of each directory\n"
+              << "  -f, --format NAME      jsonl (default) or csv\n"
+              << "  -o, --output FILE      Write results to FILE instead of stdout\n"
+              << "      --progress MS      Print a progress line with rates and an ETA to stderr every MS milliseconds\n"
+              << "      --stats FILE       Write per-stage counters and timers to FILE after the run\n"
+              << "      --stats-format NAME  json (default) or prometheus (node_exporter textfile)\n"
+              << "  -v, --verbose          Log every scanned file\n"
+              << "  -h, --help             Show this help\n";
+}
+
+int runBatch(const BatchOptions& options) {
+    if (!options.watchSocket.empty()) {
+        WatchOptions watchOptions;
+        watchOptions.roots = options.paths;
+        watchOptions.algorithm = options.algorithm;
+        watchOptions.recursive = options.recursive;
+        watchOptions.scanOptions = options.scanOptions;
+        watchOptions.socketPath = options.watchSocket;
+        watchOptions.debounceMs = options.debounceMs;
+        WatchDaemon daemon(watchOptions);
+        return daemon.run();
+    }
+    if (!options.agentAddress.empty()) {
+        AgentOptions agentOptions;
+        agentOptions.roots = options.paths;
+        agentOptions.recursive = options.recursive;
+        agentOptions.scanOptions = options.scanOptions;
+        agentOptions.listenAddress = options.agentAddress;
+        agentOptions.token = options.token;
+        ScanAgent agent(agentOptions);
+        return agent.run();
+    }
+
+    std::FILE* out = stdout;
+    if (!options.outputPath.empty()) {
+        out = std::fopen(options.outputPath.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Unable to open output file: " << options.outputPath << std::endl;
+            return 2;
+        }
+    }
+
+    FileScanner scanner;
+    scanner.setOptions(options.scanOptions);
+    // Progress goes to stderr so stdout carries nothing but records
+    scanner.setLogStream(std::cerr);
+
+    DuplicateHandler handler;
+    handler.setVerbose(options.scanOptions.verbose);
+    handler.setConcurrency(options.actionJobs);
+
+    size_t failures = 0;
+    bool written = false;
+    if (!options.remoteAgents.empty()) {
+        if (!runCoordinator(options, out, written)) {
+            if (out != stdout) {
+                std::fclose(out);
+            }
+            return 2;
+        }
+    } else {
+        // Each group is acted on as soon as the scan confirms it, while the rest are still
+        // being hashed; records are written in report order once everything finished
+        std::unordered_map<std::string, size_t> firstResult;    // By kept path
+        size_t planned = 0;
+        handler.beginPlan(options.action, options.targetDirectory);
+        if (options.action != DuplicateAction::SHOW_ONLY) {
+            scanner.setGroupCallback([&](const FileTable& files, const FileGroup& group) {
+                std::vector<PlannedAction> items = handler.planGroup(files, group);
+                firstResult[files.path(group[0])] = planned;
+                planned += items.size();
+                handler.addToPlan(std::move(items));
+            });
+        }
+        const auto& duplicateGroups = scanner.findDuplicates(options.paths, options.algorithm, options.recursive);
+        const FileTable& files = scanner.getScannedFiles();
+        const ActionReport report = handler.finishPlan();
+        failures = report.failed;
+        if (options.action == DuplicateAction::REFLINK) {
+            std::cerr << "Reflink shared " << report.bytesShared << " bytes" << std::endl;
+        }
+        if (!options.statsPath.empty()) {
+            ScanStatistics statistics = scanner.getStatistics();
+            if (options.action != DuplicateAction::SHOW_ONLY) {
+                statistics.stages.push_back(StatsWriter::actionStage(report));
+            }
+            StatsWriter::write(options.statsPath, statistics, options.statsFormat);
+        }
+
+        ResultWriter writer(out, options.format);
+        for (size_t i = 0; i < duplicateGroups.size(); ++i) {
+            const FileGroup& group = duplicateGroups[i];
+            const std::string keepPath = files.path(group[0]);
+            size_t nextResult = options.action != DuplicateAction::SHOW_ONLY ? firstResult[keepPath] : 0;
+
+            ResultGroup record;
+            record.id = i + 1;
+            record.size = files.fileSize(group[0]);
+            record.hash = files.hash(group[0]).toHex();
+            record.files.push_back(ResultFile{ keepPath, "keep", "" });
+            for (size_t j = 1; j < group.size(); ++j) {
+                ResultFile file{ files.path(group[j]), actionName(options.action), "" };
+                if (options.action != DuplicateAction::SHOW_ONLY) {
+                    if (DuplicateHandler::alreadyShared(files, group[0], group[j])) {
+                        file.action = "linked";
+                    } else {
+                        file.status = report.results[nextResult++] ? "ok" : "failed";
+                    }
+                }
+                record.files.push_back(std::move(file));
+            }
+            writer.writeGroup(record);
+        }
+        const auto& similarFiles = scanner.getSimilarFiles();
+        for (size_t i = 0; i < similarFiles.size(); ++i) {
+            const SimilarFiles& pair = similarFiles[i];
+            writer.writeSimilarity(ResultSimilarity{ i + 1, pair.sharedBytes, pair.ratio, pair.first,
+                                                     pair.firstSize, pair.second, pair.secondSize });
+        }
+        written = writer.flush();
+    }
+
+    if (out != stdout) {
+        written = std::fclose(out) == 0 && written;
+    }
+    if (!written) {
+        std::cerr << "Error writing results" << std::endl;
+        return 2;
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+#include <string>
+#include <vector>
+#include "file_scanner.h"
+#include "duplicate_handler.h"
+#include "result_writer.h"
+#include "stats_writer.h"
+#include "remote_scan.h"
+
+// Settings for a non-interactive run, filled from the command line
+struct BatchOptions {
+    std::vector<std::string> paths;
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    bool recursive = true;
+    DuplicateAction action = DuplicateAction::SHOW_ONLY;
+    std::string targetDirectory;    // Required for move and hardlink
+    size_t actionJobs = 16;         // Concurrent filesystem operations of the action
+    OutputFormat format = OutputFormat::JSONL;
+    std::string outputPath;         // Empty writes results to stdout
+    std::string statsPath;          // Non-empty dumps per-stage statistics there after the run
+    StatsFormat statsFormat = StatsFormat::JSON;
+    ScanOptions scanOptions;
+    std::string watchSocket;        // Non-empty runs the watch daemon instead of one scan
+    unsigned debounceMs = 500;
+    std::string agentAddress;       // Non-empty serves distributed scans of paths instead
+    std::vector<std::string> remoteAgents;  // Non-empty merges these agents' scans instead of scanning
+    std::string token;              // Shared secret of agents and coordinator, read from --token FILE
+    bool showHelp = false;
+};
+
+// Parse argv into options; returns false with a message on invalid usage
+bool parseBatchOptions(int argc, char* argv[], BatchOptions& options, std::string& error);
+
+void printBatchUsage(const char* program);
+
+// Scan, apply the action and write one record per group; or serve watch mode or a scan
+// agent, or merge the scans of remote agents; returns the process exit code
+int runBatch(const BatchOptions& options);
+
+#endif // BATCH_MODE_H
@@ -0,0 +1,147 @@
+#include "chunk_index.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace {
+
+const size_t INITIAL_SLOTS = 1024;
+
+// One file holding a chunk, and how many times
+struct Holder {
+    std::uint32_t file;
+    std::uint32_t count;
+};
+
+// Fingerprints are digest bytes, already uniform, so masking them picks the slot
+size_t slotOf(std::uint64_t key, size_t mask) {
+    return static_cast<size_t>(key ^ (key >> 32)) & mask;
+}
+
+} // namespace
+
+ChunkIndex::ChunkIndex() : keys(INITIAL_SLOTS, 0), ids(INITIAL_SLOTS, 0) {}
+
+void ChunkIndex::grow() {
+    std::vector<std::uint64_t> oldKeys = std::move(keys);
+    std::vector<std::uint32_t> oldIds = std::move(ids);
+    keys.assign(oldKeys.size() * 2, 0);
+    ids.assign(oldIds.size() * 2, 0);
+    const size_t mask = keys.size() - 1;
+    for (size_t i = 0; i < oldKeys.size(); ++i) {
+        if (oldKeys[i] == 0) {
+            continue;
+        }
+        size_t slot = slotOf(oldKeys[i], mask);
+        while (keys[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        keys[slot] = oldKeys[i];
+        ids[slot] = oldIds[i];
+    }
+}
+
+std::uint32_t ChunkIndex::intern(std::uint64_t fingerprint, std::uint32_t length) {
+    const std::uint64_t key = fingerprint == 0 ? 1 : fingerprint;
+    // At most half full, so probes stay short
+    if ((used + 1) * 2 > keys.size()) {
+        grow();
+    }
+    const size_t mask = keys.size() - 1;
+    size_t slot = slotOf(key, mask);
+    while (keys[slot] != 0) {
+        if (keys[slot] == key) {
+            return ids[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    keys[slot] = key;
+    ids[slot] = static_cast<std::uint32_t>(lengths.size());
+    used++;
+    lengths.push_back(length);
+    unique += length;
+    return ids[slot];
+}
+
+size_t ChunkIndex::addFile(std::uintmax_t size, const std::vector<Chunk>& chunks) {
+    std::vector<std::uint32_t> chunkIds;
+    chunkIds.reserve(chunks.size());
+    for (const auto& chunk : chunks) {
+        chunkIds.push_back(intern(chunk.fingerprint, chunk.length));
+    }
+    std::sort(chunkIds.begin(), chunkIds.end());
+
+    IndexedFile file;
+    file.size = size;
+    for (size_t i = 0; i < chunkIds.size();) {
+        size_t j = i + 1;
+        while (j < chunkIds.size() && chunkIds[j] == chunkIds[i]) {
+            j++;
+        }
+        file.chunks.push_back(Posting{ chunkIds[i], static_cast<std::uint32_t>(j - i) });
+        i = j;
+    }
+    file.chunks.shrink_to_fit();
+    files.push_back(std::move(file));
+    return files.size() - 1;
+}
+
+std::vector<SimilarPair> ChunkIndex::similarPairs(double minRatio, size_t fanoutLimit, size_t& skipped) const {
+    skipped = 0;
+    // Invert the per-file lists into holders per chunk, laid out by chunk id
+    std::vector<std::uint32_t> offsets(lengths.size() + 1, 0);
+    for (const auto& file : files) {
+        for (const auto& posting : file.chunks) {
+            offsets[posting.chunk + 1]++;
+        }
+    }
+    for (size_t i = 1; i < offsets.size(); ++i) {
+        offsets[i] += offsets[i - 1];
+    }
+    std::vector<Holder> holders(offsets.back());
+    std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t f = 0; f < files.size(); ++f) {
+        for (const auto& posting : files[f].chunks) {
+            holders[fill[posting.chunk]++] = Holder{ static_cast<std::uint32_t>(f), posting.count };
+        }
+    }
+
+    // Holders are in file order, so every key has first < second
+    std::unordered_map<std::uint64_t, std::uintmax_t> shared;
+    for (size_t chunk = 0; chunk < lengths.size(); ++chunk) {
+        const size_t begin = offsets[chunk];
+        const size_t end = offsets[chunk + 1];
+        if (end - begin < 2) {
+            continue;
+        }
+        if (end - begin > fanoutLimit) {
+            skipped++;
+            continue;
+        }
+        for (size_t a = begin; a < end; ++a) {
+            for (size_t b = a + 1; b < end; ++b) {
+                const std::uint64_t key = (static_cast<std::uint64_t>(holders[a].file) << 32) | holders[b].file;
+                shared[key] += static_cast<std::uintmax_t>(lengths[chunk]) * std::min(holders[a].count, holders[b].count);
+            }
+        }
+    }
+
+    std::vector<SimilarPair> pairs;
+    for (const auto& entry : shared) {
+        SimilarPair pair;
+        pair.first = static_cast<size_t>(entry.first >> 32);
+        pair.second = static_cast<size_t>(entry.first & 0xffffffffu);
+        pair.sharedBytes = entry.second;
+        const std::uintmax_t larger = std::max(files[pair.first].size, files[pair.second].size);
+        pair.ratio = larger > 0 ? static_cast<double>(pair.sharedBytes) / static_cast<double>(larger) : 0;
+        if (pair.ratio >= minRatio) {
+            pairs.push_back(pair);
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const SimilarPair& a, const SimilarPair& b) {
+        if (a.sharedBytes != b.sharedBytes) {
+            return a.sharedBytes > b.sharedBytes;
+        }
+        return a.first != b.first ? a.first < b.first : a.second < b.second;
+    });
+    return pairs;
+}
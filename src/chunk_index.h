@@ -0,0 +1,58 @@
+#ifndef CHUNK_INDEX_H
+#define CHUNK_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "content_chunker.h"
+
+// Two indexed files that share chunks
+struct SimilarPair {
+    size_t first = 0;               // File indices as returned by addFile, first < second
+    size_t second = 0;
+    std::uintmax_t sharedBytes = 0; // Bytes of chunks both files hold, as often as the rarer holds them
+    double ratio = 0;               // sharedBytes over the size of the larger file
+};
+
+// Chunk fingerprints of many files. Each distinct fingerprint gets a 32-bit chunk id from an
+// open-addressing table of 64-bit keys, and every file keeps its chunk ids with their counts,
+// so a file costs 8 bytes per distinct chunk no matter how large it is.
+class ChunkIndex {
+public:
+    ChunkIndex();
+
+    // Index the chunks of one file; returns its file index
+    size_t addFile(std::uintmax_t size, const std::vector<Chunk>& chunks);
+
+    size_t fileCount() const { return files.size(); }
+    size_t chunkCount() const { return lengths.size(); }
+    // Total size of the distinct chunks, what the indexed files would take deduplicated by chunk
+    std::uintmax_t uniqueBytes() const { return unique; }
+
+    // Pairs sharing at least minRatio of the larger file, most shared bytes first. Chunks held
+    // by more than fanoutLimit files, such as runs of zeros, add a pair per two holders and are
+    // left out; skipped is set to how many were.
+    std::vector<SimilarPair> similarPairs(double minRatio, size_t fanoutLimit, size_t& skipped) const;
+
+private:
+    struct Posting {
+        std::uint32_t chunk;
+        std::uint32_t count;
+    };
+    struct IndexedFile {
+        std::uintmax_t size;
+        std::vector<Posting> chunks;    // Sorted by chunk id
+    };
+
+    std::vector<std::uint64_t> keys;    // 0 marks an empty slot; a zero fingerprint is stored as 1
+    std::vector<std::uint32_t> ids;
+    size_t used = 0;
+    std::vector<std::uint32_t> lengths; // By chunk id
+    std::uintmax_t unique = 0;
+    std::vector<IndexedFile> files;
+
+    std::uint32_t intern(std::uint64_t fingerprint, std::uint32_t length);
+    void grow();
+};
+
+#endif // CHUNK_INDEX_H
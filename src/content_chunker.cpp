@@ -0,0 +1,175 @@
+#include "content_chunker.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// Random value per byte value; any fixed table works, but it decides every cut, so it must
+// never change or chunk fingerprints stop matching across versions
+const std::array<std::uint64_t, 256>& gearTable() {
+    static const std::array<std::uint64_t, 256> table = [] {
+        std::array<std::uint64_t, 256> values{};
+        std::uint64_t state = 0x2545f4914f6cdd1dULL;
+        for (auto& value : values) {
+            // splitmix64
+            std::uint64_t x = (state += 0x9e3779b97f4a7c15ULL);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            value = x ^ (x >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// The same table shifted left once, for the first byte of each two-byte step
+const std::array<std::uint64_t, 256>& shiftedGearTable() {
+    static const std::array<std::uint64_t, 256> table = [] {
+        std::array<std::uint64_t, 256> values{};
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = gearTable()[i] << 1;
+        }
+        return values;
+    }();
+    return table;
+}
+
+// bits one bits spread over the high half of the hash, where every bit depends on more of
+// the window; bit 63 stays clear so the mask survives the shift of a two-byte step
+std::uint64_t spreadMask(unsigned bits) {
+    std::uint64_t mask = 0;
+    const unsigned step = bits > 0 && bits <= 31 ? 2 : 1;
+    for (unsigned i = 0; i < bits && i < 63; ++i) {
+        mask |= std::uint64_t{ 1 } << (62 - i * step);
+    }
+    return mask;
+}
+
+unsigned log2Of(std::size_t value) {
+    unsigned bits = 0;
+    while (value > 1) {
+        value >>= 1;
+        bits++;
+    }
+    return bits;
+}
+
+} // namespace
+
+ChunkParams ChunkParams::forAverage(std::size_t averageSize) {
+    ChunkParams params;
+    params.averageSize = std::max<std::size_t>(averageSize, 256);
+    params.minSize = params.averageSize / 4;
+    params.maxSize = params.averageSize * 8;
+    return params;
+}
+
+ContentChunker::ContentChunker(const ChunkParams& chunkParams) : params(chunkParams) {
+    params.averageSize = std::max<std::size_t>(params.averageSize, 1);
+    params.minSize = std::min(params.minSize, params.averageSize);
+    params.maxSize = std::max(params.maxSize, params.averageSize);
+    // Normalized chunking, level 2: two bits either side of the average
+    const unsigned bits = log2Of(params.averageSize);
+    strictMask = spreadMask(bits + 2);
+    looseMask = spreadMask(bits > 2 ? bits - 2 : 1);
+}
+
+bool ContentChunker::scan(const std::uint8_t* data, std::size_t& i, std::size_t end, std::uint64_t mask) {
+    const std::uint64_t* gear = gearTable().data();
+    const std::uint64_t* shiftedGear = shiftedGearTable().data();
+    const std::uint64_t shiftedMask = mask << 1;
+    std::uint64_t h = hash;
+    // Two bytes per step: halfway, h is the one-byte hash shifted once, so testing it
+    // against the shifted mask is the same test the one-byte loop would make
+    while (i + 1 < end) {
+        h = (h << 2) + shiftedGear[data[i]];
+        if ((h & shiftedMask) == 0) {
+            i += 1;
+            hash = h >> 1;
+            return true;
+        }
+        h += gear[data[i + 1]];
+        i += 2;
+        if ((h & mask) == 0) {
+            hash = h;
+            return true;
+        }
+    }
+    if (i < end) {
+        h = (h << 1) + gear[data[i]];
+        i += 1;
+        if ((h & mask) == 0) {
+            hash = h;
+            return true;
+        }
+    }
+    hash = h;
+    return false;
+}
+
+std::size_t ContentChunker::next(const std::uint8_t* data, std::size_t length, bool& cut) {
+    cut = false;
+    size_t i = 0;
+    if (position < params.minSize) {
+        const size_t skip = std::min(params.minSize - position, length);
+        i = skip;
+        position += skip;
+        if (position < params.minSize) {
+            return i;
+        }
+    }
+    while (i < length) {
+        const bool belowAverage = position < params.averageSize;
+        const size_t limit = belowAverage ? params.averageSize : params.maxSize;
+        const size_t end = i + std::min(length - i, limit - position);
+        const size_t start = i;
+        const bool found = scan(data, i, end, belowAverage ? strictMask : looseMask);
+        position += i - start;
+        if (found || position >= params.maxSize) {
+            cut = true;
+            hash = 0;
+            position = 0;
+            return i;
+        }
+    }
+    return i;
+}
+
+std::vector<Chunk> ContentChunker::chunkFile(const std::string& filePath, HashAlgorithm algorithm,
+                                             const ChunkParams& params, ReadBackend backend,
+                                             std::uintmax_t sizeHint) {
+    std::vector<Chunk> chunks;
+    ContentChunker chunker(params);
+    DigestStream stream(algorithm);
+    std::uint64_t length = 0;
+    auto finishChunk = [&] {
+        const Digest digest = stream.finish();
+        Chunk chunk;
+        std::memcpy(&chunk.fingerprint, digest.bytes.data(), sizeof(chunk.fingerprint));
+        chunk.length = static_cast<std::uint32_t>(length);
+        chunks.push_back(chunk);
+        stream.reset();
+        length = 0;
+    };
+
+    // Chunks are digested as they stream past, so no chunk is ever copied
+    FileReader::readFile(filePath, [&](const void* data, std::size_t size) {
+        const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+        while (size > 0) {
+            bool cut = false;
+            const std::size_t used = chunker.next(bytes, size, cut);
+            stream.update(bytes, used);
+            length += used;
+            bytes += used;
+            size -= used;
+            if (cut) {
+                finishChunk();
+            }
+        }
+    }, backend, sizeHint);
+    if (length > 0) {
+        finishChunk();
+    }
+    return chunks;
+}
@@ -0,0 +1,56 @@
+#ifndef CONTENT_CHUNKER_H
+#define CONTENT_CHUNKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hash_calculator.h"
+
+// Bounds of the chunks the chunker cuts
+struct ChunkParams {
+    std::size_t minSize = 16 * 1024;
+    std::size_t averageSize = 64 * 1024;
+    std::size_t maxSize = 512 * 1024;
+
+    // A quarter of the average as minimum and eight times it as maximum
+    static ChunkParams forAverage(std::size_t averageSize);
+};
+
+// One content-defined chunk of a file
+struct Chunk {
+    std::uint64_t fingerprint = 0;  // First 8 bytes of the chunk's digest
+    std::uint32_t length = 0;
+};
+
+// FastCDC content-defined chunking. A gear hash over the last 64 bytes decides where chunks
+// end, so an insertion or deletion only moves the boundaries near it and the chunks after it
+// line up again. No cut is looked for in the first minSize bytes of a chunk; a stricter mask
+// applies below the average size and a looser one above it, which keeps chunk sizes close to
+// the average. The hash rolls two bytes per iteration and the cuts are identical however the
+// input is split into blocks.
+class ContentChunker {
+public:
+    explicit ContentChunker(const ChunkParams& params);
+
+    // Bytes of data, from its start, that belong to the current chunk; sets cut when the chunk
+    // ends there. Call again with the rest of data until it is used up.
+    std::size_t next(const std::uint8_t* data, std::size_t length, bool& cut);
+
+    // Chunks of a whole file, read through FileReader and fingerprinted with algorithm
+    static std::vector<Chunk> chunkFile(const std::string& filePath, HashAlgorithm algorithm,
+                                        const ChunkParams& params, ReadBackend backend = ReadBackend::AUTO,
+                                        std::uintmax_t sizeHint = UINTMAX_MAX);
+
+private:
+    ChunkParams params;
+    std::uint64_t strictMask;   // Below the average size
+    std::uint64_t looseMask;    // From the average size on
+    std::uint64_t hash = 0;
+    std::size_t position = 0;   // Bytes of the current chunk seen so far
+
+    // Roll over data[i, end); true with i just past the cut when one is found
+    bool scan(const std::uint8_t* data, std::size_t& i, std::size_t end, std::uint64_t mask);
+};
+
+#endif // CONTENT_CHUNKER_H
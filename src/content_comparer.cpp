@@ -0,0 +1,190 @@
+#include "content_comparer.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Read buffers of all members share this budget; each block stays within the limits below
+const std::size_t READ_BUDGET = 8 * 1024 * 1024;
+const std::size_t MIN_BLOCK_SIZE = 64 * 1024;
+const std::size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+// Sequential reader for one member
+class Source {
+public:
+    explicit Source(const std::string& path) {
+#ifndef _WIN32
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+#else
+        stream.rdbuf()->pubsetbuf(nullptr, 0);
+        stream.open(path, std::ios::binary);
+#endif
+    }
+    ~Source() {
+#ifndef _WIN32
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+
+    Source(const Source&) = delete;
+    Source& operator=(const Source&) = delete;
+
+    bool isOpen() const {
+#ifndef _WIN32
+        return fd >= 0;
+#else
+        return stream.is_open();
+#endif
+    }
+
+    // Fill exactly length bytes; false on error or early end of file
+    bool read(char* data, std::size_t length) {
+#ifndef _WIN32
+        while (length > 0) {
+            ssize_t bytes = ::read(fd, data, length);
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                return false;
+            }
+            data += bytes;
+            length -= static_cast<std::size_t>(bytes);
+        }
+        return true;
+#else
+        stream.read(data, static_cast<std::streamsize>(length));
+        return static_cast<std::size_t>(stream.gcount()) == length;
+#endif
+    }
+
+private:
+#ifndef _WIN32
+    int fd = -1;
+#else
+    std::ifstream stream;
+#endif
+};
+
+// Members known to be identical so far, with the digest of the bytes compared up to here
+struct MatchClass {
+    std::vector<size_t> members;
+    std::unique_ptr<DigestStream> digest;
+};
+
+} // namespace
+
+ContentComparer::Result ContentComparer::compare(const std::vector<std::string>& paths, std::uintmax_t size,
+                                                 HashAlgorithm algorithm, bool computeDigests) {
+    const size_t count = paths.size();
+    Result result;
+    result.classOf.assign(count, npos);
+    result.digests.assign(count, Digest());
+    result.errors.assign(count, std::string());
+
+    std::vector<std::unique_ptr<Source>> sources(count);
+    MatchClass initial;
+    for (size_t i = 0; i < count; ++i) {
+        sources[i].reset(new Source(paths[i]));
+        if (sources[i]->isOpen()) {
+            initial.members.push_back(i);
+        } else {
+            result.errors[i] = "Unable to open file";
+        }
+    }
+    if (initial.members.size() < 2) {
+        return result;
+    }
+    if (computeDigests) {
+        initial.digest.reset(new DigestStream(algorithm));
+    }
+
+    const std::size_t blockSize = std::min(MAX_BLOCK_SIZE, std::max(MIN_BLOCK_SIZE, READ_BUDGET / count));
+    std::vector<std::vector<char>> blocks(count);
+    std::vector<MatchClass> classes;
+    classes.push_back(std::move(initial));
+
+    for (std::uintmax_t offset = 0; offset < size && !classes.empty();) {
+        const std::size_t length = static_cast<std::size_t>(std::min<std::uintmax_t>(blockSize, size - offset));
+        std::vector<MatchClass> next;
+        for (auto& matchClass : classes) {
+            std::vector<size_t> remaining;
+            for (size_t member : matchClass.members) {
+                blocks[member].resize(blockSize);
+                if (sources[member]->read(blocks[member].data(), length)) {
+                    remaining.push_back(member);
+                    result.bytesRead += length;
+                } else {
+                    // Shorter than its recorded size: the file changed while being compared
+                    result.errors[member] = "Read failed";
+                }
+            }
+
+            // Peel off the members equal to the first remaining one; memcmp is vectorized by the C library
+            std::vector<MatchClass> children;
+            while (remaining.size() > 1) {
+                const char* leader = blocks[remaining.front()].data();
+                MatchClass same;
+                std::vector<size_t> different;
+                same.members.push_back(remaining.front());
+                for (size_t i = 1; i < remaining.size(); ++i) {
+                    if (std::memcmp(leader, blocks[remaining[i]].data(), length) == 0) {
+                        same.members.push_back(remaining[i]);
+                    } else {
+                        different.push_back(remaining[i]);
+                    }
+                }
+                if (same.members.size() > 1) {
+                    children.push_back(std::move(same));
+                }
+                remaining = std::move(different);
+            }
+
+            // Every child shares the prefix digested so far; only one member per child is hashed on
+            if (computeDigests) {
+                for (size_t c = 1; c < children.size(); ++c) {
+                    children[c].digest.reset(new DigestStream(algorithm));
+                    children[c].digest->copyFrom(*matchClass.digest);
+                }
+                if (!children.empty()) {
+                    children[0].digest = std::move(matchClass.digest);
+                }
+                for (auto& child : children) {
+                    child.digest->update(blocks[child.members.front()].data(), length);
+                }
+            }
+            for (auto& child : children) {
+                next.push_back(std::move(child));
+            }
+        }
+        classes = std::move(next);
+        offset += length;
+    }
+
+    for (size_t c = 0; c < classes.size(); ++c) {
+        Digest digest;
+        if (computeDigests) {
+            digest = classes[c].digest->finish();
+        }
+        for (size_t member : classes[c].members) {
+            result.classOf[member] = c;
+            result.digests[member] = digest;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,30 @@
+#ifndef CONTENT_COMPARER_H
+#define CONTENT_COMPARER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hash_calculator.h"
+
+// Lockstep comparison of same-size files. The members are read side by side one large
+// block at a time and split into classes of identical content as soon as a block
+// differs, so a member that matches nobody stops being read at its first differing
+// block. The algorithm's digest of every surviving class is built along the way from
+// one member per class, so matched files end up with the same digest calculateHash gives.
+class ContentComparer {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    struct Result {
+        std::vector<size_t> classOf;        // Per member: class id, npos when it matched no other member
+        std::vector<Digest> digests;        // Per member: digest of its class; empty when unmatched
+        std::vector<std::string> errors;    // Per member: non-empty when it could not be read
+        std::uintmax_t bytesRead = 0;
+    };
+
+    // Compare files that all have the given size; digests are only filled when computeDigests is set
+    static Result compare(const std::vector<std::string>& paths, std::uintmax_t size,
+                          HashAlgorithm algorithm, bool computeDigests = true);
+};
+
+#endif // CONTENT_COMPARER_H
@@ -0,0 +1,79 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Fixed-size binary digest. Large enough for every supported algorithm (at most 32 bytes),
+// so digests are stored inline and compared with memcmp instead of as heap hex strings.
+struct Digest {
+    std::array<std::uint8_t, 32> bytes{};
+    std::uint8_t length = 0;    // 0 means no digest
+
+    bool empty() const { return length == 0; }
+
+    bool operator==(const Digest& other) const {
+        return length == other.length && std::memcmp(bytes.data(), other.bytes.data(), length) == 0;
+    }
+    bool operator!=(const Digest& other) const { return !(*this == other); }
+    bool operator<(const Digest& other) const {
+        if (length != other.length) {
+            return length < other.length;
+        }
+        return std::memcmp(bytes.data(), other.bytes.data(), length) < 0;
+    }
+
+    // Hex is only produced for output
+    std::string toHex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(length * 2, '0');
+        for (std::uint8_t i = 0; i < length; ++i) {
+            hex[2 * i] = digits[bytes[i] >> 4];
+            hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+        }
+        return hex;
+    }
+
+    // Parse hex of either case; false unless it is a whole number of bytes that fits
+    static bool fromHex(const std::string& hex, Digest& digest) {
+        if (hex.empty() || hex.size() % 2 != 0 || hex.size() / 2 > digest.bytes.size()) {
+            return false;
+        }
+        auto nibble = [](char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        for (std::size_t i = 0; i < hex.size() / 2; ++i) {
+            int high = nibble(hex[2 * i]);
+            int low = nibble(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            digest.bytes[i] = static_cast<std::uint8_t>(high << 4 | low);
+        }
+        digest.length = static_cast<std::uint8_t>(hex.size() / 2);
+        return true;
+    }
+
+    static Digest fromBytes(const void* data, std::size_t size) {
+        Digest digest;
+        digest.length = static_cast<std::uint8_t>(size < digest.bytes.size() ? size : digest.bytes.size());
+        std::memcpy(digest.bytes.data(), data, digest.length);
+        return digest;
+    }
+};
+
+// Digest bytes are already uniformly distributed, so the first word is a good hash
+struct DigestHash {
+    std::size_t operator()(const Digest& digest) const {
+        std::size_t value;
+        std::memcpy(&value, digest.bytes.data(), sizeof(value));
+        return value ^ digest.length;
+    }
+};
+
+#endif // DIGEST_H
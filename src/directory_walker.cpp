@@ -0,0 +1,643 @@
+#include "directory_walker.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#include <system_error>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#endif
+
+namespace {
+
+std::string joinPath(const std::string& directory, const char* name) {
+    std::string path = directory;
+    if (!path.empty() && path.back() != '/') {
+        path += '/';
+    }
+    path += name;
+    return path;
+}
+
+} // namespace
+
+DirectoryWalker::DirectoryWalker(BatchCallback onBatch, ErrorCallback onError)
+    : onBatch(std::move(onBatch)), onError(std::move(onError)) {}
+
+#ifdef __linux__
+
+namespace {
+
+const size_t DIRENT_BUFFER_SIZE = 32 * 1024;
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Layout returned by the getdents64 syscall
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+// Directory fd shared by the subdirectories still waiting to be opened from it
+class DirFd {
+public:
+    explicit DirFd(int fd) : fd(fd) {}
+    ~DirFd() { ::close(fd); }
+    DirFd(const DirFd&) = delete;
+    DirFd& operator=(const DirFd&) = delete;
+    int get() const { return fd; }
+private:
+    int fd;
+};
+
+struct DirTask {
+    std::shared_ptr<DirFd> parent;  // Null for the root
+    std::string name;               // Name relative to parent
+    std::string path;
+    bool follow = false;            // name is a symlink to the directory
+};
+
+// One statx per entry; falls back to fstatat on kernels without statx
+bool statAt(int dirFd, const char* name, bool follow, unsigned& mode, WalkEntry& entry) {
+    const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+#ifdef STATX_BASIC_STATS
+    struct statx stx;
+    if (::statx(dirFd, name, flags, STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) == 0) {
+        mode = stx.stx_mode;
+        entry.size = stx.stx_size;
+        entry.mtime = static_cast<std::int64_t>(stx.stx_mtime.tv_sec) * 1000000000 + stx.stx_mtime.tv_nsec;
+        entry.device = static_cast<std::uint64_t>(makedev(stx.stx_dev_major, stx.stx_dev_minor));
+        entry.inode = stx.stx_ino;
+        return true;
+    }
+    if (errno != ENOSYS) {
+        return false;
+    }
+#endif
+    struct stat st;
+    if (::fstatat(dirFd, name, &st, flags) != 0) {
+        return false;
+    }
+    mode = st.st_mode;
+    entry.size = static_cast<std::uintmax_t>(st.st_size);
+    entry.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    entry.device = static_cast<std::uint64_t>(st.st_dev);
+    entry.inode = static_cast<std::uint64_t>(st.st_ino);
+    return true;
+}
+
+class WalkState {
+public:
+    WalkState(const DirectoryWalker::BatchCallback& onBatch, const DirectoryWalker::ErrorCallback& onError,
+              const DirectoryWalker::ListingCallback& provideListing,
+              const DirectoryWalker::DirectoryCallback& onDirectory, const WalkOptions& options)
+        : onBatch(onBatch), onError(onError), provideListing(provideListing), onDirectory(onDirectory),
+          options(options), filter(options.filter), queues(options.threadCount > 1 ? options.threadCount : 1),
+          batches(queues.size()), counters(queues.size()) {}
+
+    // Sum of the per-thread counters, once run returned
+    WalkCounters totals() const {
+        WalkCounters sum;
+        for (const auto& worker : counters) {
+            sum.directories += worker.directories;
+            sum.entries += worker.entries;
+            sum.stats += worker.stats;
+            sum.listSeconds += worker.listSeconds;
+            sum.statSeconds += worker.statSeconds;
+        }
+        return sum;
+    }
+
+    bool run(const std::string& root) {
+        int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            reportError(root, std::strerror(errno));
+            return false;
+        }
+        auto rootFd = std::make_shared<DirFd>(fd);
+        rootLength = root.size();
+        struct stat st;
+        if (filter && filter->rules().sameFilesystem && ::fstat(fd, &st) == 0) {
+            rootDevice = static_cast<std::uint64_t>(st.st_dev);
+        }
+
+        if (queues.size() == 1) {
+            visit(rootFd, root, 0);
+            flush(0);
+            return true;
+        }
+
+        pending = 1;
+        {
+            std::lock_guard<std::mutex> lock(queues[0].mutex);
+            queues[0].tasks.push_back(DirTask{ nullptr, std::string(), root });
+        }
+        rootDir = rootFd;
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < queues.size(); ++i) {
+            threads.emplace_back([this, i] { workerLoop(i); });
+        }
+        workerLoop(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return true;
+    }
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<DirTask> tasks;
+    };
+
+    const DirectoryWalker::BatchCallback& onBatch;
+    const DirectoryWalker::ErrorCallback& onError;
+    const DirectoryWalker::ListingCallback& provideListing;
+    const DirectoryWalker::DirectoryCallback& onDirectory;
+    const WalkOptions& options;
+    const WalkFilter* filter;
+    size_t rootLength = 0;
+    std::uint64_t rootDevice = 0;
+    // Directories already walked, by device and inode, when linked directories are followed
+    std::mutex visitedMutex;
+    std::set<std::pair<std::uint64_t, std::uint64_t>> visited;
+    std::vector<WorkQueue> queues;
+    std::vector<std::vector<WalkEntry>> batches;
+    std::vector<WalkCounters> counters;     // One per worker, so they need no lock
+    std::mutex deliverMutex;
+    std::atomic<size_t> pending{0};
+    std::shared_ptr<DirFd> rootDir;
+
+    void workerLoop(size_t worker) {
+        size_t idleRounds = 0;
+        while (true) {
+            DirTask task;
+            if (popLocal(worker, task) || steal(worker, task)) {
+                idleRounds = 0;
+                const auto started = std::chrono::steady_clock::now();
+                std::shared_ptr<DirFd> dir = task.parent ? openChild(*task.parent, task.name, task.path, task.follow) : rootDir;
+                counters[worker].listSeconds += secondsSince(started);
+                task.parent.reset();
+                if (dir) {
+                    visit(dir, task.path, worker);
+                }
+                pending.fetch_sub(1);
+                continue;
+            }
+            if (pending.load() == 0) {
+                break;
+            }
+            // Another worker is still listing a directory that may produce work
+            if (++idleRounds < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+        flush(worker);
+    }
+
+    // Owners work depth first from the back; thieves take the oldest, largest subtrees
+    bool popLocal(size_t worker, DirTask& task) {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        if (queues[worker].tasks.empty()) {
+            return false;
+        }
+        task = std::move(queues[worker].tasks.back());
+        queues[worker].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t worker, DirTask& task) {
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue& victim = queues[(worker + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::shared_ptr<DirFd> openChild(const DirFd& parent, const std::string& name, const std::string& path,
+                                     bool follow) {
+        int fd = ::openat(parent.get(), name.c_str(), O_RDONLY | O_DIRECTORY | (follow ? 0 : O_NOFOLLOW) | O_CLOEXEC);
+        if (fd < 0) {
+            reportError(path, std::strerror(errno));
+            return nullptr;
+        }
+        return std::make_shared<DirFd>(fd);
+    }
+
+    bool stopping() const {
+        return options.stop && options.stop->load(std::memory_order_relaxed);
+    }
+
+    SymlinkPolicy symlinkPolicy() const {
+        return filter ? filter->rules().symlinks : SymlinkPolicy::FILES;
+    }
+
+    // Once links are followed a directory can be reached by several paths, or from inside itself
+    bool firstVisit(int fd) {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(visitedMutex);
+        return visited.emplace(static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino)).second;
+    }
+
+    void visit(const std::shared_ptr<DirFd>& dir, const std::string& path, size_t worker) {
+        if (stopping()) {
+            return;
+        }
+        if (symlinkPolicy() == SymlinkPolicy::ALL && !firstVisit(dir->get())) {
+            return;
+        }
+        counters[worker].directories++;
+        const bool tracking = provideListing || onDirectory;
+        DirectoryStamp stamp;
+        if (tracking) {
+            readStamp(dir->get(), stamp);
+        }
+
+        DirectoryListing seen;
+        DirectoryListing known;
+        if (provideListing && provideListing(path, stamp, known)) {
+            // Unchanged directory: no getdents, but every file is still stat'ed. Files are
+            // replayed untyped, so a link is told apart from its target and resolved again.
+            counters[worker].entries += known.entries.size();
+            for (const auto& entry : known.entries) {
+                handleEntry(dir, path, entry.name.c_str(), entry.directory ? DT_DIR : DT_UNKNOWN, worker, &seen);
+            }
+        } else {
+            readEntries(dir, path, worker, tracking ? &seen : nullptr);
+        }
+
+        if (onDirectory) {
+            std::lock_guard<std::mutex> lock(deliverMutex);
+            onDirectory(path, stamp, seen);
+        }
+    }
+
+    void readEntries(const std::shared_ptr<DirFd>& dir, const std::string& path, size_t worker,
+                     DirectoryListing* seen) {
+        std::vector<char> buffer(DIRENT_BUFFER_SIZE);
+        while (!stopping()) {
+            const auto started = std::chrono::steady_clock::now();
+            long bytes = ::syscall(SYS_getdents64, dir->get(), buffer.data(), buffer.size());
+            counters[worker].listSeconds += secondsSince(started);
+            if (bytes < 0) {
+                reportError(path, std::strerror(errno));
+                return;
+            }
+            if (bytes == 0) {
+                return;
+            }
+            for (long offset = 0; offset < bytes;) {
+                const auto* dirent = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+                offset += dirent->d_reclen;
+                const char* name = dirent->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+                counters[worker].entries++;
+                handleEntry(dir, path, name, dirent->d_type, worker, seen);
+            }
+        }
+    }
+
+    static void readStamp(int fd, DirectoryStamp& stamp) {
+        struct stat st;
+        if (::fstat(fd, &st) == 0) {
+            stamp.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+            stamp.device = static_cast<std::uint64_t>(st.st_dev);
+            stamp.inode = static_cast<std::uint64_t>(st.st_ino);
+        }
+        struct timespec now;
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        stamp.listedAt = static_cast<std::int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    // Listings record every file, link and directory whatever the filter skips, so a
+    // reused listing is complete under any later filter
+    void handleEntry(const std::shared_ptr<DirFd>& dir, const std::string& path, const char* name,
+                     unsigned char type, size_t worker, DirectoryListing* seen) {
+        const SymlinkPolicy symlinks = symlinkPolicy();
+        WalkEntry entry;
+        unsigned mode = 0;
+        bool link = type == DT_LNK;
+        bool isDirectory = type == DT_DIR;
+        if (link && symlinks == SymlinkPolicy::NONE) {
+            if (seen) {
+                seen->entries.push_back(DirectoryListing::Entry{ name, false });
+            }
+            return;
+        }
+        if (type == DT_REG || type == DT_LNK || type == DT_UNKNOWN) {
+            // Regular files skip the symlink lookup; links are resolved to their target
+            if (!statEntry(dir->get(), name, link, mode, entry, worker)) {
+                if (!link) {
+                    reportError(joinPath(path, name), std::strerror(errno));
+                }
+                return;
+            }
+            if (type == DT_UNKNOWN && S_ISLNK(mode)) {
+                link = true;
+                if (symlinks == SymlinkPolicy::NONE) {
+                    if (seen) {
+                        seen->entries.push_back(DirectoryListing::Entry{ name, false });
+                    }
+                    return;
+                }
+                if (!statEntry(dir->get(), name, true, mode, entry, worker)) {
+                    return;
+                }
+            }
+            if (S_ISREG(mode)) {
+                if (seen) {
+                    seen->entries.push_back(DirectoryListing::Entry{ name, false });
+                }
+                entry.symlink = link;
+                addEntry(path, name, entry, worker);
+                return;
+            }
+            isDirectory = S_ISDIR(mode) && (!link || symlinks == SymlinkPolicy::ALL);
+        }
+        if (!isDirectory) {
+            return;
+        }
+        if (seen) {
+            // A linked directory is listed as a link, to be resolved again when replayed
+            seen->entries.push_back(DirectoryListing::Entry{ name, !link });
+        }
+        if (!options.recursive) {
+            return;
+        }
+
+        std::string childPath = joinPath(path, name);
+        if (filter) {
+            if (filter->skipsDirectory(FilterPath::split(childPath, rootLength))) {
+                return;
+            }
+            // Entries typed by getdents carry no device yet; a stat is cheaper than an open
+            if (filter->rules().sameFilesystem &&
+                ((type == DT_DIR && !statEntry(dir->get(), name, false, mode, entry, worker)) ||
+                 entry.device != rootDevice)) {
+                return;
+            }
+        }
+        if (queues.size() == 1) {
+            // Single-threaded walks descend immediately so files come out in directory order
+            const auto started = std::chrono::steady_clock::now();
+            std::shared_ptr<DirFd> child = openChild(*dir, name, childPath, link);
+            counters[worker].listSeconds += secondsSince(started);
+            if (child) {
+                visit(child, childPath, worker);
+            }
+            return;
+        }
+        pending.fetch_add(1);
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        queues[worker].tasks.push_back(DirTask{ dir, name, std::move(childPath), link });
+    }
+
+    bool statEntry(int dirFd, const char* name, bool follow, unsigned& mode, WalkEntry& entry, size_t worker) {
+        const auto started = std::chrono::steady_clock::now();
+        const bool found = statAt(dirFd, name, follow, mode, entry);
+        counters[worker].stats++;
+        counters[worker].statSeconds += secondsSince(started);
+        return found;
+    }
+
+    void addEntry(const std::string& path, const char* name, WalkEntry& entry, size_t worker) {
+        if (filter) {
+            if (filter->rules().sameFilesystem && entry.device != rootDevice) {
+                return;
+            }
+            FilterPath filterPath;
+            if (filter->needsPath()) {
+                entry.path = joinPath(path, name);
+                filterPath = FilterPath::split(entry.path, rootLength);
+            } else {
+                filterPath.name = name;
+            }
+            if (filter->skipsFile(filterPath, entry.size)) {
+                return;
+            }
+        }
+        if (entry.path.empty()) {
+            entry.path = joinPath(path, name);
+        }
+        batches[worker].push_back(std::move(entry));
+        if (batches[worker].size() >= options.batchSize) {
+            flush(worker);
+        }
+    }
+
+    void flush(size_t worker) {
+        if (batches[worker].empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(deliverMutex);
+        onBatch(batches[worker]);
+        batches[worker].clear();
+    }
+
+    void reportError(const std::string& path, const std::string& message) {
+        std::lock_guard<std::mutex> lock(deliverMutex);
+        onError(path, message);
+    }
+};
+
+} // namespace
+
+bool DirectoryWalker::walk(const std::string& root, const WalkOptions& options) {
+    WalkState state(onBatch, onError, provideListing, onDirectory, options);
+    const bool opened = state.run(root);
+    totals = state.totals();
+    return opened;
+}
+
+bool DirectoryWalker::statFile(const std::string& path, WalkEntry& entry) {
+    unsigned mode = 0;
+    if (!statAt(AT_FDCWD, path.c_str(), false, mode, entry)) {
+        return false;
+    }
+    entry.symlink = S_ISLNK(mode);
+    if ((entry.symlink && !statAt(AT_FDCWD, path.c_str(), true, mode, entry)) || !S_ISREG(mode)) {
+        return false;
+    }
+    entry.path = path;
+    return true;
+}
+
+#else
+
+namespace fs = std::filesystem;
+
+// Portable walk through std::filesystem; always single-threaded
+bool DirectoryWalker::walk(const std::string& root, const WalkOptions& options) {
+    std::error_code ec;
+    std::vector<WalkEntry> batch;
+    totals = WalkCounters();
+    const WalkFilter* filter = options.filter;
+    const SymlinkPolicy symlinks = filter ? filter->rules().symlinks : SymlinkPolicy::FILES;
+    auto stopping = [&options] { return options.stop && options.stop->load(std::memory_order_relaxed); };
+#ifndef _WIN32
+    struct stat rootStat = {};
+    ::stat(root.c_str(), &rootStat);
+    // Directories already walked, by device and inode, when linked directories are followed
+    std::set<std::pair<std::uint64_t, std::uint64_t>> visited;
+    visited.emplace(static_cast<std::uint64_t>(rootStat.st_dev), static_cast<std::uint64_t>(rootStat.st_ino));
+#endif
+    // Whether to enter a directory; the filter's device and link rules need a stat
+    auto enter = [&](const std::string& path) {
+        if (!filter) {
+            return true;
+        }
+        if (filter->skipsDirectory(FilterPath::split(path, root.size()))) {
+            return false;
+        }
+#ifndef _WIN32
+        if (filter->rules().sameFilesystem || symlinks == SymlinkPolicy::ALL) {
+            struct stat st;
+            if (::stat(path.c_str(), &st) != 0) {
+                return false;
+            }
+            if (filter->rules().sameFilesystem && st.st_dev != rootStat.st_dev) {
+                return false;
+            }
+            if (symlinks == SymlinkPolicy::ALL &&
+                !visited.emplace(static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino)).second) {
+                return false;
+            }
+        }
+#endif
+        return true;
+    };
+    // Returns false when the iterator must not descend into the entry
+    auto handle = [&](const fs::directory_entry& item) {
+        std::error_code fileError;
+        WalkEntry entry;
+        totals.entries++;
+        const bool link = item.is_symlink(fileError);
+        if (link && symlinks == SymlinkPolicy::NONE) {
+            return false;
+        }
+        if (item.is_directory(fileError)) {
+            if (link && symlinks != SymlinkPolicy::ALL) {
+                return false;
+            }
+            if (!enter(item.path().string())) {
+                return false;
+            }
+            totals.directories++;
+            return true;
+        }
+        if (item.is_regular_file(fileError) && statFile(item.path().string(), entry)) {
+            totals.stats++;
+            entry.symlink = link;
+#ifndef _WIN32
+            if (filter && filter->rules().sameFilesystem && entry.device != static_cast<std::uint64_t>(rootStat.st_dev)) {
+                return false;
+            }
+#endif
+            if (filter && filter->skipsFile(FilterPath::split(entry.path, root.size()), entry.size)) {
+                return false;
+            }
+            batch.push_back(std::move(entry));
+            if (batch.size() >= options.batchSize) {
+                onBatch(batch);
+                batch.clear();
+            }
+        }
+        return false;
+    };
+
+    if (options.recursive) {
+        fs::directory_options iteratorOptions = fs::directory_options::skip_permission_denied;
+        if (symlinks == SymlinkPolicy::ALL) {
+            iteratorOptions |= fs::directory_options::follow_directory_symlink;
+        }
+        fs::recursive_directory_iterator it(root, iteratorOptions, ec);
+        if (ec) {
+            onError(root, ec.message());
+            return false;
+        }
+        for (; it != fs::recursive_directory_iterator() && !stopping(); it.increment(ec)) {
+            if (ec) {
+                onError(root, ec.message());
+                break;
+            }
+            if (!handle(*it)) {
+                it.disable_recursion_pending();
+            }
+        }
+    } else {
+        fs::directory_iterator it(root, ec);
+        if (ec) {
+            onError(root, ec.message());
+            return false;
+        }
+        for (; it != fs::directory_iterator() && !stopping(); it.increment(ec)) {
+            if (ec) {
+                onError(root, ec.message());
+                break;
+            }
+            handle(*it);
+        }
+    }
+    if (!batch.empty()) {
+        onBatch(batch);
+    }
+    return true;
+}
+
+bool DirectoryWalker::statFile(const std::string& path, WalkEntry& entry) {
+    std::error_code ec;
+    entry.size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    entry.mtime = static_cast<std::int64_t>(fs::last_write_time(path, ec).time_since_epoch().count());
+    if (ec) {
+        return false;
+    }
+#ifndef _WIN32
+    struct stat st;
+    if (::stat(path.c_str(), &st) == 0) {
+        entry.device = static_cast<std::uint64_t>(st.st_dev);
+        entry.inode = static_cast<std::uint64_t>(st.st_ino);
+    }
+#endif
+    entry.symlink = fs::is_symlink(fs::symlink_status(path, ec));
+    entry.path = path;
+    return true;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "walk_filter.h"
+
+// Metadata for one regular file, gathered from a single statx call
+struct WalkEntry {
+    std::string path;
+    std::uintmax_t size = 0;
+    std::int64_t mtime = 0;     // Nanoseconds since the Unix epoch (file clock ticks on Windows)
+    std::uint64_t device = 0;   // 0 when the platform does not report device/inode
+    std::uint64_t inode = 0;
+    bool symlink = false;       // Reached through a symbolic link; device and inode are its target's
+};
+
+// Identity of a directory's contents: any entry added, removed or renamed changes its mtime
+struct DirectoryStamp {
+    std::int64_t mtime = 0;     // Nanoseconds since the Unix epoch
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::int64_t listedAt = 0;  // Wall clock time the directory was listed, same units
+};
+
+// Regular files (or links to them) and subdirectories found in one directory, in directory order
+struct DirectoryListing {
+    struct Entry {
+        std::string name;
+        bool directory;
+    };
+    std::vector<Entry> entries;
+};
+
+// Where a walk spent its time; the seconds are summed over walker threads
+struct WalkCounters {
+    size_t directories = 0;
+    size_t entries = 0;         // Names listed, or taken from a reused listing
+    size_t stats = 0;           // statx calls
+    double listSeconds = 0;     // Opening and reading directories
+    double statSeconds = 0;
+};
+
+struct WalkOptions {
+    bool recursive = true;
+    // Walker threads; subtrees are shared by work stealing when more than one
+    size_t threadCount = 1;
+    // Entries handed to the callback at a time
+    size_t batchSize = 256;
+    // Once set, no further directory is read and the walk returns early
+    const std::atomic<bool>* stop = nullptr;
+    // Files it skips are never reported and directories it excludes are never opened;
+    // null walks everything
+    const WalkFilter* filter = nullptr;
+};
+
+// Directory walker built on getdents64 and statx relative to directory fds. A single
+// thread visits entries in directory order, descending into each subdirectory where it
+// appears; parallel walks give no ordering guarantee. Unless the filter's symlink policy
+// says otherwise, directory symlinks are not followed and symlinks to regular files are
+// reported as files.
+class DirectoryWalker {
+public:
+    // Called with batches of files; calls are serialized even when walking in parallel
+    using BatchCallback = std::function<void(std::vector<WalkEntry>& batch)>;
+    using ErrorCallback = std::function<void(const std::string& path, const std::string& message)>;
+    // Fill listing and return true to skip reading a directory; may be called concurrently
+    using ListingCallback = std::function<bool(const std::string& path, const DirectoryStamp& stamp,
+                                               DirectoryListing& listing)>;
+    // Reports every visited directory with what it held; calls are serialized
+    using DirectoryCallback = std::function<void(const std::string& path, const DirectoryStamp& stamp,
+                                                 const DirectoryListing& listing)>;
+
+    DirectoryWalker(BatchCallback onBatch, ErrorCallback onError);
+
+    // Reused listings still get every file stat'ed, so in-place modifications are seen.
+    // Only the Linux walker consults these callbacks.
+    void setListingProvider(ListingCallback callback) { provideListing = std::move(callback); }
+    void setDirectoryObserver(DirectoryCallback callback) { onDirectory = std::move(callback); }
+
+    // Walk root; returns false when root itself could not be opened
+    bool walk(const std::string& root, const WalkOptions& options);
+
+    // Fill entry for one path the same way the walker does; false if it cannot be read
+    static bool statFile(const std::string& path, WalkEntry& entry);
+
+    // Totals of the last walk; only the Linux walker times its system calls
+    const WalkCounters& counters() const { return totals; }
+
+private:
+    BatchCallback onBatch;
+    ErrorCallback onError;
+    ListingCallback provideListing;
+    DirectoryCallback onDirectory;
+    WalkCounters totals;
+};
+
+#endif // DIRECTORY_WALKER_H
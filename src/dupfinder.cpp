@@ -0,0 +1,124 @@
+#include "dupfinder/dupfinder.h"
+#include <ostream>
+#include "file_scanner.h"
+
+namespace dupfinder {
+
+namespace {
+
+HashAlgorithm toHashAlgorithm(Algorithm algorithm) {
+    switch (algorithm) {
+        case Algorithm::MD5: return HashAlgorithm::MD5;
+        case Algorithm::SHA256: return HashAlgorithm::SHA256;
+        case Algorithm::XXH3_128: return HashAlgorithm::XXH3_128;
+        case Algorithm::BLAKE3: return HashAlgorithm::BLAKE3;
+    }
+    return HashAlgorithm::SHA256;
+}
+
+GroupVerification toVerification(Verification verification) {
+    switch (verification) {
+        case Verification::NONE: return GroupVerification::NONE;
+        case Verification::SHA256: return GroupVerification::SHA256;
+        case Verification::BYTE_COMPARE: return GroupVerification::BYTE_COMPARE;
+    }
+    return GroupVerification::NONE;
+}
+
+SymlinkPolicy toSymlinkPolicy(Symlinks symlinks) {
+    switch (symlinks) {
+        case Symlinks::FILES: return SymlinkPolicy::FILES;
+        case Symlinks::NONE: return SymlinkPolicy::NONE;
+        case Symlinks::ALL: return SymlinkPolicy::ALL;
+    }
+    return SymlinkPolicy::FILES;
+}
+
+ScanOptions toScanOptions(const ScanConfig& config) {
+    ScanOptions options;
+    options.filters.minSize = config.minFileSize;
+    options.filters.maxSize = config.maxFileSize;
+    options.filters.includeGlobs = config.includeGlobs;
+    options.filters.excludeGlobs = config.excludeGlobs;
+    options.filters.excludeDirectories = config.excludeDirectories;
+    options.filters.sameFilesystem = config.sameFilesystem;
+    options.filters.symlinks = toSymlinkPolicy(config.symlinks);
+    options.threadCount = config.threads;
+    options.walkThreads = config.walkThreads;
+    options.deviceReadLimit = config.deviceReadLimit;
+    options.partialHashWindow = config.partialHashWindow;
+    options.compareBucketLimit = config.compareBucketLimit;
+    options.verification = toVerification(config.verification);
+    options.hashCachePath = config.hashCachePath;
+    options.snapshotPath = config.snapshotPath;
+    options.streamingMemoryBudget = config.streamingMemoryBudget;
+    options.similarityMinSize = config.similarityMinSize;
+    options.chunkAverageSize = config.chunkAverageSize;
+    options.similarityThreshold = config.similarityThreshold;
+    options.useIoUring = config.useIoUring;
+    options.progressIntervalMs = config.progressIntervalMs;
+    return options;
+}
+
+} // namespace
+
+struct Scanner::Impl {
+    FileScanner scanner;
+    // No stream buffer: everything written to it is dropped
+    std::ostream nullLog{ nullptr };
+};
+
+Scanner::Scanner() : impl(std::make_unique<Impl>()) {}
+
+Scanner::~Scanner() = default;
+
+ScanSummary Scanner::scan(const ScanConfig& config, const ScanCallbacks& callbacks, const CancellationToken& token) {
+    ScanOptions options = toScanOptions(config);
+    options.cancelFlag = token.flag;
+    FileScanner& scanner = impl->scanner;
+    scanner.setOptions(options);
+    scanner.setLogStream(config.log ? *config.log : impl->nullLog);
+
+    size_t delivered = 0;
+    if (callbacks.onGroup) {
+        scanner.setGroupCallback([&callbacks, &delivered](const FileTable& files, const FileGroup& group) {
+            DuplicateGroup record;
+            record.id = ++delivered;
+            record.size = files.fileSize(group[0]);
+            record.digest = files.hash(group[0]).toHex();
+            for (size_t index : group) {
+                record.paths.push_back(files.path(index));
+            }
+            callbacks.onGroup(record);
+        });
+    } else {
+        scanner.setGroupCallback(nullptr);
+    }
+    const GroupList& groups = scanner.findDuplicates(config.roots, toHashAlgorithm(config.algorithm),
+                                                     config.recursive);
+    const auto& similarFiles = scanner.getSimilarFiles();
+    if (callbacks.onSimilar) {
+        for (const auto& pair : similarFiles) {
+            callbacks.onSimilar(SimilarFiles{ pair.first, pair.second, pair.firstSize, pair.secondSize,
+                                              pair.sharedBytes, pair.ratio });
+        }
+    }
+
+    const ScanStatistics& statistics = scanner.getStatistics();
+    ScanSummary summary;
+    summary.filesScanned = statistics.filesWalked;
+    summary.bytesScanned = statistics.bytesWalked;
+    summary.duplicateGroups = groups.size();
+    summary.duplicateBytes = statistics.duplicateBytes;
+    summary.reclaimableBytes = statistics.reclaimableBytes;
+    summary.similarPairs = similarFiles.size();
+    summary.seconds = statistics.seconds;
+    summary.cancelled = statistics.cancelled;
+    return summary;
+}
+
+bool Scanner::isAvailable(Algorithm algorithm) {
+    return HashCalculator::isAvailable(toHashAlgorithm(algorithm));
+}
+
+} // namespace dupfinder
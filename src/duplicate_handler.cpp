@@ -1,152 +1,595 @@
 #include "duplicate_handler.h"
-#include <filesystem>
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
+#include <system_error>
 
-bool DuplicateHandler::deleteDuplicate(const std::string& filePath) {
-    try {
-        if (std::filesystem::remove(filePath)) {
-            std::cout << "Deleted: " << filePath << std::endl;
-            return true;
-        } else {
-            std::cerr << "Error deleting file: " << filePath << std::endl;
-            return false;
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Exception deleting file " << filePath << ": " << e.what() << std::endl;
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// A name taken between the listing and the operation is retried under the next free name
+const unsigned NAME_ATTEMPTS = 8;
+
+// Temporary link names sit next to the duplicate so the rename stays within one directory
+const char* const TEMP_LINK_SUFFIX = ".dfflink";
+
+// Rename that fails with EEXIST instead of replacing an existing target where the kernel
+// supports it; elsewhere the name reservation alone prevents clobbering
+bool renameNoReplace(const std::filesystem::path& from, const std::filesystem::path& to, std::error_code& ec) {
+#if defined(__linux__) && defined(SYS_renameat2)
+    static const unsigned RENAME_NOREPLACE_FLAG = 1;
+    if (::syscall(SYS_renameat2, AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE_FLAG) == 0) {
+        ec.clear();
+        return true;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        ec.assign(errno, std::generic_category());
         return false;
     }
+#endif
+    std::filesystem::rename(from, to, ec);
+    return !ec;
+}
+
+#ifdef FIDEDUPERANGE
+// One request must fit in a page, and btrfs dedupes at most 16 MiB per call
+const size_t DEDUPE_MAX_TARGETS = (4096 - sizeof(file_dedupe_range)) / sizeof(file_dedupe_range_info);
+const std::uint64_t DEDUPE_CHUNK = 16 * 1024 * 1024;
+#endif
+
+} // namespace
+
+bool DuplicateHandler::deleteDuplicate(const std::string& filePath) {
+    Outcome outcome = removeFile(filePath);
+    report(outcome);
+    return outcome.ok;
 }
 
 bool DuplicateHandler::moveDuplicate(const std::string& filePath, const std::string& targetDirectory) {
-    try {
-        std::filesystem::path sourcePath(filePath);
-        std::filesystem::path targetPath(targetDirectory);
-        
-        // Create target directory if it doesn't exist
-        if (!std::filesystem::exists(targetPath)) {
-            std::filesystem::create_directories(targetPath);
-        }
-        
-        std::filesystem::path newFilePath = targetPath / sourcePath.filename();
-        
-        // Handle name conflicts
-        int counter = 1;
-        std::filesystem::path finalPath = newFilePath;
-        while (std::filesystem::exists(finalPath)) {
-            std::string stem = newFilePath.stem().string();
-            std::string extension = newFilePath.extension().string();
-            finalPath = targetPath / (stem + "_" + std::to_string(counter) + extension);
-            counter++;
-        }
-        
-        std::filesystem::rename(sourcePath, finalPath);
-        std::cout << "Moved: " << filePath << " to " << finalPath << std::endl;
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Exception moving file " << filePath << ": " << e.what() << std::endl;
-        return false;
-    }
+    Outcome outcome = moveFile(filePath, targetDirectory);
+    report(outcome);
+    return outcome.ok;
 }
 
 bool DuplicateHandler::createHardLink(const std::string& originalPath, const std::string& linkPath) {
-    try {
-        std::filesystem::path linkDir = std::filesystem::path(linkPath).parent_path();
-        if (!std::filesystem::exists(linkDir)) {
-            std::filesystem::create_directories(linkDir);
-        }
-        
-        std::filesystem::create_hard_link(originalPath, linkPath);
-        std::cout << "Created hard link: " << linkPath << " for " << originalPath << std::endl;
+    std::error_code ec;
+    std::filesystem::path linkDir = std::filesystem::path(linkPath).parent_path();
+    if (!linkDir.empty()) {
+        std::filesystem::create_directories(linkDir, ec);
+    }
+    if (!ec) {
+        std::filesystem::create_hard_link(originalPath, linkPath, ec);
+    }
+    Outcome outcome;
+    outcome.ok = !ec;
+    outcome.message = ec ? "Exception creating hard link for " + originalPath + ": " + ec.message()
+                         : "Created hard link: " + linkPath + " for " + originalPath;
+    report(outcome);
+    return outcome.ok;
+}
+
+bool DuplicateHandler::applyAction(const std::string& keepPath, const std::string& filePath,
+                                   DuplicateAction action, const std::string& targetDirectory) {
+    if (action == DuplicateAction::SHOW_ONLY) {
         return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Exception creating hard link for " << originalPath << ": " << e.what() << std::endl;
-        return false;
     }
+    Outcome outcome = perform(PlannedAction{ keepPath, filePath }, action, targetDirectory);
+    report(outcome);
+    return outcome.ok;
 }
 
-void DuplicateHandler::handleDuplicates(const std::vector<std::string>& duplicateFiles, 
-                                       DuplicateAction action, 
-                                       const std::string& targetDirectory) {
-    if (duplicateFiles.size() <= 1) {
+ActionReport DuplicateHandler::executePlan(const std::vector<PlannedAction>& plan, DuplicateAction action,
+                                           const std::string& targetDirectory) {
+    size_t workers = std::min(concurrency, plan.size());
+    if (action == DuplicateAction::REFLINK) {
+        std::unordered_set<std::string> keptFiles;
+        for (const auto& item : plan) {
+            keptFiles.insert(item.keepPath);
+        }
+        workers = std::min(concurrency, keptFiles.size());
+    }
+    beginPlan(action, targetDirectory, workers);
+    addToPlan(plan);
+    return finishPlan();
+}
+
+void DuplicateHandler::beginPlan(DuplicateAction action, const std::string& targetDirectory, size_t workers) {
+    run = std::make_unique<PlanRun>();
+    run->action = action;
+    run->targetDirectory = targetDirectory;
+    run->workers = workers > 0 ? std::min(workers, concurrency) : concurrency;
+    run->started = std::chrono::steady_clock::now();
+}
+
+void DuplicateHandler::addToPlan(std::vector<PlannedAction> items) {
+    if (items.empty()) {
+        return;
+    }
+    run->batches.push_back(std::make_unique<PlanBatch>());
+    PlanBatch& batch = *run->batches.back();
+    batch.items = std::move(items);
+    batch.outcomes.resize(batch.items.size());
+    if (run->action == DuplicateAction::SHOW_ONLY) {
         return;
     }
-    
-    std::cout << "\nFound " << duplicateFiles.size() << " duplicate files:" << std::endl;
-    for (size_t i = 0; i < duplicateFiles.size(); ++i) {
-        std::cout << "  " << i + 1 << ". " << duplicateFiles[i] << std::endl;
+
+    // Operations are independent once their names are reserved, so metadata latency overlaps;
+    // the queue bound keeps at most twice the concurrency outstanding
+    using Clock = std::chrono::steady_clock;
+    if (!run->pool) {
+        run->pool = std::make_unique<WorkerPool>(run->workers, run->workers);
+    }
+    PlanRun& current = *run;
+    auto timed = [&current](Clock::time_point started) {
+        current.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count();
+    };
+    if (current.action == DuplicateAction::REFLINK) {
+        // Items sharing a kept file go out together, in order of first appearance
+        std::unordered_map<std::string, size_t> groupOf;
+        std::vector<std::vector<size_t>> groups;
+        for (size_t i = 0; i < batch.items.size(); ++i) {
+            auto inserted = groupOf.emplace(batch.items[i].keepPath, groups.size());
+            if (inserted.second) {
+                groups.emplace_back();
+            }
+            groups[inserted.first->second].push_back(i);
+        }
+        for (auto& group : groups) {
+            current.pool->submit([this, &batch, group = std::move(group), timed](size_t) {
+                const Clock::time_point started = Clock::now();
+                reflinkGroup(batch.items, group, batch.outcomes);
+                timed(started);
+            });
+        }
+    } else {
+        for (size_t i = 0; i < batch.items.size(); ++i) {
+            current.pool->submit([this, &batch, &current, i, timed](size_t) {
+                const Clock::time_point started = Clock::now();
+                batch.outcomes[i] = perform(batch.items[i], current.action, current.targetDirectory);
+                timed(started);
+            });
+        }
+    }
+}
+
+ActionReport DuplicateHandler::finishPlan() {
+    std::unique_ptr<PlanRun> finished = std::move(run);
+    ActionReport result;
+    size_t total = 0;
+    for (const auto& batch : finished->batches) {
+        total += batch->items.size();
+    }
+    result.results.assign(total, finished->action == DuplicateAction::SHOW_ONLY);
+    if (finished->action == DuplicateAction::SHOW_ONLY || total == 0) {
+        result.succeeded = finished->action == DuplicateAction::SHOW_ONLY ? total : 0;
+        return result;
+    }
+
+    finished->pool->wait();
+    result.workers = finished->pool->size();
+    finished->pool.reset();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - finished->started).count();
+    result.busySeconds = static_cast<double>(finished->busyNanos.load()) / 1e9;
+
+    size_t position = 0;
+    for (const auto& batch : finished->batches) {
+        for (const Outcome& outcome : batch->outcomes) {
+            report(outcome);
+            result.results[position++] = outcome.ok;
+            result.bytesShared += outcome.bytesShared;
+            if (outcome.ok) {
+                ++result.succeeded;
+            } else {
+                ++result.failed;
+            }
+        }
+    }
+    if (verbose && total > 1) {
+        std::cout << "Processed " << total << " duplicates: " << result.succeeded << " succeeded, "
+                  << result.failed << " failed" << '\n';
+    }
+    if (verbose && finished->action == DuplicateAction::REFLINK) {
+        std::cout << "Extents shared: " << result.bytesShared << " bytes" << '\n';
+    }
+    return result;
+}
+
+std::vector<PlannedAction> DuplicateHandler::planGroup(const std::vector<std::string>& duplicateFiles) const {
+    std::vector<PlannedAction> plan;
+    if (duplicateFiles.size() <= 1) {
+        return plan;
+    }
+
+    if (verbose) {
+        std::cout << "\nFound " << duplicateFiles.size() << " duplicate files:" << '\n';
+        for (size_t i = 0; i < duplicateFiles.size(); ++i) {
+            std::cout << "  " << i + 1 << ". " << duplicateFiles[i] << '\n';
+        }
     }
-    
+
     // Keep the first file, handle the rest
     for (size_t i = 1; i < duplicateFiles.size(); ++i) {
-        const std::string& filePath = duplicateFiles[i];
-        
-        switch (action) {
-            case DuplicateAction::DELETE:
-                deleteDuplicate(filePath);
-                break;
-            case DuplicateAction::MOVE:
-                if (!targetDirectory.empty()) {
-                    moveDuplicate(filePath, targetDirectory);
-                }
-                break;
-            case DuplicateAction::HARD_LINK:
-                if (!targetDirectory.empty()) {
-                    std::filesystem::path linkPath = std::filesystem::path(targetDirectory) / std::filesystem::path(filePath).filename();
-                    createHardLink(duplicateFiles[0], linkPath.string());
-                    deleteDuplicate(filePath);
-                }
-                break;
-            case DuplicateAction::SHOW_ONLY:
-                // Already shown above
-                break;
+        plan.push_back(PlannedAction{ duplicateFiles[0], duplicateFiles[i] });
+    }
+    return plan;
+}
+
+std::vector<PlannedAction> DuplicateHandler::planGroup(const FileTable& files, const FileGroup& group) const {
+    std::vector<std::string> paths;
+    paths.reserve(group.size());
+    for (size_t index : group) {
+        paths.push_back(files.path(index));
+    }
+    std::vector<PlannedAction> listed = planGroup(paths);
+    std::vector<PlannedAction> plan;
+    for (size_t i = 1; i < group.size(); ++i) {
+        if (!alreadyShared(files, group[0], group[i])) {
+            plan.push_back(std::move(listed[i - 1]));
         }
     }
+    return plan;
 }
 
-void DuplicateHandler::handleDuplicatesInteractive(const std::vector<std::string>& duplicateFiles) {
-    if (duplicateFiles.size() <= 1) {
+bool DuplicateHandler::alreadyShared(const FileTable& files, size_t keep, size_t member) {
+    return files.symlink(keep) || files.symlink(member) ||
+           (files.device(keep) != 0 && files.device(member) == files.device(keep) &&
+            files.inode(member) == files.inode(keep));
+}
+
+void DuplicateHandler::handleDuplicates(const FileTable& files, const FileGroup& group,
+                                       DuplicateAction action,
+                                       const std::string& targetDirectory) {
+    executePlan(planGroup(files, group), action, targetDirectory);
+}
+
+void DuplicateHandler::handleDuplicatesInteractive(const FileTable& files, const FileGroup& group) {
+    if (group.size() <= 1) {
         return;
     }
-    
-    std::cout << "\nFound " << duplicateFiles.size() << " duplicate files:" << std::endl;
-    for (size_t i = 0; i < duplicateFiles.size(); ++i) {
-        std::cout << "  " << i + 1 << ". " << duplicateFiles[i] << std::endl;
+
+    std::cout << "\nFound " << group.size() << " duplicate files:" << std::endl;
+    for (size_t i = 0; i < group.size(); ++i) {
+        std::cout << "  " << i + 1 << ". " << files.path(group[i]) << std::endl;
     }
-    
+
     std::cout << "\nChoose action:" << std::endl;
     std::cout << "1. Delete all duplicates (keep first)" << std::endl;
     std::cout << "2. Move duplicates to folder" << std::endl;
     std::cout << "3. Create hard links (replace duplicates)" << std::endl;
-    std::cout << "4. Skip this group" << std::endl;
+    std::cout << "4. Replace duplicates with hard links in place" << std::endl;
+    std::cout << "5. Reflink duplicates (share extents in place, btrfs/XFS)" << std::endl;
+    std::cout << "6. Skip this group" << std::endl;
     std::cout << "Choice: ";
-    
+
     int choice;
     std::cin >> choice;
-    
+
     switch (choice) {
         case 1:
-            handleDuplicates(duplicateFiles, DuplicateAction::DELETE);
+            handleDuplicates(files, group, DuplicateAction::DELETE);
             break;
         case 2: {
             std::string targetDir;
             std::cout << "Enter target directory: ";
             std::cin >> targetDir;
-            handleDuplicates(duplicateFiles, DuplicateAction::MOVE, targetDir);
+            handleDuplicates(files, group, DuplicateAction::MOVE, targetDir);
             break;
         }
         case 3: {
             std::string targetDir;
             std::cout << "Enter target directory for hard links: ";
             std::cin >> targetDir;
-            handleDuplicates(duplicateFiles, DuplicateAction::HARD_LINK, targetDir);
+            handleDuplicates(files, group, DuplicateAction::HARD_LINK, targetDir);
             break;
         }
         case 4:
+            handleDuplicates(files, group, DuplicateAction::HARD_LINK_IN_PLACE);
+            break;
+        case 5:
+            handleDuplicates(files, group, DuplicateAction::REFLINK);
+            break;
+        case 6:
             std::cout << "Skipping this group." << std::endl;
             break;
         default:
             std::cout << "Invalid choice. Skipping this group." << std::endl;
             break;
     }
-}
\ No newline at end of file
+}
+
+DuplicateHandler::Outcome DuplicateHandler::removeFile(const std::string& filePath) {
+    Outcome outcome;
+    std::error_code ec;
+    if (std::filesystem::remove(filePath, ec)) {
+        outcome.ok = true;
+        outcome.message = "Deleted: " + filePath;
+    } else if (ec) {
+        outcome.message = "Exception deleting file " + filePath + ": " + ec.message();
+    } else {
+        outcome.message = "Error deleting file: " + filePath;
+    }
+    return outcome;
+}
+
+DuplicateHandler::Outcome DuplicateHandler::moveFile(const std::string& filePath, const std::string& targetDirectory) {
+    Outcome outcome;
+    const std::string fileName = std::filesystem::path(filePath).filename().string();
+    std::error_code ec;
+    for (unsigned attempt = 0; attempt < NAME_ATTEMPTS; ++attempt) {
+        std::filesystem::path finalPath;
+        std::string error;
+        if (!reserveName(targetDirectory, fileName, finalPath, error)) {
+            outcome.message = "Exception moving file " + filePath + ": " + error;
+            return outcome;
+        }
+        if (renameNoReplace(filePath, finalPath, ec)) {
+            outcome.ok = true;
+            outcome.message = "Moved: " + filePath + " to " + finalPath.string();
+            return outcome;
+        }
+        if (ec != std::errc::file_exists) {
+            break;
+        }
+    }
+    outcome.message = "Exception moving file " + filePath + ": " + ec.message();
+    return outcome;
+}
+
+DuplicateHandler::Outcome DuplicateHandler::linkIntoTarget(const std::string& keepPath, const std::string& filePath,
+                                                           const std::string& targetDirectory) {
+    Outcome outcome;
+    const std::string fileName = std::filesystem::path(filePath).filename().string();
+    std::error_code ec;
+    for (unsigned attempt = 0; attempt < NAME_ATTEMPTS; ++attempt) {
+        std::filesystem::path linkPath;
+        std::string error;
+        if (!reserveName(targetDirectory, fileName, linkPath, error)) {
+            outcome.message = "Exception creating hard link for " + keepPath + ": " + error;
+            return outcome;
+        }
+        std::filesystem::create_hard_link(keepPath, linkPath, ec);
+        if (!ec) {
+            // The duplicate only goes once its replacement link exists
+            Outcome removed = removeFile(filePath);
+            if (!removed.ok) {
+                return removed;
+            }
+            outcome.ok = true;
+            outcome.message = "Created hard link: " + linkPath.string() + " for " + keepPath + "\n" + removed.message;
+            return outcome;
+        }
+        if (ec != std::errc::file_exists) {
+            break;
+        }
+    }
+    outcome.message = "Exception creating hard link for " + keepPath + ": " + ec.message();
+    return outcome;
+}
+
+void DuplicateHandler::reflinkGroup(const std::vector<PlannedAction>& plan, const std::vector<size_t>& items,
+                                    std::vector<Outcome>& outcomes) {
+    const std::string& keepPath = plan[items.front()].keepPath;
+#ifdef FIDEDUPERANGE
+    auto fail = [&](size_t item, const std::string& error) {
+        outcomes[item] = Outcome{ false, "Exception reflinking " + plan[item].filePath + ": " + error, 0 };
+    };
+
+    int source = ::open(keepPath.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat sourceStat;
+    if (source < 0 || ::fstat(source, &sourceStat) != 0) {
+        const std::string error = "Unable to open " + keepPath + ": " + std::strerror(errno);
+        for (size_t item : items) {
+            fail(item, error);
+        }
+        if (source >= 0) {
+            ::close(source);
+        }
+        return;
+    }
+    const std::uint64_t size = static_cast<std::uint64_t>(sourceStat.st_size);
+
+    struct Target {
+        size_t item;
+        int fd;
+        std::uint64_t shared;
+    };
+    for (size_t first = 0; first < items.size(); first += DEDUPE_MAX_TARGETS) {
+        const size_t last = std::min(items.size(), first + DEDUPE_MAX_TARGETS);
+        std::vector<Target> targets;
+        for (size_t k = first; k < last; ++k) {
+            const size_t item = items[k];
+            const char* path = plan[item].filePath.c_str();
+            // Write access is only needed by kernels older than 4.19 or for files owned by others
+            int fd = ::open(path, O_RDWR | O_CLOEXEC);
+            if (fd < 0 && (errno == EACCES || errno == EPERM || errno == ETXTBSY)) {
+                fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            }
+            struct stat targetStat;
+            if (fd < 0 || ::fstat(fd, &targetStat) != 0) {
+                fail(item, std::strerror(errno));
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            } else if (targetStat.st_dev == sourceStat.st_dev && targetStat.st_ino == sourceStat.st_ino) {
+                outcomes[item] = Outcome{ true, "Already the same file: " + plan[item].filePath, 0 };
+                ::close(fd);
+            } else if (targetStat.st_size != sourceStat.st_size) {
+                fail(item, "File size changed since the scan");
+                ::close(fd);
+            } else {
+                targets.push_back(Target{ item, fd, 0 });
+            }
+        }
+
+        // Every surviving target rides along on each chunk's request; the kernel compares the
+        // ranges itself and reports per target whether they differed
+        std::vector<unsigned char> request;
+        for (std::uint64_t offset = 0; offset < size && !targets.empty();) {
+            const std::uint64_t length = std::min(DEDUPE_CHUNK, size - offset);
+            request.assign(sizeof(file_dedupe_range) + targets.size() * sizeof(file_dedupe_range_info), 0);
+            auto* range = reinterpret_cast<file_dedupe_range*>(request.data());
+            range->src_offset = offset;
+            range->src_length = length;
+            range->dest_count = static_cast<std::uint16_t>(targets.size());
+            for (size_t t = 0; t < targets.size(); ++t) {
+                range->info[t].dest_fd = targets[t].fd;
+                range->info[t].dest_offset = offset;
+            }
+
+            std::vector<Target> remaining;
+            if (::ioctl(source, FIDEDUPERANGE, range) != 0) {
+                const std::string error = std::strerror(errno);
+                for (const Target& target : targets) {
+                    fail(target.item, error);
+                    ::close(target.fd);
+                }
+            } else {
+                for (size_t t = 0; t < targets.size(); ++t) {
+                    const file_dedupe_range_info& info = range->info[t];
+                    if (info.status == FILE_DEDUPE_RANGE_SAME) {
+                        targets[t].shared += info.bytes_deduped;
+                        remaining.push_back(targets[t]);
+                        continue;
+                    }
+                    fail(targets[t].item, info.status == FILE_DEDUPE_RANGE_DIFFERS ? "Contents differ"
+                                                                                  : std::strerror(-info.status));
+                    ::close(targets[t].fd);
+                }
+            }
+            targets = std::move(remaining);
+            offset += length;
+        }
+
+        for (const Target& target : targets) {
+            outcomes[target.item] = Outcome{ true, "Reflinked: " + plan[target.item].filePath + " to " + keepPath +
+                                                   " (" + std::to_string(target.shared) + " bytes)", target.shared };
+            ::close(target.fd);
+        }
+    }
+    ::close(source);
+#else
+    for (size_t item : items) {
+        outcomes[item] = Outcome{ false, "Reflink dedupe is not supported on this platform: " + keepPath, 0 };
+    }
+#endif
+}
+
+DuplicateHandler::Outcome DuplicateHandler::replaceWithLink(const PlannedAction& item) {
+    // link() to a temporary name, then rename() over the duplicate: the path always names
+    // either the old file or the kept one, and nothing is stat'ed on the way
+    std::error_code ec;
+    for (unsigned attempt = 0; attempt < NAME_ATTEMPTS; ++attempt) {
+        const std::string tempPath = item.filePath + TEMP_LINK_SUFFIX + std::to_string(attempt);
+        std::filesystem::create_hard_link(item.keepPath, tempPath, ec);
+        if (ec == std::errc::file_exists) {
+            continue;
+        }
+        if (ec) {
+            break;
+        }
+        std::filesystem::rename(tempPath, item.filePath, ec);
+        std::error_code ignored;
+        if (ec) {
+            std::filesystem::remove(tempPath, ignored);
+            break;
+        }
+        // Renaming one link of an inode over another does nothing and leaves the temporary
+        // name behind; normally it is gone already
+        if (std::filesystem::remove(tempPath, ignored)) {
+            return Outcome{ true, "Already linked: " + item.filePath, 0 };
+        }
+        return Outcome{ true, "Replaced with hard link: " + item.filePath + " -> " + item.keepPath, 0 };
+    }
+    return Outcome{ false, "Exception replacing " + item.filePath + " with a hard link: " + ec.message(), 0 };
+}
+
+DuplicateHandler::Outcome DuplicateHandler::perform(const PlannedAction& item, DuplicateAction action,
+                                                    const std::string& targetDirectory) {
+    switch (action) {
+        case DuplicateAction::DELETE:
+            return removeFile(item.filePath);
+        case DuplicateAction::MOVE:
+            if (!targetDirectory.empty()) {
+                return moveFile(item.filePath, targetDirectory);
+            }
+            break;
+        case DuplicateAction::HARD_LINK:
+            if (!targetDirectory.empty()) {
+                return linkIntoTarget(item.keepPath, item.filePath, targetDirectory);
+            }
+            break;
+        case DuplicateAction::HARD_LINK_IN_PLACE:
+            return replaceWithLink(item);
+        case DuplicateAction::REFLINK: {
+            std::vector<Outcome> outcomes(1);
+            reflinkGroup(std::vector<PlannedAction>{ item }, std::vector<size_t>{ 0 }, outcomes);
+            return outcomes.front();
+        }
+        case DuplicateAction::SHOW_ONLY:
+            return Outcome{ true, "", 0 };
+    }
+    return Outcome{ false, "No target directory for " + item.filePath, 0 };
+}
+
+void DuplicateHandler::report(const Outcome& outcome) const {
+    if (!outcome.ok) {
+        std::cerr << outcome.message << '\n';
+    } else if (verbose && !outcome.message.empty()) {
+        std::cout << outcome.message << '\n';
+    }
+}
+
+bool DuplicateHandler::reserveName(const std::string& targetDirectory, const std::string& fileName,
+                                   std::filesystem::path& path, std::string& error) {
+    const std::filesystem::path targetPath(targetDirectory);
+    std::lock_guard<std::mutex> lock(targetsMutex);
+    auto found = targets.find(targetDirectory);
+    if (found == targets.end()) {
+        // First use: create the directory and take one listing instead of a stat per candidate name
+        TargetDirectory target;
+        std::error_code ec;
+        std::filesystem::create_directories(targetPath, ec);
+        if (!ec) {
+            for (std::filesystem::directory_iterator it(targetPath, ec), end; !ec && it != end; it.increment(ec)) {
+                target.names.insert(it->path().filename().string());
+            }
+        }
+        if (ec) {
+            target.error = ec.message();
+        }
+        found = targets.emplace(targetDirectory, std::move(target)).first;
+    }
+    TargetDirectory& target = found->second;
+    if (!target.error.empty()) {
+        error = target.error;
+        return false;
+    }
+
+    // Same scheme as before: name, then stem_1.ext, stem_2.ext, ...
+    std::string name = fileName;
+    if (target.names.count(name)) {
+        const std::filesystem::path base(fileName);
+        const std::string stem = base.stem().string();
+        const std::string extension = base.extension().string();
+        unsigned& counter = target.nextSuffix[fileName];
+        do {
+            name = stem + "_" + std::to_string(++counter) + extension;
+        } while (target.names.count(name));
+    }
+    target.names.insert(name);
+    path = targetPath / name;
+    return true;
+}
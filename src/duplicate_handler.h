@@ -1,19 +1,55 @@
 #ifndef DUPLICATE_HANDLER_H
 #define DUPLICATE_HANDLER_H
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "file_table.h"
+#include "grouping_engine.h"
+#include "worker_pool.h"
 
 enum class DuplicateAction {
     DELETE,
     MOVE,
     HARD_LINK,
+    HARD_LINK_IN_PLACE,
+    REFLINK,
     SHOW_ONLY
 };
 
+// One duplicate to act on and the file of its group that is kept
+struct PlannedAction {
+    std::string keepPath;
+    std::string filePath;
+};
+
+// Outcome of a plan; results are in plan order
+struct ActionReport {
+    size_t succeeded = 0;
+    size_t failed = 0;
+    std::uintmax_t bytesShared = 0;     // REFLINK: bytes the kernel deduplicated
+    double seconds = 0;                 // Wall time of the whole plan
+    double busySeconds = 0;             // Time the operations took, summed over workers
+    size_t workers = 0;
+    std::vector<bool> results;
+};
+
 class DuplicateHandler {
 public:
+    // Quiet handlers only report errors; the group listing and per-file messages are dropped
+    void setVerbose(bool enabled) { verbose = enabled; }
+
+    // Filesystem operations executePlan keeps in flight at once
+    void setConcurrency(size_t operations) { concurrency = operations > 0 ? operations : 1; }
+
     // Deletes a duplicate file
     bool deleteDuplicate(const std::string& filePath);
 
@@ -23,13 +59,94 @@ public:
     // Creates a hard link for a duplicate file
     bool createHardLink(const std::string& originalPath, const std::string& linkPath);
 
+    // Apply action to one duplicate of keepPath; SHOW_ONLY does nothing and succeeds
+    bool applyAction(const std::string& keepPath, const std::string& filePath,
+                     DuplicateAction action, const std::string& targetDirectory = "");
+
+    // Apply action to every planned file. The target directory is created once, names in it
+    // are assigned from one listing instead of a stat per file, and the operations run
+    // concurrently; messages are printed in plan order once all of them finished. REFLINK
+    // runs one task per kept file so its duplicates share each dedupe request.
+    ActionReport executePlan(const std::vector<PlannedAction>& plan, DuplicateAction action,
+                             const std::string& targetDirectory = "");
+
+    // The same plan built up while it runs, so duplicates are acted on while the scan is still
+    // finding others: begin, add the items of each group as it is confirmed, then finish for
+    // the report, whose results are in the order items were added. workers 0 uses the
+    // concurrency. Adding blocks while twice the workers are already waiting.
+    void beginPlan(DuplicateAction action, const std::string& targetDirectory = "", size_t workers = 0);
+    void addToPlan(std::vector<PlannedAction> items);
+    ActionReport finishPlan();
+
+    // Plan the group's duplicates against its first file, listing the group when verbose
+    std::vector<PlannedAction> planGroup(const std::vector<std::string>& duplicateFiles) const;
+    // Same from scanned rows, leaving out the members alreadyShared says acting on frees nothing
+    std::vector<PlannedAction> planGroup(const FileTable& files, const FileGroup& group) const;
+    // Whether a member of a group whose kept file is keep is a symbolic link or a hard link to
+    // the kept file's inode: deleting, moving or relinking it would free nothing, and deleting
+    // the target of a link would leave the link dangling
+    static bool alreadyShared(const FileTable& files, size_t keep, size_t member);
+
     // Handle duplicates with specified action
-    void handleDuplicates(const std::vector<std::string>& duplicateFiles, 
-                         DuplicateAction action, 
+    void handleDuplicates(const FileTable& files, const FileGroup& group,
+                         DuplicateAction action,
                          const std::string& targetDirectory = "");
 
     // Interactive duplicate handling
-    void handleDuplicatesInteractive(const std::vector<std::string>& duplicateFiles);
+    void handleDuplicatesInteractive(const FileTable& files, const FileGroup& group);
+
+private:
+    // Names present in or handed out for one target directory
+    struct TargetDirectory {
+        std::string error;      // Set when the directory could not be created or listed
+        std::unordered_set<std::string> names;
+        std::unordered_map<std::string, unsigned> nextSuffix;
+    };
+
+    bool verbose = true;
+    size_t concurrency = 16;
+    std::mutex targetsMutex;
+    std::unordered_map<std::string, TargetDirectory> targets;
+
+    // Outcome of one operation; message is the success line or the error
+    struct Outcome {
+        bool ok = false;
+        std::string message;
+        std::uintmax_t bytesShared = 0;
+    };
+
+    // Items added together; tasks only touch their own batch, which never grows
+    struct PlanBatch {
+        std::vector<PlannedAction> items;
+        std::vector<Outcome> outcomes;
+    };
+    // State of the plan between beginPlan and finishPlan
+    struct PlanRun {
+        DuplicateAction action = DuplicateAction::SHOW_ONLY;
+        std::string targetDirectory;
+        size_t workers = 0;
+        std::chrono::steady_clock::time_point started;
+        std::atomic<std::int64_t> busyNanos{ 0 };
+        std::deque<std::unique_ptr<PlanBatch>> batches;
+        std::unique_ptr<WorkerPool> pool;       // Started by the first item
+    };
+    std::unique_ptr<PlanRun> run;
+
+    Outcome removeFile(const std::string& filePath);
+    Outcome moveFile(const std::string& filePath, const std::string& targetDirectory);
+    Outcome linkIntoTarget(const std::string& keepPath, const std::string& filePath,
+                           const std::string& targetDirectory);
+    Outcome replaceWithLink(const PlannedAction& item);
+    // Share the extents of the listed items' common kept file with each of them through FIDEDUPERANGE
+    void reflinkGroup(const std::vector<PlannedAction>& plan, const std::vector<size_t>& items,
+                      std::vector<Outcome>& outcomes);
+    Outcome perform(const PlannedAction& item, DuplicateAction action, const std::string& targetDirectory);
+    void report(const Outcome& outcome) const;
+
+    // Reserve a name for fileName in targetDirectory that no earlier call handed out and that
+    // was not there when the directory was first listed; false when the directory is unusable
+    bool reserveName(const std::string& targetDirectory, const std::string& fileName,
+                     std::filesystem::path& path, std::string& error);
 };
 
-#endif // DUPLICATE_HANDLER_H
\ No newline at end of file
+#endif // DUPLICATE_HANDLER_H
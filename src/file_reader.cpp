@@ -0,0 +1,338 @@
+#include "file_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Files up to this size are read with one small pread; mapping them costs more than copying
+const std::uintmax_t SMALL_FILE_LIMIT = 256 * 1024;
+// Files above this size are streamed through pread so they do not evict the page cache
+const std::uintmax_t MMAP_LIMIT = 1ull << 30;
+
+const std::size_t SMALL_BUFFER_SIZE = 256 * 1024;
+const std::size_t LARGE_BUFFER_SIZE = 4 * 1024 * 1024;
+const std::size_t MMAP_BLOCK_SIZE = 16 * 1024 * 1024;
+const std::size_t IO_ALIGNMENT = 4096;
+
+// Per-thread aligned buffer, grown on demand and reused across files
+char* alignedBuffer(std::size_t size) {
+    struct FreeDeleter {
+        void operator()(char* p) const { std::free(p); }
+    };
+    thread_local std::unique_ptr<char, FreeDeleter> buffer;
+    thread_local std::size_t capacity = 0;
+    if (capacity < size) {
+        void* memory = nullptr;
+#ifndef _WIN32
+        if (posix_memalign(&memory, IO_ALIGNMENT, size) != 0) {
+            memory = nullptr;
+        }
+#else
+        memory = std::malloc(size);
+#endif
+        if (!memory) {
+            throw std::bad_alloc();
+        }
+        buffer.reset(static_cast<char*>(memory));
+        capacity = size;
+    }
+    return buffer.get();
+}
+
+#ifndef _WIN32
+
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    int get() const { return fd; }
+
+private:
+    int fd;
+};
+
+int openForRead(const std::string& filePath, int extraFlags) {
+    int fd;
+    do {
+        fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC | extraFlags);
+    } while (fd < 0 && errno == EINTR);
+    return fd;
+}
+
+// Read until length bytes arrive or EOF; returns the number of bytes read. With O_DIRECT a
+// short read is only possible at EOF, and retrying at an unaligned offset would fail.
+std::size_t preadFully(int fd, char* buffer, std::size_t length, std::uintmax_t offset,
+                       const std::string& filePath, bool direct = false) {
+    std::size_t total = 0;
+    while (total < length) {
+        ssize_t n = ::pread(fd, buffer + total, length - total, static_cast<off_t>(offset + total));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to read file: " + filePath + ": " + std::strerror(errno));
+        }
+        if (n == 0) {
+            break;
+        }
+        total += static_cast<std::size_t>(n);
+        if (direct) {
+            break;
+        }
+    }
+    return total;
+}
+
+void readWithPread(int fd, std::uintmax_t fileSize, std::size_t bufferSize, bool dropBehind, bool direct,
+                   const std::string& filePath, const FileReader::BlockConsumer& consumer) {
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    char* buffer = alignedBuffer(bufferSize);
+    std::uintmax_t offset = 0;
+    while (true) {
+        std::size_t n = preadFully(fd, buffer, bufferSize, offset, filePath, direct);
+        if (n == 0) {
+            break;
+        }
+        consumer(buffer, n);
+#ifdef POSIX_FADV_DONTNEED
+        if (dropBehind) {
+            posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(n), POSIX_FADV_DONTNEED);
+        }
+#endif
+        offset += n;
+        // A short read at the expected size means EOF; a file that grew keeps being read
+        if (n < bufferSize && offset >= fileSize) {
+            break;
+        }
+    }
+    (void)dropBehind;
+}
+
+// The mapping this thread is reading, for the SIGBUS handler
+struct ActiveMapping {
+    char* start = nullptr;
+    std::size_t length = 0;
+    volatile std::sig_atomic_t truncated = 0;
+};
+thread_local ActiveMapping activeMapping;
+
+struct sigaction previousBusAction;
+std::uintptr_t pageSize = 4096;
+
+// Touching a mapped page past the end of a file that shrank raises SIGBUS. Inside the
+// mapping being read, the rest of it is replaced with zero pages so the access completes
+// and the reader can report the change; any other fault goes to the previous handler.
+void onBusError(int signal, siginfo_t* info, void* context) {
+    ActiveMapping& mapping = activeMapping;
+    char* address = static_cast<char*>(info->si_addr);
+    if (mapping.start && address >= mapping.start && address < mapping.start + mapping.length) {
+        char* page = reinterpret_cast<char*>(reinterpret_cast<std::uintptr_t>(address) & ~(pageSize - 1));
+        if (::mmap(page, static_cast<std::size_t>(mapping.start + mapping.length - page), PROT_READ,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+            mapping.truncated = 1;
+            return;
+        }
+    }
+    if (previousBusAction.sa_flags & SA_SIGINFO) {
+        previousBusAction.sa_sigaction(signal, info, context);
+    } else if (previousBusAction.sa_handler != SIG_DFL && previousBusAction.sa_handler != SIG_IGN) {
+        previousBusAction.sa_handler(signal);
+    } else {
+        // The faulting access runs again and gets the default action
+        ::sigaction(SIGBUS, &previousBusAction, nullptr);
+    }
+}
+
+void guardMappedReads() {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        pageSize = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+        struct sigaction action = {};
+        action.sa_sigaction = onBusError;
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        ::sigaction(SIGBUS, &action, &previousBusAction);
+    });
+}
+
+bool readWithMmap(int fd, std::uintmax_t fileSize, const std::string& filePath,
+                  const FileReader::BlockConsumer& consumer) {
+    guardMappedReads();
+    void* mapping = ::mmap(nullptr, static_cast<std::size_t>(fileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(mapping, static_cast<std::size_t>(fileSize), MADV_SEQUENTIAL);
+
+    struct Unmap {
+        void* mapping;
+        std::size_t length;
+        ~Unmap() {
+            activeMapping.start = nullptr;
+            ::munmap(mapping, length);
+        }
+    } unmap{ mapping, static_cast<std::size_t>(fileSize) };
+    activeMapping.start = static_cast<char*>(mapping);
+    activeMapping.length = static_cast<std::size_t>(fileSize);
+    activeMapping.truncated = 0;
+
+    const char* data = static_cast<const char*>(mapping);
+    for (std::uintmax_t offset = 0; offset < fileSize; offset += MMAP_BLOCK_SIZE) {
+        std::size_t length = static_cast<std::size_t>(std::min<std::uintmax_t>(MMAP_BLOCK_SIZE, fileSize - offset));
+        consumer(data + offset, length);
+        if (activeMapping.truncated) {
+            throw std::runtime_error("File shrank while it was read: " + filePath);
+        }
+    }
+    return true;
+}
+
+#endif // _WIN32
+
+} // namespace
+
+ReadBackend FileReader::selectBackend(std::uintmax_t fileSize) {
+    if (fileSize <= SMALL_FILE_LIMIT || fileSize > MMAP_LIMIT) {
+        return ReadBackend::PREAD;
+    }
+    return ReadBackend::MMAP;
+}
+
+const char* FileReader::backendName(ReadBackend backend) {
+    switch (backend) {
+        case ReadBackend::AUTO: return "Auto";
+        case ReadBackend::MMAP: return "mmap";
+        case ReadBackend::PREAD: return "pread";
+        case ReadBackend::DIRECT: return "O_DIRECT";
+    }
+    return "Unknown";
+}
+
+void FileReader::readFile(const std::string& filePath, const BlockConsumer& consumer,
+                          ReadBackend backend, std::uintmax_t sizeHint) {
+#ifndef _WIN32
+    int directFlag = 0;
+#ifdef O_DIRECT
+    if (backend == ReadBackend::DIRECT) {
+        directFlag = O_DIRECT;
+    }
+#endif
+    int rawFd = openForRead(filePath, directFlag);
+    if (rawFd < 0 && directFlag != 0) {
+        // Filesystems such as tmpfs reject O_DIRECT
+        backend = ReadBackend::PREAD;
+        rawFd = openForRead(filePath, 0);
+    }
+    if (rawFd < 0) {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    FileDescriptor fd(rawFd);
+
+    std::uintmax_t fileSize = sizeHint;
+    if (fileSize == UINTMAX_MAX) {
+        struct stat st;
+        if (::fstat(fd.get(), &st) != 0) {
+            throw std::runtime_error("Unable to stat file: " + filePath);
+        }
+        fileSize = static_cast<std::uintmax_t>(st.st_size);
+    }
+
+    if (backend == ReadBackend::AUTO) {
+        backend = selectBackend(fileSize);
+    }
+
+    switch (backend) {
+        case ReadBackend::MMAP:
+            if (fileSize > 0 && readWithMmap(fd.get(), fileSize, filePath, consumer)) {
+                return;
+            }
+            // Empty or unmappable files (pipes, some network filesystems) fall through to pread
+            readWithPread(fd.get(), fileSize, SMALL_BUFFER_SIZE, false, false, filePath, consumer);
+            return;
+        case ReadBackend::DIRECT:
+            readWithPread(fd.get(), fileSize, LARGE_BUFFER_SIZE, false, directFlag != 0, filePath, consumer);
+            return;
+        default:
+            readWithPread(fd.get(), fileSize,
+                          fileSize <= SMALL_FILE_LIMIT ? SMALL_BUFFER_SIZE : LARGE_BUFFER_SIZE,
+                          fileSize > MMAP_LIMIT, false, filePath, consumer);
+            return;
+    }
+#else
+    (void)backend;
+    (void)sizeHint;
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    char* buffer = alignedBuffer(SMALL_BUFFER_SIZE);
+    while (file.read(buffer, SMALL_BUFFER_SIZE) || file.gcount() > 0) {
+        consumer(buffer, static_cast<std::size_t>(file.gcount()));
+        if (file.eof()) {
+            break;
+        }
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Failed to read file: " + filePath);
+    }
+#endif
+}
+
+void FileReader::readRanges(const std::string& filePath,
+                            const std::vector<std::pair<std::uintmax_t, std::size_t>>& ranges,
+                            const BlockConsumer& consumer) {
+    std::size_t largest = 0;
+    for (const auto& range : ranges) {
+        largest = std::max(largest, range.second);
+    }
+    char* buffer = alignedBuffer(std::max(largest, SMALL_BUFFER_SIZE));
+
+#ifndef _WIN32
+    FileDescriptor fd(openForRead(filePath, 0));
+    if (fd.get() < 0) {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    for (const auto& range : ranges) {
+        if (preadFully(fd.get(), buffer, range.second, range.first, filePath) != range.second) {
+            throw std::runtime_error("Short read: " + filePath);
+        }
+        consumer(buffer, range.second);
+    }
+#else
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to open file: " + filePath);
+    }
+    for (const auto& range : ranges) {
+        file.seekg(static_cast<std::streamoff>(range.first));
+        file.read(buffer, static_cast<std::streamsize>(range.second));
+        if (file.gcount() != static_cast<std::streamsize>(range.second)) {
+            throw std::runtime_error("Short read: " + filePath);
+        }
+        consumer(buffer, range.second);
+    }
+#endif
+}
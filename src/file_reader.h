@@ -0,0 +1,39 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// How file contents are brought into memory for hashing
+enum class ReadBackend {
+    AUTO,       // Pick per file from its size
+    MMAP,       // mmap + madvise(MADV_SEQUENTIAL); a file that shrinks while mapped fails its read
+    PREAD,      // Large aligned pread buffers + posix_fadvise
+    DIRECT      // O_DIRECT pread, bypassing the page cache
+};
+
+// Shared read loop for HashCalculator. Every backend hands the consumer consecutive
+// blocks of the file; the consumer never sees which backend produced them.
+class FileReader {
+public:
+    using BlockConsumer = std::function<void(const void* data, std::size_t length)>;
+
+    // Stream the whole file. sizeHint avoids an fstat when the caller already knows the size.
+    static void readFile(const std::string& filePath, const BlockConsumer& consumer,
+                         ReadBackend backend = ReadBackend::AUTO, std::uintmax_t sizeHint = UINTMAX_MAX);
+
+    // Stream the given (offset, length) ranges in order with a single open
+    static void readRanges(const std::string& filePath,
+                           const std::vector<std::pair<std::uintmax_t, std::size_t>>& ranges,
+                           const BlockConsumer& consumer);
+
+    // Backend AUTO resolves to for a file of this size
+    static ReadBackend selectBackend(std::uintmax_t fileSize);
+
+    static const char* backendName(ReadBackend backend);
+};
+
+#endif // FILE_READER_H
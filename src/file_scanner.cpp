@@ -1,87 +1,1688 @@
 #include "file_scanner.h"
+#include "chunk_index.h"
+#include "content_comparer.h"
+#include "sha256_multibuffer.h"
+#include "uring_engine.h"
 #include <filesystem>
 #include <iostream>
 #include <unordered_map>
 #include <algorithm>
+#include <unordered_set>
 
 namespace fs = std::filesystem;
 
-std::vector<std::vector<std::string>> FileScanner::findDuplicates(const std::string& directoryPath, 
-                                                                  HashAlgorithm algorithm, 
-                                                                  bool recursive) {
-    scannedFiles.clear();
+namespace {
+
+// Partial digests only need to match within a size bucket
+struct SizedDigest {
+    std::uintmax_t size;
+    Digest digest;
+    bool operator==(const SizedDigest& other) const { return size == other.size && digest == other.digest; }
+};
+
+struct SizedDigestHash {
+    size_t operator()(const SizedDigest& key) const {
+        return DigestHash()(key.digest) ^ std::hash<std::uintmax_t>()(key.size);
+    }
+};
+
+// Largest group byte comparison verifies in a single lockstep pass
+const size_t LOCKSTEP_GROUP_LIMIT = 64;
+
+// Partitions the streaming walk starts with, and the memory one partition's files are
+// assumed to take while processed: the record, its size and inode counts and a table row
+const size_t STREAMING_PARTITIONS = 64;
+const std::uintmax_t STREAMING_BYTES_PER_FILE = 320;
+
+// Chunks held by more files than this are left out of the similarity pairs: every two
+// holders make a pair, and such chunks are mostly zeros or common headers
+const size_t SIMILARITY_FANOUT_LIMIT = 256;
+
+} // namespace
+
+std::vector<size_t> FileScanner::interleaveByDevice(const std::vector<size_t>& indices) const {
+    std::vector<std::uint64_t> order;
+    std::unordered_map<std::uint64_t, std::vector<size_t>> byDevice;
+    for (size_t index : indices) {
+        std::vector<size_t>& list = byDevice[files.device(index)];
+        if (list.empty()) {
+            order.push_back(files.device(index));
+        }
+        list.push_back(index);
+    }
+    if (order.size() < 2) {
+        return indices;
+    }
+
+    std::vector<size_t> interleaved;
+    interleaved.reserve(indices.size());
+    for (size_t round = 0; interleaved.size() < indices.size(); ++round) {
+        for (std::uint64_t device : order) {
+            const std::vector<size_t>& list = byDevice[device];
+            if (round < list.size()) {
+                interleaved.push_back(list[round]);
+            }
+        }
+    }
+    return interleaved;
+}
+
+void FileScanner::beginStage(const char* name, bool reads) {
+    statistics.arenaBytes = std::max(statistics.arenaBytes, arena.reserved() + stageArena.reserved());
+    stageArena.release();
+    const bool keep = walkReads;
+    if (reads) {
+        walkReads = false;
+    }
+    progress.enter(name, keep);
+    if (!keep) {
+        readsStarted = false;
+        busyNanos = 0;
+        scheduler->takePeakPending();
+    }
+}
+
+void FileScanner::endStage(StageStatistics& stage, Clock::time_point stageStarted, bool reads) {
+    const Clock::time_point started = reads && readsStarted ? std::min(readsStartedAt, stageStarted) : stageStarted;
+    stage.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    if (reads) {
+        stage.busySeconds = static_cast<double>(busyNanos.load()) / 1e9;
+        stage.workers = pool->size();
+        stage.peakQueueDepth = scheduler->takePeakPending();
+    }
+}
+
+void FileScanner::readQueued(std::uintmax_t bytes, size_t count) {
+    if (!readsStarted) {
+        readsStarted = true;
+        readsStartedAt = Clock::now();
+    }
+    progress.queued(bytes, count);
+}
+
+void FileScanner::readFinished(Clock::time_point started, std::uintmax_t bytes, size_t count) {
+    busyNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count(),
+                        std::memory_order_relaxed);
+    progress.finished(bytes, count);
+}
+
+void FileScanner::recordWalk(double seconds) {
+    // Listing and stat'ing interleave on the same threads, so both stages span the whole walk
+    const size_t threads = options.walkThreads > 1 ? options.walkThreads : 1;
+    StageStatistics walk;
+    walk.name = "Walk";
+    walk.candidatesIn = walkTotals.entries;
+    walk.candidatesRemoved = walkTotals.entries - std::min(walkTotals.entries, walkTotals.stats);
+    walk.seconds = seconds;
+    walk.busySeconds = walkTotals.listSeconds;
+    walk.workers = threads;
+    statistics.stages.push_back(walk);
+
+    StageStatistics stat;
+    stat.name = "Stat";
+    stat.candidatesIn = walkTotals.stats;
+    stat.candidatesRemoved = walkTotals.stats - std::min(walkTotals.stats, statistics.filesWalked);
+    stat.seconds = seconds;
+    stat.busySeconds = walkTotals.statSeconds;
+    stat.workers = threads;
+    statistics.stages.push_back(stat);
+}
+
+const GroupList& FileScanner::findDuplicates(const std::string& directoryPath, 
+                                             HashAlgorithm algorithm, 
+                                             bool recursive) {
+    return findDuplicates(std::vector<std::string>{ directoryPath }, algorithm, recursive);
+}
+
+const GroupList& FileScanner::findDuplicates(const std::vector<std::string>& directoryPaths,
+                                             HashAlgorithm algorithm,
+                                             bool recursive) {
+    files.clear();
     duplicateGroups.clear();
+    linkLeaders.clear();
+    hasLinks.clear();
+    queued.clear();
+    chunkCandidates.clear();
+    similarFiles.clear();
+    statistics = ScanStatistics();
+    // Compiled once for every root, and before anything is read in case a pattern is malformed
+    walkFilter = options.filters.active() ? std::make_unique<WalkFilter>(options.filters) : nullptr;
+    resetLookups(true);
+    const Clock::time_point scanStarted = Clock::now();
+
+    pool = std::make_unique<WorkerPool>(options.threadCount);
+    shards.assign(pool->size(), {});
+    scheduler = std::make_unique<IoScheduler>(*pool, options.deviceReadLimit);
+    for (const auto& rootLimit : options.rootReadLimits) {
+        scheduler->setLimit(IoScheduler::deviceOf(rootLimit.first), rootLimit.second);
+    }
+
+    hashCache.reset();
+    if (!options.hashCachePath.empty()) {
+        hashCache = std::make_unique<HashCache>(options.hashCachePath);
+        if (hashCache->load()) {
+            *log << "Loaded " << hashCache->size() << " cached hashes from " << options.hashCachePath << std::endl;
+        }
+    }
+    loadSnapshot(algorithm);
     
-    std::cout << "Scanning directory: " << directoryPath << std::endl;
-    std::cout << "Using " << (algorithm == HashAlgorithm::MD5 ? "MD5" : "SHA256") << " hashing" << std::endl;
-    std::cout << "Recursive: " << (recursive ? "Yes" : "No") << std::endl;
+    for (const auto& directoryPath : directoryPaths) {
+        *log << "Scanning directory: " << directoryPath << std::endl;
+    }
+    *log << "Using " << HashCalculator::algorithmName(algorithm) << " hashing" << std::endl;
+    *log << "Recursive: " << (recursive ? "Yes" : "No") << std::endl;
+    *log << "Hashing threads: " << pool->size() << std::endl;
+    if (directoryPaths.size() > 1) {
+        for (const auto& directoryPath : directoryPaths) {
+            *log << "Reads in flight for " << directoryPath << ": "
+                 << scheduler->limit(IoScheduler::deviceOf(directoryPath)) << std::endl;
+        }
+    }
+
+    deferFullHashes = false;
+    if (options.useIoUring) {
+        deferFullHashes = UringHashEngine::isSupported();
+        *log << "Full hash reads: " << (deferFullHashes ? "io_uring" : "io_uring unavailable, using portable reads")
+             << std::endl;
+    }
     
-    scanDirectory(directoryPath, algorithm, recursive);
-    findDuplicateGroups();
+    readsStarted = false;
+    busyNanos = 0;
+    walkTotals = WalkCounters();
+    progress.filesWalked = 0;
+    progress.bytesWalked = 0;
+    progress.enter("Walk");
+    std::unique_ptr<ProgressReporter> reporter;
+    if (options.progressIntervalMs > 0) {
+        reporter = std::make_unique<ProgressReporter>(progress, options.progressIntervalMs,
+                                                      [this] { return scheduler->pending(); });
+    }
+
+    partitioner.reset();
+    if (options.streamingMemoryBudget > 0) {
+        partitioner = std::make_unique<SizePartitioner>(STREAMING_PARTITIONS);
+    }
+
+    // Hashing of colliding sizes starts while the walk is still running, unless the walk
+    // only spills records for the partitions
+    const Clock::time_point walkStarted = Clock::now();
+    for (const auto& directoryPath : directoryPaths) {
+        scanDirectory(directoryPath, algorithm, recursive);
+    }
+    recordWalk(std::chrono::duration<double>(Clock::now() - walkStarted).count());
+    walkReads = readsStarted;
+
+    if (partitioner) {
+        scanPartitions(algorithm);
+        partitioner.reset();
+    } else {
+        runPipeline(algorithm);
+    }
+    if (!chunkCandidates.empty() && !stopping()) {
+        findSimilarFiles(algorithm);
+    }
+    if (stopping()) {
+        // Groups found so far may be missing members that were never read
+        duplicateGroups.clear();
+        chunkCandidates.clear();
+        similarFiles.clear();
+        statistics.duplicateBytes = 0;
+        statistics.reclaimableBytes = 0;
+        statistics.cancelled = true;
+        snapshot.reset();
+        visitedDirectories.clear();
+        snapshotRows.clear();
+    }
+    // Nothing after the pipeline looks files up by size or inode; a long-running caller
+    // should not keep the blocks between scans
+    resetLookups(false);
+    updateHashCache(algorithm);
+    saveSnapshot(algorithm);
+
+    reporter.reset();
+    scheduler.reset();
+    pool.reset();
+    shards.clear();
+    statistics.duplicateGroups = duplicateGroups.size();
+    statistics.seconds = std::chrono::duration<double>(Clock::now() - scanStarted).count();
     
-    std::cout << "Scan complete. Found " << scannedFiles.size() << " files." << std::endl;
-    std::cout << "Found " << duplicateGroups.size() << " groups of duplicates." << std::endl;
+    if (statistics.cancelled) {
+        *log << "Scan cancelled after " << statistics.filesWalked << " files." << std::endl;
+        return duplicateGroups;
+    }
+    *log << "Scan complete. Found " << statistics.filesWalked << " files." << std::endl;
+    *log << "Found " << duplicateGroups.size() << " groups of duplicates." << std::endl;
+    if (statistics.linksCollapsed > 0) {
+        *log << "Hard links sharing a digest: " << statistics.linksCollapsed << "; duplicate bytes "
+             << statistics.duplicateBytes << ", reclaimable " << statistics.reclaimableBytes << std::endl;
+    }
     
     return duplicateGroups;
 }
 
+void FileScanner::runPipeline(HashAlgorithm algorithm) {
+    groupsDelivered = false;
+    tracker.reset();
+    std::vector<size_t> candidates = filterBySize();
+    if (options.partialHashWindow > 0) {
+        candidates = filterByPartialHash(candidates);
+    }
+    // Without a partial stage full hashes already started during the walk, unless deferred
+    if (options.compareBucketLimit > 1 && (options.partialHashWindow > 0 || deferFullHashes)) {
+        candidates = compareSmallBuckets(candidates, algorithm);
+    }
+    hashCandidates(candidates, algorithm);
+    if (stopping()) {
+        return;
+    }
+    shareLinkDigests();
+
+    StageStatistics grouping;
+    grouping.name = "Grouping";
+    for (size_t index = 0; index < files.size(); ++index) {
+        grouping.candidatesIn += files.hash(index).empty() ? 0 : 1;
+    }
+    const Clock::time_point groupingStarted = Clock::now();
+    beginStage("Grouping", false);
+    GroupList kept;
+    findDuplicateGroups(algorithm, kept);
+    grouping.candidatesRemoved = grouping.candidatesIn - duplicateGroups.fileCount() - kept.fileCount();
+    endStage(grouping, groupingStarted, false);
+    statistics.stages.push_back(grouping);
+    if (options.verification != GroupVerification::NONE && !HashCalculator::isCollisionResistant(algorithm)) {
+        verifyGroups(algorithm);
+    }
+    groupUnreadLinks(kept);
+    mergeGroups(kept);
+    countDuplicateBytes();
+    if (onGroup && !groupsDelivered && !stopping()) {
+        for (const FileGroup& group : duplicateGroups) {
+            onGroup(files, group);
+        }
+    }
+    if (options.similarityMinSize > 0) {
+        collectChunkCandidates();
+    }
+}
+
+void FileScanner::scanPartitions(HashAlgorithm algorithm) {
+    partitioner->finish();
+    *log << "Streaming " << statistics.filesWalked << " files through size partitions ("
+         << partitioner->spilledBytes() / 1024 << " KB spilled, memory budget "
+         << options.streamingMemoryBudget / (1024 * 1024) << " MB)" << std::endl;
+
+    // Walk and Stat are counted once; every partition adds to the stages after them
+    std::vector<StageStatistics> totals = std::move(statistics.stages);
+    const size_t walkStages = totals.size();
+    auto mergeStages = [&totals, walkStages](const std::vector<StageStatistics>& stages) {
+        for (const auto& stage : stages) {
+            auto it = std::find_if(totals.begin() + static_cast<std::ptrdiff_t>(walkStages), totals.end(),
+                                   [&stage](const StageStatistics& total) { return total.name == stage.name; });
+            if (it == totals.end()) {
+                totals.push_back(stage);
+                continue;
+            }
+            it->candidatesIn += stage.candidatesIn;
+            it->candidatesRemoved += stage.candidatesRemoved;
+            it->bytesRead += stage.bytesRead;
+            it->bytesSkipped += stage.bytesSkipped;
+            it->seconds += stage.seconds;
+            it->busySeconds += stage.busySeconds;
+            it->workers = std::max(it->workers, stage.workers);
+            it->peakQueueDepth = std::max(it->peakQueueDepth, stage.peakQueueDepth);
+        }
+    };
+
+    FileTable kept;
+    GroupList keptGroups;
+    std::vector<SpilledFile> records;
+    size_t processed = 0;
+    size_t splits = 0;
+    size_t oversized = 0;   // Partitions of a single size that still exceed the budget
+    for (size_t partition = 0; partition < partitioner->partitionCount() && !stopping(); ++partition) {
+        const size_t count = partitioner->recordCount(partition);
+        if (count == 0) {
+            continue;
+        }
+        // A partition over the budget is split again; one holding a single size cannot be
+        const std::uintmax_t estimate = static_cast<std::uintmax_t>(count) * STREAMING_BYTES_PER_FILE;
+        if (estimate > options.streamingMemoryBudget &&
+            partitioner->split(partition, static_cast<size_t>(estimate / options.streamingMemoryBudget) + 2)) {
+            splits++;
+            continue;
+        }
+        if (estimate > options.streamingMemoryBudget) {
+            oversized++;
+        }
+        partitioner->read(partition, records);
+
+        files.clear();
+        duplicateGroups.clear();
+        resetLookups(true);
+        linkLeaders.clear();
+        hasLinks.clear();
+        queued.clear();
+        readsStarted = false;
+        busyNanos = 0;
+        progress.enter("Partition load");
+        statistics.stages.clear();
+
+        StageStatistics prefilter = loadPartition(records, algorithm);
+        walkReads = readsStarted;
+        if (!files.empty()) {
+            runPipeline(algorithm);
+        }
+        for (auto& stage : statistics.stages) {
+            if (stage.name == prefilter.name) {
+                stage.candidatesIn += prefilter.candidatesIn;
+                stage.candidatesRemoved += prefilter.candidatesRemoved;
+                stage.bytesSkipped += prefilter.bytesSkipped;
+                prefilter.candidatesIn = 0;
+            }
+        }
+        if (prefilter.candidatesIn > 0) {
+            statistics.stages.insert(statistics.stages.begin(), prefilter);
+        }
+        mergeStages(statistics.stages);
+        storeHashes(algorithm);
+
+        // Only group members outlive their partition
+        std::vector<size_t> members;
+        for (size_t g = 0; g < duplicateGroups.size(); ++g) {
+            members.clear();
+            for (size_t index : duplicateGroups[g]) {
+                const size_t row = kept.add(files.path(index), files.fileSize(index), files.mtime(index),
+                                            files.device(index), files.inode(index), files.symlink(index));
+                kept.hash(row) = files.hash(index);
+                kept.partialHash(row) = files.partialHash(index);
+                members.push_back(row);
+            }
+            keptGroups.add(members, duplicateGroups.fileSize(g));
+        }
+        processed++;
+    }
+    if (splits > 0) {
+        *log << "Split " << splits << " size partitions to stay within the memory budget" << std::endl;
+    }
+    *log << "Processed " << processed << " size partitions" << std::endl;
+    if (oversized > 0) {
+        std::cerr << "Warning: " << oversized << " partitions hold files of a single size that exceed the "
+                  << "streaming memory budget; each was processed as a whole" << std::endl;
+    }
+
+    statistics.stages = std::move(totals);
+    files = std::move(kept);
+    resetLookups(false);
+    linkLeaders.clear();
+    hasLinks.clear();
+    queued.clear();
+    // Same (size, digest) order, member order and group order as a scan held in memory
+    duplicateGroups.clear();
+    mergeGroups(keptGroups);
+}
+
+StageStatistics FileScanner::loadPartition(const std::vector<SpilledFile>& records, HashAlgorithm algorithm) {
+    StageStatistics stage;
+    stage.name = "Size grouping";
+
+    // A file needs its path back only when another inode has its size or another path links
+    // to it, or when it is large enough to be chunked; the rest are what the size stage would drop
+    ArenaMap<std::uint64_t, size_t> inodesPerSize(ArenaAllocator<char>{ stageArena });
+    ArenaMap<InodeKey, size_t, InodeKeyHash> pathsPerInode(ArenaAllocator<char>{ stageArena });
+    for (const auto& record : records) {
+        if (record.device == 0 || record.symlink || ++pathsPerInode[InodeKey{ record.device, record.inode }] == 1) {
+            inodesPerSize[record.size]++;
+        }
+    }
+    for (const auto& record : records) {
+        const bool linked = record.device != 0 && !record.symlink &&
+                            pathsPerInode[InodeKey{ record.device, record.inode }] > 1;
+        const bool chunked = options.similarityMinSize > 0 && record.size >= options.similarityMinSize;
+        if (inodesPerSize[record.size] < 2 && !linked && !chunked) {
+            stage.candidatesIn++;
+            stage.candidatesRemoved++;
+            stage.bytesSkipped += record.size;
+            continue;
+        }
+        WalkEntry entry;
+        entry.path = partitioner->path(record);
+        entry.size = record.size;
+        entry.mtime = record.mtime;
+        entry.device = record.device;
+        entry.inode = record.inode;
+        entry.symlink = record.symlink;
+        try {
+            addFile(entry, algorithm);
+        } catch (const std::exception& e) {
+            std::cerr << "Error processing file " << fs::path(entry.path) << ": " << e.what() << std::endl;
+        }
+    }
+    return stage;
+}
+
+void FileScanner::resetLookups(bool reopen) {
+    // Everything on the arena goes before its blocks do
+    lookups.reset();
+    statistics.arenaBytes = std::max(statistics.arenaBytes, arena.reserved() + stageArena.reserved());
+    arena.release();
+    stageArena.release();
+    if (reopen) {
+        lookups = std::make_unique<ScanLookups>(arena);
+    }
+}
+
+void FileScanner::loadSnapshot(HashAlgorithm algorithm) {
+    snapshot.reset();
+    snapshotRows.clear();
+    visitedDirectories.clear();
+    directoriesReused = 0;
+    if (options.snapshotPath.empty()) {
+        return;
+    }
+    if (options.streamingMemoryBudget > 0) {
+        // A snapshot holds the whole file table, which streaming never builds
+        std::cerr << "Warning: the scan snapshot is not used by streaming scans" << std::endl;
+        return;
+    }
+
+    snapshot = std::make_unique<ScanSnapshot>(options.snapshotPath);
+    if (!snapshot->load() || snapshot->files.empty()) {
+        return;
+    }
+    *log << "Loaded snapshot of " << snapshot->files.size() << " files in " << snapshot->directories.size()
+         << " directories from " << options.snapshotPath << std::endl;
+
+    // Digests only carry over between scans that produced them the same way
+    const bool sameAlgorithm = snapshot->algorithm == algorithm;
+    const bool sameWindow = snapshot->partialHashWindow == options.partialHashWindow;
+    if (!sameAlgorithm || !sameWindow) {
+        for (size_t row = 0; row < snapshot->files.size(); ++row) {
+            if (!sameAlgorithm) {
+                snapshot->files.hash(row) = Digest();
+            }
+            snapshot->files.partialHash(row) = Digest();
+        }
+    }
+}
+
+bool FileScanner::canReuseGroups(HashAlgorithm algorithm) const {
+    return snapshot && !snapshot->files.empty() && snapshot->algorithm == algorithm &&
+           snapshot->verification == static_cast<std::uint8_t>(options.verification);
+}
+
+void FileScanner::saveSnapshot(HashAlgorithm algorithm) {
+    if (!snapshot) {
+        return;
+    }
+    statistics.directoriesReused = directoriesReused;
+    if (statistics.directoriesReused > 0 || statistics.filesReused > 0) {
+        *log << "Snapshot reused " << statistics.directoriesReused << " directory listings, "
+             << statistics.filesReused << " file digests and " << statistics.groupsReused << " groups" << std::endl;
+    }
+
+    snapshot->algorithm = algorithm;
+    snapshot->partialHashWindow = options.partialHashWindow;
+    snapshot->verification = static_cast<std::uint8_t>(options.verification);
+    snapshot->directories = std::move(visitedDirectories);
+    visitedDirectories.clear();
+    snapshot->save(files, duplicateGroups);
+    snapshot.reset();
+    snapshotRows.clear();
+}
+
+std::vector<std::string> FileScanner::groupPaths(const FileGroup& group) const {
+    std::vector<std::string> paths;
+    paths.reserve(group.size());
+    for (size_t index : group) {
+        paths.push_back(files.path(index));
+    }
+    return paths;
+}
+
 void FileScanner::scanDirectory(const std::string& directoryPath, HashAlgorithm algorithm, bool recursive) {
+    DirectoryWalker walker(
+        [this, algorithm](std::vector<WalkEntry>& batch) {
+            for (auto& entry : batch) {
+                processFile(entry, algorithm);
+            }
+        },
+        [](const std::string& path, const std::string& message) {
+            std::cerr << "Error scanning directory: " << path << ": " << message << std::endl;
+        });
+
+    if (snapshot) {
+        // A directory whose stamp is unchanged still holds the same names; its listing is only
+        // trusted when the directory was last modified well before the previous scan listed it,
+        // since an entry added within the timestamp granularity would not move the mtime
+        const std::int64_t racyWindow = 2 * 1000000000LL;
+        walker.setListingProvider([this, racyWindow](const std::string& path, const DirectoryStamp& stamp,
+                                                     DirectoryListing& listing) {
+            auto it = snapshot->directories.find(path);
+            if (it == snapshot->directories.end()) {
+                return false;
+            }
+            const DirectoryStamp& previous = it->second.stamp;
+            if (previous.mtime != stamp.mtime || previous.device != stamp.device || previous.inode != stamp.inode ||
+                previous.mtime >= previous.listedAt - racyWindow) {
+                return false;
+            }
+            listing = it->second.listing;
+            directoriesReused++;
+            return true;
+        });
+        walker.setDirectoryObserver([this](const std::string& path, const DirectoryStamp& stamp,
+                                           const DirectoryListing& listing) {
+            visitedDirectories[path] = SnapshotDirectory{ stamp, listing };
+        });
+    }
+
+    WalkOptions walkOptions;
+    walkOptions.recursive = recursive;
+    walkOptions.threadCount = options.walkThreads;
+    walkOptions.stop = options.cancelFlag.get();
+    walkOptions.filter = walkFilter.get();
+    walker.walk(directoryPath, walkOptions);
+
+    const WalkCounters& counters = walker.counters();
+    walkTotals.directories += counters.directories;
+    walkTotals.entries += counters.entries;
+    walkTotals.stats += counters.stats;
+    walkTotals.listSeconds += counters.listSeconds;
+    walkTotals.statSeconds += counters.statSeconds;
+}
+
+void FileScanner::processFile(WalkEntry& entry, HashAlgorithm algorithm) {
+    if (stopping()) {
+        return;
+    }
+    try {
+        if (partitioner) {
+            partitioner->add(entry);
+        } else {
+            addFile(entry, algorithm);
+        }
+        statistics.filesWalked++;
+        statistics.bytesWalked += entry.size;
+        progress.filesWalked.fetch_add(1, std::memory_order_relaxed);
+        progress.bytesWalked.fetch_add(entry.size, std::memory_order_relaxed);
+
+        if (options.verbose) {
+            *log << "Processed: " << fs::path(entry.path).filename()
+                 << " (Size: " << entry.size << " bytes)" << '\n';
+        }
+        
+    } catch (const std::exception& e) {
+        std::cerr << "Error processing file " << fs::path(entry.path) << ": " << e.what() << std::endl;
+    }
+}
+
+void FileScanner::addFile(const WalkEntry& entry, HashAlgorithm algorithm) {
+    size_t index = files.add(entry.path, entry.size, entry.mtime, entry.device, entry.inode, entry.symlink);
+
+    if (snapshot) {
+        // Files with the same identity and stamp as in the snapshot keep their digests
+        size_t row = snapshot->files.find(entry.path);
+        if (row != FileTable::npos && (snapshot->files.fileSize(row) != entry.size ||
+                                       snapshot->files.mtime(row) != entry.mtime ||
+                                       snapshot->files.device(row) != entry.device ||
+                                       snapshot->files.inode(row) != entry.inode)) {
+            row = FileTable::npos;
+        }
+        if (row != FileTable::npos) {
+            files.hash(index) = snapshot->files.hash(row);
+            files.partialHash(index) = snapshot->files.partialHash(row);
+            statistics.filesReused++;
+        }
+        snapshotRows.push_back(row);
+    }
+
+    // A further hard link to an inode already walked is never read: it takes the digest
+    // of the inode's first path, which is only read once another inode has its size. A
+    // symbolic link reports its target's inode but is a file of its own, so it stays apart.
+    size_t leader = FileTable::npos;
+    if (entry.device != 0 && !entry.symlink) {
+        auto inserted = lookups->inodeToFile.emplace(InodeKey{ entry.device, entry.inode }, index);
+        if (!inserted.second) {
+            leader = inserted.first->second;
+        }
+    }
+    linkLeaders.push_back(leader);
+    hasLinks.push_back(0);
+    queued.push_back(0);
+    if (leader != FileTable::npos) {
+        statistics.linksCollapsed++;
+        hasLinks[leader] = 1;
+    } else {
+        // A size bucket becomes worth hashing once it has a second member
+        SizeBucket& bucket = lookups->sizeToFiles[entry.size];
+        if (bucket.count++ == 0) {
+            bucket.first = index;
+        }
+        if (bucket.count == 2) {
+            queueCandidate(bucket.first, algorithm);
+        }
+        if (bucket.count >= 2) {
+            queueCandidate(index, algorithm);
+        }
+    }
+}
+
+void FileScanner::queueCandidate(size_t index, HashAlgorithm algorithm) {
+    if (queued[index]) {
+        return;
+    }
+    queued[index] = 1;
+    const bool partial = options.partialHashWindow > 0;
+    if (!files.hash(index).empty() || (partial && !files.partialHash(index).empty())) {
+        // Carried over from the snapshot
+        return;
+    }
+    if (hashCache && hashCache->lookup(files.device(index), files.inode(index), files.fileSize(index),
+                                       files.mtime(index), algorithm, files.hash(index))) {
+        statistics.cacheHits++;
+        statistics.cacheBytesSaved += files.fileSize(index);
+        return;
+    }
+    if (!partial && deferFullHashes) {
+        return;
+    }
+    submitHash(index, algorithm, partial);
+}
+
+void FileScanner::submitHash(size_t index, HashAlgorithm algorithm, bool partial) {
+    // Copy what the task needs: the table may reallocate while the walk continues
+    std::string path = files.path(index);
+    std::uintmax_t size = files.fileSize(index);
+    std::size_t window = options.partialHashWindow;
+    ReadBackend backend = options.readBackend;
+    const std::uintmax_t bytes = partial ? std::min<std::uintmax_t>(size, 2 * window) : size;
+    readQueued(bytes);
+
+    if (HashCalculator::canBatch(algorithm, bytes)) {
+        const std::uint64_t device = files.device(index);
+        HashBatch& batch = hashBatches[device];
+        batch.algorithm = algorithm;
+        batch.indices.push_back(index);
+        batch.jobs.push_back(HashJob{ std::move(path), size, partial ? window : 0, Digest(), std::string() });
+        batch.bytes += bytes;
+        if (batch.jobs.size() >= Sha256MultiBuffer::lanes()) {
+            submitBatch(device, std::move(batch));
+            hashBatches.erase(device);
+        }
+        return;
+    }
+
+    scheduler->submit(files.device(index), [this, index, path, size, window, backend, algorithm, partial, bytes](size_t workerIndex) {
+        const Clock::time_point started = Clock::now();
+        if (stopping()) {
+            readFinished(started, bytes);
+            return;
+        }
+        HashResult result;
+        result.index = index;
+        try {
+            result.digest = partial ? HashCalculator::calculatePartialHash(path, algorithm, size, window)
+                                    : HashCalculator::calculateHash(path, algorithm, backend);
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        postResult(workerIndex, std::move(result));
+        readFinished(started, bytes);
+    });
+}
+
+void FileScanner::submitBatch(std::uint64_t device, HashBatch batch) {
+    auto shared = std::make_shared<HashBatch>(std::move(batch));
+    scheduler->submit(device, [this, shared](size_t workerIndex) {
+        const Clock::time_point started = Clock::now();
+        if (stopping()) {
+            readFinished(started, shared->bytes, shared->jobs.size());
+            return;
+        }
+        HashCalculator::calculateBatch(shared->jobs, shared->algorithm);
+        for (size_t i = 0; i < shared->jobs.size(); ++i) {
+            HashResult result;
+            result.index = shared->indices[i];
+            result.digest = shared->jobs[i].digest;
+            result.error = std::move(shared->jobs[i].error);
+            postResult(workerIndex, std::move(result));
+        }
+        readFinished(started, shared->bytes, shared->jobs.size());
+    });
+}
+
+void FileScanner::flushHashBatches() {
+    for (auto& entry : hashBatches) {
+        submitBatch(entry.first, std::move(entry.second));
+    }
+    hashBatches.clear();
+}
+
+void FileScanner::hashWithIoUring(const std::vector<size_t>& indices, HashAlgorithm algorithm) {
+    if (stopping()) {
+        return;
+    }
+    UringHashEngine engine(options.ioQueueDepth);
+    if (!engine.available()) {
+        for (size_t index : indices) {
+            submitHash(index, algorithm, false);
+        }
+        return;
+    }
+
+    std::vector<UringHashJob> jobs;
+    jobs.reserve(indices.size());
+    for (size_t index : indices) {
+        jobs.push_back(UringHashJob{ index, files.path(index) });
+        readQueued(files.fileSize(index));
+    }
+    // Each job is posted by one worker; run only returns once the pool is idle
+    std::vector<char> posted(files.size(), 0);
     try {
-        if (recursive) {
-            for (const auto& entry : fs::recursive_directory_iterator(directoryPath)) {
-                if (fs::is_regular_file(entry)) {
-                    processFile(entry.path(), algorithm);
+        // Reads overlap inside the ring, so only progress is counted, not busy time
+        engine.run(jobs, algorithm, *pool, [this, &posted](size_t workerIndex, size_t jobId, const Digest& digest, std::string error) {
+            progress.finished(files.fileSize(jobId));
+            HashResult result;
+            result.index = jobId;
+            result.digest = digest;
+            result.error = std::move(error);
+            postResult(workerIndex, std::move(result));
+            posted[jobId] = 1;
+        }, options.cancelFlag.get());
+    } catch (const std::exception& e) {
+        *log << e.what() << "; hashing the remaining files without io_uring" << std::endl;
+        for (size_t index : indices) {
+            if (!posted[index]) {
+                // submitHash queues the bytes again
+                progress.finished(files.fileSize(index));
+                submitHash(index, algorithm, false);
+            }
+        }
+    }
+}
+
+void FileScanner::postResult(size_t workerIndex, HashResult result) {
+    std::lock_guard<std::mutex> lock(resultsMutex);
+    shards[workerIndex].push_back(std::move(result));
+    postedResults++;
+    resultsPosted.notify_one();
+}
+
+void FileScanner::takeResults(const std::function<void(HashResult&)>& apply) {
+    std::vector<std::vector<HashResult>> taken(shards.size());
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        for (size_t i = 0; i < shards.size(); ++i) {
+            taken[i].swap(shards[i]);
+        }
+        postedResults = 0;
+    }
+    for (auto& shard : taken) {
+        for (auto& result : shard) {
+            apply(result);
+            if (tracker && tracker->awaiting[result.index]) {
+                tracker->awaiting[result.index] = 0;
+                const size_t bucket = tracker->bucketOf[result.index];
+                if (--tracker->outstanding[bucket] == 0) {
+                    deliverBucket(bucket);
                 }
             }
+        }
+    }
+}
+
+void FileScanner::awaitResults(const std::function<void(HashResult&)>& apply) {
+    flushHashBatches();
+    if (!tracker) {
+        scheduler->wait();
+        takeResults(apply);
+        return;
+    }
+    while (true) {
+        const bool idle = scheduler->pending() == 0;
+        takeResults(apply);
+        if (idle) {
+            return;
+        }
+        // Tasks skipped by a cancel post nothing, so the wait is bounded
+        std::unique_lock<std::mutex> lock(resultsMutex);
+        resultsPosted.wait_for(lock, std::chrono::milliseconds(50), [this] { return postedResults > 0; });
+    }
+}
+
+void FileScanner::applyHash(HashResult& result, bool partial, StageStatistics& stage) {
+    if (!result.error.empty()) {
+        std::cerr << "Error hashing file " << files.path(result.index) << ": " << result.error << std::endl;
+        stage.candidatesRemoved++;
+        return;
+    }
+    const std::uintmax_t size = files.fileSize(result.index);
+    if (partial) {
+        files.partialHash(result.index) = result.digest;
+        stage.bytesRead += std::min<std::uintmax_t>(size, 2 * options.partialHashWindow);
+    } else {
+        files.hash(result.index) = result.digest;
+        stage.bytesRead += size;
+    }
+}
+
+void FileScanner::collectHashes(bool partial, StageStatistics& stage) {
+    awaitResults([this, partial, &stage](HashResult& result) { applyHash(result, partial, stage); });
+}
+
+std::vector<size_t> FileScanner::filterBySize() {
+    StageStatistics stage;
+    stage.name = "Size grouping";
+    const Clock::time_point started = Clock::now();
+    beginStage("Size grouping", false);
+
+    // A file whose size is unique in the tree cannot have a duplicate, so it is never read;
+    // paths that link to it are grouped by inode instead. Later hard links are not in any
+    // bucket; they take the digest of their inode's first path. Walking the table keeps the
+    // walk order.
+    std::vector<size_t> candidates;
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (linkLeaders[index] != FileTable::npos) {
+            continue;
+        }
+        stage.candidatesIn++;
+        if (lookups->sizeToFiles.find(files.fileSize(index))->second.count > 1) {
+            candidates.push_back(index);
+        } else {
+            stage.candidatesRemoved++;
+            stage.bytesSkipped += files.fileSize(index);
+        }
+    }
+
+    endStage(stage, started, false);
+    statistics.stages.push_back(stage);
+    return candidates;
+}
+
+std::vector<size_t> FileScanner::filterByPartialHash(const std::vector<size_t>& candidates) {
+    StageStatistics stage;
+    stage.name = "Partial hash";
+    stage.candidatesIn = candidates.size();
+    const Clock::time_point started = Clock::now();
+    beginStage("Partial hash", true);
+
+    // The partial hashes were queued during the walk
+    collectHashes(true, stage);
+    endStage(stage, started, true);
+
+    const std::uintmax_t window = options.partialHashWindow;
+    ArenaMap<SizedDigest, ArenaVector<size_t>, SizedDigestHash> partialToFiles(ArenaAllocator<char>{ stageArena });
+    ArenaSet<std::uintmax_t> sizesWithCachedHash(ArenaAllocator<char>{ stageArena });
+    for (size_t index : candidates) {
+        if (!files.hash(index).empty()) {
+            // Full digest came from the cache; nothing to compare it with at this stage
+            sizesWithCachedHash.insert(files.fileSize(index));
+        } else if (!files.partialHash(index).empty()) {
+            partialToFiles[SizedDigest{ files.fileSize(index), files.partialHash(index) }].push_back(index);
+        }
+    }
+
+    std::vector<size_t> remaining;
+    for (const auto& pair : partialToFiles) {
+        if (pair.second.size() > 1) {
+            remaining.insert(remaining.end(), pair.second.begin(), pair.second.end());
+            continue;
+        }
+        const std::uintmax_t size = files.fileSize(pair.second.front());
+        if (sizesWithCachedHash.count(size) > 0) {
+            // A unique partial digest may still match a cached full digest of the same size
+            remaining.push_back(pair.second.front());
+            continue;
+        }
+        stage.candidatesRemoved++;
+        stage.bytesSkipped += size - std::min(size, 2 * window);
+    }
+
+    // Small files were hashed whole, so their partial digest already is the full digest
+    std::vector<size_t> needFullHash;
+    for (size_t index : remaining) {
+        if (files.fileSize(index) <= 2 * window) {
+            files.hash(index) = files.partialHash(index);
+        } else {
+            needFullHash.push_back(index);
+        }
+    }
+    std::sort(needFullHash.begin(), needFullHash.end());
+
+    statistics.stages.push_back(stage);
+    return needFullHash;
+}
+
+std::vector<size_t> FileScanner::compareSmallBuckets(const std::vector<size_t>& candidates, HashAlgorithm algorithm) {
+    StageStatistics stage;
+    stage.name = "Chunked compare";
+    const Clock::time_point started = Clock::now();
+    beginStage("Chunked compare", true);
+
+    // Sizes with a digest already known must be hashed, so the others can be matched against it
+    ArenaMap<SizedDigest, ArenaVector<size_t>, SizedDigestHash> buckets(ArenaAllocator<char>{ stageArena });
+    ArenaSet<std::uintmax_t> sizesWithHash(ArenaAllocator<char>{ stageArena });
+    for (size_t index : candidates) {
+        if (!files.hash(index).empty()) {
+            sizesWithHash.insert(files.fileSize(index));
+        } else {
+            buckets[SizedDigest{ files.fileSize(index), files.partialHash(index) }].push_back(index);
+        }
+    }
+
+    trackBuckets(candidates, algorithm);
+    std::vector<size_t> remaining;
+    std::vector<const ArenaVector<size_t>*> small;
+    for (const auto& pair : buckets) {
+        const ArenaVector<size_t>& members = pair.second;
+        if (members.size() < 2 || members.size() > options.compareBucketLimit ||
+            sizesWithHash.count(pair.first.size) > 0) {
+            remaining.insert(remaining.end(), members.begin(), members.end());
         } else {
-            for (const auto& entry : fs::directory_iterator(directoryPath)) {
-                if (fs::is_regular_file(entry)) {
-                    processFile(entry.path(), algorithm);
+            small.push_back(&members);
+        }
+    }
+    for (size_t index : candidates) {
+        if (!files.hash(index).empty()) {
+            remaining.push_back(index);
+        }
+    }
+    if (tracker) {
+        // Sizes one after another, largest first, so their buckets complete early
+        std::stable_sort(small.begin(), small.end(), [this](const ArenaVector<size_t>* a, const ArenaVector<size_t>* b) {
+            return files.fileSize(a->front()) > files.fileSize(b->front());
+        });
+    }
+
+    size_t matched = 0;
+    auto applyCompare = [this, &matched](HashResult& result) {
+        if (!result.error.empty()) {
+            std::cerr << "Error comparing file " << files.path(result.index) << ": " << result.error << std::endl;
+            return;
+        }
+        // Members that matched no other have no digest; they are settled all the same
+        if (!result.digest.empty()) {
+            files.hash(result.index) = result.digest;
+            matched++;
+        }
+    };
+    std::atomic<std::uintmax_t> bytesRead{ 0 };
+    for (size_t s = 0; s < small.size(); ++s) {
+        const ArenaVector<size_t>* members = small[s];
+        std::vector<std::string> paths;
+        for (size_t index : *members) {
+            paths.push_back(files.path(index));
+        }
+        const std::uintmax_t size = files.fileSize(members->front());
+        stage.candidatesIn += members->size();
+        stage.bytesSkipped += size * members->size();
+        readQueued(size * members->size(), members->size());
+
+        scheduler->submit(files.device(members->front()), [this, members, paths, size, algorithm, &bytesRead](size_t workerIndex) {
+            const Clock::time_point compareStarted = Clock::now();
+            if (stopping()) {
+                readFinished(compareStarted, size * paths.size(), paths.size());
+                return;
+            }
+            ContentComparer::Result result = ContentComparer::compare(paths, size, algorithm);
+            readFinished(compareStarted, size * paths.size(), paths.size());
+            bytesRead += result.bytesRead;
+            for (size_t i = 0; i < paths.size(); ++i) {
+                postResult(workerIndex, HashResult{ (*members)[i], result.digests[i], result.errors[i] });
+            }
+        });
+        if (tracker && s % 16 == 15) {
+            takeResults(applyCompare);
+        }
+    }
+    awaitResults(applyCompare);
+    endStage(stage, started, true);
+
+    stage.candidatesRemoved = stage.candidatesIn - matched;
+    stage.bytesRead = bytesRead;
+    stage.bytesSkipped -= stage.bytesRead;
+
+    std::sort(remaining.begin(), remaining.end());
+    statistics.stages.push_back(stage);
+    return remaining;
+}
+
+void FileScanner::hashCandidates(const std::vector<size_t>& candidates, HashAlgorithm algorithm) {
+    StageStatistics stage;
+    stage.name = "Full hash";
+    stage.candidatesIn = candidates.size();
+    const Clock::time_point started = Clock::now();
+    beginStage("Full hash", true);
+
+    // Without a partial stage the full hashes were already queued (or cached) during the walk,
+    // unless they were held back for the io_uring engine
+    std::vector<size_t> pending;
+    if (options.partialHashWindow > 0 || deferFullHashes) {
+        for (size_t index : candidates) {
+            if (files.hash(index).empty()) {
+                pending.push_back(index);
+            }
+        }
+    }
+    trackBuckets(candidates, algorithm);
+    if (deferFullHashes) {
+        hashWithIoUring(pending, algorithm);
+    } else {
+        if (tracker) {
+            // Whole buckets are read one after another, largest files first, so each completes
+            // early instead of as the stage ends
+            std::stable_sort(pending.begin(), pending.end(),
+                             [this](size_t a, size_t b) { return files.fileSize(a) > files.fileSize(b); });
+        }
+        // Alternate between devices so each one's queue fills before any backlog blocks the rest
+        pending = interleaveByDevice(pending);
+        for (size_t i = 0; i < pending.size(); ++i) {
+            submitHash(pending[i], algorithm, false);
+            if (tracker && i % 64 == 63) {
+                takeResults([this, &stage](HashResult& result) { applyHash(result, false, stage); });
+            }
+        }
+    }
+    collectHashes(false, stage);
+    groupsDelivered = tracker && !stopping();
+    tracker.reset();
+    endStage(stage, started, true);
+
+    // Candidates whose full digest turned out unique are removed by this stage too
+    ArenaMap<Digest, size_t, DigestHash> hashCounts(ArenaAllocator<char>{ stageArena });
+    for (size_t index : candidates) {
+        if (!files.hash(index).empty()) {
+            // A file with hard links is already part of a group on its own
+            hashCounts[files.hash(index)] += hasLinks[index] ? 2 : 1;
+        }
+    }
+    for (const auto& pair : hashCounts) {
+        if (pair.second == 1) {
+            stage.candidatesRemoved++;
+        }
+    }
+
+    statistics.stages.push_back(stage);
+}
+
+bool FileScanner::canDeliverBySize(HashAlgorithm algorithm) const {
+    // Confirmation and reused snapshot groups can change the groups after this stage, and the
+    // io_uring engine only returns once every read is done
+    const bool verifies = options.verification != GroupVerification::NONE &&
+                          !HashCalculator::isCollisionResistant(algorithm);
+    return onGroup && !deferFullHashes && !verifies && !canReuseGroups(algorithm);
+}
+
+void FileScanner::trackBuckets(const std::vector<size_t>& candidates, HashAlgorithm algorithm) {
+    if (tracker || !canDeliverBySize(algorithm)) {
+        return;
+    }
+    // Candidates without a digest are compared or hashed from here on or, with no partial
+    // stage, were queued during the walk
+    const size_t npos = FileTable::npos;
+    tracker = std::make_unique<BucketTracker>();
+    BucketTracker& t = *tracker;
+    t.bucketOf.assign(files.size(), npos);
+    t.awaiting.assign(files.size(), 0);
+    ArenaMap<std::uintmax_t, size_t> bucketBySize(ArenaAllocator<char>{ stageArena });
+    auto bucketFor = [&](size_t index) {
+        auto inserted = bucketBySize.emplace(files.fileSize(index), t.outstanding.size());
+        if (inserted.second) {
+            t.outstanding.push_back(0);
+        }
+        return inserted.first->second;
+    };
+    for (size_t index : candidates) {
+        if (files.hash(index).empty()) {
+            t.bucketOf[index] = bucketFor(index);
+            t.awaiting[index] = 1;
+            t.outstanding[t.bucketOf[index]]++;
+        }
+    }
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (linkLeaders[index] != npos) {
+            t.bucketOf[index] = t.bucketOf[linkLeaders[index]];
+        } else if (t.bucketOf[index] == npos && !files.hash(index).empty()) {
+            t.bucketOf[index] = bucketFor(index);
+        }
+    }
+
+    t.offsets.assign(t.outstanding.size() + 1, 0);
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (t.bucketOf[index] != npos) {
+            t.offsets[t.bucketOf[index] + 1]++;
+        }
+    }
+    for (size_t b = 1; b < t.offsets.size(); ++b) {
+        t.offsets[b] += t.offsets[b - 1];
+    }
+    t.members.resize(t.offsets.back());
+    std::vector<size_t> fill(t.offsets.begin(), t.offsets.end() - 1);
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (t.bucketOf[index] != npos) {
+            t.members[fill[t.bucketOf[index]]++] = index;
+        }
+    }
+    for (size_t bucket = 0; bucket < t.outstanding.size(); ++bucket) {
+        if (t.outstanding[bucket] == 0) {
+            deliverBucket(bucket);
+        }
+    }
+}
+
+void FileScanner::deliverBucket(size_t bucket) {
+    // Hard links take their inode's digest here already, so the groups are complete
+    std::vector<size_t> hashed;
+    for (size_t m = tracker->offsets[bucket]; m < tracker->offsets[bucket + 1]; ++m) {
+        const size_t index = tracker->members[m];
+        if (linkLeaders[index] != FileTable::npos) {
+            files.hash(index) = files.hash(linkLeaders[index]);
+            files.partialHash(index) = files.partialHash(linkLeaders[index]);
+        }
+        if (!files.hash(index).empty()) {
+            hashed.push_back(index);
+        }
+    }
+    if (hashed.size() < 2) {
+        return;
+    }
+    std::stable_sort(hashed.begin(), hashed.end(), [this](size_t a, size_t b) { return files.hash(a) < files.hash(b); });
+    std::vector<size_t> group;
+    for (size_t i = 0; i < hashed.size();) {
+        size_t j = i + 1;
+        while (j < hashed.size() && files.hash(hashed[j]) == files.hash(hashed[i])) {
+            j++;
+        }
+        if (j - i > 1) {
+            group.assign(hashed.begin() + static_cast<std::ptrdiff_t>(i), hashed.begin() + static_cast<std::ptrdiff_t>(j));
+            // The member order mergeGroups gives them
+            if (options.walkThreads > 1) {
+                std::sort(group.begin(), group.end(), [this](size_t a, size_t b) { return files.path(a) < files.path(b); });
+            }
+            auto kept = std::find_if(group.begin(), group.end(), [this](size_t index) { return !files.symlink(index); });
+            if (kept != group.end()) {
+                std::rotate(group.begin(), kept, kept + 1);
+            }
+            onGroup(files, FileGroup(group.data(), group.size()));
+        }
+        i = j;
+    }
+}
+
+void FileScanner::shareLinkDigests() {
+    for (size_t index = 0; index < files.size(); ++index) {
+        const size_t leader = linkLeaders[index];
+        if (leader != FileTable::npos) {
+            files.hash(index) = files.hash(leader);
+            files.partialHash(index) = files.partialHash(leader);
+        }
+    }
+}
+
+void FileScanner::groupUnreadLinks(GroupList& groups) {
+    ArenaMap<size_t, size_t> slotOfInode(ArenaAllocator<char>{ stageArena });
+    std::vector<std::vector<size_t>> linked;
+    for (size_t index = 0; index < files.size(); ++index) {
+        const size_t leader = linkLeader(index);
+        if (!hasLinks[leader] || !files.hash(leader).empty()) {
+            continue;
+        }
+        auto inserted = slotOfInode.emplace(leader, linked.size());
+        if (inserted.second) {
+            linked.emplace_back();
+        }
+        linked[inserted.first->second].push_back(index);
+    }
+    for (auto& group : linked) {
+        // The member order mergeGroups gives them
+        if (options.walkThreads > 1) {
+            std::sort(group.begin(), group.end(), [this](size_t a, size_t b) { return files.path(a) < files.path(b); });
+        }
+        groups.add(group, files.fileSize(group.front()));
+        if (onGroup && groupsDelivered) {
+            onGroup(files, FileGroup(group.data(), group.size()));
+        }
+    }
+}
+
+void FileScanner::findDuplicateGroups(HashAlgorithm algorithm, GroupList& kept) {
+    GroupingEngine engine(*pool, options.groupingMemoryBudget);
+    if (!canReuseGroups(algorithm)) {
+        // Files filtered out before hashing have no hash and are skipped
+        engine.group(files, duplicateGroups);
+    } else {
+        const FileTable& previous = snapshot->files;
+        std::vector<size_t> currentRows(previous.size(), FileTable::npos);
+        for (size_t index = 0; index < snapshotRows.size(); ++index) {
+            if (snapshotRows[index] != FileTable::npos) {
+                currentRows[snapshotRows[index]] = index;
+            }
+        }
+
+        // A key is touched when an old group lost a member, or when a file that was new,
+        // changed or not hashed before now has it
+        ArenaSet<SizedDigest, SizedDigestHash> touched(ArenaAllocator<char>{ stageArena });
+        for (size_t g = 0; g < snapshot->groups.size(); ++g) {
+            FileGroup group = snapshot->groups[g];
+            for (size_t row : group) {
+                if (currentRows[row] == FileTable::npos) {
+                    touched.insert(SizedDigest{ snapshot->groups.fileSize(g), previous.hash(group.front()) });
+                    break;
                 }
             }
         }
-    } catch (const fs::filesystem_error& e) {
-        std::cerr << "Error scanning directory: " << e.what() << std::endl;
+        for (size_t index = 0; index < files.size(); ++index) {
+            if (files.hash(index).empty()) {
+                continue;
+            }
+            const size_t row = snapshotRows[index];
+            if (row == FileTable::npos || previous.hash(row).empty()) {
+                touched.insert(SizedDigest{ files.fileSize(index), files.hash(index) });
+            }
+        }
+
+        std::vector<size_t> members;
+        for (size_t g = 0; g < snapshot->groups.size(); ++g) {
+            FileGroup group = snapshot->groups[g];
+            // Groups of unread links are formed again from the inodes, which costs nothing
+            if (previous.hash(group.front()).empty() ||
+                touched.count(SizedDigest{ snapshot->groups.fileSize(g), previous.hash(group.front()) }) > 0) {
+                continue;
+            }
+            members.clear();
+            for (size_t row : group) {
+                members.push_back(currentRows[row]);
+            }
+            kept.add(members, snapshot->groups.fileSize(g));
+        }
+        statistics.groupsReused = kept.size();
+
+        std::vector<size_t> regroup;
+        for (size_t index = 0; index < files.size(); ++index) {
+            if (!files.hash(index).empty() &&
+                touched.count(SizedDigest{ files.fileSize(index), files.hash(index) }) > 0) {
+                regroup.push_back(index);
+            }
+        }
+        engine.group(files, regroup, duplicateGroups);
+    }
+    if (engine.spilledRuns() > 0) {
+        *log << "Grouping spilled " << engine.spilledRuns() << " sorted runs to disk" << std::endl;
     }
 }
 
-void FileScanner::processFile(const fs::path& filePath, HashAlgorithm algorithm) {
-    try {
-        FileInfo fileInfo;
-        fileInfo.path = filePath.string();
-        fileInfo.size = fs::file_size(filePath);
-        fileInfo.lastModified = fs::last_write_time(filePath);
-        
-        // Calculate hash
-        fileInfo.hash = HashCalculator::calculateHash(filePath.string(), algorithm);
-        
-        scannedFiles.push_back(fileInfo);
-        
-        std::cout << "Processed: " << filePath.filename() << " (Size: " << fileInfo.size << " bytes)" << std::endl;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing file " << filePath << ": " << e.what() << std::endl;
+void FileScanner::mergeGroups(const GroupList& kept) {
+    if (!kept.empty()) {
+        // Interleave by (size, digest), the order the grouping engine emits
+        struct Source {
+            const GroupList* list;
+            size_t position;
+        };
+        std::vector<Source> order;
+        order.reserve(kept.size() + duplicateGroups.size());
+        for (size_t g = 0; g < duplicateGroups.size(); ++g) {
+            order.push_back(Source{ &duplicateGroups, g });
+        }
+        for (size_t g = 0; g < kept.size(); ++g) {
+            order.push_back(Source{ &kept, g });
+        }
+        std::stable_sort(order.begin(), order.end(), [this](const Source& a, const Source& b) {
+            const std::uintmax_t sizeA = a.list->fileSize(a.position);
+            const std::uintmax_t sizeB = b.list->fileSize(b.position);
+            if (sizeA != sizeB) {
+                return sizeA < sizeB;
+            }
+            return files.hash((*a.list)[a.position].front()) < files.hash((*b.list)[b.position].front());
+        });
+
+        GroupList merged;
+        for (const auto& source : order) {
+            FileGroup group = (*source.list)[source.position];
+            merged.add(group.begin(), group.size(), source.list->fileSize(source.position));
+        }
+        duplicateGroups = std::move(merged);
     }
+
+    // A parallel walk appends files in no fixed order
+    if (options.walkThreads > 1) {
+        duplicateGroups.sortMembers([this](size_t a, size_t b) { return files.path(a) < files.path(b); });
+    }
+    // The first member is the one kept, so a symbolic link never is while the group has a file
+    duplicateGroups.moveToFront([this](size_t index) { return !files.symlink(index); });
+    duplicateGroups.sort(options.groupOrder);
 }
 
-void FileScanner::findDuplicateGroups() {
-    std::unordered_map<std::string, std::vector<std::string>> hashToFiles;
-    
-    // Group files by hash
-    for (const auto& fileInfo : scannedFiles) {
-        hashToFiles[fileInfo.hash].push_back(fileInfo.path);
+void FileScanner::countDuplicateBytes() {
+    ArenaSet<size_t> inodes(ArenaAllocator<char>{ stageArena });
+    for (size_t g = 0; g < duplicateGroups.size(); ++g) {
+        FileGroup group = duplicateGroups[g];
+        const std::uintmax_t size = duplicateGroups.fileSize(g);
+        inodes.clear();
+        for (size_t index : group) {
+            // Removing a symbolic link frees nothing
+            if (!files.symlink(index)) {
+                inodes.insert(linkLeader(index));
+            }
+        }
+        statistics.duplicateBytes += size * (group.size() - 1);
+        statistics.reclaimableBytes += size * (inodes.empty() ? 0 : inodes.size() - 1);
     }
-    
-    // Find groups with more than one file (duplicates)
-    for (const auto& pair : hashToFiles) {
-        if (pair.second.size() > 1) {
-            duplicateGroups.push_back(pair.second);
+}
+
+void FileScanner::collectChunkCandidates() {
+    // Identical files are already reported as a group, so only the member kept stands for it
+    std::vector<char> skip(files.size(), 0);
+    std::unordered_set<size_t> inodes;
+    // A symbolic link would only be found similar to its own target
+    auto add = [this, &inodes](size_t index) {
+        if (files.fileSize(index) >= options.similarityMinSize && !files.symlink(index) &&
+            inodes.insert(linkLeader(index)).second) {
+            chunkCandidates.push_back(ChunkCandidate{ files.path(index), files.fileSize(index), files.device(index) });
+        }
+    };
+    for (const FileGroup& group : duplicateGroups) {
+        for (size_t index : group) {
+            skip[index] = 1;
         }
+        add(group[0]);
     }
-    
-    // Sort duplicate groups by size (largest groups first)
-    std::sort(duplicateGroups.begin(), duplicateGroups.end(), 
-              [](const std::vector<std::string>& a, const std::vector<std::string>& b) {
-                  return a.size() > b.size();
-              });
-}
\ No newline at end of file
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (!skip[index]) {
+            add(index);
+        }
+    }
+}
+
+void FileScanner::findSimilarFiles(HashAlgorithm algorithm) {
+    StageStatistics stage;
+    stage.name = "Chunking";
+    stage.candidatesIn = chunkCandidates.size();
+    const Clock::time_point started = Clock::now();
+    beginStage("Chunking", true);
+
+    struct ChunkedFile {
+        size_t candidate;
+        std::vector<Chunk> chunks;
+        std::string error;
+    };
+    std::vector<std::vector<ChunkedFile>> chunked(pool->size());
+    const ChunkParams params = ChunkParams::forAverage(options.chunkAverageSize);
+    const ReadBackend backend = options.readBackend;
+    // Files are chunked in parallel, each on one worker, with the per-device read limits of the hashes
+    for (size_t i = 0; i < chunkCandidates.size(); ++i) {
+        const ChunkCandidate& candidate = chunkCandidates[i];
+        readQueued(candidate.size);
+        scheduler->submit(candidate.device, [this, i, &candidate, &chunked, params, backend, algorithm](size_t workerIndex) {
+            const Clock::time_point readStarted = Clock::now();
+            if (stopping()) {
+                readFinished(readStarted, candidate.size);
+                return;
+            }
+            ChunkedFile result;
+            result.candidate = i;
+            try {
+                result.chunks = ContentChunker::chunkFile(candidate.path, algorithm, params, backend, candidate.size);
+            } catch (const std::exception& e) {
+                result.error = e.what();
+            }
+            chunked[workerIndex].push_back(std::move(result));
+            readFinished(readStarted, candidate.size);
+        });
+    }
+    scheduler->wait();
+    endStage(stage, started, true);
+
+    // Indexed in candidate order, so the pairs do not depend on which worker finished first
+    std::vector<ChunkedFile> results;
+    for (auto& shard : chunked) {
+        for (auto& result : shard) {
+            results.push_back(std::move(result));
+        }
+    }
+    std::sort(results.begin(), results.end(),
+              [](const ChunkedFile& a, const ChunkedFile& b) { return a.candidate < b.candidate; });
+    ChunkIndex index;
+    std::vector<size_t> candidateOf;
+    for (auto& result : results) {
+        const ChunkCandidate& candidate = chunkCandidates[result.candidate];
+        if (!result.error.empty()) {
+            std::cerr << "Error chunking file " << candidate.path << ": " << result.error << std::endl;
+            stage.candidatesRemoved++;
+            continue;
+        }
+        stage.bytesRead += candidate.size;
+        index.addFile(candidate.size, result.chunks);
+        candidateOf.push_back(result.candidate);
+        std::vector<Chunk>().swap(result.chunks);
+    }
+
+    size_t skipped = 0;
+    std::vector<char> paired(index.fileCount(), 0);
+    for (const SimilarPair& pair : index.similarPairs(options.similarityThreshold, SIMILARITY_FANOUT_LIMIT, skipped)) {
+        const ChunkCandidate& first = chunkCandidates[candidateOf[pair.first]];
+        const ChunkCandidate& second = chunkCandidates[candidateOf[pair.second]];
+        similarFiles.push_back(SimilarFiles{ first.path, second.path, first.size, second.size,
+                                             pair.sharedBytes, pair.ratio });
+        paired[pair.first] = 1;
+        paired[pair.second] = 1;
+    }
+    stage.candidatesRemoved += static_cast<size_t>(std::count(paired.begin(), paired.end(), 0));
+    statistics.stages.push_back(stage);
+
+    *log << "Chunked " << index.fileCount() << " files into " << index.chunkCount() << " distinct chunks ("
+         << index.uniqueBytes() / (1024 * 1024) << " MB unique of " << stage.bytesRead / (1024 * 1024)
+         << " MB); " << similarFiles.size() << " similar pairs" << std::endl;
+    if (skipped > 0) {
+        *log << "Left out " << skipped << " chunks held by more than " << SIMILARITY_FANOUT_LIMIT << " files"
+             << std::endl;
+    }
+    chunkCandidates.clear();
+}
+
+void FileScanner::verifyGroups(HashAlgorithm algorithm) {
+    StageStatistics stage;
+    stage.name = options.verification == GroupVerification::SHA256 ? "SHA256 confirmation" : "Byte comparison";
+    stage.candidatesIn = duplicateGroups.fileCount();
+    const Clock::time_point started = Clock::now();
+    beginStage(options.verification == GroupVerification::SHA256 ? "SHA256 confirmation" : "Byte comparison", true);
+
+    GroupList confirmed;
+    if (options.verification == GroupVerification::SHA256) {
+        // Re-hash every inode on the pool once; the result index is the position in a flat
+        // member list, and the other links of an inode take its digest
+        std::vector<size_t> members;
+        std::vector<size_t> sources;
+        for (const auto& group : duplicateGroups) {
+            std::unordered_map<size_t, size_t> firstPosition;
+            for (size_t index : group) {
+                size_t position = members.size();
+                members.push_back(index);
+                auto inserted = firstPosition.emplace(linkLeader(index), position);
+                sources.push_back(inserted.first->second);
+                if (!inserted.second) {
+                    continue;
+                }
+                std::string path = files.path(index);
+                const std::uintmax_t size = files.fileSize(index);
+                readQueued(size);
+                scheduler->submit(files.device(index), [this, position, path, size](size_t workerIndex) {
+                    const Clock::time_point hashStarted = Clock::now();
+                    if (stopping()) {
+                        readFinished(hashStarted, size);
+                        return;
+                    }
+                    HashResult result;
+                    result.index = position;
+                    try {
+                        result.digest = HashCalculator::calculateHash(path, HashAlgorithm::SHA256);
+                    } catch (const std::exception& e) {
+                        result.error = e.what();
+                    }
+                    shards[workerIndex].push_back(std::move(result));
+                    readFinished(hashStarted, size);
+                });
+            }
+        }
+        scheduler->wait();
+
+        std::vector<Digest> digests(members.size());
+        for (auto& shard : shards) {
+            for (auto& result : shard) {
+                if (!result.error.empty()) {
+                    std::cerr << "Error hashing file " << files.path(members[result.index]) << ": " << result.error << std::endl;
+                }
+                digests[result.index] = result.digest;
+            }
+            shard.clear();
+        }
+        for (size_t position = 0; position < members.size(); ++position) {
+            digests[position] = digests[sources[position]];
+        }
+
+        size_t position = 0;
+        for (size_t g = 0; g < duplicateGroups.size(); ++g) {
+            FileGroup group = duplicateGroups[g];
+            std::unordered_map<Digest, std::vector<size_t>, DigestHash> split;
+            std::vector<Digest> order;
+            for (size_t index : group) {
+                const Digest& digest = digests[position++];
+                if (digest.empty()) {
+                    continue;
+                }
+                if (split.find(digest) == split.end()) {
+                    order.push_back(digest);
+                }
+                split[digest].push_back(index);
+            }
+            for (const auto& digest : order) {
+                if (split[digest].size() > 1) {
+                    confirmed.add(split[digest], duplicateGroups.fileSize(g));
+                }
+            }
+        }
+    } else {
+        for (size_t g = 0; g < duplicateGroups.size() && !stopping(); ++g) {
+            FileGroup group = duplicateGroups[g];
+
+            // Only the first member of each inode is read; its other links follow its class
+            std::vector<size_t> distinct;
+            std::vector<size_t> distinctOf(group.size());
+            std::unordered_map<size_t, size_t> slotOfInode;
+            for (size_t i = 0; i < group.size(); ++i) {
+                auto inserted = slotOfInode.emplace(linkLeader(group[i]), distinct.size());
+                if (inserted.second) {
+                    distinct.push_back(group[i]);
+                }
+                distinctOf[i] = inserted.first->second;
+            }
+            const size_t unreadable = static_cast<size_t>(-2);
+            std::vector<size_t> classOf(distinct.size(), ContentComparer::npos);
+            const std::uintmax_t groupBytes = duplicateGroups.fileSize(g) * distinct.size();
+            readQueued(groupBytes, distinct.size());
+            const Clock::time_point groupStarted = Clock::now();
+
+            if (distinct.size() <= LOCKSTEP_GROUP_LIMIT) {
+                // Read all members side by side once
+                std::vector<std::string> paths;
+                for (size_t index : distinct) {
+                    paths.push_back(files.path(index));
+                }
+                ContentComparer::Result result = ContentComparer::compare(paths, duplicateGroups.fileSize(g),
+                                                                          algorithm, false);
+                for (size_t i = 0; i < distinct.size(); ++i) {
+                    if (!result.errors[i].empty()) {
+                        std::cerr << "Error comparing file " << paths[i] << ": " << result.errors[i] << std::endl;
+                        classOf[i] = unreadable;
+                    } else {
+                        classOf[i] = result.classOf[i];
+                    }
+                }
+            } else {
+                // Too many open files and buffers for one pass: peel off the members identical
+                // to the first remaining file until none are left
+                std::vector<size_t> remaining(distinct.size());
+                for (size_t i = 0; i < remaining.size(); ++i) {
+                    remaining[i] = i;
+                }
+                size_t classes = 0;
+                while (remaining.size() > 1) {
+                    std::vector<size_t> different;
+                    const std::string first = files.path(distinct[remaining.front()]);
+                    classOf[remaining.front()] = classes;
+                    for (size_t i = 1; i < remaining.size(); ++i) {
+                        const std::string other = files.path(distinct[remaining[i]]);
+                        try {
+                            if (HashCalculator::compareContents(first, other)) {
+                                classOf[remaining[i]] = classes;
+                            } else {
+                                different.push_back(remaining[i]);
+                            }
+                        } catch (const std::exception& e) {
+                            std::cerr << "Error comparing file " << other << ": " << e.what() << std::endl;
+                            classOf[remaining[i]] = unreadable;
+                        }
+                    }
+                    classes++;
+                    remaining = std::move(different);
+                }
+            }
+            readFinished(groupStarted, groupBytes, distinct.size());
+
+            // Classes are listed in order of their first member; an inode that matched no other
+            // one still forms a class with its own links
+            std::vector<std::vector<size_t>> members;
+            std::unordered_map<size_t, size_t> slots;
+            for (size_t i = 0; i < group.size(); ++i) {
+                const size_t d = distinctOf[i];
+                if (classOf[d] == unreadable) {
+                    continue;
+                }
+                const size_t key = classOf[d] != ContentComparer::npos ? classOf[d] : distinct.size() + d;
+                auto slot = slots.emplace(key, members.size()).first->second;
+                if (slot == members.size()) {
+                    members.emplace_back();
+                }
+                members[slot].push_back(group[i]);
+            }
+            for (const auto& classMembers : members) {
+                if (classMembers.size() > 1) {
+                    confirmed.add(classMembers, duplicateGroups.fileSize(g));
+                }
+            }
+        }
+    }
+
+    endStage(stage, started, true);
+    if (options.verification == GroupVerification::BYTE_COMPARE) {
+        // Groups are compared one after another on this thread
+        stage.workers = 1;
+    }
+    stage.candidatesRemoved = stage.candidatesIn - confirmed.fileCount();
+    if (stage.candidatesRemoved > 0) {
+        std::cerr << "Warning: " << stage.candidatesRemoved << " files matched by "
+                  << HashCalculator::algorithmName(algorithm) << " were not identical" << std::endl;
+    }
+
+    duplicateGroups = std::move(confirmed);
+    statistics.stages.push_back(stage);
+}
+
+void FileScanner::updateHashCache(HashAlgorithm algorithm) {
+    if (!hashCache) {
+        return;
+    }
+    storeHashes(algorithm);
+    hashCache->save();
+}
+
+void FileScanner::storeHashes(HashAlgorithm algorithm) {
+    if (!hashCache) {
+        return;
+    }
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (!files.hash(index).empty()) {
+            hashCache->store(files.device(index), files.inode(index), files.fileSize(index), files.mtime(index),
+                             algorithm, files.hash(index), files.path(index));
+        }
+    }
+}
@@ -3,40 +3,390 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
-#include <filesystem>
+#include <iostream>
 #include "hash_calculator.h"
+#include "directory_walker.h"
+#include "file_table.h"
+#include "grouping_engine.h"
+#include "worker_pool.h"
+#include "io_scheduler.h"
+#include "progress_reporter.h"
+#include "hash_cache.h"
+#include "scan_snapshot.h"
+#include "size_partitioner.h"
+#include "content_chunker.h"
+#include "scan_arena.h"
 
-struct FileInfo {
-    std::string path;
-    std::string hash;
-    std::uintmax_t size;
-    std::filesystem::file_time_type lastModified;
+
+// Counters for one stage of the duplicate detection pipeline
+struct StageStatistics {
+    std::string name;
+    size_t candidatesIn = 0;
+    size_t candidatesRemoved = 0;
+    std::uintmax_t bytesRead = 0;       // Bytes read from disk by this stage
+    std::uintmax_t bytesSkipped = 0;    // Bytes never read because candidates were dropped here
+    double seconds = 0;                 // Wall time, from the stage's first queued read when that came earlier
+    double busySeconds = 0;             // Time spent in the stage's work, summed over its threads
+    size_t workers = 0;                 // Threads available to the stage; 0 when its work is not timed
+    size_t peakQueueDepth = 0;          // Most reads waiting or running in the scheduler at once
+};
+
+struct ScanStatistics {
+    double seconds = 0;
+    size_t duplicateGroups = 0;
+    size_t filesWalked = 0;
+    std::uintmax_t bytesWalked = 0;
+    size_t cacheHits = 0;
+    std::uintmax_t cacheBytesSaved = 0;
+    size_t directoriesReused = 0;       // Directories listed from the snapshot instead of read
+    size_t filesReused = 0;             // Unchanged files whose digests came from the snapshot
+    size_t groupsReused = 0;            // Duplicate groups carried over without regrouping
+    size_t linksCollapsed = 0;          // Extra hard links that shared an earlier path's digest
+    std::uintmax_t duplicateBytes = 0;  // Size of every group member but the first
+    std::uintmax_t reclaimableBytes = 0;    // Same, counting each extra inode of a group once
+    std::size_t arenaBytes = 0;         // Most memory the scan arena held at once
+    bool cancelled = false;             // Stopped by the cancel flag; no groups were reported
+    std::vector<StageStatistics> stages;
+};
+
+// Two files that are not identical but share content-defined chunks
+struct SimilarFiles {
+    std::string first;
+    std::string second;
+    std::uintmax_t firstSize = 0;
+    std::uintmax_t secondSize = 0;
+    std::uintmax_t sharedBytes = 0;
+    double ratio = 0;           // Shared bytes over the size of the larger file
+};
+
+// Confirmation step run on the final groups when the hash is not collision resistant
+enum class GroupVerification {
+    NONE,
+    SHA256,         // Re-hash group members with SHA-256
+    BYTE_COMPARE    // Compare group members byte for byte
+};
+
+// Tunable pipeline settings
+struct ScanOptions {
+    // Bytes hashed from the head and from the tail of each same-size candidate before
+    // the full hash; 0 disables the partial hash stage
+    std::size_t partialHashWindow = 4096;
+
+    // Candidate sets (same size and partial digest) with at most this many members are
+    // compared block by block instead of being hashed; 0 or 1 disables the compare stage
+    size_t compareBucketLimit = 3;
+
+    // Hashing worker threads; 0 uses one per hardware thread
+    size_t threadCount = 0;
+
+    // Concurrent reads per device; 0 lets every hashing thread read the same device.
+    // Rotational disks get 1 unless a root on them has its own limit below
+    size_t deviceReadLimit = 0;
+    // Read limits for the devices holding these roots, e.g. 1 for a USB disk, 32 for NVMe
+    std::vector<std::pair<std::string, size_t>> rootReadLimits;
+
+    // Directory walker threads; above 1 subtrees are walked in parallel and the members of
+    // each group are listed in path order instead of walk order
+    size_t walkThreads = 1;
+
+    // Files and directories the walk leaves out; excluded directories are never opened.
+    // Malformed patterns make findDuplicates throw std::invalid_argument.
+    FilterRules filters;
+
+    // Persistent digest cache file; empty disables the cache
+    std::string hashCachePath;
+
+    // Snapshot of the previous scan for incremental rescans; empty disables it
+    std::string snapshotPath;
+
+    GroupVerification verification = GroupVerification::NONE;
+
+    // How full hashes read file contents; AUTO picks mmap or pread per file size
+    ReadBackend readBackend = ReadBackend::AUTO;
+
+    // Log one "Processed:" line per walked file
+    bool verbose = false;
+    // Print a progress line with rates and an ETA to stderr at most this often; 0 disables it
+    unsigned progressIntervalMs = 0;
+
+    GroupOrder groupOrder = GroupOrder::WASTED_BYTES;
+    // Bytes of sort records the grouping stage keeps in memory before spilling runs to disk
+    std::size_t groupingMemoryBudget = 256 * 1024 * 1024;
+
+    // Above 0, the walk spills compact records to temporary files split by size and each
+    // size partition is deduplicated on its own with about this many bytes of file state,
+    // so memory follows the budget and the duplicates found instead of the tree size.
+    // Snapshots are not used in this mode.
+    std::size_t streamingMemoryBudget = 0;
+
+    // Files of at least this many bytes are also cut into content-defined chunks after the
+    // duplicate search, and pairs that share most of their chunks are reported; 0 disables it.
+    // Of each duplicate group only the member kept is chunked.
+    std::uintmax_t similarityMinSize = 0;
+    // Average chunk size; chunks are between a quarter of it and eight times it
+    std::size_t chunkAverageSize = 64 * 1024;
+    // Share of the larger file two files must have in common to be reported
+    double similarityThreshold = 0.5;
+
+    // Drive full hashes through the Linux io_uring engine; falls back when unsupported
+    bool useIoUring = false;
+    unsigned ioQueueDepth = 64;
+
+    // Setting it from any thread stops the scan at the next directory, read or stage; the
+    // scan then returns no groups, since those not yet handed to the group callback may be
+    // missing members
+    std::shared_ptr<const std::atomic<bool>> cancelFlag;
 };
 
 class FileScanner {
 public:
+    // Receives a duplicate group once it is final, with the table holding its rows; both are
+    // only valid during the call
+    using GroupCallback = std::function<void(const FileTable& files, const FileGroup& group)>;
+
     FileScanner() = default;
+
+    void setOptions(const ScanOptions& scanOptions) { options = scanOptions; }
+    const ScanOptions& getOptions() const { return options; }
+
+    // Hand out every group as soon as it is known, on the scanning thread, while other size
+    // buckets are still being hashed. With no later step that could change them, a size's
+    // groups go out once the last of its full hashes is in, and pending hashes are read by
+    // size, largest first; otherwise they go out as each pipeline run, or streaming
+    // partition, finishes. The groups findDuplicates returns are the same, in report order.
+    void setGroupCallback(GroupCallback callback) { onGroup = std::move(callback); }
+
+    // Progress messages go to stdout unless redirected; errors always go to stderr
+    void setLogStream(std::ostream& stream) { log = &stream; }
     
     // Scan directory and return groups of duplicate files
-    std::vector<std::vector<std::string>> findDuplicates(const std::string& directoryPath, 
-                                                         HashAlgorithm algorithm = HashAlgorithm::SHA256,
-                                                         bool recursive = true);
+    const GroupList& findDuplicates(const std::string& directoryPath, 
+                                    HashAlgorithm algorithm = HashAlgorithm::SHA256,
+                                    bool recursive = true);
+
+    // Scan several directories as one file set
+    const GroupList& findDuplicates(const std::vector<std::string>& directoryPaths,
+                                    HashAlgorithm algorithm = HashAlgorithm::SHA256,
+                                    bool recursive = true);
+
+    // Paths of a group's members, in group order; the first member is the file to keep
+    std::vector<std::string> groupPaths(const FileGroup& group) const;
     
-    // Get all scanned files
-    const std::vector<FileInfo>& getScannedFiles() const { return scannedFiles; }
+    // Get all scanned files; after a streaming scan only the members of duplicate groups
+    const FileTable& getScannedFiles() const { return files; }
     
     // Get statistics
-    size_t getTotalFilesScanned() const { return scannedFiles.size(); }
+    size_t getTotalFilesScanned() const { return statistics.filesWalked; }
     size_t getTotalDuplicateGroups() const { return duplicateGroups.size(); }
+    const ScanStatistics& getStatistics() const { return statistics; }
+    // Near-duplicate pairs of the last scan, most shared bytes first; empty unless enabled
+    const std::vector<SimilarFiles>& getSimilarFiles() const { return similarFiles; }
 
 private:
-    std::vector<FileInfo> scannedFiles;
-    std::vector<std::vector<std::string>> duplicateGroups;
+    // Digest produced by a worker, kept in that worker's shard until the stage is merged
+    struct HashResult {
+        size_t index;
+        Digest digest;
+        std::string error;      // Non-empty when hashing failed
+    };
+
+    // File cut into chunks by the similarity stage
+    struct ChunkCandidate {
+        std::string path;
+        std::uintmax_t size;
+        std::uint64_t device;
+    };
+
+    struct InodeKey {
+        std::uint64_t device;
+        std::uint64_t inode;
+        bool operator==(const InodeKey& other) const { return device == other.device && inode == other.inode; }
+    };
+    struct InodeKeyHash {
+        size_t operator()(const InodeKey& key) const {
+            return std::hash<std::uint64_t>()(key.inode) ^ (std::hash<std::uint64_t>()(key.device) << 1);
+        }
+    };
+    // Walked files of one size; counts only the first path walked for each inode
+    struct SizeBucket {
+        size_t first = 0;
+        size_t count = 0;
+    };
+    // Per-file lookups of one scan, or of one streaming partition, all on the arena
+    struct ScanLookups {
+        explicit ScanLookups(ScanArena& arena)
+            : sizeToFiles(ArenaAllocator<char>(arena)), inodeToFile(ArenaAllocator<char>(arena)) {}
+        ArenaMap<std::uintmax_t, SizeBucket> sizeToFiles;
+        ArenaMap<InodeKey, size_t, InodeKeyHash> inodeToFile;
+    };
+
+    // Declared before everything allocated from them, so they are destroyed last. The stage
+    // arena holds the maps local to one stage and is released when the next stage begins.
+    ScanArena arena;
+    ScanArena stageArena;
+    std::unique_ptr<ScanLookups> lookups;
+
+    FileTable files;
+    GroupList duplicateGroups;
+    std::vector<ChunkCandidate> chunkCandidates;
+    std::vector<SimilarFiles> similarFiles;
+    ScanStatistics statistics;
+    ScanOptions options;
+    std::ostream* log = &std::cout;
+
+    std::unique_ptr<WorkerPool> pool;
+    std::unique_ptr<IoScheduler> scheduler;     // Every file read goes through it, by device
+    std::unique_ptr<HashCache> hashCache;
+    std::unique_ptr<ScanSnapshot> snapshot;
+    std::unique_ptr<SizePartitioner> partitioner;   // Set while a streaming scan runs
+    std::vector<size_t> snapshotRows;       // Snapshot row of each unchanged file, npos otherwise
+    std::unordered_map<std::string, SnapshotDirectory> visitedDirectories;
+    std::atomic<size_t> directoriesReused{ 0 };
+    bool deferFullHashes = false;   // Full hashes wait for the io_uring stage instead of the walk
+    std::vector<std::vector<HashResult>> shards;
+    // Results are posted under the lock, so a stage can take them while others are still
+    // being read
+    std::mutex resultsMutex;
+    std::condition_variable resultsPosted;
+    size_t postedResults = 0;
+
+    // Size buckets that hand out their groups once none of their files is still being read:
+    // every size with a file that has its full digest or may still get one, with the hard
+    // links to those files
+    struct BucketTracker {
+        std::vector<size_t> bucketOf;       // Per file; npos outside every bucket
+        std::vector<char> awaiting;         // Per file: a comparison or full hash is still due
+        std::vector<size_t> outstanding;    // Per bucket: files still awaiting
+        std::vector<size_t> offsets;        // Bucket b holds members[offsets[b]] to members[offsets[b + 1] - 1]
+        std::vector<size_t> members;        // In index order within each bucket
+    };
+    GroupCallback onGroup;
+    std::unique_ptr<BucketTracker> tracker;
+
+    // Small reads held back per device until there are enough to fill the multi-buffer lanes
+    struct HashBatch {
+        HashAlgorithm algorithm = HashAlgorithm::SHA256;
+        std::vector<size_t> indices;
+        std::vector<HashJob> jobs;
+        std::uintmax_t bytes = 0;
+    };
+    std::unordered_map<std::uint64_t, HashBatch> hashBatches;
+    bool groupsDelivered = false;   // The current pipeline run already handed out its groups
+
+    using Clock = std::chrono::steady_clock;
+    ScanProgress progress;
+    WalkCounters walkTotals;
+    // Reads of the stage in progress; those queued during the walk belong to the first stage that reads
+    bool readsStarted = false;
+    bool walkReads = false;
+    Clock::time_point readsStartedAt;
+    std::atomic<std::int64_t> busyNanos{ 0 };
+    std::vector<size_t> linkLeaders;        // Per file: first file with its inode, npos for that file itself
+    std::vector<char> hasLinks;             // Per file: another path is a hard link to it
+    std::vector<char> queued;               // Per file: queueCandidate already ran
+    std::unique_ptr<WalkFilter> walkFilter; // options.filters compiled for the walk; null when unset
     
+    // Drop the lookups and give the arena's blocks back; reopen starts empty lookups on it
+    void resetLookups(bool reopen);
+
+    void loadSnapshot(HashAlgorithm algorithm);
+    void saveSnapshot(HashAlgorithm algorithm);
+    // Whether the snapshot groups are still valid for this scan's settings
+    bool canReuseGroups(HashAlgorithm algorithm) const;
+
+    // Stage timing: reads stages claim the walk's reads, the others only time themselves.
+    // Also releases the stage arena, so no caller may hold anything allocated from it.
+    void beginStage(const char* name, bool reads);
+    void endStage(StageStatistics& stage, Clock::time_point stageStarted, bool reads);
+    // Called where a read is queued, and on the worker that finished it
+    void readQueued(std::uintmax_t bytes, size_t count = 1);
+    void readFinished(Clock::time_point started, std::uintmax_t bytes, size_t count = 1);
+    // Walk and Stat stages from the walker's counters
+    void recordWalk(double seconds);
+
     void scanDirectory(const std::string& directoryPath, HashAlgorithm algorithm, bool recursive);
-    void processFile(const std::filesystem::path& filePath, HashAlgorithm algorithm);
-    void findDuplicateGroups();
+    void processFile(WalkEntry& entry, HashAlgorithm algorithm);
+    // Add a file to the table and queue the hashes its size bucket or inode calls for
+    void addFile(const WalkEntry& entry, HashAlgorithm algorithm);
+
+    // Everything after the walk, over the files in the table
+    void runPipeline(HashAlgorithm algorithm);
+    // Run the pipeline over each spilled size partition and keep only the group members
+    void scanPartitions(HashAlgorithm algorithm);
+    // Add the partition's files that can have a duplicate; returns what the size stage dropped
+    StageStatistics loadPartition(const std::vector<SpilledFile>& records, HashAlgorithm algorithm);
+
+    bool stopping() const {
+        return options.cancelFlag && options.cancelFlag->load(std::memory_order_relaxed);
+    }
+
+    size_t linkLeader(size_t index) const {
+        return linkLeaders[index] == FileTable::npos ? index : linkLeaders[index];
+    }
+
+    // Reuse a cached digest for files[index] or queue it for hashing
+    void queueCandidate(size_t index, HashAlgorithm algorithm);
+    // Queue a hash of files[index] on the worker pool; partial selects the head/tail digest
+    void submitHash(size_t index, HashAlgorithm algorithm, bool partial);
+    // Queue one task that hashes the whole batch and posts a result per file
+    void submitBatch(std::uint64_t device, HashBatch batch);
+    // Submit the batches still filling; every wait for hash results starts with this
+    void flushHashBatches();
+    // Add a result to the worker's shard and wake a stage waiting for results
+    void postResult(size_t workerIndex, HashResult result);
+    // Apply the results posted so far, then settle their files with the bucket tracker
+    void takeResults(const std::function<void(HashResult&)>& apply);
+    // Same until every queued read finished; with a tracker, results are taken as they arrive
+    void awaitResults(const std::function<void(HashResult&)>& apply);
+    void applyHash(HashResult& result, bool partial, StageStatistics& stage);
+    // Wait for queued hashes and move the shard results into the file table
+    void collectHashes(bool partial, StageStatistics& stage);
+
+    // Whether groups can go out before the full hash stage ends, unchanged by anything after it
+    bool canDeliverBySize(HashAlgorithm algorithm) const;
+    // Start tracking buckets when groups can go out early; candidates are the files still to
+    // be compared or hashed. Buckets with nothing due are handed out at once.
+    void trackBuckets(const std::vector<size_t>& candidates, HashAlgorithm algorithm);
+    // Group the hashed members of a bucket, all final, and pass the groups to the callback
+    void deliverBucket(size_t bucket);
+    // Full-hash the given files through the io_uring engine
+    void hashWithIoUring(const std::vector<size_t>& indices, HashAlgorithm algorithm);
+
+    // Pipeline stages: each one narrows the list of candidate indices into the file table
+    std::vector<size_t> filterBySize();
+    std::vector<size_t> filterByPartialHash(const std::vector<size_t>& candidates);
+    // Settle small candidate sets by lockstep comparison; returns the candidates left to hash
+    std::vector<size_t> compareSmallBuckets(const std::vector<size_t>& candidates, HashAlgorithm algorithm);
+    void hashCandidates(const std::vector<size_t>& candidates, HashAlgorithm algorithm);
+    // Same indices, taking one file per device in turn
+    std::vector<size_t> interleaveByDevice(const std::vector<size_t>& indices) const;
+    // Give every hard link the digests computed for the first path of its inode
+    void shareLinkDigests();
+    // Add a group of its paths for every linked inode that was never fully hashed, because no
+    // other inode has its size or its content; paths of one inode need no read to match
+    void groupUnreadLinks(GroupList& groups);
+    // Regroup the table into duplicateGroups; with a usable snapshot only the (size, digest)
+    // keys touched by new, changed or removed files are regrouped, the rest land in kept
+    void findDuplicateGroups(HashAlgorithm algorithm, GroupList& kept);
+    void verifyGroups(HashAlgorithm algorithm);
+    // Merge kept groups into duplicateGroups in the order a full regroup would produce
+    void mergeGroups(const GroupList& kept);
+    void countDuplicateBytes();
+    // Remember the table's large files for chunking: one path per inode, and of each group
+    // only its first member
+    void collectChunkCandidates();
+    // Chunk the candidates and report the pairs that share enough of their chunks
+    void findSimilarFiles(HashAlgorithm algorithm);
+    void updateHashCache(HashAlgorithm algorithm);
+    // Hand the table's digests to the cache without saving it
+    void storeHashes(HashAlgorithm algorithm);
 };
 
-#endif // FILE_SCANNER_H
\ No newline at end of file
+#endif // FILE_SCANNER_H
@@ -0,0 +1,130 @@
+#include "file_table.h"
+#include <algorithm>
+
+namespace {
+
+#ifdef _WIN32
+const char* PATH_SEPARATORS = "/\\";
+#else
+const char* PATH_SEPARATORS = "/";
+#endif
+
+} // namespace
+
+size_t FileTable::add(const std::string& path, std::uintmax_t size, std::int64_t mtime,
+                      std::uint64_t device, std::uint64_t inode, bool symlink) {
+    std::string_view view(path);
+    size_t split = view.find_last_of(PATH_SEPARATORS);
+    size_t nameStart = split == std::string_view::npos ? 0 : split + 1;
+
+    size_t index = sizes.size();
+    parents.push_back(internDirectory(view.substr(0, nameStart)));
+    names.insert(names.end(), path.begin() + static_cast<std::ptrdiff_t>(nameStart), path.end());
+    nameEnds.push_back(names.size());
+    sizes.push_back(size);
+    mtimes.push_back(mtime);
+    devices.push_back(device);
+    inodes.push_back(inode);
+    symlinks.push_back(symlink ? 1 : 0);
+    hashes.emplace_back();
+    partialHashes.emplace_back();
+    bytes += size;
+    return index;
+}
+
+void FileTable::clear() {
+    directoryIds.clear();
+    directories.clear();
+    directoryStorage.clear();
+    lastDirectory = 0;
+    parents.clear();
+    nameEnds.clear();
+    names.clear();
+    sizes.clear();
+    mtimes.clear();
+    devices.clear();
+    inodes.clear();
+    symlinks.clear();
+    hashes.clear();
+    partialHashes.clear();
+    bytes = 0;
+    lookup.clear();
+}
+
+std::string FileTable::path(size_t index) const {
+    std::string_view fileName = name(index);
+    const std::string& parent = directory(index);
+    std::string result;
+    result.reserve(parent.size() + fileName.size());
+    result += parent;
+    result += fileName;
+    return result;
+}
+
+std::string_view FileTable::name(size_t index) const {
+    std::uint64_t start = index == 0 ? 0 : nameEnds[index - 1];
+    return std::string_view(names.data() + start, static_cast<size_t>(nameEnds[index] - start));
+}
+
+FileInfo FileTable::at(size_t index) const {
+    FileInfo info;
+    info.path = path(index);
+    info.hash = hashes[index];
+    info.partialHash = partialHashes[index];
+    info.size = sizes[index];
+    info.lastModified = mtimes[index];
+    info.device = devices[index];
+    info.inode = inodes[index];
+    info.symlink = symlinks[index] != 0;
+    return info;
+}
+
+void FileTable::buildLookup() {
+    lookup.resize(sizes.size());
+    for (size_t i = 0; i < lookup.size(); ++i) {
+        lookup[i] = i;
+    }
+    std::sort(lookup.begin(), lookup.end(), [this](size_t a, size_t b) {
+        if (parents[a] != parents[b]) {
+            return parents[a] < parents[b];
+        }
+        return name(a) < name(b);
+    });
+}
+
+size_t FileTable::find(const std::string& path) const {
+    std::string_view view(path);
+    size_t split = view.find_last_of(PATH_SEPARATORS);
+    size_t nameStart = split == std::string_view::npos ? 0 : split + 1;
+    auto directory = directoryIds.find(view.substr(0, nameStart));
+    if (directory == directoryIds.end()) {
+        return npos;
+    }
+    const std::uint32_t parent = directory->second;
+    const std::string_view fileName = view.substr(nameStart);
+    auto it = std::lower_bound(lookup.begin(), lookup.end(), fileName, [this, parent](size_t row, std::string_view key) {
+        if (parents[row] != parent) {
+            return parents[row] < parent;
+        }
+        return name(row) < key;
+    });
+    if (it == lookup.end() || parents[*it] != parent || name(*it) != fileName) {
+        return npos;
+    }
+    return *it;
+}
+
+std::uint32_t FileTable::internDirectory(std::string_view directory) {
+    if (!directories.empty() && *directories[lastDirectory] == directory) {
+        return lastDirectory;
+    }
+    auto it = directoryIds.find(directory);
+    if (it == directoryIds.end()) {
+        directoryStorage.emplace_back(directory);
+        directories.push_back(&directoryStorage.back());
+        it = directoryIds.emplace(std::string_view(directoryStorage.back()),
+                                  static_cast<std::uint32_t>(directories.size() - 1)).first;
+    }
+    lastDirectory = it->second;
+    return lastDirectory;
+}
@@ -0,0 +1,97 @@
+#ifndef FILE_TABLE_H
+#define FILE_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "digest.h"
+
+// One file as a standalone value, materialized from a FileTable row
+struct FileInfo {
+    std::string path;
+    Digest hash;                // Empty when the file was filtered out before hashing
+    Digest partialHash;         // Head/tail digest, set only for same-size candidates
+    std::uintmax_t size = 0;
+    std::int64_t lastModified = 0;  // Nanoseconds since the Unix epoch, as reported by the walker
+    std::uint64_t device = 0;   // 0 when the platform does not report device/inode
+    std::uint64_t inode = 0;
+    bool symlink = false;       // Walked through a symbolic link; device and inode are its target's
+};
+
+// Columnar store of scanned files. Each column is a packed array indexed by file index;
+// a path is kept as its parent directory id plus a name in a shared character arena,
+// so every directory string is stored once no matter how many files it holds.
+class FileTable {
+public:
+    FileTable() = default;
+    // The directory index points into its own storage, which a move keeps in place
+    FileTable(const FileTable&) = delete;
+    FileTable& operator=(const FileTable&) = delete;
+    FileTable(FileTable&&) = default;
+    FileTable& operator=(FileTable&&) = default;
+
+    // Append a file and return its index
+    size_t add(const std::string& path, std::uintmax_t size, std::int64_t mtime,
+               std::uint64_t device, std::uint64_t inode, bool symlink = false);
+
+    void clear();
+
+    size_t size() const { return sizes.size(); }
+    bool empty() const { return sizes.empty(); }
+
+    // Full path, rebuilt from the directory and name
+    std::string path(size_t index) const;
+    std::string_view name(size_t index) const;
+    // Parent directory including its trailing separator
+    const std::string& directory(size_t index) const { return *directories[parents[index]]; }
+
+    std::uintmax_t fileSize(size_t index) const { return sizes[index]; }
+    std::int64_t mtime(size_t index) const { return mtimes[index]; }
+    std::uint64_t device(size_t index) const { return devices[index]; }
+    std::uint64_t inode(size_t index) const { return inodes[index]; }
+    // The path is a symbolic link; removing it frees nothing and it is never the file kept
+    bool symlink(size_t index) const { return symlinks[index] != 0; }
+
+    const Digest& hash(size_t index) const { return hashes[index]; }
+    Digest& hash(size_t index) { return hashes[index]; }
+    const Digest& partialHash(size_t index) const { return partialHashes[index]; }
+    Digest& partialHash(size_t index) { return partialHashes[index]; }
+
+    FileInfo at(size_t index) const;
+
+    // Path lookup; buildLookup() must be called after the last add()
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    void buildLookup();
+    size_t find(const std::string& path) const;
+
+    size_t directoryCount() const { return directories.size(); }
+    std::uintmax_t totalBytes() const { return bytes; }
+
+private:
+    // Deque keeps the strings in place so the lookup map can view them
+    std::deque<std::string> directoryStorage;
+    std::vector<const std::string*> directories;
+    std::unordered_map<std::string_view, std::uint32_t> directoryIds;
+    std::uint32_t lastDirectory = 0;    // Files arrive grouped by directory
+
+    std::vector<std::uint32_t> parents;
+    std::vector<std::uint64_t> nameEnds;   // Name i spans [nameEnds[i - 1], nameEnds[i])
+    std::vector<char> names;
+
+    std::vector<std::uint64_t> sizes;
+    std::vector<std::int64_t> mtimes;
+    std::vector<std::uint64_t> devices;
+    std::vector<std::uint64_t> inodes;
+    std::vector<char> symlinks;
+    std::vector<Digest> hashes;
+    std::vector<Digest> partialHashes;
+    std::uintmax_t bytes = 0;
+    std::vector<size_t> lookup;         // Indices sorted by (directory id, name)
+
+    std::uint32_t internDirectory(std::string_view directory);
+};
+
+#endif // FILE_TABLE_H
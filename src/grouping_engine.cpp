@@ -0,0 +1,248 @@
+#include "grouping_engine.h"
+#include <cstdio>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+const size_t SPILL_READ_RECORDS = 4096;
+
+// Fixed-width sort key plus the file it belongs to; written to spill files as raw bytes
+struct SortRecord {
+    std::uint64_t size;
+    std::uint64_t index;
+    Digest digest;
+};
+
+bool sameKey(const SortRecord& a, const SortRecord& b) {
+    return a.size == b.size && a.digest == b.digest;
+}
+
+bool keyLess(const SortRecord& a, const SortRecord& b) {
+    if (a.size != b.size) {
+        return a.size < b.size;
+    }
+    if (a.digest != b.digest) {
+        return a.digest < b.digest;
+    }
+    return a.index < b.index;
+}
+
+// LSD radix sort on size, one byte per pass; passes where every record shares the byte are skipped.
+// Stable, so records of one size stay in index order.
+void radixSortBySize(SortRecord* first, SortRecord* last, SortRecord* scratch) {
+    const size_t count = static_cast<size_t>(last - first);
+    SortRecord* source = first;
+    SortRecord* target = scratch;
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        size_t buckets[257] = {};
+        for (size_t i = 0; i < count; ++i) {
+            buckets[((source[i].size >> shift) & 0xff) + 1]++;
+        }
+        if (buckets[((source[0].size >> shift) & 0xff) + 1] == count) {
+            continue;
+        }
+        for (size_t b = 1; b < 257; ++b) {
+            buckets[b] += buckets[b - 1];
+        }
+        for (size_t i = 0; i < count; ++i) {
+            target[buckets[(source[i].size >> shift) & 0xff]++] = source[i];
+        }
+        std::swap(source, target);
+    }
+    if (source != first) {
+        std::copy(source, source + count, first);
+    }
+}
+
+void sortRun(SortRecord* first, SortRecord* last, SortRecord* scratch) {
+    if (last - first < 2) {
+        return;
+    }
+    radixSortBySize(first, last, scratch);
+    // Only records of equal size still need ordering, by digest then index
+    for (SortRecord* runStart = first; runStart != last;) {
+        SortRecord* runEnd = runStart + 1;
+        while (runEnd != last && runEnd->size == runStart->size) {
+            ++runEnd;
+        }
+        if (runEnd - runStart > 1) {
+            std::sort(runStart, runEnd, keyLess);
+        }
+        runStart = runEnd;
+    }
+}
+
+// A sorted run, either a slice of memory or a spill file read back in blocks
+class Run {
+public:
+    Run(const SortRecord* first, const SortRecord* last) : current(first), last(last) {}
+    explicit Run(std::FILE* file) : file(file), buffer(SPILL_READ_RECORDS) { refill(); }
+    Run(Run&& other) noexcept
+        : current(other.current), last(other.last), file(other.file), buffer(std::move(other.buffer)) {
+        other.file = nullptr;
+    }
+    ~Run() {
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+    bool done() const { return current == last; }
+    const SortRecord& head() const { return *current; }
+
+    void pop() {
+        if (++current == last && file) {
+            refill();
+        }
+    }
+
+private:
+    const SortRecord* current = nullptr;
+    const SortRecord* last = nullptr;
+    std::FILE* file = nullptr;
+    std::vector<SortRecord> buffer;
+
+    void refill() {
+        size_t read = std::fread(buffer.data(), sizeof(SortRecord), buffer.size(), file);
+        current = buffer.data();
+        last = buffer.data() + read;
+    }
+};
+
+} // namespace
+
+void GroupList::add(const size_t* first, size_t count, std::uintmax_t fileSize) {
+    ranges.push_back(Range{ members.size(), count, fileSize });
+    members.insert(members.end(), first, first + count);
+}
+
+void GroupList::sort(GroupOrder order) {
+    if (order == GroupOrder::WASTED_BYTES) {
+        std::stable_sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+            std::uintmax_t wastedA = a.fileSize * (a.count - 1);
+            std::uintmax_t wastedB = b.fileSize * (b.count - 1);
+            if (wastedA != wastedB) {
+                return wastedA > wastedB;
+            }
+            return a.count > b.count;
+        });
+    } else {
+        std::stable_sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+            return a.count > b.count;
+        });
+    }
+}
+
+GroupingEngine::GroupingEngine(WorkerPool& pool, std::size_t memoryBudget)
+    : pool(pool), memoryBudget(memoryBudget) {}
+
+void GroupingEngine::group(const FileTable& files, GroupList& groups) {
+    std::vector<size_t> indices;
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (!files.hash(index).empty()) {
+            indices.push_back(index);
+        }
+    }
+    group(files, indices, groups);
+}
+
+void GroupingEngine::group(const FileTable& files, const std::vector<size_t>& indices, GroupList& groups) {
+    spilled = 0;
+    const size_t total = indices.size();
+    if (total < 2) {
+        return;
+    }
+
+    // The record buffer and its radix scratch space share the budget
+    size_t chunk = total;
+    if (memoryBudget > 0) {
+        chunk = std::min(total, std::max<size_t>(2, memoryBudget / (2 * sizeof(SortRecord))));
+    }
+    const bool spill = chunk < total;
+
+    std::vector<SortRecord> buffer;
+    buffer.reserve(chunk);
+    std::vector<SortRecord> scratch(chunk);
+    std::vector<Run> runs;
+
+    // Sort the buffer as one slice per worker; the slices become runs
+    auto flushBuffer = [&]() {
+        const size_t slices = std::min(pool.size(), buffer.size());
+        const size_t sliceSize = (buffer.size() + slices - 1) / slices;
+        for (size_t start = 0; start < buffer.size(); start += sliceSize) {
+            SortRecord* first = buffer.data() + start;
+            SortRecord* last = buffer.data() + std::min(buffer.size(), start + sliceSize);
+            SortRecord* slack = scratch.data() + start;
+            pool.submit([first, last, slack](size_t) { sortRun(first, last, slack); });
+        }
+        pool.wait();
+
+        for (size_t start = 0; start < buffer.size(); start += sliceSize) {
+            const SortRecord* first = buffer.data() + start;
+            const SortRecord* last = buffer.data() + std::min(buffer.size(), start + sliceSize);
+            if (!spill) {
+                runs.emplace_back(first, last);
+                continue;
+            }
+            std::FILE* file = std::tmpfile();
+            if (!file) {
+                throw std::runtime_error("Unable to create grouping spill file");
+            }
+            const size_t count = static_cast<size_t>(last - first);
+            if (std::fwrite(first, sizeof(SortRecord), count, file) != count) {
+                std::fclose(file);
+                throw std::runtime_error("Unable to write grouping spill file");
+            }
+            std::rewind(file);
+            runs.emplace_back(file);
+            spilled++;
+        }
+        if (spill) {
+            buffer.clear();
+        }
+    };
+
+    for (size_t index : indices) {
+        buffer.push_back(SortRecord{ files.fileSize(index), index, files.hash(index) });
+        if (buffer.size() == chunk) {
+            flushBuffer();
+        }
+    }
+    if (spill && !buffer.empty()) {
+        flushBuffer();
+    }
+
+    // K-way merge; equal keys arrive back to back in index order
+    auto greater = [&runs](size_t a, size_t b) { return keyLess(runs[b].head(), runs[a].head()); };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heads(greater);
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (!runs[i].done()) {
+            heads.push(i);
+        }
+    }
+
+    SortRecord groupKey{};
+    std::vector<size_t> members;
+    auto emit = [&]() {
+        if (members.size() > 1) {
+            groups.add(members, groupKey.size);
+        }
+        members.clear();
+    };
+    while (!heads.empty()) {
+        size_t runIndex = heads.top();
+        heads.pop();
+        const SortRecord& record = runs[runIndex].head();
+        if (members.empty() || !sameKey(record, groupKey)) {
+            emit();
+            groupKey = record;
+        }
+        members.push_back(static_cast<size_t>(record.index));
+        runs[runIndex].pop();
+        if (!runs[runIndex].done()) {
+            heads.push(runIndex);
+        }
+    }
+    emit();
+}
@@ -0,0 +1,119 @@
+#ifndef GROUPING_ENGINE_H
+#define GROUPING_ENGINE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "file_table.h"
+#include "worker_pool.h"
+
+// How duplicate groups are ordered in the result
+enum class GroupOrder {
+    WASTED_BYTES,   // Bytes a group would free, size * (members - 1), largest first
+    MEMBER_COUNT    // Largest groups first
+};
+
+// Read-only view of one group's file indices inside a GroupList
+class FileGroup {
+public:
+    FileGroup(const size_t* first, size_t count) : first(first), count(count) {}
+
+    const size_t* begin() const { return first; }
+    const size_t* end() const { return first + count; }
+    size_t size() const { return count; }
+    size_t operator[](size_t i) const { return first[i]; }
+    size_t front() const { return first[0]; }
+
+private:
+    const size_t* first;
+    size_t count;
+};
+
+// Duplicate groups stored as ranges over one flat array of file indices
+class GroupList {
+public:
+    class const_iterator {
+    public:
+        const_iterator(const GroupList* list, size_t position) : list(list), position(position) {}
+        FileGroup operator*() const { return (*list)[position]; }
+        const_iterator& operator++() { ++position; return *this; }
+        bool operator!=(const const_iterator& other) const { return position != other.position; }
+    private:
+        const GroupList* list;
+        size_t position;
+    };
+
+    void clear() { members.clear(); ranges.clear(); }
+
+    // Append a group; fileSize is the size of each member
+    void add(const size_t* first, size_t count, std::uintmax_t fileSize);
+    void add(const std::vector<size_t>& group, std::uintmax_t fileSize) { add(group.data(), group.size(), fileSize); }
+
+    // Reorder the groups; members keep their order inside each group
+    void sort(GroupOrder order);
+
+    // Reorder the members of every group
+    template <typename Compare>
+    void sortMembers(Compare compare) {
+        for (const auto& range : ranges) {
+            std::sort(members.begin() + static_cast<std::ptrdiff_t>(range.offset),
+                      members.begin() + static_cast<std::ptrdiff_t>(range.offset + range.count), compare);
+        }
+    }
+
+    // Move the first member of every group that matches, if one does, to the front; the
+    // others keep their order
+    template <typename Predicate>
+    void moveToFront(Predicate matches) {
+        for (const auto& range : ranges) {
+            auto first = members.begin() + static_cast<std::ptrdiff_t>(range.offset);
+            auto found = std::find_if(first, first + static_cast<std::ptrdiff_t>(range.count), matches);
+            if (found != first + static_cast<std::ptrdiff_t>(range.count)) {
+                std::rotate(first, found, found + 1);
+            }
+        }
+    }
+
+    size_t size() const { return ranges.size(); }
+    bool empty() const { return ranges.empty(); }
+    size_t fileCount() const { return members.size(); }
+    FileGroup operator[](size_t i) const { return FileGroup(members.data() + ranges[i].offset, ranges[i].count); }
+    std::uintmax_t fileSize(size_t i) const { return ranges[i].fileSize; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, ranges.size()); }
+
+private:
+    struct Range {
+        size_t offset;
+        size_t count;
+        std::uintmax_t fileSize;
+    };
+
+    std::vector<size_t> members;
+    std::vector<Range> ranges;
+};
+
+// Groups the hashed files of a table by (size, digest) by sorting instead of hashing.
+// Records are radix sorted on size in parallel runs, runs are k-way merged, and equal
+// keys come out as contiguous groups in file index order. When there are more records
+// than the memory budget allows, sorted runs are spilled to temporary files and merged
+// from disk.
+class GroupingEngine {
+public:
+    // memoryBudget is in bytes of sort records; 0 never spills
+    GroupingEngine(WorkerPool& pool, std::size_t memoryBudget);
+
+    void group(const FileTable& files, GroupList& groups);
+    // Group only the given rows; each must have a full hash
+    void group(const FileTable& files, const std::vector<size_t>& indices, GroupList& groups);
+
+    // Number of runs written to disk by the last group() call
+    size_t spilledRuns() const { return spilled; }
+
+private:
+    WorkerPool& pool;
+    std::size_t memoryBudget;
+    size_t spilled = 0;
+};
+
+#endif // GROUPING_ENGINE_H
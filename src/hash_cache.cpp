@@ -0,0 +1,241 @@
+#include "hash_cache.h"
+#include "directory_walker.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char CACHE_MAGIC[4] = { 'D', 'F', 'H', 'C' };
+// Version 2: mtime is nanoseconds since the Unix epoch as reported by the walker
+const std::uint32_t CACHE_VERSION = 2;
+
+// Fixed-size part of an on-disk record; digest and path bytes follow it
+struct RecordHeader {
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint64_t size;
+    std::int64_t mtime;
+    std::uint8_t algorithm;
+    std::uint8_t digestLength;
+    std::uint16_t pathLength;
+};
+
+// Advisory lock on a sidecar file, held for the lifetime of the object
+class CacheLock {
+public:
+    CacheLock(const std::string& cachePath, bool exclusive) {
+#ifndef _WIN32
+        fd = ::open((cachePath + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd >= 0 && ::flock(fd, exclusive ? LOCK_EX : LOCK_SH) != 0) {
+            ::close(fd);
+            fd = -1;
+        }
+#else
+        (void)cachePath;
+        (void)exclusive;
+#endif
+    }
+    ~CacheLock() {
+#ifndef _WIN32
+        if (fd >= 0) {
+            ::flock(fd, LOCK_UN);
+            ::close(fd);
+        }
+#endif
+    }
+    bool locked() const {
+#ifndef _WIN32
+        return fd >= 0;
+#else
+        return true;
+#endif
+    }
+
+private:
+    int fd = -1;
+};
+
+} // namespace
+
+HashCache::HashCache(const std::string& cachePath) : cachePath(cachePath) {}
+
+bool HashCache::load() {
+    CacheLock lock(cachePath, false);
+    if (!lock.locked()) {
+        std::cerr << "Unable to lock hash cache: " << cachePath << std::endl;
+        return false;
+    }
+    entries.clear();
+    return readFile(cachePath, entries);
+}
+
+bool HashCache::save() {
+    if (pending.empty() && evicted.empty()) {
+        return true;
+    }
+
+    CacheLock lock(cachePath, true);
+    if (!lock.locked()) {
+        std::cerr << "Unable to lock hash cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    // Re-read under the exclusive lock so entries written by another run are kept
+    EntryMap merged;
+    readFile(cachePath, merged);
+    for (const Key& key : evicted) {
+        merged.erase(key);
+    }
+    for (const auto& pair : pending) {
+        merged[pair.first] = pair.second;
+    }
+
+    std::string tempPath = cachePath + ".tmp";
+    if (!writeFile(tempPath, merged)) {
+        std::cerr << "Unable to write hash cache: " << tempPath << std::endl;
+        return false;
+    }
+    std::error_code ec;
+    fs::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::cerr << "Unable to replace hash cache " << cachePath << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    entries = std::move(merged);
+    pending.clear();
+    evicted.clear();
+    return true;
+}
+
+bool HashCache::lookup(std::uint64_t device, std::uint64_t inode, std::uint64_t size, std::int64_t mtime,
+                       HashAlgorithm algorithm, Digest& digest) const {
+    auto it = entries.find(Key{ device, inode, static_cast<std::uint8_t>(algorithm) });
+    if (it == entries.end() || it->second.size != size || it->second.mtime != mtime) {
+        return false;
+    }
+    digest = it->second.digest;
+    return true;
+}
+
+void HashCache::store(std::uint64_t device, std::uint64_t inode, std::uint64_t size, std::int64_t mtime,
+                      HashAlgorithm algorithm, const Digest& digest, const std::string& path) {
+    // Without inode numbers there is no stable key
+    if (inode == 0) {
+        return;
+    }
+    HashCacheEntry entry;
+    entry.size = size;
+    entry.mtime = mtime;
+    entry.digest = digest;
+    entry.path = path;
+
+    Key key{ device, inode, static_cast<std::uint8_t>(algorithm) };
+    entries[key] = entry;
+    pending[key] = entry;
+}
+
+size_t HashCache::evictStale() {
+    size_t removed = 0;
+    for (auto it = entries.begin(); it != entries.end();) {
+        bool stale = true;
+        WalkEntry current;
+        if (DirectoryWalker::statFile(it->second.path, current)) {
+            stale = current.device != it->first.device || current.inode != it->first.inode ||
+                    current.size != it->second.size || current.mtime != it->second.mtime;
+        }
+        if (stale) {
+            evicted.push_back(it->first);
+            pending.erase(it->first);
+            it = entries.erase(it);
+            removed++;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+bool HashCache::readFile(const std::string& path, EntryMap& into) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return true;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint64_t count = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (!file || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != CACHE_VERSION) {
+        std::cerr << "Ignoring unreadable hash cache: " << path << std::endl;
+        return false;
+    }
+
+    for (std::uint64_t i = 0; i < count; ++i) {
+        RecordHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        Digest digest;
+        if (!file || header.digestLength > digest.bytes.size()) {
+            std::cerr << "Corrupt hash cache: " << path << std::endl;
+            return false;
+        }
+        std::string entryPath(header.pathLength, '\0');
+        file.read(reinterpret_cast<char*>(digest.bytes.data()), header.digestLength);
+        file.read(&entryPath[0], entryPath.size());
+        if (!file) {
+            std::cerr << "Truncated hash cache: " << path << std::endl;
+            return false;
+        }
+
+        HashCacheEntry entry;
+        entry.size = header.size;
+        entry.mtime = header.mtime;
+        digest.length = header.digestLength;
+        entry.digest = digest;
+        entry.path = std::move(entryPath);
+        into[Key{ header.device, header.inode, header.algorithm }] = std::move(entry);
+    }
+    return true;
+}
+
+bool HashCache::writeFile(const std::string& path, const EntryMap& from) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    std::uint64_t count = from.size();
+    file.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    file.write(reinterpret_cast<const char*>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+    for (const auto& pair : from) {
+        const Digest& digest = pair.second.digest;
+        RecordHeader header = {};
+        header.device = pair.first.device;
+        header.inode = pair.first.inode;
+        header.size = pair.second.size;
+        header.mtime = pair.second.mtime;
+        header.algorithm = pair.first.algorithm;
+        header.digestLength = digest.length;
+        header.pathLength = static_cast<std::uint16_t>(std::min<size_t>(pair.second.path.size(), UINT16_MAX));
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(digest.bytes.data()), digest.length);
+        file.write(pair.second.path.data(), header.pathLength);
+    }
+    return static_cast<bool>(file.flush());
+}
@@ -0,0 +1,68 @@
+#ifndef HASH_CACHE_H
+#define HASH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "hash_calculator.h"
+
+// One cached digest. An entry is valid only while the file keeps the same size and mtime.
+struct HashCacheEntry {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    Digest digest;
+    std::string path;           // Last path seen for the inode, used for eviction
+};
+
+// Persistent digest cache keyed by (device, inode, algorithm). The file is read under a
+// shared lock and rewritten atomically under an exclusive lock, so overlapping runs
+// merge their results instead of clobbering each other.
+class HashCache {
+public:
+    explicit HashCache(const std::string& cachePath);
+
+    // Load the cache file; a missing file is an empty cache
+    bool load();
+
+    // Merge this run's changes into the on-disk cache
+    bool save();
+
+    // Returns true and fills digest when the entry matches the file's current metadata
+    bool lookup(std::uint64_t device, std::uint64_t inode, std::uint64_t size, std::int64_t mtime,
+                HashAlgorithm algorithm, Digest& digest) const;
+
+    void store(std::uint64_t device, std::uint64_t inode, std::uint64_t size, std::int64_t mtime,
+               HashAlgorithm algorithm, const Digest& digest, const std::string& path);
+
+    // Drop entries whose file is gone or has changed since it was cached
+    size_t evictStale();
+
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Key {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint8_t algorithm;
+        bool operator==(const Key& other) const {
+            return device == other.device && inode == other.inode && algorithm == other.algorithm;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<std::uint64_t>()(key.inode * 31 + key.device) ^ key.algorithm;
+        }
+    };
+    using EntryMap = std::unordered_map<Key, HashCacheEntry, KeyHash>;
+
+    std::string cachePath;
+    EntryMap entries;
+    EntryMap pending;           // Stored this run, not yet written
+    std::vector<Key> evicted;   // Evicted this run, removed from disk on save
+
+    static bool readFile(const std::string& path, EntryMap& into);
+    static bool writeFile(const std::string& path, const EntryMap& from);
+};
+
+#endif // HASH_CACHE_H
@@ -1,117 +1,430 @@
 #include "hash_calculator.h"
+#include "content_comparer.h"
+#include "file_reader.h"
+#include "sha256_multibuffer.h"
 #include <openssl/evp.h>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
 #include <stdexcept>
+#include <vector>
+#include <cstring>
 
-std::string HashCalculator::calculateMD5(const std::string& filePath) {
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        throw std::runtime_error("Failed to create MD5 context");
+#ifdef HAVE_XXHASH
+#include <xxhash.h>
+#endif
+#ifdef HAVE_BLAKE3
+#include <blake3.h>
+#endif
+
+struct DigestStream::Impl {
+    explicit Impl(HashAlgorithm algorithm) : algorithm(algorithm) {
+        switch (algorithm) {
+            case HashAlgorithm::MD5:
+            case HashAlgorithm::SHA256:
+                mdctx = EVP_MD_CTX_new();
+                if (!mdctx) {
+                    throw std::runtime_error("Failed to create digest context");
+                }
+                break;
+            case HashAlgorithm::XXH3_128:
+#ifdef HAVE_XXHASH
+                xxhState = XXH3_createState();
+                if (!xxhState) {
+                    throw std::runtime_error("Failed to create XXH3 state");
+                }
+                break;
+#else
+                throw std::runtime_error("XXH3 support not compiled in");
+#endif
+            case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+                break;
+#else
+                throw std::runtime_error("BLAKE3 support not compiled in");
+#endif
+        }
+        reset();
     }
 
-    if (EVP_DigestInit_ex(mdctx, EVP_md5(), nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Failed to initialize MD5");
+    ~Impl() {
+        if (mdctx) {
+            EVP_MD_CTX_free(mdctx);
+        }
+#ifdef HAVE_XXHASH
+        if (xxhState) {
+            XXH3_freeState(xxhState);
+        }
+#endif
     }
 
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Unable to open file: " + filePath);
+    // Re-initializing an existing EVP context keeps its fetched method and allocations
+    void reset() {
+        switch (algorithm) {
+            case HashAlgorithm::MD5:
+            case HashAlgorithm::SHA256: {
+                static const EVP_MD* md5 = EVP_md5();
+                static const EVP_MD* sha256 = EVP_sha256();
+                if (EVP_DigestInit_ex(mdctx, algorithm == HashAlgorithm::MD5 ? md5 : sha256, nullptr) != 1) {
+                    throw std::runtime_error("Failed to initialize digest");
+                }
+                break;
+            }
+            case HashAlgorithm::XXH3_128:
+#ifdef HAVE_XXHASH
+                if (XXH3_128bits_reset(xxhState) != XXH_OK) {
+                    throw std::runtime_error("Failed to initialize XXH3");
+                }
+#endif
+                break;
+            case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+                blake3_hasher_init(&blake3Hasher);
+#endif
+                break;
+        }
     }
 
-    char buffer[8192];
-    while (file.read(buffer, sizeof(buffer))) {
-        if (EVP_DigestUpdate(mdctx, buffer, file.gcount()) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            throw std::runtime_error("Failed to update MD5 hash");
+    void update(const void* data, size_t length, bool parallel = false) {
+        (void)parallel;
+        switch (algorithm) {
+            case HashAlgorithm::MD5:
+            case HashAlgorithm::SHA256:
+                if (EVP_DigestUpdate(mdctx, data, length) != 1) {
+                    throw std::runtime_error("Failed to update digest");
+                }
+                break;
+            case HashAlgorithm::XXH3_128:
+#ifdef HAVE_XXHASH
+                if (XXH3_128bits_update(xxhState, data, length) != XXH_OK) {
+                    throw std::runtime_error("Failed to update XXH3");
+                }
+#endif
+                break;
+            case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+#ifdef HAVE_BLAKE3_TBB
+                if (parallel) {
+                    blake3_hasher_update_tbb(&blake3Hasher, data, length);
+                    break;
+                }
+#endif
+                blake3_hasher_update(&blake3Hasher, data, length);
+#endif
+                break;
         }
     }
-    if (file.gcount() > 0) {
-        if (EVP_DigestUpdate(mdctx, buffer, file.gcount()) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            throw std::runtime_error("Failed to update MD5 hash");
+
+    Digest finish() {
+        Digest digest;
+        switch (algorithm) {
+            case HashAlgorithm::MD5:
+            case HashAlgorithm::SHA256: {
+                unsigned int hash_len = 0;
+                if (EVP_DigestFinal_ex(mdctx, digest.bytes.data(), &hash_len) != 1) {
+                    throw std::runtime_error("Failed to finalize digest");
+                }
+                digest.length = static_cast<std::uint8_t>(hash_len);
+                break;
+            }
+            case HashAlgorithm::XXH3_128: {
+#ifdef HAVE_XXHASH
+                XXH128_canonical_t canonical;
+                XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(xxhState));
+                digest = Digest::fromBytes(canonical.digest, sizeof(canonical.digest));
+#endif
+                break;
+            }
+            case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+                blake3_hasher_finalize(&blake3Hasher, digest.bytes.data(), BLAKE3_OUT_LEN);
+                digest.length = BLAKE3_OUT_LEN;
+#endif
+                break;
         }
+        return digest;
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Failed to finalize MD5 hash");
+    void copyFrom(const Impl& other) {
+        switch (algorithm) {
+            case HashAlgorithm::MD5:
+            case HashAlgorithm::SHA256:
+                if (EVP_MD_CTX_copy_ex(mdctx, other.mdctx) != 1) {
+                    throw std::runtime_error("Failed to copy digest");
+                }
+                break;
+            case HashAlgorithm::XXH3_128:
+#ifdef HAVE_XXHASH
+                XXH3_copyState(xxhState, other.xxhState);
+#endif
+                break;
+            case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+                blake3Hasher = other.blake3Hasher;
+#endif
+                break;
+        }
     }
 
-    EVP_MD_CTX_free(mdctx);
+    HashAlgorithm algorithm;
+    EVP_MD_CTX* mdctx = nullptr;
+#ifdef HAVE_XXHASH
+    XXH3_state_t* xxhState = nullptr;
+#endif
+#ifdef HAVE_BLAKE3
+    blake3_hasher blake3Hasher;
+#endif
+};
+
+DigestStream::DigestStream(HashAlgorithm algorithm) : impl(new Impl(algorithm)) {}
+
+DigestStream::~DigestStream() = default;
+
+void DigestStream::reset() {
+    impl->reset();
+}
+
+void DigestStream::update(const void* data, std::size_t length, bool parallel) {
+    impl->update(data, length, parallel);
+}
+
+Digest DigestStream::finish() {
+    return impl->finish();
+}
 
-    std::ostringstream result;
-    for (unsigned int i = 0; i < hash_len; ++i) {
-        result << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+void DigestStream::copyFrom(const DigestStream& other) {
+    if (other.impl->algorithm != impl->algorithm) {
+        throw std::invalid_argument("Cannot copy a digest of another algorithm");
     }
-    return result.str();
+    impl->copyFrom(*other.impl);
 }
 
-std::string HashCalculator::calculateSHA256(const std::string& filePath) {
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        throw std::runtime_error("Failed to create SHA256 context");
+namespace {
+
+const std::size_t PARALLEL_HASH_BLOCK = 1024 * 1024;
+
+// One reusable hasher per algorithm per thread, reset before each file
+DigestStream& threadHasher(HashAlgorithm algorithm) {
+    thread_local std::unique_ptr<DigestStream> hashers[4];
+    std::unique_ptr<DigestStream>& hasher = hashers[static_cast<size_t>(algorithm)];
+    if (!hasher) {
+        hasher.reset(new DigestStream(algorithm));
+    } else {
+        hasher->reset();
     }
+    return *hasher;
+}
+
+Digest hashWholeFile(const std::string& filePath, HashAlgorithm algorithm, ReadBackend backend) {
+    DigestStream& digest = threadHasher(algorithm);
+    // Only large blocks are worth splitting across BLAKE3's worker threads
+    const bool parallel = algorithm == HashAlgorithm::BLAKE3;
+    FileReader::readFile(filePath, [&digest, parallel](const void* data, std::size_t length) {
+        digest.update(data, length, parallel && length >= PARALLEL_HASH_BLOCK);
+    }, backend);
+    return digest.finish();
+}
+
+} // namespace
+
+std::string HashCalculator::calculateMD5(const std::string& filePath) {
+    return hashWholeFile(filePath, HashAlgorithm::MD5, ReadBackend::AUTO).toHex();
+}
 
-    if (EVP_DigestInit_ex(mdctx, EVP_sha256(), nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Failed to initialize SHA256");
+std::string HashCalculator::calculateSHA256(const std::string& filePath) {
+    return hashWholeFile(filePath, HashAlgorithm::SHA256, ReadBackend::AUTO).toHex();
+}
+
+Digest HashCalculator::calculateHash(const std::string& filePath, HashAlgorithm algorithm, ReadBackend backend) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5:
+        case HashAlgorithm::SHA256:
+        case HashAlgorithm::XXH3_128:
+        case HashAlgorithm::BLAKE3:
+            return hashWholeFile(filePath, algorithm, backend);
+        default:
+            throw std::invalid_argument("Unsupported hash algorithm");
     }
+}
 
-    std::ifstream file(filePath, std::ios::binary);
-    if (!file) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Unable to open file: " + filePath);
+Digest HashCalculator::calculatePartialHash(const std::string& filePath, HashAlgorithm algorithm,
+                                                 std::uintmax_t fileSize, std::size_t windowSize) {
+    if (fileSize <= 2 * static_cast<std::uintmax_t>(windowSize)) {
+        return calculateHash(filePath, algorithm);
     }
 
-    char buffer[8192];
-    while (file.read(buffer, sizeof(buffer))) {
-        if (EVP_DigestUpdate(mdctx, buffer, file.gcount()) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            throw std::runtime_error("Failed to update SHA256 hash");
+    // Head window, then tail window
+    DigestStream& digest = threadHasher(algorithm);
+    FileReader::readRanges(filePath, { { 0, windowSize }, { fileSize - windowSize, windowSize } },
+                           [&digest](const void* data, std::size_t length) {
+        digest.update(data, length);
+    });
+    return digest.finish();
+}
+
+void HashCalculator::calculateOnPool(WorkerPool& pool, std::vector<HashJob>& jobs, HashAlgorithm algorithm,
+                                     ReadBackend backend, std::function<void()> done) {
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].error.empty()) {
+            pending.push_back(i);
         }
     }
-    if (file.gcount() > 0) {
-        if (EVP_DigestUpdate(mdctx, buffer, file.gcount()) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            throw std::runtime_error("Failed to update SHA256 hash");
+    if (pending.empty()) {
+        if (done) {
+            done();
+        }
+        return;
+    }
+
+    // Each task owns one job, so results need no locking
+    auto remaining = std::make_shared<std::atomic<size_t>>(pending.size());
+    for (size_t i : pending) {
+        pool.submit([&jobs, i, algorithm, backend, remaining, done](size_t) {
+            HashJob& job = jobs[i];
+            try {
+                job.digest = job.window > 0 ? calculatePartialHash(job.path, algorithm, job.size, job.window)
+                                            : calculateHash(job.path, algorithm, backend);
+            } catch (const std::exception& e) {
+                job.error = e.what();
+            }
+            if (remaining->fetch_sub(1) == 1 && done) {
+                done();
+            }
+        });
+    }
+    if (!done) {
+        pool.wait();
+    }
+}
+
+bool HashCalculator::canBatch(HashAlgorithm algorithm, std::uintmax_t bytes) {
+    return algorithm == HashAlgorithm::SHA256 && bytes <= BATCH_MESSAGE_LIMIT && Sha256MultiBuffer::lanes() > 1;
+}
+
+void HashCalculator::calculateBatch(std::vector<HashJob>& jobs, HashAlgorithm algorithm) {
+    // Messages stay in per-thread buffers, so their capacity is reused across batches
+    thread_local std::vector<std::vector<std::uint8_t>> buffers;
+    if (buffers.size() < jobs.size()) {
+        buffers.resize(jobs.size());
+    }
+    std::vector<size_t> loaded;
+    loaded.reserve(jobs.size());
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        HashJob& job = jobs[i];
+        std::vector<std::uint8_t>& buffer = buffers[i];
+        buffer.clear();
+        auto append = [&buffer](const void* data, std::size_t length) {
+            const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+            buffer.insert(buffer.end(), bytes, bytes + length);
+        };
+        try {
+            if (job.window > 0 && job.size > 2 * static_cast<std::uintmax_t>(job.window)) {
+                FileReader::readRanges(job.path, { { 0, job.window }, { job.size - job.window, job.window } }, append);
+            } else {
+                FileReader::readFile(job.path, append, ReadBackend::AUTO, job.size);
+            }
+            loaded.push_back(i);
+        } catch (const std::exception& e) {
+            job.error = e.what();
         }
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hash_len;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hash_len) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        throw std::runtime_error("Failed to finalize SHA256 hash");
+    const size_t lanes = algorithm == HashAlgorithm::SHA256 ? Sha256MultiBuffer::lanes() : 0;
+    size_t next = 0;
+    if (lanes > 1) {
+        const std::uint8_t* messages[16];
+        std::size_t lengths[16];
+        Digest digests[16];
+        while (loaded.size() - next >= 2) {
+            const size_t count = std::min(lanes, loaded.size() - next);
+            for (size_t lane = 0; lane < count; ++lane) {
+                const std::vector<std::uint8_t>& buffer = buffers[loaded[next + lane]];
+                messages[lane] = buffer.data();
+                lengths[lane] = buffer.size();
+            }
+            Sha256MultiBuffer::hash(messages, lengths, count, digests);
+            for (size_t lane = 0; lane < count; ++lane) {
+                jobs[loaded[next + lane]].digest = digests[lane];
+            }
+            next += count;
+        }
     }
+    // A lone message gains nothing from the lanes
+    for (; next < loaded.size(); ++next) {
+        const std::vector<std::uint8_t>& buffer = buffers[loaded[next]];
+        DigestStream& digest = threadHasher(algorithm);
+        digest.update(buffer.data(), buffer.size());
+        jobs[loaded[next]].digest = digest.finish();
+    }
+}
 
-    EVP_MD_CTX_free(mdctx);
+std::string HashCalculator::calculateXXH3_128(const std::string& filePath) {
+    return hashWholeFile(filePath, HashAlgorithm::XXH3_128, ReadBackend::AUTO).toHex();
+}
+
+std::string HashCalculator::calculateBLAKE3(const std::string& filePath) {
+    return hashWholeFile(filePath, HashAlgorithm::BLAKE3, ReadBackend::AUTO).toHex();
+}
+
+bool HashCalculator::compareFiles(const std::string& filePath1, const std::string& filePath2, HashAlgorithm algorithm) {
+    (void)algorithm;
+    return compareContents(filePath1, filePath2);
+}
+
+bool HashCalculator::compareContents(const std::string& filePath1, const std::string& filePath2) {
+    std::error_code ec1;
+    std::error_code ec2;
+    const std::uintmax_t size1 = std::filesystem::file_size(filePath1, ec1);
+    const std::uintmax_t size2 = std::filesystem::file_size(filePath2, ec2);
+    if (ec1 || ec2) {
+        throw std::runtime_error("Unable to open file: " + (ec1 ? filePath1 : filePath2));
+    }
+    if (size1 != size2) {
+        return false;
+    }
 
-    std::ostringstream result;
-    for (unsigned int i = 0; i < hash_len; ++i) {
-        result << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
+    ContentComparer::Result result = ContentComparer::compare({ filePath1, filePath2 }, size1,
+                                                              HashAlgorithm::SHA256, false);
+    for (size_t i = 0; i < result.errors.size(); ++i) {
+        if (!result.errors[i].empty()) {
+            throw std::runtime_error(result.errors[i] + ": " + (i == 0 ? filePath1 : filePath2));
+        }
     }
-    return result.str();
+    return result.classOf[0] != ContentComparer::npos && result.classOf[0] == result.classOf[1];
 }
 
-std::string HashCalculator::calculateHash(const std::string& filePath, HashAlgorithm algorithm) {
+bool HashCalculator::isAvailable(HashAlgorithm algorithm) {
     switch (algorithm) {
         case HashAlgorithm::MD5:
-            return calculateMD5(filePath);
         case HashAlgorithm::SHA256:
-            return calculateSHA256(filePath);
-        default:
-            throw std::invalid_argument("Unsupported hash algorithm");
+            return true;
+        case HashAlgorithm::XXH3_128:
+#ifdef HAVE_XXHASH
+            return true;
+#else
+            return false;
+#endif
+        case HashAlgorithm::BLAKE3:
+#ifdef HAVE_BLAKE3
+            return true;
+#else
+            return false;
+#endif
     }
+    return false;
 }
 
-bool HashCalculator::compareFiles(const std::string& filePath1, const std::string& filePath2, HashAlgorithm algorithm) {
-    std::string hash1 = calculateHash(filePath1, algorithm);
-    std::string hash2 = calculateHash(filePath2, algorithm);
-    return hash1 == hash2;
-}
\ No newline at end of file
+bool HashCalculator::isCollisionResistant(HashAlgorithm algorithm) {
+    return algorithm == HashAlgorithm::SHA256 || algorithm == HashAlgorithm::BLAKE3;
+}
+
+const char* HashCalculator::algorithmName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5: return "MD5";
+        case HashAlgorithm::SHA256: return "SHA256";
+        case HashAlgorithm::XXH3_128: return "XXH3-128";
+        case HashAlgorithm::BLAKE3: return "BLAKE3";
+    }
+    return "Unknown";
+}
@@ -2,19 +2,92 @@
 #define HASH_CALCULATOR_H
 
 #include <string>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 #include <openssl/evp.h>
+#include "digest.h"
+#include "file_reader.h"
+#include "worker_pool.h"
 
 enum class HashAlgorithm {
     MD5,
-    SHA256
+    SHA256,
+    XXH3_128,   // Non-cryptographic; needs libxxhash at build time
+    BLAKE3      // Needs libblake3 at build time
+};
+
+// Incremental digest over any supported algorithm, for callers that bring their own blocks
+class DigestStream {
+public:
+    explicit DigestStream(HashAlgorithm algorithm);
+    ~DigestStream();
+
+    DigestStream(const DigestStream&) = delete;
+    DigestStream& operator=(const DigestStream&) = delete;
+
+    // Start a new digest, reusing the existing context
+    void reset();
+    // parallel lets BLAKE3 split a large block across threads when built with TBB
+    void update(const void* data, std::size_t length, bool parallel = false);
+    Digest finish();
+    // Continue from another stream's state; both must use the same algorithm
+    void copyFrom(const DigestStream& other);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+// One file of a batch; window 0 hashes the whole file, otherwise its head and tail as
+// calculatePartialHash does
+struct HashJob {
+    std::string path;
+    std::uintmax_t size = 0;
+    std::size_t window = 0;
+    Digest digest;
+    std::string error;      // Set instead of the digest when the file could not be read
 };
 
 class HashCalculator {
 public:
+    // Largest message, whole file or head and tail, that calculateBatch hashes in memory
+    static const std::size_t BATCH_MESSAGE_LIMIT = 64 * 1024;
+    // Hex digest helpers
     static std::string calculateMD5(const std::string& filePath);
     static std::string calculateSHA256(const std::string& filePath);
-    static std::string calculateHash(const std::string& filePath, HashAlgorithm algorithm);
+    static std::string calculateXXH3_128(const std::string& filePath);
+    static std::string calculateBLAKE3(const std::string& filePath);
+    // Binary digest; hashing threads reuse one context per algorithm
+    static Digest calculateHash(const std::string& filePath, HashAlgorithm algorithm,
+                                ReadBackend backend = ReadBackend::AUTO);
+    // Hashes only the first and last windowSize bytes of a file. Files no larger than
+    // 2 * windowSize are hashed whole, so the result equals calculateHash for them.
+    static Digest calculatePartialHash(const std::string& filePath, HashAlgorithm algorithm,
+                                       std::uintmax_t fileSize, std::size_t windowSize);
+    // Whether hashing bytes per file is faster in batches: SHA-256 of small messages when the
+    // CPU has a multi-buffer kernel
+    static bool canBatch(HashAlgorithm algorithm, std::uintmax_t bytes);
+    // Hash every job, reading each message into memory first so that SHA-256 can run one
+    // message per SIMD lane; errors are recorded per job instead of thrown
+    static void calculateBatch(std::vector<HashJob>& jobs, HashAlgorithm algorithm);
+    // Hash every job that has no error yet on the pool, one task each, recording errors per
+    // job. Without done the call waits for the pool to drain; with it, it returns at once and
+    // done runs on the worker that finished the last job, so the jobs must outlive it.
+    static void calculateOnPool(WorkerPool& pool, std::vector<HashJob>& jobs, HashAlgorithm algorithm,
+                                ReadBackend backend, std::function<void()> done = nullptr);
+    // Same as compareContents; the algorithm is no longer used, nothing is hashed
     static bool compareFiles(const std::string& filePath1, const std::string& filePath2, HashAlgorithm algorithm);
+
+    // Byte-for-byte comparison that stops at the first differing block
+    static bool compareContents(const std::string& filePath1, const std::string& filePath2);
+
+    // Whether the algorithm was compiled in
+    static bool isAvailable(HashAlgorithm algorithm);
+    // Whether matching digests can be trusted without a confirmation step
+    static bool isCollisionResistant(HashAlgorithm algorithm);
+    static const char* algorithmName(HashAlgorithm algorithm);
 };
 
-#endif // HASH_CALCULATOR_H
\ No newline at end of file
+#endif // HASH_CALCULATOR_H
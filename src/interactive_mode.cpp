@@ -0,0 +1,625 @@
+#include "interactive_mode.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "file_scanner.h"
+#include "hash_calculator.h"
+#include "duplicate_handler.h"
+#include "uring_engine.h"
+#include "stats_writer.h"
+
+namespace {
+
+void displayMenu() {
+    std::cout << "\n=== Duplicate File Finder ===" << std::endl;
+    std::cout << "1. Scan Directory for Duplicates" << std::endl;
+    std::cout << "2. Configure Settings" << std::endl;
+    std::cout << "3. Show Statistics" << std::endl;
+    std::cout << "4. Exit" << std::endl;
+    std::cout << "Choose an option: ";
+}
+
+void displaySettings(HashAlgorithm& algorithm, bool& recursive, DuplicateAction& action, ScanOptions& options) {
+    std::cout << "\n=== Current Settings ===" << std::endl;
+    std::cout << "Hash Algorithm: " << HashCalculator::algorithmName(algorithm) << std::endl;
+    std::cout << "Recursive Scan: " << (recursive ? "Yes" : "No") << std::endl;
+    std::cout << "Default Action: ";
+    switch (action) {
+        case DuplicateAction::DELETE: std::cout << "Delete"; break;
+        case DuplicateAction::MOVE: std::cout << "Move"; break;
+        case DuplicateAction::HARD_LINK: std::cout << "Hard Link"; break;
+        case DuplicateAction::HARD_LINK_IN_PLACE: std::cout << "Hard Link In Place"; break;
+        case DuplicateAction::REFLINK: std::cout << "Reflink"; break;
+        case DuplicateAction::SHOW_ONLY: std::cout << "Show Only"; break;
+    }
+    std::cout << std::endl;
+    std::cout << "Partial Hash Window: ";
+    if (options.partialHashWindow > 0) {
+        std::cout << options.partialHashWindow << " bytes";
+    } else {
+        std::cout << "Disabled";
+    }
+    std::cout << std::endl;
+    std::cout << "Hashing Threads: ";
+    if (options.threadCount > 0) {
+        std::cout << options.threadCount;
+    } else {
+        std::cout << "Auto (" << WorkerPool::defaultThreadCount() << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "Walker Threads: " << options.walkThreads << std::endl;
+    std::cout << "Device Read Limit: ";
+    if (options.deviceReadLimit > 0) {
+        std::cout << options.deviceReadLimit;
+    } else {
+        std::cout << "Hashing threads";
+    }
+    std::cout << " (1 on rotational disks)" << std::endl;
+    std::cout << "Verbose Logging: " << (options.verbose ? "Enabled" : "Disabled") << std::endl;
+    std::cout << "Streaming Memory Budget: ";
+    if (options.streamingMemoryBudget > 0) {
+        std::cout << options.streamingMemoryBudget / (1024 * 1024) << " MB";
+    } else {
+        std::cout << "Disabled (whole tree in memory)";
+    }
+    std::cout << std::endl;
+    std::cout << "Similar File Detection: ";
+    if (options.similarityMinSize > 0) {
+        std::cout << "Files from " << options.similarityMinSize / (1024 * 1024) << " MB sharing "
+                  << static_cast<int>(options.similarityThreshold * 100 + 0.5) << "%";
+    } else {
+        std::cout << "Disabled";
+    }
+    std::cout << std::endl;
+    const FilterRules& filters = options.filters;
+    std::cout << "File Filters: ";
+    if (filters.minSize > 0 || !filters.excludeDirectories.empty() || !filters.excludeGlobs.empty()) {
+        std::cout << "Files from " << filters.minSize << " bytes";
+        for (const auto& pattern : filters.excludeDirectories) {
+            std::cout << ", skip dir " << pattern;
+        }
+        for (const auto& pattern : filters.excludeGlobs) {
+            std::cout << ", skip " << pattern;
+        }
+    } else {
+        std::cout << "None";
+    }
+    std::cout << std::endl;
+    std::cout << "Progress Interval: ";
+    if (options.progressIntervalMs > 0) {
+        std::cout << options.progressIntervalMs << " ms";
+    } else {
+        std::cout << "Disabled";
+    }
+    std::cout << std::endl;
+    std::cout << "Group Order: " << (options.groupOrder == GroupOrder::WASTED_BYTES ? "Wasted Bytes" : "Member Count")
+              << std::endl;
+    std::cout << "Hash Cache: " << (options.hashCachePath.empty() ? "Disabled" : options.hashCachePath) << std::endl;
+    std::cout << "Scan Snapshot: " << (options.snapshotPath.empty() ? "Disabled" : options.snapshotPath) << std::endl;
+    std::cout << "Group Confirmation: ";
+    switch (options.verification) {
+        case GroupVerification::NONE: std::cout << "None"; break;
+        case GroupVerification::SHA256: std::cout << "SHA256"; break;
+        case GroupVerification::BYTE_COMPARE: std::cout << "Byte Compare"; break;
+    }
+    std::cout << std::endl;
+    std::cout << "Read Backend: " << FileReader::backendName(options.readBackend) << std::endl;
+    std::cout << "io_uring Reads: " << (options.useIoUring ? "Enabled" : "Disabled")
+              << (UringHashEngine::isSupported() ? "" : " (not supported here)") << std::endl;
+}
+
+void configureSettings(HashAlgorithm& algorithm, bool& recursive, DuplicateAction& action, ScanOptions& options) {
+    int choice;
+    
+    std::cout << "\n=== Configure Settings ===" << std::endl;
+    std::cout << "1. Change Hash Algorithm" << std::endl;
+    std::cout << "2. Toggle Recursive Scan" << std::endl;
+    std::cout << "3. Change Default Action" << std::endl;
+    std::cout << "4. Change Partial Hash Window" << std::endl;
+    std::cout << "5. Change Hashing Threads" << std::endl;
+    std::cout << "6. Set Hash Cache File" << std::endl;
+    std::cout << "7. Prune Hash Cache" << std::endl;
+    std::cout << "8. Change Group Confirmation" << std::endl;
+    std::cout << "9. Change Read Backend" << std::endl;
+    std::cout << "10. Toggle io_uring Reads" << std::endl;
+    std::cout << "11. Change Walker Threads" << std::endl;
+    std::cout << "12. Toggle Verbose Logging" << std::endl;
+    std::cout << "13. Toggle Group Order" << std::endl;
+    std::cout << "14. Set Scan Snapshot File" << std::endl;
+    std::cout << "15. Change Device Read Limit" << std::endl;
+    std::cout << "16. Change Progress Interval" << std::endl;
+    std::cout << "17. Change Streaming Memory Budget" << std::endl;
+    std::cout << "18. Change Similar File Detection" << std::endl;
+    std::cout << "19. Change File Filters" << std::endl;
+    std::cout << "20. Back to Main Menu" << std::endl;
+    std::cout << "Choose option: ";
+    
+    if (!(std::cin >> choice)) {
+        std::cout << "Invalid input. Please enter a number." << std::endl;
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        return;
+    }
+    
+    switch (choice) {
+        case 1: {
+            std::cout << "Select Hash Algorithm:" << std::endl;
+            std::cout << "1. MD5 (faster)" << std::endl;
+            std::cout << "2. SHA256 (more secure)" << std::endl;
+            std::cout << "3. XXH3-128 (fastest, not collision resistant)"
+                      << (HashCalculator::isAvailable(HashAlgorithm::XXH3_128) ? "" : " [not available]") << std::endl;
+            std::cout << "4. BLAKE3 (fast and secure)"
+                      << (HashCalculator::isAvailable(HashAlgorithm::BLAKE3) ? "" : " [not available]") << std::endl;
+            std::cout << "Choice: ";
+            int algoChoice;
+            if (std::cin >> algoChoice) {
+                HashAlgorithm selected;
+                switch (algoChoice) {
+                    case 1: selected = HashAlgorithm::MD5; break;
+                    case 3: selected = HashAlgorithm::XXH3_128; break;
+                    case 4: selected = HashAlgorithm::BLAKE3; break;
+                    default: selected = HashAlgorithm::SHA256; break;
+                }
+                if (HashCalculator::isAvailable(selected)) {
+                    algorithm = selected;
+                    std::cout << "Hash algorithm updated." << std::endl;
+                } else {
+                    std::cout << HashCalculator::algorithmName(selected) << " support was not compiled in." << std::endl;
+                }
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 2:
+            recursive = !recursive;
+            std::cout << "Recursive scan " << (recursive ? "enabled" : "disabled") << std::endl;
+            break;
+        case 3: {
+            std::cout << "Select Default Action:" << std::endl;
+            std::cout << "1. Show Only" << std::endl;
+            std::cout << "2. Delete Duplicates" << std::endl;
+            std::cout << "3. Move Duplicates" << std::endl;
+            std::cout << "4. Create Hard Links" << std::endl;
+            std::cout << "5. Reflink Duplicates (btrfs/XFS)" << std::endl;
+            std::cout << "6. Replace Duplicates With Hard Links In Place" << std::endl;
+            std::cout << "Choice: ";
+            int actionChoice;
+            if (std::cin >> actionChoice) {
+                switch (actionChoice) {
+                    case 1: action = DuplicateAction::SHOW_ONLY; break;
+                    case 2: action = DuplicateAction::DELETE; break;
+                    case 3: action = DuplicateAction::MOVE; break;
+                    case 4: action = DuplicateAction::HARD_LINK; break;
+                    case 5: action = DuplicateAction::REFLINK; break;
+                    case 6: action = DuplicateAction::HARD_LINK_IN_PLACE; break;
+                    default: std::cout << "Invalid choice." << std::endl; break;
+                }
+                if (actionChoice >= 1 && actionChoice <= 6) {
+                    std::cout << "Default action updated." << std::endl;
+                }
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 4: {
+            std::cout << "Enter partial hash window in bytes (0 to disable): ";
+            std::size_t window;
+            if (std::cin >> window) {
+                options.partialHashWindow = window;
+                std::cout << "Partial hash window updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 5: {
+            std::cout << "Enter number of hashing threads (0 for auto): ";
+            size_t threads;
+            if (std::cin >> threads) {
+                options.threadCount = threads;
+                std::cout << "Hashing threads updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 6: {
+            std::cout << "Enter hash cache file (empty to disable): ";
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            std::getline(std::cin, options.hashCachePath);
+            std::cout << "Hash cache " << (options.hashCachePath.empty() ? "disabled" : "updated") << "." << std::endl;
+            break;
+        }
+        case 7: {
+            if (options.hashCachePath.empty()) {
+                std::cout << "No hash cache file configured." << std::endl;
+                break;
+            }
+            HashCache cache(options.hashCachePath);
+            if (cache.load()) {
+                size_t removed = cache.evictStale();
+                cache.save();
+                std::cout << "Removed " << removed << " stale entries, " << cache.size() << " remain." << std::endl;
+            }
+            break;
+        }
+        case 8: {
+            std::cout << "Confirm groups found with a non-collision-resistant hash:" << std::endl;
+            std::cout << "1. No confirmation" << std::endl;
+            std::cout << "2. Re-hash with SHA256" << std::endl;
+            std::cout << "3. Byte-by-byte comparison" << std::endl;
+            std::cout << "Choice: ";
+            int verifyChoice;
+            if (std::cin >> verifyChoice) {
+                switch (verifyChoice) {
+                    case 1: options.verification = GroupVerification::NONE; break;
+                    case 2: options.verification = GroupVerification::SHA256; break;
+                    case 3: options.verification = GroupVerification::BYTE_COMPARE; break;
+                    default: std::cout << "Invalid choice." << std::endl; break;
+                }
+                if (verifyChoice >= 1 && verifyChoice <= 3) {
+                    std::cout << "Group confirmation updated." << std::endl;
+                }
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 9: {
+            std::cout << "Select Read Backend:" << std::endl;
+            std::cout << "1. Auto (by file size)" << std::endl;
+            std::cout << "2. mmap" << std::endl;
+            std::cout << "3. pread" << std::endl;
+            std::cout << "4. O_DIRECT (bypass page cache)" << std::endl;
+            std::cout << "Choice: ";
+            int backendChoice;
+            if (std::cin >> backendChoice) {
+                switch (backendChoice) {
+                    case 1: options.readBackend = ReadBackend::AUTO; break;
+                    case 2: options.readBackend = ReadBackend::MMAP; break;
+                    case 3: options.readBackend = ReadBackend::PREAD; break;
+                    case 4: options.readBackend = ReadBackend::DIRECT; break;
+                    default: std::cout << "Invalid choice." << std::endl; break;
+                }
+                if (backendChoice >= 1 && backendChoice <= 4) {
+                    std::cout << "Read backend updated." << std::endl;
+                }
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 10:
+            options.useIoUring = !options.useIoUring;
+            std::cout << "io_uring reads " << (options.useIoUring ? "enabled" : "disabled") << std::endl;
+            break;
+        case 11: {
+            std::cout << "Enter number of directory walker threads: ";
+            size_t threads;
+            if (std::cin >> threads && threads > 0) {
+                options.walkThreads = threads;
+                std::cout << "Walker threads updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 12:
+            options.verbose = !options.verbose;
+            std::cout << "Verbose logging " << (options.verbose ? "enabled" : "disabled") << std::endl;
+            break;
+        case 13:
+            options.groupOrder = options.groupOrder == GroupOrder::WASTED_BYTES ? GroupOrder::MEMBER_COUNT
+                                                                                  : GroupOrder::WASTED_BYTES;
+            std::cout << "Groups ordered by "
+                      << (options.groupOrder == GroupOrder::WASTED_BYTES ? "wasted bytes" : "member count") << std::endl;
+            break;
+        case 14: {
+            std::cout << "Enter scan snapshot file (empty to disable): ";
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            std::getline(std::cin, options.snapshotPath);
+            std::cout << "Scan snapshot " << (options.snapshotPath.empty() ? "disabled" : "updated") << "." << std::endl;
+            break;
+        }
+        case 15: {
+            std::cout << "Enter reads in flight per device (0 for one per hashing thread): ";
+            size_t limit;
+            if (std::cin >> limit) {
+                options.deviceReadLimit = limit;
+                std::cout << "Device read limit updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 16: {
+            std::cout << "Enter milliseconds between progress lines (0 to disable): ";
+            unsigned interval;
+            if (std::cin >> interval) {
+                options.progressIntervalMs = interval;
+                std::cout << "Progress interval updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 17: {
+            std::cout << "Enter the memory budget in MB for streaming scans (0 keeps the whole tree in memory): ";
+            size_t megabytes;
+            if (std::cin >> megabytes) {
+                options.streamingMemoryBudget = megabytes * 1024 * 1024;
+                std::cout << "Streaming memory budget updated." << std::endl;
+            } else {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+            break;
+        }
+        case 18: {
+            std::cout << "Enter the smallest file size in MB to chunk for similar files (0 to disable): ";
+            size_t megabytes;
+            unsigned percent;
+            if (!(std::cin >> megabytes)) {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            } else if (megabytes == 0) {
+                options.similarityMinSize = 0;
+                std::cout << "Similar file detection disabled." << std::endl;
+            } else {
+                std::cout << "Enter the percent of content a similar pair must share (1-100): ";
+                if (std::cin >> percent && percent >= 1 && percent <= 100) {
+                    options.similarityMinSize = static_cast<std::uintmax_t>(megabytes) * 1024 * 1024;
+                    options.similarityThreshold = static_cast<double>(percent) / 100;
+                    std::cout << "Similar file detection updated." << std::endl;
+                } else {
+                    std::cout << "Invalid input." << std::endl;
+                    std::cin.clear();
+                    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                }
+            }
+            break;
+        }
+        case 19: {
+            FilterRules filters = options.filters;
+            std::cout << "Enter the smallest file size in bytes to scan (1 skips empty files): ";
+            if (!(std::cin >> filters.minSize)) {
+                std::cout << "Invalid input." << std::endl;
+                std::cin.clear();
+                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+                break;
+            }
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            // Space-separated patterns; names like .git match at any depth, paths are never entered
+            auto readPatterns = [](const char* prompt, std::vector<std::string>& patterns) {
+                std::cout << prompt;
+                std::string line;
+                std::getline(std::cin, line);
+                std::istringstream words(line);
+                patterns.clear();
+                for (std::string word; words >> word;) {
+                    patterns.push_back(word);
+                }
+            };
+            readPatterns("Enter directories to skip, e.g. .git node_modules (empty for none): ", filters.excludeDirectories);
+            readPatterns("Enter file patterns to skip, e.g. *.tmp (empty for none): ", filters.excludeGlobs);
+            try {
+                WalkFilter compiled(filters);
+                options.filters = filters;
+                std::cout << "File filters updated." << std::endl;
+            } catch (const std::invalid_argument& e) {
+                std::cout << "Invalid pattern: " << e.what() << std::endl;
+            }
+            break;
+        }
+        case 20:
+            break;
+        default:
+            std::cout << "Invalid option." << std::endl;
+            break;
+    }
+}
+
+void showStatistics(const FileScanner& scanner, const ActionReport* actions) {
+    std::cout << "\n=== Scan Statistics ===" << std::endl;
+    std::cout << "Total files scanned: " << scanner.getTotalFilesScanned() << std::endl;
+    std::cout << "Duplicate groups found: " << scanner.getTotalDuplicateGroups() << std::endl;
+    
+    const ScanStatistics& stats = scanner.getStatistics();
+    if (stats.filesWalked > 0) {
+        std::cout << "Total size scanned: " << std::fixed << std::setprecision(2) 
+                  << static_cast<double>(stats.bytesWalked) / (1024 * 1024) << " MB" << std::endl;
+    }
+
+    if (scanner.getTotalDuplicateGroups() > 0) {
+        // Hard links to one inode are duplicates by path but free nothing when removed
+        std::cout << "Duplicate data: " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(stats.duplicateBytes) / (1024 * 1024) << " MB logical, "
+                  << static_cast<double>(stats.reclaimableBytes) / (1024 * 1024) << " MB reclaimable" << std::endl;
+    }
+    if (stats.linksCollapsed > 0) {
+        std::cout << "Hard links hashed once per inode: " << stats.linksCollapsed << std::endl;
+    }
+    if (!stats.stages.empty()) {
+        std::vector<StageStatistics> stages = stats.stages;
+        if (actions) {
+            stages.push_back(StatsWriter::actionStage(*actions));
+        }
+        std::cout << "\nPipeline stages (" << std::fixed << std::setprecision(2) << stats.seconds << " s scan):"
+                  << std::endl;
+        for (const auto& stage : stages) {
+            std::cout << "  " << stage.name << ": " << stage.candidatesIn << " candidates, "
+                      << stage.candidatesRemoved << " removed, "
+                      << std::fixed << std::setprecision(2)
+                      << static_cast<double>(stage.bytesRead) / (1024 * 1024) << " MB read, "
+                      << static_cast<double>(stage.bytesSkipped) / (1024 * 1024) << " MB skipped" << std::endl;
+            // Rates per second of the stage's own wall time; utilization only where work was timed
+            std::cout << "    " << stage.seconds << " s";
+            if (stage.seconds > 0) {
+                std::cout << ", " << std::setprecision(0) << static_cast<double>(stage.candidatesIn) / stage.seconds
+                          << " files/s, " << std::setprecision(2)
+                          << static_cast<double>(stage.bytesRead) / (1024 * 1024) / stage.seconds << " MB/s";
+                if (stage.workers > 0) {
+                    std::cout << ", " << std::setprecision(0)
+                              << 100 * stage.busySeconds / (stage.seconds * static_cast<double>(stage.workers))
+                              << "% of " << stage.workers << " threads busy";
+                }
+            }
+            if (stage.peakQueueDepth > 0) {
+                std::cout << ", peak queue " << stage.peakQueueDepth;
+            }
+            std::cout << std::endl;
+        }
+    }
+    if (stats.cacheHits > 0) {
+        std::cout << "Hash cache hits: " << stats.cacheHits << " ("
+                  << std::fixed << std::setprecision(2)
+                  << static_cast<double>(stats.cacheBytesSaved) / (1024 * 1024) << " MB not re-read)" << std::endl;
+    }
+    if (stats.arenaBytes > 0) {
+        std::cout << "Scan lookups: " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(stats.arenaBytes) / (1024 * 1024) << " MB arena at peak" << std::endl;
+    }
+    if (stats.filesReused > 0 || stats.directoriesReused > 0) {
+        std::cout << "Snapshot reuse: " << stats.directoriesReused << " directories, " << stats.filesReused
+                  << " files, " << stats.groupsReused << " groups" << std::endl;
+    }
+}
+
+} // namespace
+
+int runInteractive() {
+    std::string directoryPath;
+    std::string targetDirectory;
+    int choice;
+    
+    // Default settings
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    bool recursive = true;
+    DuplicateAction defaultAction = DuplicateAction::SHOW_ONLY;
+    ScanOptions scanOptions;
+    
+    FileScanner scanner;
+    DuplicateHandler handler;
+    // Actions of the last automatic run, shown as the final stage of its statistics
+    ActionReport lastActions;
+    bool hasActionReport = false;
+    
+    std::cout << "Welcome to Duplicate File Finder!" << std::endl;
+    std::cout << "This tool helps you find and manage duplicate files using hash comparison." << std::endl;
+
+    while (true) {
+        displayMenu();
+        
+        // Clear any previous error states and handle input validation
+        if (!(std::cin >> choice)) {
+            std::cout << "Invalid input. Please enter a number." << std::endl;
+            std::cin.clear(); // Clear error flags
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Ignore rest of line
+            continue;
+        }
+
+        // Clear any leftover characters in buffer after reading choice
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        switch (choice) {
+            case 1: {
+                std::cout << "Enter directory path to scan: ";
+                std::getline(std::cin, directoryPath);
+                
+                try {
+                    hasActionReport = false;
+                    scanner.setOptions(scanOptions);
+                    // Automatic mode acts on each group as soon as the scan confirms it
+                    const bool automatic = defaultAction != DuplicateAction::SHOW_ONLY;
+                    if (automatic) {
+                        if (defaultAction == DuplicateAction::MOVE || defaultAction == DuplicateAction::HARD_LINK) {
+                            std::cout << "Enter target directory: ";
+                            std::getline(std::cin, targetDirectory);
+                        }
+                        // One plan across all groups so the operations share one pool
+                        handler.beginPlan(defaultAction, targetDirectory);
+                        scanner.setGroupCallback([&handler](const FileTable& files, const FileGroup& group) {
+                            handler.addToPlan(handler.planGroup(files, group));
+                        });
+                    } else {
+                        scanner.setGroupCallback(nullptr);
+                    }
+                    const auto& duplicateGroups = scanner.findDuplicates(directoryPath, algorithm, recursive);
+                    if (automatic) {
+                        lastActions = handler.finishPlan();
+                        hasActionReport = true;
+                    }
+
+                    // Near duplicates are only listed; no action applies to them
+                    const auto& similarFiles = scanner.getSimilarFiles();
+                    if (!similarFiles.empty()) {
+                        std::cout << "\nFound " << similarFiles.size() << " pairs of similar files:" << std::endl;
+                        for (const auto& pair : similarFiles) {
+                            std::cout << "  " << std::fixed << std::setprecision(1) << pair.ratio * 100 << "% ("
+                                      << std::setprecision(2) << static_cast<double>(pair.sharedBytes) / (1024 * 1024)
+                                      << " MB) shared: " << pair.first << " <-> " << pair.second << std::endl;
+                        }
+                    }
+                    
+                    if (duplicateGroups.empty()) {
+                        std::cout << "No duplicate files found!" << std::endl;
+                        break;
+                    }
+                    
+                    std::cout << "\nFound " << duplicateGroups.size() << " groups of duplicate files." << std::endl;
+                    
+                    if (!automatic) {
+                        // Interactive mode
+                        for (const auto& group : duplicateGroups) {
+                            handler.handleDuplicatesInteractive(scanner.getScannedFiles(), group);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error: " << e.what() << std::endl;
+                }
+                break;
+            }
+            case 2:
+                displaySettings(algorithm, recursive, defaultAction, scanOptions);
+                configureSettings(algorithm, recursive, defaultAction, scanOptions);
+                break;
+            case 3:
+                showStatistics(scanner, hasActionReport ? &lastActions : nullptr);
+                break;
+            case 4:
+                std::cout << "Exiting..." << std::endl;
+                return 0;
+            default:
+                std::cout << "Invalid option. Please try again." << std::endl;
+                break;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef INTERACTIVE_MODE_H
+#define INTERACTIVE_MODE_H
+
+// Menu-driven scans with settings, statistics and per-group prompts on the console;
+// returns the process exit code
+int runInteractive();
+
+#endif // INTERACTIVE_MODE_H
@@ -0,0 +1,146 @@
+#include "io_scheduler.h"
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+IoScheduler::IoScheduler(WorkerPool& pool, size_t defaultLimit, size_t queueCapacity)
+    : pool(pool),
+      defaultLimit(defaultLimit > 0 ? defaultLimit : pool.size()),
+      capacity(queueCapacity > 0 ? queueCapacity : pool.size() * 64) {}
+
+void IoScheduler::setLimit(std::uint64_t device, size_t limit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fixedLimits[device] = limit;
+    auto it = devices.find(device);
+    if (it != devices.end()) {
+        it->second.limit = limit > 0 ? limit : defaultLimit;
+    }
+}
+
+size_t IoScheduler::limit(std::uint64_t device) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return queueFor(device).limit;
+}
+
+IoScheduler::DeviceQueue& IoScheduler::queueFor(std::uint64_t device) {
+    auto it = devices.find(device);
+    if (it != devices.end()) {
+        return it->second;
+    }
+    DeviceQueue& queue = devices[device];
+    auto fixed = fixedLimits.find(device);
+    if (fixed != fixedLimits.end()) {
+        queue.limit = fixed->second > 0 ? fixed->second : defaultLimit;
+    } else {
+        size_t detected = detectLimit(device);
+        queue.limit = detected > 0 ? detected : defaultLimit;
+    }
+    if (queue.limit == 0) {
+        queue.limit = 1;
+    }
+    return queue;
+}
+
+void IoScheduler::submit(std::uint64_t device, WorkerPool::Task task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    DeviceQueue& queue = queueFor(device);
+    spaceAvailable.wait(lock, [&] { return queue.waiting.size() < capacity; });
+    outstanding++;
+    peakOutstanding = std::max(peakOutstanding, outstanding);
+    if (queue.running >= queue.limit) {
+        queue.waiting.push_back(std::move(task));
+        return;
+    }
+    queue.running++;
+    lock.unlock();
+    pool.submit([this, device, task = std::move(task)](size_t workerIndex) mutable {
+        drain(device, std::move(task), workerIndex);
+    });
+}
+
+void IoScheduler::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return outstanding == 0; });
+}
+
+size_t IoScheduler::pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return outstanding;
+}
+
+size_t IoScheduler::takePeakPending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    const size_t peak = peakOutstanding;
+    peakOutstanding = outstanding;
+    return peak;
+}
+
+void IoScheduler::drain(std::uint64_t device, WorkerPool::Task task, size_t workerIndex) {
+    while (true) {
+        try {
+            task(workerIndex);
+        } catch (const std::exception& e) {
+            std::cerr << "Worker task failed: " << e.what() << std::endl;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--outstanding == 0) {
+            allDone.notify_all();
+        }
+        DeviceQueue& queue = devices[device];
+        if (queue.waiting.empty()) {
+            queue.running--;
+            return;
+        }
+        task = std::move(queue.waiting.front());
+        queue.waiting.pop_front();
+        spaceAvailable.notify_all();
+    }
+}
+
+size_t IoScheduler::detectLimit(std::uint64_t device) {
+#ifdef __linux__
+    if (device == 0) {
+        return 0;
+    }
+    // A partition has no queue of its own; its disk's is one directory up
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    const fs::path node = fs::canonical("/sys/dev/block/" + std::to_string(major(device)) + ":" +
+                                        std::to_string(minor(device)), ec);
+    if (ec) {
+        return 0;
+    }
+    for (const fs::path& directory : { node, node.parent_path() }) {
+        std::ifstream in(directory / "queue" / "rotational");
+        int rotational = 0;
+        if (in >> rotational) {
+            return rotational == 1 ? 1 : 0;
+        }
+    }
+#else
+    (void)device;
+#endif
+    return 0;
+}
+
+std::uint64_t IoScheduler::deviceOf(const std::string& path) {
+#ifndef _WIN32
+    struct stat info;
+    if (::stat(path.c_str(), &info) == 0) {
+        return static_cast<std::uint64_t>(info.st_dev);
+    }
+#else
+    (void)path;
+#endif
+    return 0;
+}
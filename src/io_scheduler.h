@@ -0,0 +1,72 @@
+#ifndef IO_SCHEDULER_H
+#define IO_SCHEDULER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "worker_pool.h"
+
+// Runs read tasks on a worker pool with a separate concurrency limit per device. A device
+// never holds more workers than its limit, and its backlog waits in its own queue, so one
+// slow disk keeps the rest of the pool busy with the other devices instead of stalling it.
+// Each worker that gets a device slot keeps draining that device's queue until it is empty.
+class IoScheduler {
+public:
+    // defaultLimit 0 allows as many reads per device as the pool has workers; queueCapacity
+    // bounds the tasks waiting per device before submit blocks
+    IoScheduler(WorkerPool& pool, size_t defaultLimit = 0, size_t queueCapacity = 0);
+
+    IoScheduler(const IoScheduler&) = delete;
+    IoScheduler& operator=(const IoScheduler&) = delete;
+
+    // Fix the limit of one device (0 = the default); devices without one get detectLimit() or the default
+    void setLimit(std::uint64_t device, size_t limit);
+    size_t limit(std::uint64_t device);
+
+    // Queue a read of device, blocking while that device already has a full backlog
+    void submit(std::uint64_t device, WorkerPool::Task task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    // Tasks submitted and not finished yet, queued or running
+    size_t pending();
+    // Most tasks pending at once since the last call
+    size_t takePeakPending();
+
+    // 1 for a rotational disk, where parallel reads only add seeks; 0 when unknown
+    static size_t detectLimit(std::uint64_t device);
+
+    // Device holding path, 0 when it cannot be determined
+    static std::uint64_t deviceOf(const std::string& path);
+
+private:
+    struct DeviceQueue {
+        std::deque<WorkerPool::Task> waiting;
+        size_t running = 0;
+        size_t limit = 0;
+    };
+
+    WorkerPool& pool;
+    size_t defaultLimit;
+    size_t capacity;
+    size_t outstanding = 0;
+    size_t peakOutstanding = 0;
+    std::unordered_map<std::uint64_t, size_t> fixedLimits;
+    std::unordered_map<std::uint64_t, DeviceQueue> devices;
+
+    std::mutex mutex;
+    std::condition_variable spaceAvailable;
+    std::condition_variable allDone;
+
+    // Must be called with the mutex held
+    DeviceQueue& queueFor(std::uint64_t device);
+    // Run task, then whatever else is waiting for device, on the calling worker
+    void drain(std::uint64_t device, WorkerPool::Task task, size_t workerIndex);
+};
+
+#endif // IO_SCHEDULER_H
@@ -0,0 +1,120 @@
+#include "progress_reporter.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string formatBytes(std::uintmax_t bytes) {
+    char text[32];
+    const double value = static_cast<double>(bytes);
+    if (value >= 1024.0 * 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.2f GB", value / (1024.0 * 1024 * 1024));
+    } else {
+        std::snprintf(text, sizeof(text), "%.1f MB", value / (1024.0 * 1024));
+    }
+    return text;
+}
+
+} // namespace
+
+void ScanProgress::enter(const char* name, bool keepReads) {
+    if (!keepReads) {
+        filesQueued = 0;
+        filesDone = 0;
+        bytesQueued = 0;
+        bytesDone = 0;
+    }
+    filesAtStart = filesDone.load();
+    bytesAtStart = bytesDone.load();
+    stageStartedNs = nowNs();
+    // Published last, so a reader that sees the new stage also sees its counters
+    stage = name;
+}
+
+ProgressReporter::ProgressReporter(const ScanProgress& progress, unsigned intervalMs,
+                                   std::function<size_t()> queueDepth, std::ostream& out)
+    : progress(progress), interval(intervalMs > 0 ? intervalMs : 1), queueDepth(std::move(queueDepth)), out(out) {
+    thread = std::thread([this] { run(); });
+}
+
+ProgressReporter::~ProgressReporter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    thread.join();
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+        // One write per line keeps it whole next to the scan's own messages
+        out << line() + "\n" << std::flush;
+    }
+}
+
+std::string ProgressReporter::line() {
+    const char* stage = progress.stage.load();
+    const double elapsed = static_cast<double>(nowNs() - progress.stageStartedNs.load()) / 1e9;
+    const size_t filesQueued = progress.filesQueued.load(std::memory_order_relaxed);
+    const size_t filesDone = progress.filesDone.load(std::memory_order_relaxed);
+    const std::uintmax_t bytesQueued = progress.bytesQueued.load(std::memory_order_relaxed);
+    const std::uintmax_t bytesDone = progress.bytesDone.load(std::memory_order_relaxed);
+
+    std::ostringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(1);
+    text << "Progress: " << stage;
+    if (std::strcmp(stage, "Walk") == 0) {
+        // Nothing tells how large the tree is, so the walk has counts and a rate but no ETA
+        const size_t walked = progress.filesWalked.load(std::memory_order_relaxed);
+        text << " " << walked << " files, " << formatBytes(progress.bytesWalked.load(std::memory_order_relaxed));
+        if (elapsed > 0) {
+            text << ", " << static_cast<double>(walked) / elapsed << " files/s";
+        }
+        if (filesQueued > 0) {
+            text << "; " << filesDone << "/" << filesQueued << " reads done";
+        }
+    } else if (filesQueued > 0) {
+        const double fileRate = elapsed > 0 ? static_cast<double>(filesDone - progress.filesAtStart) / elapsed : 0;
+        const double byteRate = elapsed > 0 ? static_cast<double>(bytesDone - progress.bytesAtStart) / elapsed : 0;
+        text << " " << filesDone << "/" << filesQueued << " files, " << formatBytes(bytesDone) << "/"
+             << formatBytes(bytesQueued) << ", " << byteRate / (1024 * 1024) << " MB/s, " << fileRate << " files/s";
+        if (queueDepth) {
+            text << ", " << queueDepth() << " queued";
+        }
+        // Bytes predict better than files when sizes vary, as long as any were read yet
+        double remaining = -1;
+        if (byteRate > 0 && bytesQueued > bytesDone) {
+            remaining = static_cast<double>(bytesQueued - bytesDone) / byteRate;
+        } else if (fileRate > 0 && filesQueued > filesDone) {
+            remaining = static_cast<double>(filesQueued - filesDone) / fileRate;
+        }
+        if (remaining >= 0) {
+            text << ", ETA " << formatDuration(remaining);
+        }
+    } else {
+        text << ", " << formatDuration(elapsed);
+    }
+    return text.str();
+}
+
+std::string ProgressReporter::formatDuration(double seconds) {
+    const long long total = seconds > 0 ? static_cast<long long>(seconds + 0.5) : 0;
+    char text[32];
+    if (total >= 3600) {
+        std::snprintf(text, sizeof(text), "%lldh%02lldm%02llds", total / 3600, total / 60 % 60, total % 60);
+    } else if (total >= 60) {
+        std::snprintf(text, sizeof(text), "%lldm%02llds", total / 60, total % 60);
+    } else {
+        std::snprintf(text, sizeof(text), "%llds", total);
+    }
+    return text;
+}
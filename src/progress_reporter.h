@@ -0,0 +1,73 @@
+#ifndef PROGRESS_REPORTER_H
+#define PROGRESS_REPORTER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Live counters of a running scan. The scan and its workers update them with relaxed
+// atomics; the reporter thread only reads them.
+struct ScanProgress {
+    std::atomic<const char*> stage{ "" };
+    std::atomic<size_t> filesWalked{ 0 };
+    std::atomic<std::uintmax_t> bytesWalked{ 0 };
+    // Reads of the current stage: queued so far and finished
+    std::atomic<size_t> filesQueued{ 0 };
+    std::atomic<size_t> filesDone{ 0 };
+    std::atomic<std::uintmax_t> bytesQueued{ 0 };
+    std::atomic<std::uintmax_t> bytesDone{ 0 };
+    // When the current stage started and what was already done then, for its rates
+    std::atomic<std::int64_t> stageStartedNs{ 0 };
+    std::atomic<size_t> filesAtStart{ 0 };
+    std::atomic<std::uintmax_t> bytesAtStart{ 0 };
+
+    // Switch to the next stage; keepReads carries over reads queued before it started
+    void enter(const char* name, bool keepReads = false);
+    void queued(std::uintmax_t bytes, size_t count = 1) {
+        filesQueued.fetch_add(count, std::memory_order_relaxed);
+        bytesQueued.fetch_add(bytes, std::memory_order_relaxed);
+    }
+    void finished(std::uintmax_t bytes, size_t count = 1) {
+        filesDone.fetch_add(count, std::memory_order_relaxed);
+        bytesDone.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
+// Prints one progress line at most every interval on a background thread: the stage, how far
+// it got, its rate since it started, the scheduler backlog and an ETA once the stage knows
+// how much it has left. Nothing is printed for scans shorter than one interval.
+class ProgressReporter {
+public:
+    // queueDepth reports reads waiting or running; it is called from the reporter thread
+    ProgressReporter(const ScanProgress& progress, unsigned intervalMs, std::function<size_t()> queueDepth,
+                     std::ostream& out = std::cerr);
+    ~ProgressReporter();
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    // "1h02m03s", "2m05s" or "45s"
+    static std::string formatDuration(double seconds);
+
+private:
+    const ScanProgress& progress;
+    std::chrono::milliseconds interval;
+    std::function<size_t()> queueDepth;
+    std::ostream& out;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    void run();
+    std::string line();
+};
+
+#endif // PROGRESS_REPORTER_H
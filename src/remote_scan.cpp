@@ -0,0 +1,944 @@
+#include "remote_scan.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Longest line either side accepts; far above any path the protocol carries
+const size_t MAX_LINE_LENGTH = 1024 * 1024;
+// Paths per PARTIAL or HASH request; the agent hashes a whole batch before answering
+const size_t MAX_BATCH = 4096;
+// How long an agent waits for a new connection's first request, and for the coordinator
+// within a request; between requests it waits as long as other agents take to scan
+const int REQUEST_TIMEOUT_MS = 30 * 1000;
+
+// Set from the agent's signal handler; the scan's cancel flag points at it
+std::atomic<bool> stopRequested{ false };
+
+// Protocol names of the algorithms, the same as on the command line
+const char* algorithmKey(HashAlgorithm algorithm) {
+    switch (algorithm) {
+        case HashAlgorithm::MD5: return "md5";
+        case HashAlgorithm::SHA256: return "sha256";
+        case HashAlgorithm::XXH3_128: return "xxh3";
+        case HashAlgorithm::BLAKE3: return "blake3";
+    }
+    return "sha256";
+}
+
+bool algorithmFromKey(const std::string& key, HashAlgorithm& algorithm) {
+    for (HashAlgorithm candidate : { HashAlgorithm::MD5, HashAlgorithm::SHA256, HashAlgorithm::XXH3_128,
+                                     HashAlgorithm::BLAKE3 }) {
+        if (key == algorithmKey(candidate)) {
+            algorithm = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string escapePath(const std::string& path) {
+    std::string escaped;
+    escaped.reserve(path.size());
+    for (char c : path) {
+        if (c == '\\') {
+            escaped += "\\\\";
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c == '\r') {
+            escaped += "\\r";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+std::string unescapePath(const std::string& escaped) {
+    std::string path;
+    path.reserve(escaped.size());
+    for (size_t i = 0; i < escaped.size(); ++i) {
+        if (escaped[i] == '\\' && i + 1 < escaped.size()) {
+            const char next = escaped[++i];
+            path += next == 'n' ? '\n' : next == 'r' ? '\r' : next;
+        } else {
+            path += escaped[i];
+        }
+    }
+    return path;
+}
+
+std::string digestField(const Digest& digest) {
+    return digest.empty() ? "-" : digest.toHex();
+}
+
+bool parseDigestField(const std::string& field, Digest& digest) {
+    if (field == "-") {
+        digest = Digest();
+        return true;
+    }
+    return Digest::fromHex(field, digest);
+}
+
+bool parseNumber(const std::string& text, std::uintmax_t& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    try {
+        value = std::stoull(text);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Split "command rest" at the first space
+void splitCommand(const std::string& line, std::string& command, std::string& rest) {
+    const size_t space = line.find(' ');
+    command = line.substr(0, space);
+    rest = space == std::string::npos ? std::string() : line.substr(space + 1);
+}
+
+// "HOST:PORT", "[V6]:PORT" or, when host is optional, "PORT"
+bool splitAddress(const std::string& address, std::string& host, std::string& port, bool hostOptional) {
+    const size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        host.clear();
+        port = address;
+        return hostOptional && !port.empty();
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return !port.empty() && (hostOptional || !host.empty());
+}
+
+// Compare without stopping at the first difference, so timing does not reveal a prefix
+bool sameToken(const std::string& given, const std::string& expected) {
+    unsigned char difference = given.size() == expected.size() ? 0 : 1;
+    for (size_t i = 0; i < given.size(); ++i) {
+        difference |= static_cast<unsigned char>(given[i] ^ expected[i % expected.size()]);
+    }
+    return difference == 0;
+}
+
+} // namespace
+
+#ifndef _WIN32
+
+namespace {
+
+void requestStop(int) {
+    stopRequested = true;
+}
+
+// Wait until fd is ready for events; false on timeout or error
+bool waitReady(int fd, short events, int timeoutMs, const std::atomic<bool>* stop) {
+    if (timeoutMs < 0) {
+        return true;
+    }
+    pollfd entry{ fd, events, 0 };
+    while (true) {
+        const int ready = ::poll(&entry, 1, timeoutMs);
+        if (ready < 0 && errno == EINTR && !(stop && stop->load())) {
+            continue;
+        }
+        return ready > 0;
+    }
+}
+
+bool isLoopback(const sockaddr* address) {
+    if (address->sa_family == AF_INET) {
+        const auto* v4 = reinterpret_cast<const sockaddr_in*>(address);
+        return (ntohl(v4->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (address->sa_family == AF_INET6) {
+        return IN6_IS_ADDR_LOOPBACK(&reinterpret_cast<const sockaddr_in6*>(address)->sin6_addr);
+    }
+    return false;
+}
+
+int connectTo(const std::string& address, std::string& error) {
+    std::string host;
+    std::string port;
+    if (!splitAddress(address, host, port, false)) {
+        error = "expected HOST:PORT";
+        return -1;
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    const int status = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &results);
+    if (status != 0) {
+        error = ::gai_strerror(status);
+        return -1;
+    }
+    int fd = -1;
+    error = "no address";
+    for (addrinfo* entry = results; entry; entry = entry->ai_next) {
+        fd = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+        if (fd < 0) {
+            error = std::strerror(errno);
+            continue;
+        }
+        if (::connect(fd, entry->ai_addr, entry->ai_addrlen) == 0) {
+            break;
+        }
+        error = std::strerror(errno);
+        ::close(fd);
+        fd = -1;
+    }
+    ::freeaddrinfo(results);
+    return fd;
+}
+
+} // namespace
+
+LineSocket::~LineSocket() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+bool LineSocket::readLine(std::string& line) {
+    while (true) {
+        const size_t newline = input.find('\n', inputStart);
+        if (newline != std::string::npos) {
+            line.assign(input, inputStart, newline - inputStart);
+            inputStart = newline + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            return true;
+        }
+        if (input.size() - inputStart > MAX_LINE_LENGTH || failed) {
+            return false;
+        }
+        // Drop consumed lines before reading more, so the buffer holds at most one chunk
+        input.erase(0, inputStart);
+        inputStart = 0;
+
+        if (!waitReady(fd, POLLIN, timeoutMs, stop)) {
+            failed = true;
+            return false;
+        }
+        char buffer[64 * 1024];
+        const ssize_t bytes = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (bytes < 0 && errno == EINTR && !(stop && stop->load())) {
+            continue;
+        }
+        if (bytes <= 0) {
+            failed = true;
+            return false;
+        }
+        input.append(buffer, static_cast<size_t>(bytes));
+        received += static_cast<std::uintmax_t>(bytes);
+    }
+}
+
+void LineSocket::writeLine(const std::string& line) {
+    output += line;
+    output += '\n';
+    if (output.size() >= 64 * 1024) {
+        flush();
+    }
+}
+
+bool LineSocket::flush() {
+    size_t sent = 0;
+    while (sent < output.size() && !failed) {
+        if (!waitReady(fd, POLLOUT, timeoutMs, stop)) {
+            failed = true;
+            break;
+        }
+        const ssize_t written = ::send(fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR && !(stop && stop->load())) {
+            continue;
+        }
+        if (written <= 0) {
+            failed = true;
+            break;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    output.clear();
+    return !failed;
+}
+
+ScanAgent::ScanAgent(const AgentOptions& options) : options(options) {}
+
+ScanAgent::~ScanAgent() {
+    if (listenFd >= 0) {
+        ::close(listenFd);
+    }
+}
+
+int ScanAgent::run() {
+    pool = std::make_unique<WorkerPool>(options.scanOptions.threadCount);
+    if (!openListener()) {
+        return 2;
+    }
+
+    // No SA_RESTART, so a blocked accept or read returns and sees the request
+    struct sigaction action = {};
+    action.sa_handler = requestStop;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cerr << "Agent serving " << options.roots.size() << " roots on " << options.listenAddress << std::endl;
+    while (!stopRequested) {
+        pollfd listener{ listenFd, POLLIN, 0 };
+        if (::poll(&listener, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Agent loop failed: " << std::strerror(errno) << std::endl;
+            return 2;
+        }
+        const int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        // Between requests only keepalive notices a coordinator that went away
+        const int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+#ifdef TCP_KEEPIDLE
+        const int idleSeconds = 60;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idleSeconds, sizeof(idleSeconds));
+#endif
+        LineSocket session(fd, &stopRequested);
+        serve(session);
+    }
+
+    std::cerr << "Agent stopped" << std::endl;
+    return 0;
+}
+
+bool ScanAgent::openListener() {
+    std::string host;
+    std::string port;
+    if (!splitAddress(options.listenAddress, host, port, true)) {
+        std::cerr << "Invalid listen address: " << options.listenAddress << std::endl;
+        return false;
+    }
+    // Serving other hosts takes an explicit address, such as 0.0.0.0:PORT
+    if (host.empty()) {
+        host = "127.0.0.1";
+    }
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* results = nullptr;
+    const int status = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &results);
+    if (status != 0) {
+        std::cerr << "Unable to resolve " << options.listenAddress << ": " << ::gai_strerror(status) << std::endl;
+        return false;
+    }
+    std::string error = "no address";
+    bool loopback = false;
+    for (addrinfo* entry = results; entry && listenFd < 0; entry = entry->ai_next) {
+        loopback = isLoopback(entry->ai_addr);
+        listenFd = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+        if (listenFd < 0) {
+            error = std::strerror(errno);
+            continue;
+        }
+        const int reuse = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (::bind(listenFd, entry->ai_addr, entry->ai_addrlen) != 0 || ::listen(listenFd, 4) != 0) {
+            error = std::strerror(errno);
+            ::close(listenFd);
+            listenFd = -1;
+        }
+    }
+    ::freeaddrinfo(results);
+    if (listenFd < 0) {
+        std::cerr << "Unable to listen on " << options.listenAddress << ": " << error << std::endl;
+        return false;
+    }
+    if (!loopback && options.token.empty()) {
+        std::cerr << "Warning: any host that reaches " << options.listenAddress
+                  << " can list and hash the served files; give a --token file" << std::endl;
+    }
+    return true;
+}
+
+bool ScanAgent::authenticate(LineSocket& session) {
+    std::string line;
+    std::string command;
+    std::string token;
+    if (!session.readLine(line)) {
+        return false;
+    }
+    splitCommand(line, command, token);
+    if (command != "AUTH") {
+        session.writeLine("ERR authentication required");
+    } else if (!sameToken(token, options.token)) {
+        session.writeLine("ERR authentication failed");
+    } else {
+        session.writeLine("OK");
+        return session.flush();
+    }
+    session.flush();
+    return false;
+}
+
+void ScanAgent::serve(LineSocket& session) {
+    // A connection that never sends a request would hold the agent, which serves one at a time
+    session.setTimeout(REQUEST_TIMEOUT_MS);
+    char hostname[256] = "unknown";
+    ::gethostname(hostname, sizeof(hostname) - 1);
+    session.writeLine(std::string("DUPFINDER 1 ") + hostname);
+    if (!session.flush() || (!options.token.empty() && !authenticate(session))) {
+        return;
+    }
+
+    std::string line;
+    std::string command;
+    std::string arguments;
+    bool first = true;
+    while (!stopRequested) {
+        session.setTimeout(first ? REQUEST_TIMEOUT_MS : -1);
+        if (!session.readLine(line)) {
+            return;
+        }
+        session.setTimeout(REQUEST_TIMEOUT_MS);
+        first = false;
+        splitCommand(line, command, arguments);
+        bool open = true;
+        if (command == "SCAN") {
+            open = scan(session, arguments);
+        } else if (command == "PARTIAL" || command == "HASH") {
+            open = hashBatch(session, arguments, command == "PARTIAL");
+        } else {
+            session.writeLine("ERR unknown command");
+        }
+        if (!session.flush() || !open) {
+            return;
+        }
+    }
+}
+
+bool ScanAgent::scan(LineSocket& session, const std::string& arguments) {
+    std::string key;
+    std::string windowText;
+    splitCommand(arguments, key, windowText);
+    std::uintmax_t window = 0;
+    if (!algorithmFromKey(key, algorithm) || !parseNumber(windowText, window)) {
+        session.writeLine("ERR usage: SCAN <algorithm> <partial window>");
+        return true;
+    }
+    if (!HashCalculator::isAvailable(algorithm)) {
+        session.writeLine(std::string("ERR ") + HashCalculator::algorithmName(algorithm) + " support was not compiled in");
+        return true;
+    }
+    partialWindow = static_cast<std::size_t>(window);
+
+    ScanOptions scanOptions = options.scanOptions;
+    scanOptions.partialHashWindow = partialWindow;
+    // Aliases the process-wide flag without owning it
+    scanOptions.cancelFlag = std::shared_ptr<const std::atomic<bool>>(std::shared_ptr<void>(), &stopRequested);
+    FileScanner scanner;
+    scanner.setOptions(scanOptions);
+    scanner.setLogStream(std::cerr);
+    try {
+        scanner.findDuplicates(options.roots, algorithm, options.recursive);
+    } catch (const std::exception& e) {
+        session.writeLine(std::string("ERR ") + e.what());
+        return true;
+    }
+    if (stopRequested) {
+        return false;
+    }
+
+    // Files arrive grouped by directory, so each directory is sent once
+    const FileTable& table = scanner.getScannedFiles();
+    scannedSizes.clear();
+    scannedSizes.reserve(table.size());
+    const std::string* directory = nullptr;
+    for (size_t index = 0; index < table.size(); ++index) {
+        if (&table.directory(index) != directory) {
+            directory = &table.directory(index);
+            session.writeLine("D " + escapePath(*directory));
+        }
+        session.writeLine("F " + std::to_string(table.fileSize(index)) + " " + digestField(table.partialHash(index)) +
+                          " " + digestField(table.hash(index)) + " " + escapePath(std::string(table.name(index))));
+        scannedSizes.emplace(table.path(index), table.fileSize(index));
+    }
+    std::uintmax_t bytesRead = 0;
+    for (const auto& stage : scanner.getStatistics().stages) {
+        bytesRead += stage.bytesRead;
+    }
+    session.writeLine("END " + std::to_string(table.size()) + " " + std::to_string(bytesRead));
+    std::cerr << "Sent " << table.size() << " file records" << std::endl;
+    return true;
+}
+
+bool ScanAgent::hashBatch(LineSocket& session, const std::string& arguments, bool partial) {
+    std::uintmax_t count = 0;
+    if (!parseNumber(arguments, count) || count > MAX_BATCH) {
+        session.writeLine("ERR batches hold at most " + std::to_string(MAX_BATCH) + " paths");
+        return false;
+    }
+    std::vector<std::string> paths(static_cast<size_t>(count));
+    for (auto& path : paths) {
+        std::string line;
+        if (!session.readLine(line)) {
+            return false;
+        }
+        path = unescapePath(line);
+    }
+
+    std::vector<HashJob> jobs(paths.size());
+    for (size_t i = 0; i < paths.size(); ++i) {
+        jobs[i].path = std::move(paths[i]);
+        auto scanned = scannedSizes.find(jobs[i].path);
+        if (scanned == scannedSizes.end()) {
+            jobs[i].error = "not a file of the last scan";
+            continue;
+        }
+        jobs[i].size = scanned->second;
+        jobs[i].window = partial ? partialWindow : 0;
+    }
+    HashCalculator::calculateOnPool(*pool, jobs, algorithm, options.scanOptions.readBackend);
+
+    for (const HashJob& job : jobs) {
+        session.writeLine(job.error.empty() ? "OK " + job.digest.toHex() : "ERR " + job.error);
+    }
+    return true;
+}
+
+#else
+
+LineSocket::~LineSocket() {}
+
+bool LineSocket::readLine(std::string&) {
+    return false;
+}
+
+void LineSocket::writeLine(const std::string&) {}
+
+bool LineSocket::flush() {
+    return false;
+}
+
+ScanAgent::ScanAgent(const AgentOptions& options) : options(options) {}
+
+ScanAgent::~ScanAgent() {}
+
+int ScanAgent::run() {
+    std::cerr << "Agent mode requires POSIX sockets" << std::endl;
+    return 2;
+}
+
+#endif
+
+// One agent as seen by the coordinator
+struct ScanCoordinator::Connection {
+    std::string address;
+    std::string label;          // Host prefix of its paths
+    std::uint64_t number = 0;   // 1-based, stored as the device of its files
+    std::unique_ptr<LineSocket> socket;
+    FileTable files;            // Records as received, emptied by the merge
+    std::uintmax_t bytesRead = 0;   // Reported by the agent's own scan
+    std::uintmax_t requestBytes = 0;    // Read by the agent for the last digest requests
+    std::string error;
+    std::vector<std::string> fileErrors;
+};
+
+ScanCoordinator::ScanCoordinator(const CoordinatorOptions& options) : options(options) {}
+
+ScanCoordinator::~ScanCoordinator() = default;
+
+template <typename Function>
+bool ScanCoordinator::forEachConnection(Function fn) {
+    std::vector<char> succeeded(connections.size(), 0);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < connections.size(); ++i) {
+        threads.emplace_back([&, i] { succeeded[i] = fn(*connections[i]) ? 1 : 0; });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    bool ok = true;
+    for (size_t i = 0; i < connections.size(); ++i) {
+        Connection& connection = *connections[i];
+        for (const auto& message : connection.fileErrors) {
+            std::cerr << message << std::endl;
+        }
+        connection.fileErrors.clear();
+        if (!succeeded[i]) {
+            std::cerr << "Agent " << connection.address << ": " << connection.error << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool ScanCoordinator::run() {
+    const Clock::time_point started = Clock::now();
+    statistics = ScanStatistics();
+    groups.clear();
+    files.clear();
+    if (!connectAll()) {
+        return false;
+    }
+
+    StageStatistics scanStage;
+    scanStage.name = "Agent scan";
+    scanStage.workers = connections.size();
+    Clock::time_point stageStarted = Clock::now();
+    if (!forEachConnection([this](Connection& connection) { return receiveScan(connection); })) {
+        return false;
+    }
+    for (const auto& connection : connections) {
+        scanStage.bytesRead += connection->bytesRead;
+    }
+    mergeTables();
+    scanStage.candidatesIn = files.size();
+    scanStage.seconds = std::chrono::duration<double>(Clock::now() - stageStarted).count();
+    statistics.stages.push_back(scanStage);
+
+    // Files the agents could not settle alone: first head/tail digests for sizes shared
+    // across hosts, then full digests where a head/tail digest is
+    const bool byPartial = options.partialHashWindow > 0;
+    const std::vector<size_t> candidates = crossHostSizes();
+    if (byPartial) {
+        StageStatistics partialStage;
+        partialStage.name = "Partial hash";
+        partialStage.candidatesIn = candidates.size();
+        stageStarted = Clock::now();
+        std::vector<size_t> missing;
+        for (size_t index : candidates) {
+            // A file no larger than both windows is hashed whole, so its full digest will do
+            if (files.partialHash(index).empty()) {
+                if (!files.hash(index).empty() && files.fileSize(index) <= 2 * options.partialHashWindow) {
+                    files.partialHash(index) = files.hash(index);
+                } else {
+                    missing.push_back(index);
+                }
+            }
+        }
+        if (!requestDigests(missing, true, partialStage)) {
+            return false;
+        }
+        partialStage.seconds = std::chrono::duration<double>(Clock::now() - stageStarted).count();
+        statistics.stages.push_back(partialStage);
+    }
+
+    StageStatistics fullStage;
+    fullStage.name = "Full hash";
+    stageStarted = Clock::now();
+    const std::vector<size_t> unhashed = crossHostCandidates(candidates, byPartial);
+    if (byPartial) {
+        statistics.stages.back().candidatesRemoved = candidates.size() - unhashed.size();
+    }
+    fullStage.candidatesIn = unhashed.size();
+    if (!requestDigests(unhashed, false, fullStage)) {
+        return false;
+    }
+    fullStage.seconds = std::chrono::duration<double>(Clock::now() - stageStarted).count();
+
+    StageStatistics groupStage;
+    groupStage.name = "Grouping";
+    stageStarted = Clock::now();
+    std::vector<size_t> hashed;
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (!files.hash(index).empty()) {
+            hashed.push_back(index);
+        }
+    }
+    WorkerPool pool(options.threadCount);
+    GroupingEngine engine(pool, options.groupingMemoryBudget);
+    engine.group(files, hashed, groups);
+    groups.sort(options.groupOrder);
+    groupStage.candidatesIn = hashed.size();
+    groupStage.candidatesRemoved = hashed.size() - groups.fileCount();
+    groupStage.workers = pool.size();
+    groupStage.seconds = std::chrono::duration<double>(Clock::now() - stageStarted).count();
+
+    // Full-hash candidates that joined no group were only read to rule them out
+    std::vector<char> grouped(files.size(), 0);
+    for (const FileGroup& group : groups) {
+        for (size_t index : group) {
+            grouped[index] = 1;
+        }
+    }
+    for (size_t index : unhashed) {
+        fullStage.candidatesRemoved += grouped[index] ? 0 : 1;
+    }
+    statistics.stages.push_back(fullStage);
+    statistics.stages.push_back(groupStage);
+
+    statistics.filesWalked = files.size();
+    statistics.bytesWalked = files.totalBytes();
+    statistics.duplicateGroups = groups.size();
+    for (size_t g = 0; g < groups.size(); ++g) {
+        statistics.duplicateBytes += groups.fileSize(g) * (groups[g].size() - 1);
+    }
+    statistics.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    return true;
+}
+
+bool ScanCoordinator::connectAll() {
+    connections.clear();
+    for (const auto& address : options.agents) {
+        auto connection = std::make_unique<Connection>();
+        connection->address = address;
+        connection->number = connections.size() + 1;
+        std::string host;
+        std::string port;
+        splitAddress(address, host, port, false);
+        connection->label = host;
+
+#ifndef _WIN32
+        std::string error;
+        const int fd = connectTo(address, error);
+        if (fd < 0) {
+            std::cerr << "Unable to reach agent " << address << ": " << error << std::endl;
+            return false;
+        }
+        connection->socket = std::make_unique<LineSocket>(fd);
+#else
+        std::cerr << "Distributed scans require POSIX sockets" << std::endl;
+        return false;
+#endif
+        std::string greeting;
+        if (!connection->socket->readLine(greeting) || greeting.compare(0, 12, "DUPFINDER 1 ") != 0) {
+            std::cerr << "Agent " << address << " did not answer as a dupfinder agent" << std::endl;
+            return false;
+        }
+        if (!options.token.empty()) {
+            std::string reply;
+            connection->socket->writeLine("AUTH " + options.token);
+            if (!connection->socket->flush() || !connection->socket->readLine(reply) || reply != "OK") {
+                std::cerr << "Agent " << address << " refused the token"
+                          << (reply.empty() ? std::string() : ": " + reply) << std::endl;
+                return false;
+            }
+        }
+        connections.push_back(std::move(connection));
+    }
+
+    // Paths carry the host name, or the whole address when one host runs several agents
+    std::unordered_map<std::string, size_t> agentsOnHost;
+    for (const auto& connection : connections) {
+        agentsOnHost[connection->label]++;
+    }
+    for (auto& connection : connections) {
+        if (agentsOnHost[connection->label] > 1) {
+            connection->label = connection->address;
+        }
+    }
+    return true;
+}
+
+bool ScanCoordinator::receiveScan(Connection& connection) {
+    LineSocket& socket = *connection.socket;
+    socket.writeLine(std::string("SCAN ") + algorithmKey(options.algorithm) + " " +
+                     std::to_string(options.partialHashWindow));
+    if (!socket.flush()) {
+        connection.error = "connection lost";
+        return false;
+    }
+
+    std::string line;
+    std::string command;
+    std::string rest;
+    std::string directory;
+    while (socket.readLine(line)) {
+        splitCommand(line, command, rest);
+        if (command == "D") {
+            directory = unescapePath(rest);
+        } else if (command == "F") {
+            // The name is last, so it may hold spaces
+            std::string sizeText;
+            std::string partialText;
+            std::string fullText;
+            std::string name;
+            splitCommand(rest, sizeText, rest);
+            splitCommand(rest, partialText, rest);
+            splitCommand(rest, fullText, name);
+            std::uintmax_t size = 0;
+            Digest partialDigest;
+            Digest fullDigest;
+            if (!parseNumber(sizeText, size) || !parseDigestField(partialText, partialDigest) ||
+                !parseDigestField(fullText, fullDigest) || name.empty()) {
+                connection.error = "malformed record: " + line;
+                return false;
+            }
+            const size_t index = connection.files.add(directory + unescapePath(name), size, 0, connection.number, 0);
+            connection.files.partialHash(index) = partialDigest;
+            connection.files.hash(index) = fullDigest;
+        } else if (command == "END") {
+            std::string countText;
+            std::string bytesText;
+            splitCommand(rest, countText, bytesText);
+            std::uintmax_t count = 0;
+            if (!parseNumber(countText, count) || count != connection.files.size() ||
+                !parseNumber(bytesText, connection.bytesRead)) {
+                connection.error = "record count does not match";
+                return false;
+            }
+            return true;
+        } else if (command == "ERR") {
+            connection.error = rest;
+            return false;
+        } else {
+            connection.error = "unexpected reply: " + line;
+            return false;
+        }
+    }
+    connection.error = "connection lost during the scan";
+    return false;
+}
+
+void ScanCoordinator::mergeTables() {
+    for (auto& connection : connections) {
+        const FileTable& received = connection->files;
+        const std::string prefix = connection->label + ":";
+        for (size_t i = 0; i < received.size(); ++i) {
+            const size_t index = files.add(prefix + received.path(i), received.fileSize(i), 0, connection->number, 0);
+            files.partialHash(index) = received.partialHash(i);
+            files.hash(index) = received.hash(i);
+        }
+        connection->files.clear();
+    }
+}
+
+namespace {
+
+// Size and digest of one file; the digest is empty when only the size is compared
+struct ContentKey {
+    std::uintmax_t size;
+    Digest digest;
+    bool operator==(const ContentKey& other) const { return size == other.size && digest == other.digest; }
+};
+struct ContentKeyHash {
+    size_t operator()(const ContentKey& key) const {
+        return DigestHash()(key.digest) ^ std::hash<std::uintmax_t>()(key.size);
+    }
+};
+
+// Agent of the first file with a key, or 0 once a second agent has it too
+template <typename Key, typename Hash>
+void noteHost(std::unordered_map<Key, std::uint64_t, Hash>& hosts, const Key& key, std::uint64_t host) {
+    auto inserted = hosts.emplace(key, host);
+    if (!inserted.second && inserted.first->second != host) {
+        inserted.first->second = 0;
+    }
+}
+
+} // namespace
+
+std::vector<size_t> ScanCoordinator::crossHostSizes() const {
+    std::unordered_map<std::uintmax_t, std::uint64_t, std::hash<std::uintmax_t>> hosts;
+    for (size_t index = 0; index < files.size(); ++index) {
+        noteHost(hosts, files.fileSize(index), files.device(index));
+    }
+    std::vector<size_t> candidates;
+    for (size_t index = 0; index < files.size(); ++index) {
+        if (hosts[files.fileSize(index)] == 0) {
+            candidates.push_back(index);
+        }
+    }
+    return candidates;
+}
+
+std::vector<size_t> ScanCoordinator::crossHostCandidates(const std::vector<size_t>& candidates, bool byPartial) const {
+    // Keys held by one agent only were settled by that agent's own pipeline
+    std::unordered_map<ContentKey, std::uint64_t, ContentKeyHash> hosts;
+    for (size_t index : candidates) {
+        if (byPartial && files.partialHash(index).empty()) {
+            continue;
+        }
+        noteHost(hosts, ContentKey{ files.fileSize(index), byPartial ? files.partialHash(index) : Digest() },
+                 files.device(index));
+    }
+    std::vector<size_t> unhashed;
+    for (size_t index : candidates) {
+        if (!files.hash(index).empty() || (byPartial && files.partialHash(index).empty())) {
+            continue;
+        }
+        auto key = hosts.find(ContentKey{ files.fileSize(index), byPartial ? files.partialHash(index) : Digest() });
+        if (key != hosts.end() && key->second == 0) {
+            unhashed.push_back(index);
+        }
+    }
+    return unhashed;
+}
+
+bool ScanCoordinator::requestDigests(const std::vector<size_t>& indices, bool partial, StageStatistics& stage) {
+    std::vector<std::vector<size_t>> byAgent(connections.size());
+    for (size_t index : indices) {
+        byAgent[files.device(index) - 1].push_back(index);
+    }
+    const std::uintmax_t window = options.partialHashWindow;
+    const bool ok = forEachConnection([&](Connection& connection) {
+        const std::vector<size_t>& mine = byAgent[connection.number - 1];
+        const size_t prefixLength = connection.label.size() + 1;
+        LineSocket& socket = *connection.socket;
+        connection.requestBytes = 0;
+        for (size_t first = 0; first < mine.size(); first += MAX_BATCH) {
+            const size_t count = std::min(MAX_BATCH, mine.size() - first);
+            socket.writeLine((partial ? "PARTIAL " : "HASH ") + std::to_string(count));
+            for (size_t i = first; i < first + count; ++i) {
+                socket.writeLine(escapePath(files.path(mine[i]).substr(prefixLength)));
+            }
+            if (!socket.flush()) {
+                connection.error = "connection lost";
+                return false;
+            }
+            // Each task writes only its own agent's rows
+            std::string line;
+            for (size_t i = first; i < first + count; ++i) {
+                if (!socket.readLine(line)) {
+                    connection.error = "connection lost while hashing";
+                    return false;
+                }
+                const size_t index = mine[i];
+                Digest digest;
+                if (line.compare(0, 3, "OK ") == 0 && Digest::fromHex(line.substr(3), digest)) {
+                    (partial ? files.partialHash(index) : files.hash(index)) = digest;
+                    connection.requestBytes += partial ? std::min<std::uintmax_t>(files.fileSize(index), 2 * window)
+                                                       : files.fileSize(index);
+                } else {
+                    connection.fileErrors.push_back("Error hashing file " + files.path(index) + ": " +
+                                                    (line.compare(0, 4, "ERR ") == 0 ? line.substr(4) : line));
+                }
+            }
+        }
+        return true;
+    });
+    for (const auto& connection : connections) {
+        stage.bytesRead += connection->requestBytes;
+    }
+    stage.workers = connections.size();
+    return ok;
+}
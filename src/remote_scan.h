@@ -0,0 +1,159 @@
+#ifndef REMOTE_SCAN_H
+#define REMOTE_SCAN_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "file_scanner.h"
+
+// Buffered newline-delimited I/O over a connected socket, shared by both ends of a
+// distributed scan. The socket is closed with the object.
+class LineSocket {
+public:
+    // A wait interrupted by a signal gives up once stop is set
+    explicit LineSocket(int fd, const std::atomic<bool>* stop = nullptr) : fd(fd), stop(stop) {}
+    ~LineSocket();
+
+    LineSocket(const LineSocket&) = delete;
+    LineSocket& operator=(const LineSocket&) = delete;
+
+    // Next line without its terminator; false at the end of the stream, on errors and on
+    // lines too long to be part of the protocol
+    bool readLine(std::string& line);
+    // Queue a line; the buffer is sent when it fills and on flush
+    void writeLine(const std::string& line);
+    bool flush();
+    // Reads and writes fail after waiting this long for the peer; -1 waits forever
+    void setTimeout(int milliseconds) { timeoutMs = milliseconds; }
+
+    std::uintmax_t bytesReceived() const { return received; }
+
+private:
+    int fd;
+    const std::atomic<bool>* stop;
+    int timeoutMs = -1;
+    std::string input;
+    size_t inputStart = 0;
+    std::string output;
+    bool failed = false;
+    std::uintmax_t received = 0;
+};
+
+struct AgentOptions {
+    std::vector<std::string> roots;
+    bool recursive = true;
+    // Pipeline settings of every local scan; the coordinator picks the algorithm and the
+    // partial hash window, which must match across hosts
+    ScanOptions scanOptions;
+    std::string listenAddress;      // [HOST:]PORT; 127.0.0.1 when HOST is left out
+    std::string token;              // Non-empty: coordinators must send it in AUTH first
+};
+
+// Scan agent for distributed runs. Each request from a coordinator runs the walk and the
+// hashing stages over the local roots, with local cores and disks, then streams one compact
+// record per file: size, head/tail digest and full digest when the local pipeline computed
+// them, and the path. Digests of files that only the merge across hosts made candidates
+// are computed on request. One coordinator is served at a time, over TCP:
+//
+//   -> "DUPFINDER 1 <hostname>" on connect
+//   AUTH <token>                        -> "OK", or "ERR ..." and the connection closes;
+//                                          first and required when the agent has a token
+//   SCAN <algorithm> <partial window>   -> "D <directory>" before the files of each directory,
+//                                          "F <size> <partial hex|-> <full hex|-> <name>",
+//                                          then "END <files> <bytes read>"
+//   PARTIAL <n> / HASH <n>, n path lines -> n lines of "OK <hex>" or "ERR <message>"
+//
+// Paths are escaped with \\, \n and \r. Only files of the last scan are hashed on request.
+// A bare PORT listens on loopback only. The token is sent in the clear, so it keeps stray
+// clients out but does not protect against anyone who can watch the network. A peer that
+// stalls inside a request, or sends nothing after connecting, is dropped after a timeout.
+// POSIX only.
+class ScanAgent {
+public:
+    explicit ScanAgent(const AgentOptions& options);
+    ~ScanAgent();
+
+    ScanAgent(const ScanAgent&) = delete;
+    ScanAgent& operator=(const ScanAgent&) = delete;
+
+    // Serve coordinators until SIGINT or SIGTERM; returns the process exit code
+    int run();
+
+private:
+    AgentOptions options;
+    int listenFd = -1;
+    std::unique_ptr<WorkerPool> pool;
+    // Size of every file of the last scan by path, which also limits what may be hashed
+    std::unordered_map<std::string, std::uintmax_t> scannedSizes;
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    std::size_t partialWindow = 0;
+
+    bool openListener();
+    bool authenticate(LineSocket& session);
+    // Answer one coordinator's requests until it disconnects
+    void serve(LineSocket& session);
+    // Handlers return false when the connection cannot go on
+    bool scan(LineSocket& session, const std::string& arguments);
+    bool hashBatch(LineSocket& session, const std::string& arguments, bool partial);
+};
+
+struct CoordinatorOptions {
+    std::vector<std::string> agents;    // HOST:PORT of each agent
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    std::size_t partialHashWindow = 4096;
+    GroupOrder groupOrder = GroupOrder::WASTED_BYTES;
+    std::size_t groupingMemoryBudget = 256 * 1024 * 1024;
+    size_t threadCount = 0;     // Grouping threads; 0 uses one per hardware thread
+    std::string token;          // Sent to every agent in AUTH when not empty
+};
+
+// Merges the scans of several agents into one duplicate report without moving file contents.
+// Every agent scans at once; their records go into one table, with each path prefixed by
+// its host. Only sizes found on more than one host can hide duplicates the agents did not
+// see themselves, so only those files get head/tail digests, and then full digests where a
+// head/tail digest is shared across hosts; each is computed by the agent holding the file.
+// The hashed files are grouped by (size, digest) with the sort-based grouping engine.
+class ScanCoordinator {
+public:
+    explicit ScanCoordinator(const CoordinatorOptions& options);
+    ~ScanCoordinator();
+
+    ScanCoordinator(const ScanCoordinator&) = delete;
+    ScanCoordinator& operator=(const ScanCoordinator&) = delete;
+
+    // Run the distributed scan; false with a message on stderr when an agent failed
+    bool run();
+
+    // Every file of every agent, as "<host>:<path>"; device holds the agent's 1-based number
+    const FileTable& getFiles() const { return files; }
+    const GroupList& getGroups() const { return groups; }
+    // Stages are the agents' scans, the cross-host hashes and the grouping
+    const ScanStatistics& getStatistics() const { return statistics; }
+
+private:
+    struct Connection;
+
+    CoordinatorOptions options;
+    std::vector<std::unique_ptr<Connection>> connections;
+    FileTable files;
+    GroupList groups;
+    ScanStatistics statistics;
+
+    bool connectAll();
+    // Run fn for every connection on a thread of its own; false if any call failed
+    template <typename Function>
+    bool forEachConnection(Function fn);
+    bool receiveScan(Connection& connection);
+    void mergeTables();
+    // Candidates of the head/tail digest stage: files of sizes seen on more than one host
+    std::vector<size_t> crossHostSizes() const;
+    // Files that share a key with a file of another host and still lack a full digest
+    std::vector<size_t> crossHostCandidates(const std::vector<size_t>& candidates, bool byPartial) const;
+    // Ask each file's agent for its digest, in batches; files that fail keep no digest
+    bool requestDigests(const std::vector<size_t>& indices, bool partial, StageStatistics& stage);
+};
+
+#endif // REMOTE_SCAN_H
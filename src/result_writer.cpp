@@ -0,0 +1,170 @@
+#include "result_writer.h"
+
+namespace {
+
+const size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+} // namespace
+
+ResultWriter::ResultWriter(std::FILE* out, OutputFormat format) : out(out), format(format) {
+    buffer.reserve(WRITE_BUFFER_SIZE);
+}
+
+ResultWriter::~ResultWriter() {
+    flush();
+}
+
+void ResultWriter::writeGroup(const ResultGroup& group) {
+    if (format == OutputFormat::JSONL) {
+        buffer += "{\"group\":";
+        buffer += std::to_string(group.id);
+        buffer += ",\"size\":";
+        buffer += std::to_string(group.size);
+        buffer += ",\"hash\":";
+        appendJsonString(group.hash);
+        buffer += ",\"files\":[";
+        for (size_t i = 0; i < group.files.size(); ++i) {
+            const ResultFile& file = group.files[i];
+            buffer += i == 0 ? "{\"path\":" : ",{\"path\":";
+            appendJsonString(file.path);
+            buffer += ",\"action\":";
+            appendJsonString(file.action);
+            if (!file.status.empty()) {
+                buffer += ",\"status\":";
+                appendJsonString(file.status);
+            }
+            buffer += '}';
+        }
+        buffer += "]}\n";
+    } else {
+        if (!headerWritten) {
+            buffer += "group,size,hash,path,action,status\n";
+            headerWritten = true;
+        }
+        for (const auto& file : group.files) {
+            buffer += std::to_string(group.id);
+            buffer += ',';
+            buffer += std::to_string(group.size);
+            buffer += ',';
+            buffer += group.hash;
+            buffer += ',';
+            appendCsvField(file.path);
+            buffer += ',';
+            buffer += file.action;
+            buffer += ',';
+            buffer += file.status;
+            buffer += '\n';
+        }
+    }
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void ResultWriter::writeSimilarity(const ResultSimilarity& similarity) {
+    char ratio[32];
+    std::snprintf(ratio, sizeof(ratio), "%.4f", similarity.ratio);
+    if (format == OutputFormat::JSONL) {
+        buffer += "{\"similar\":";
+        buffer += std::to_string(similarity.id);
+        buffer += ",\"shared_bytes\":";
+        buffer += std::to_string(similarity.sharedBytes);
+        buffer += ",\"ratio\":";
+        buffer += ratio;
+        buffer += ",\"files\":[{\"path\":";
+        appendJsonString(similarity.firstPath);
+        buffer += ",\"size\":";
+        buffer += std::to_string(similarity.firstSize);
+        buffer += "},{\"path\":";
+        appendJsonString(similarity.secondPath);
+        buffer += ",\"size\":";
+        buffer += std::to_string(similarity.secondSize);
+        buffer += "}]}\n";
+    } else {
+        if (!similarityHeaderWritten) {
+            buffer += "similar,shared_bytes,ratio,path,size\n";
+            similarityHeaderWritten = true;
+        }
+        const std::string prefix = std::to_string(similarity.id) + ',' + std::to_string(similarity.sharedBytes) +
+                                   ',' + ratio + ',';
+        buffer += prefix;
+        appendCsvField(similarity.firstPath);
+        buffer += ',';
+        buffer += std::to_string(similarity.firstSize);
+        buffer += '\n';
+        buffer += prefix;
+        appendCsvField(similarity.secondPath);
+        buffer += ',';
+        buffer += std::to_string(similarity.secondSize);
+        buffer += '\n';
+    }
+
+    if (buffer.size() >= WRITE_BUFFER_SIZE) {
+        flush();
+    }
+}
+
+bool ResultWriter::flush() {
+    if (!buffer.empty()) {
+        if (std::fwrite(buffer.data(), 1, buffer.size(), out) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+    }
+    if (std::fflush(out) != 0) {
+        failed = true;
+    }
+    return !failed;
+}
+
+bool ResultWriter::parseFormat(const std::string& name, OutputFormat& format) {
+    if (name == "jsonl" || name == "json") {
+        format = OutputFormat::JSONL;
+    } else if (name == "csv") {
+        format = OutputFormat::CSV;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void ResultWriter::appendJsonString(const std::string& value) {
+    static const char HEX[] = "0123456789abcdef";
+    buffer += '"';
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    buffer += "\\u00";
+                    buffer += HEX[c >> 4];
+                    buffer += HEX[c & 0xf];
+                } else {
+                    buffer += static_cast<char>(c);
+                }
+                break;
+        }
+    }
+    buffer += '"';
+}
+
+// RFC 4180 quoting, only when the field needs it
+void ResultWriter::appendCsvField(const std::string& value) {
+    if (value.find_first_of(",\"\r\n") == std::string::npos) {
+        buffer += value;
+        return;
+    }
+    buffer += '"';
+    for (char c : value) {
+        if (c == '"') {
+            buffer += '"';
+        }
+        buffer += c;
+    }
+    buffer += '"';
+}
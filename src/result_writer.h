@@ -0,0 +1,72 @@
+#ifndef RESULT_WRITER_H
+#define RESULT_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+enum class OutputFormat {
+    JSONL,  // One JSON object per duplicate group
+    CSV     // One row per file
+};
+
+// One member of a reported group and what was done with it
+struct ResultFile {
+    std::string path;
+    std::string action;         // "keep", "duplicate", "delete", "move" or "hardlink";
+                                // "linked" for a symbolic link or a hard link to the kept file, left alone
+    std::string status;         // "ok" or "failed"; empty when no action ran
+};
+
+struct ResultGroup {
+    size_t id = 0;
+    std::uintmax_t size = 0;
+    std::string hash;
+    std::vector<ResultFile> files;
+};
+
+// Two near-duplicate files and how much of their content they share
+struct ResultSimilarity {
+    size_t id = 0;
+    std::uintmax_t sharedBytes = 0;
+    double ratio = 0;
+    std::string firstPath;
+    std::uintmax_t firstSize = 0;
+    std::string secondPath;
+    std::uintmax_t secondSize = 0;
+};
+
+// Writes machine-readable results through a private buffer; the stream is only written
+// when the buffer fills and on flush, never per record.
+class ResultWriter {
+public:
+    // out is borrowed; pass stdout or a file opened by the caller
+    ResultWriter(std::FILE* out, OutputFormat format);
+    ~ResultWriter();
+
+    ResultWriter(const ResultWriter&) = delete;
+    ResultWriter& operator=(const ResultWriter&) = delete;
+
+    void writeGroup(const ResultGroup& group);
+    // In CSV, pairs are rows of their own table, after the groups under a second header
+    void writeSimilarity(const ResultSimilarity& similarity);
+
+    // Push buffered records to the stream; false if the write failed
+    bool flush();
+
+    static bool parseFormat(const std::string& name, OutputFormat& format);
+
+private:
+    std::FILE* out;
+    OutputFormat format;
+    std::string buffer;
+    bool headerWritten = false;
+    bool similarityHeaderWritten = false;
+    bool failed = false;
+
+    void appendJsonString(const std::string& value);
+    void appendCsvField(const std::string& value);
+};
+
+#endif // RESULT_WRITER_H
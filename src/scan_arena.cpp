@@ -0,0 +1,48 @@
+#include "scan_arena.h"
+#include <algorithm>
+
+namespace {
+
+// Blocks stop doubling here; a scan of a few hundred million files needs only dozens of them
+const std::size_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+} // namespace
+
+ScanArena::ScanArena(std::size_t firstBlockSize)
+    : firstBlockSize(std::max<std::size_t>(firstBlockSize, 4096)), nextBlockSize(this->firstBlockSize) {}
+
+ScanArena::~ScanArena() {
+    release();
+}
+
+void ScanArena::release() {
+    for (void* block : blocks) {
+        ::operator delete(block);
+    }
+    blocks.clear();
+    cursor = nullptr;
+    end = nullptr;
+    nextBlockSize = firstBlockSize;
+    reservedBytes = 0;
+}
+
+void* ScanArena::allocateSlow(std::size_t bytes, std::size_t alignment) {
+    // A request too large to share a block, such as a bucket array, gets one of its own and
+    // leaves the current block open for the small ones
+    const std::size_t needed = bytes + alignment;
+    const bool dedicated = needed > nextBlockSize / 2;
+    const std::size_t size = dedicated ? needed : nextBlockSize;
+    blocks.reserve(blocks.size() + 1);
+    char* block = static_cast<char*>(::operator new(size));
+    blocks.push_back(block);
+    reservedBytes += size;
+
+    const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(block) + alignment - 1) &
+                                   ~static_cast<std::uintptr_t>(alignment - 1);
+    if (!dedicated) {
+        cursor = reinterpret_cast<char*>(aligned + bytes);
+        end = block + size;
+        nextBlockSize = std::min(nextBlockSize * 2, MAX_BLOCK_SIZE);
+    }
+    return reinterpret_cast<void*>(aligned);
+}
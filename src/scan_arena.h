@@ -0,0 +1,100 @@
+#ifndef SCAN_ARENA_H
+#define SCAN_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <scoped_allocator>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Monotonic memory for the lookups that live exactly as long as one scan. Allocation bumps a
+// pointer through blocks that double in size, nothing is freed one object at a time, and
+// release() hands every block back at once, so millions of map nodes cost a few dozen large
+// allocations and leave no fragmented heap behind. Not thread-safe: only the thread that
+// drives the scan, or the walker callback it serializes, allocates from it.
+class ScanArena {
+public:
+    explicit ScanArena(std::size_t firstBlockSize = 256 * 1024);
+    ~ScanArena();
+
+    ScanArena(const ScanArena&) = delete;
+    ScanArena& operator=(const ScanArena&) = delete;
+
+    void* allocate(std::size_t bytes, std::size_t alignment) {
+        const std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(cursor) + alignment - 1) &
+                                       ~static_cast<std::uintptr_t>(alignment - 1);
+        if (cursor && aligned + bytes <= reinterpret_cast<std::uintptr_t>(end)) {
+            cursor = reinterpret_cast<char*>(aligned + bytes);
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocateSlow(bytes, alignment);
+    }
+
+    // Free every block; whatever was allocated from the arena must already be destroyed
+    void release();
+
+    // Bytes of blocks currently held
+    std::size_t reserved() const { return reservedBytes; }
+    std::size_t blockCount() const { return blocks.size(); }
+
+private:
+    std::vector<void*> blocks;
+    char* cursor = nullptr;
+    char* end = nullptr;
+    std::size_t firstBlockSize;
+    std::size_t nextBlockSize;
+    std::size_t reservedBytes = 0;
+
+    void* allocateSlow(std::size_t bytes, std::size_t alignment);
+};
+
+// Standard allocator over a ScanArena; deallocate is a no-op until the arena is released
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator(ScanArena& arena) noexcept : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(std::size_t count) {
+        if (count > static_cast<std::size_t>(-1) / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, std::size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    ScanArena* arena;
+};
+
+// Containers on the arena. The scoped adaptor hands the arena on to containers stored as
+// values, so an ArenaVector inside an ArenaMap allocates from it too.
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+using ArenaMap = std::unordered_map<Key, Value, Hash, Equal,
+                                    std::scoped_allocator_adaptor<ArenaAllocator<std::pair<const Key, Value>>>>;
+
+template <typename Key, typename Hash = std::hash<Key>, typename Equal = std::equal_to<Key>>
+using ArenaSet = std::unordered_set<Key, Hash, Equal, ArenaAllocator<Key>>;
+
+#endif // SCAN_ARENA_H
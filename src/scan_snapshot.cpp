@@ -0,0 +1,251 @@
+#include "scan_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[4] = { 'D', 'F', 'S', 'S' };
+const std::uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    std::uint8_t algorithm;
+    std::uint8_t verification;
+    std::uint64_t partialHashWindow;
+    std::uint64_t directoryCount;
+    std::uint64_t fileCount;
+    std::uint64_t groupCount;
+};
+
+struct DirectoryHeader {
+    std::int64_t mtime;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::int64_t listedAt;
+    std::uint32_t pathLength;
+    std::uint32_t entryCount;
+};
+
+struct FileHeader {
+    std::uint64_t size;
+    std::int64_t mtime;
+    std::uint64_t device;
+    std::uint64_t inode;
+    std::uint32_t pathLength;
+    std::uint8_t hashLength;
+    std::uint8_t partialHashLength;
+};
+
+template <typename T>
+bool readValue(std::ifstream& file, T& value) {
+    file.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return static_cast<bool>(file);
+}
+
+template <typename T>
+void writeValue(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool readString(std::ifstream& file, std::string& value, size_t length) {
+    value.resize(length);
+    file.read(&value[0], static_cast<std::streamsize>(length));
+    return static_cast<bool>(file);
+}
+
+bool readDigest(std::ifstream& file, Digest& digest, std::uint8_t length) {
+    if (length > digest.bytes.size()) {
+        return false;
+    }
+    file.read(reinterpret_cast<char*>(digest.bytes.data()), length);
+    digest.length = length;
+    return static_cast<bool>(file);
+}
+
+// Entry names are short; the top bit of the length marks a subdirectory
+const std::uint16_t DIRECTORY_FLAG = 0x8000;
+
+bool readListing(std::ifstream& file, DirectoryListing& listing, std::uint32_t count) {
+    listing.entries.resize(count);
+    for (auto& entry : listing.entries) {
+        std::uint16_t length = 0;
+        if (!readValue(file, length) || !readString(file, entry.name, length & ~DIRECTORY_FLAG)) {
+            return false;
+        }
+        entry.directory = (length & DIRECTORY_FLAG) != 0;
+    }
+    return true;
+}
+
+void writeListing(std::ofstream& file, const DirectoryListing& listing) {
+    for (const auto& entry : listing.entries) {
+        std::uint16_t length = static_cast<std::uint16_t>(std::min<size_t>(entry.name.size(), DIRECTORY_FLAG - 1));
+        writeValue(file, static_cast<std::uint16_t>(length | (entry.directory ? DIRECTORY_FLAG : 0)));
+        file.write(entry.name.data(), length);
+    }
+}
+
+} // namespace
+
+ScanSnapshot::ScanSnapshot(const std::string& snapshotPath) : snapshotPath(snapshotPath) {}
+
+bool ScanSnapshot::load() {
+    directories.clear();
+    files.clear();
+    groups.clear();
+
+    std::ifstream file(snapshotPath, std::ios::binary);
+    if (!file) {
+        return true;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    SnapshotHeader header = {};
+    file.read(magic, sizeof(magic));
+    if (!file || std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file, version) || version != SNAPSHOT_VERSION || !readValue(file, header)) {
+        std::cerr << "Ignoring unreadable scan snapshot: " << snapshotPath << std::endl;
+        return false;
+    }
+    algorithm = static_cast<HashAlgorithm>(header.algorithm);
+    verification = header.verification;
+    partialHashWindow = header.partialHashWindow;
+
+    auto corrupt = [this]() {
+        std::cerr << "Corrupt scan snapshot: " << snapshotPath << std::endl;
+        directories.clear();
+        files.clear();
+        groups.clear();
+        return false;
+    };
+
+    for (std::uint64_t i = 0; i < header.directoryCount; ++i) {
+        DirectoryHeader record;
+        std::string path;
+        SnapshotDirectory directory;
+        if (!readValue(file, record) || !readString(file, path, record.pathLength) ||
+            !readListing(file, directory.listing, record.entryCount)) {
+            return corrupt();
+        }
+        directory.stamp.mtime = record.mtime;
+        directory.stamp.device = record.device;
+        directory.stamp.inode = record.inode;
+        directory.stamp.listedAt = record.listedAt;
+        directories.emplace(std::move(path), std::move(directory));
+    }
+
+    std::string path;
+    for (std::uint64_t i = 0; i < header.fileCount; ++i) {
+        FileHeader record;
+        Digest hash;
+        Digest partialHash;
+        if (!readValue(file, record) || !readString(file, path, record.pathLength) ||
+            !readDigest(file, hash, record.hashLength) || !readDigest(file, partialHash, record.partialHashLength)) {
+            return corrupt();
+        }
+        size_t index = files.add(path, record.size, record.mtime, record.device, record.inode);
+        files.hash(index) = hash;
+        files.partialHash(index) = partialHash;
+    }
+    files.buildLookup();
+
+    std::vector<size_t> members;
+    for (std::uint64_t i = 0; i < header.groupCount; ++i) {
+        std::uint64_t fileSize = 0;
+        std::uint64_t count = 0;
+        if (!readValue(file, fileSize) || !readValue(file, count) || count > files.size()) {
+            return corrupt();
+        }
+        members.resize(static_cast<size_t>(count));
+        for (auto& member : members) {
+            std::uint64_t row = 0;
+            if (!readValue(file, row) || row >= files.size()) {
+                return corrupt();
+            }
+            member = static_cast<size_t>(row);
+        }
+        groups.add(members, fileSize);
+    }
+    return true;
+}
+
+bool ScanSnapshot::save(const FileTable& scannedFiles, const GroupList& duplicateGroups) const {
+    std::string tempPath = snapshotPath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Unable to write scan snapshot: " << tempPath << std::endl;
+            return false;
+        }
+
+        SnapshotHeader header = {};
+        header.algorithm = static_cast<std::uint8_t>(algorithm);
+        header.verification = verification;
+        header.partialHashWindow = partialHashWindow;
+        header.directoryCount = directories.size();
+        header.fileCount = scannedFiles.size();
+        header.groupCount = duplicateGroups.size();
+        file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        writeValue(file, SNAPSHOT_VERSION);
+        writeValue(file, header);
+
+        for (const auto& pair : directories) {
+            const SnapshotDirectory& directory = pair.second;
+            DirectoryHeader record = {};
+            record.mtime = directory.stamp.mtime;
+            record.device = directory.stamp.device;
+            record.inode = directory.stamp.inode;
+            record.listedAt = directory.stamp.listedAt;
+            record.pathLength = static_cast<std::uint32_t>(pair.first.size());
+            record.entryCount = static_cast<std::uint32_t>(directory.listing.entries.size());
+            writeValue(file, record);
+            file.write(pair.first.data(), record.pathLength);
+            writeListing(file, directory.listing);
+        }
+
+        for (size_t index = 0; index < scannedFiles.size(); ++index) {
+            const std::string path = scannedFiles.path(index);
+            const Digest& hash = scannedFiles.hash(index);
+            const Digest& partialHash = scannedFiles.partialHash(index);
+            FileHeader record = {};
+            record.size = scannedFiles.fileSize(index);
+            record.mtime = scannedFiles.mtime(index);
+            record.device = scannedFiles.device(index);
+            record.inode = scannedFiles.inode(index);
+            record.pathLength = static_cast<std::uint32_t>(path.size());
+            record.hashLength = hash.length;
+            record.partialHashLength = partialHash.length;
+            writeValue(file, record);
+            file.write(path.data(), record.pathLength);
+            file.write(reinterpret_cast<const char*>(hash.bytes.data()), hash.length);
+            file.write(reinterpret_cast<const char*>(partialHash.bytes.data()), partialHash.length);
+        }
+
+        for (size_t i = 0; i < duplicateGroups.size(); ++i) {
+            FileGroup group = duplicateGroups[i];
+            writeValue(file, static_cast<std::uint64_t>(duplicateGroups.fileSize(i)));
+            writeValue(file, static_cast<std::uint64_t>(group.size()));
+            for (size_t row : group) {
+                writeValue(file, static_cast<std::uint64_t>(row));
+            }
+        }
+
+        if (!file.flush()) {
+            std::cerr << "Unable to write scan snapshot: " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tempPath, snapshotPath, ec);
+    if (ec) {
+        std::cerr << "Unable to replace scan snapshot " << snapshotPath << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
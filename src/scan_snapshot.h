@@ -0,0 +1,44 @@
+#ifndef SCAN_SNAPSHOT_H
+#define SCAN_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "directory_walker.h"
+#include "file_table.h"
+#include "grouping_engine.h"
+#include "hash_calculator.h"
+
+// A directory as the previous scan saw it
+struct SnapshotDirectory {
+    DirectoryStamp stamp;
+    DirectoryListing listing;
+};
+
+// Everything a scan needs to redo only what changed: directory stamps and listings, the
+// file table with its digests, and the duplicate groups as rows of that table. Read at
+// the start of a scan and replaced atomically at its end.
+class ScanSnapshot {
+public:
+    explicit ScanSnapshot(const std::string& snapshotPath);
+
+    // Load the snapshot file; a missing file leaves the snapshot empty
+    bool load();
+
+    // Write directories and settings from this snapshot with the given scan results
+    bool save(const FileTable& scannedFiles, const GroupList& duplicateGroups) const;
+
+    // Settings the digests and groups were produced with
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    std::uint64_t partialHashWindow = 0;
+    std::uint8_t verification = 0;
+
+    std::unordered_map<std::string, SnapshotDirectory> directories;
+    FileTable files;
+    GroupList groups;
+
+private:
+    std::string snapshotPath;
+};
+
+#endif // SCAN_SNAPSHOT_H
@@ -0,0 +1,304 @@
+#include "sha256_multibuffer.h"
+#include <cstring>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_MULTIBUFFER_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const std::uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const std::uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const size_t MAX_LANES = 16;
+
+// Compresses one 64-byte block per lane. state holds word i of lane l at i * lanes + l,
+// blocks holds lane l's block at l * 64, and only lanes whose active entry is all ones
+// take the result.
+using Kernel = void (*)(std::uint32_t* state, const std::uint8_t* blocks, const std::uint32_t* active);
+
+#ifdef SHA256_MULTIBUFFER_X86
+
+__attribute__((target("avx2")))
+void compressAvx2(std::uint32_t* state, const std::uint8_t* blocks, const std::uint32_t* active) {
+#define ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+#define XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+    const __m256i byteSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                              3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i laneOffsets = _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112);
+    const int* words = reinterpret_cast<const int*>(blocks);
+
+    __m256i w[16];
+    for (int t = 0; t < 16; ++t) {
+        const __m256i gathered = _mm256_i32gather_epi32(words, _mm256_add_epi32(laneOffsets, _mm256_set1_epi32(t)), 4);
+        w[t] = _mm256_shuffle_epi8(gathered, byteSwap);
+    }
+    __m256i initial[8];
+    for (int i = 0; i < 8; ++i) {
+        initial[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state + i * 8));
+    }
+    __m256i a = initial[0], b = initial[1], c = initial[2], d = initial[3];
+    __m256i e = initial[4], f = initial[5], g = initial[6], h = initial[7];
+
+    for (int t = 0; t < 64; ++t) {
+        if (t >= 16) {
+            const __m256i w15 = w[(t - 15) & 15];
+            const __m256i w2 = w[(t - 2) & 15];
+            const __m256i s0 = XOR3(ROTR(w15, 7), ROTR(w15, 18), _mm256_srli_epi32(w15, 3));
+            const __m256i s1 = XOR3(ROTR(w2, 17), ROTR(w2, 19), _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        const __m256i sum1 = XOR3(ROTR(e, 6), ROTR(e, 11), ROTR(e, 25));
+        const __m256i choose = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_add_epi32(h, sum1), choose),
+                                            _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(ROUND_CONSTANTS[t])), w[t & 15]));
+        const __m256i sum0 = XOR3(ROTR(a, 2), ROTR(a, 13), ROTR(a, 22));
+        const __m256i majority = XOR3(_mm256_and_si256(a, b), _mm256_and_si256(a, c), _mm256_and_si256(b, c));
+        const __m256i t2 = _mm256_add_epi32(sum0, majority);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+
+    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(active));
+    const __m256i result[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; ++i) {
+        const __m256i updated = _mm256_add_epi32(initial[i], result[i]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state + i * 8), _mm256_blendv_epi8(initial[i], updated, mask));
+    }
+#undef ROTR
+#undef XOR3
+}
+
+// GCC 12's AVX-512 headers pass an uninitialized placeholder to the unmasked builtins
+// and warn about it once inlined here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+__attribute__((target("avx512f,avx512bw")))
+void compressAvx512(std::uint32_t* state, const std::uint8_t* blocks, const std::uint32_t* active) {
+#define XOR3(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+    const __m512i byteSwap = _mm512_set_epi8(
+        60, 61, 62, 63, 56, 57, 58, 59, 52, 53, 54, 55, 48, 49, 50, 51,
+        44, 45, 46, 47, 40, 41, 42, 43, 36, 37, 38, 39, 32, 33, 34, 35,
+        28, 29, 30, 31, 24, 25, 26, 27, 20, 21, 22, 23, 16, 17, 18, 19,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    const __m512i laneOffsets = _mm512_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240);
+    const int* words = reinterpret_cast<const int*>(blocks);
+
+    __m512i w[16];
+    for (int t = 0; t < 16; ++t) {
+        const __m512i gathered = _mm512_i32gather_epi32(_mm512_add_epi32(laneOffsets, _mm512_set1_epi32(t)), words, 4);
+        w[t] = _mm512_shuffle_epi8(gathered, byteSwap);
+    }
+    __m512i initial[8];
+    for (int i = 0; i < 8; ++i) {
+        initial[i] = _mm512_loadu_si512(state + i * 16);
+    }
+    __m512i a = initial[0], b = initial[1], c = initial[2], d = initial[3];
+    __m512i e = initial[4], f = initial[5], g = initial[6], h = initial[7];
+
+    for (int t = 0; t < 64; ++t) {
+        if (t >= 16) {
+            const __m512i w15 = w[(t - 15) & 15];
+            const __m512i w2 = w[(t - 2) & 15];
+            const __m512i s0 = XOR3(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18), _mm512_srli_epi32(w15, 3));
+            const __m512i s1 = XOR3(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19), _mm512_srli_epi32(w2, 10));
+            w[t & 15] = _mm512_add_epi32(_mm512_add_epi32(w[t & 15], s0), _mm512_add_epi32(w[(t - 7) & 15], s1));
+        }
+        const __m512i sum1 = XOR3(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25));
+        const __m512i choose = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+        const __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(_mm512_add_epi32(h, sum1), choose),
+                                            _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(ROUND_CONSTANTS[t])), w[t & 15]));
+        const __m512i sum0 = XOR3(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22));
+        const __m512i majority = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+        const __m512i t2 = _mm512_add_epi32(sum0, majority);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi32(t1, t2);
+    }
+
+    const __m512i flags = _mm512_loadu_si512(active);
+    const __mmask16 mask = _mm512_test_epi32_mask(flags, flags);
+    const __m512i result[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0; i < 8; ++i) {
+        const __m512i updated = _mm512_add_epi32(initial[i], result[i]);
+        _mm512_storeu_si512(state + i * 16, _mm512_mask_blend_epi32(mask, initial[i], updated));
+    }
+#undef XOR3
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+struct Dispatch {
+    Kernel kernel = nullptr;
+    size_t lanes = 0;
+    const char* name = "none";
+};
+
+#ifdef SHA256_MULTIBUFFER_X86
+bool hasShaExtensions() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29)) != 0;
+}
+#endif
+
+// Every kernel this CPU and build can run, including the empty one
+std::vector<Dispatch> runnableKernels() {
+    std::vector<Dispatch> kernels;
+#ifdef SHA256_MULTIBUFFER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        kernels.push_back(Dispatch{ compressAvx512, 16, "avx512" });
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back(Dispatch{ compressAvx2, 8, "avx2" });
+    }
+#endif
+    kernels.push_back(Dispatch());
+    return kernels;
+}
+
+// 16 lanes beat OpenSSL's SHA-NI path about twofold on small files; 8 lanes only beat its
+// generic code, so AVX2 is left out where the CPU has SHA-NI
+Dispatch selectKernel() {
+    Dispatch dispatch;
+#ifdef SHA256_MULTIBUFFER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        dispatch = Dispatch{ compressAvx512, 16, "avx512" };
+    } else if (__builtin_cpu_supports("avx2") && !hasShaExtensions()) {
+        dispatch = Dispatch{ compressAvx2, 8, "avx2" };
+    }
+#endif
+    return dispatch;
+}
+
+Dispatch& dispatch() {
+    static Dispatch selected = selectKernel();
+    return selected;
+}
+
+} // namespace
+
+size_t Sha256MultiBuffer::lanes() {
+    return dispatch().lanes;
+}
+
+const char* Sha256MultiBuffer::kernelName() {
+    return dispatch().name;
+}
+
+bool Sha256MultiBuffer::forceKernel(const char* name) {
+    if (!name) {
+        dispatch() = selectKernel();
+        return true;
+    }
+    for (const Dispatch& kernel : runnableKernels()) {
+        if (std::strcmp(kernel.name, name) == 0) {
+            dispatch() = kernel;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Sha256MultiBuffer::hash(const std::uint8_t* const* messages, const std::size_t* lengths, size_t count,
+                             Digest* digests) {
+    const Dispatch selected = dispatch();
+    const size_t lanes = selected.lanes;
+    if (count == 0 || count > lanes) {
+        return;
+    }
+
+    // Whole blocks are read from the message in place; the last one or two, holding the
+    // end of the message, the 0x80 marker and the bit length, are built per lane
+    alignas(64) std::uint32_t state[8 * MAX_LANES];
+    alignas(64) std::uint8_t tails[MAX_LANES][128];
+    alignas(64) std::uint8_t blocks[MAX_LANES * 64];
+    alignas(64) std::uint32_t active[MAX_LANES] = {};
+    std::size_t wholeBlocks[MAX_LANES] = {};
+    std::size_t totalBlocks[MAX_LANES] = {};
+    std::size_t longest = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            state[i * lanes + lane] = INITIAL_STATE[i];
+        }
+    }
+    std::memset(blocks, 0, sizeof(blocks));
+    for (size_t lane = 0; lane < count; ++lane) {
+        const std::size_t length = lengths[lane];
+        const std::size_t remainder = length % 64;
+        wholeBlocks[lane] = length / 64;
+        totalBlocks[lane] = (length + 9 + 63) / 64;
+        longest = totalBlocks[lane] > longest ? totalBlocks[lane] : longest;
+
+        std::uint8_t* tail = tails[lane];
+        std::memset(tail, 0, sizeof(tails[lane]));
+        if (remainder > 0) {
+            std::memcpy(tail, messages[lane] + wholeBlocks[lane] * 64, remainder);
+        }
+        tail[remainder] = 0x80;
+        const std::uint64_t bits = static_cast<std::uint64_t>(length) * 8;
+        std::uint8_t* end = tail + (totalBlocks[lane] - wholeBlocks[lane]) * 64;
+        for (int i = 1; i <= 8; ++i) {
+            end[-i] = static_cast<std::uint8_t>(bits >> (8 * (i - 1)));
+        }
+    }
+
+    for (std::size_t block = 0; block < longest; ++block) {
+        for (size_t lane = 0; lane < count; ++lane) {
+            if (block >= totalBlocks[lane]) {
+                active[lane] = 0;
+                continue;
+            }
+            const std::uint8_t* source = block < wholeBlocks[lane] ? messages[lane] + block * 64
+                                                                   : tails[lane] + (block - wholeBlocks[lane]) * 64;
+            std::memcpy(blocks + lane * 64, source, 64);
+            active[lane] = 0xffffffffu;
+        }
+        selected.kernel(state, blocks, active);
+    }
+
+    for (size_t lane = 0; lane < count; ++lane) {
+        Digest& digest = digests[lane];
+        digest.length = 32;
+        for (size_t i = 0; i < 8; ++i) {
+            const std::uint32_t word = state[i * lanes + lane];
+            digest.bytes[4 * i] = static_cast<std::uint8_t>(word >> 24);
+            digest.bytes[4 * i + 1] = static_cast<std::uint8_t>(word >> 16);
+            digest.bytes[4 * i + 2] = static_cast<std::uint8_t>(word >> 8);
+            digest.bytes[4 * i + 3] = static_cast<std::uint8_t>(word);
+        }
+    }
+}
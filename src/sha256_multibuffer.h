@@ -0,0 +1,28 @@
+#ifndef SHA256_MULTIBUFFER_H
+#define SHA256_MULTIBUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include "digest.h"
+
+// SHA-256 over several independent messages at once, one message per 32-bit SIMD lane, so
+// short messages keep the vector units busy instead of running one serial compression
+// chain each. The kernel is picked at runtime from the CPU: 16 lanes with AVX-512, 8 with
+// AVX2 unless the CPU has SHA-NI. Single messages, and CPUs without a kernel, are better
+// served by OpenSSL, which already uses SHA-NI or the ARMv8 crypto extensions where present.
+class Sha256MultiBuffer {
+public:
+    // Messages one call hashes in parallel; 0 when the CPU or the build has no kernel
+    static size_t lanes();
+    // Kernel in use, for logs: "avx512", "avx2" or "none"
+    static const char* kernelName();
+
+    // Test hook: run the named kernel instead of the CPU's pick, or return to the pick with
+    // nullptr. False when this CPU or build cannot run it. Not for use while others hash.
+    static bool forceKernel(const char* name);
+
+    // Hash count messages, at most lanes(), into digests; lengths may differ
+    static void hash(const std::uint8_t* const* messages, const std::size_t* lengths, size_t count, Digest* digests);
+};
+
+#endif // SHA256_MULTIBUFFER_H
@@ -0,0 +1,226 @@
+#include "size_partitioner.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const size_t RECORD_BYTES = 8 + 8 + 8 + 8 + 8 + 4 + 1;
+const size_t PARTITION_BUFFER_SIZE = 64 * 1024;
+const size_t PATH_BUFFER_SIZE = 1024 * 1024;
+// Records decoded at a time while splitting, so an oversized partition is never held whole
+const size_t SPLIT_CHUNK_RECORDS = 64 * 1024;
+
+std::FILE* openSpill() {
+    std::FILE* file = std::tmpfile();
+    if (!file) {
+        throw std::runtime_error("Unable to create a temporary spill file");
+    }
+    return file;
+}
+
+void writeAll(std::FILE* file, const std::string& data) {
+    if (!data.empty() && std::fwrite(data.data(), 1, data.size(), file) != data.size()) {
+        throw std::runtime_error("Unable to write a temporary spill file");
+    }
+}
+
+void seekTo(std::FILE* file, std::uint64_t offset) {
+#ifdef _WIN32
+    const int failed = ::_fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+    const int failed = ::fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    if (failed != 0) {
+        throw std::runtime_error("Unable to seek in a temporary spill file");
+    }
+}
+
+void encode(const SpilledFile& record, std::string& out) {
+    char bytes[RECORD_BYTES];
+    char* p = bytes;
+    std::memcpy(p, &record.size, 8);
+    std::memcpy(p + 8, &record.mtime, 8);
+    std::memcpy(p + 16, &record.device, 8);
+    std::memcpy(p + 24, &record.inode, 8);
+    std::memcpy(p + 32, &record.pathOffset, 8);
+    std::memcpy(p + 40, &record.pathLength, 4);
+    p[44] = record.symlink ? 1 : 0;
+    out.append(bytes, RECORD_BYTES);
+}
+
+void decode(const char* p, SpilledFile& record) {
+    std::memcpy(&record.size, p, 8);
+    std::memcpy(&record.mtime, p + 8, 8);
+    std::memcpy(&record.device, p + 16, 8);
+    std::memcpy(&record.inode, p + 24, 8);
+    std::memcpy(&record.pathOffset, p + 32, 8);
+    std::memcpy(&record.pathLength, p + 40, 4);
+    record.symlink = p[44] != 0;
+}
+
+// Decode up to limit records from the current position; returns how many were read
+size_t readRecords(std::FILE* file, std::vector<SpilledFile>& records, size_t limit) {
+    std::vector<char> bytes(limit * RECORD_BYTES);
+    const size_t read = std::fread(bytes.data(), 1, bytes.size(), file) / RECORD_BYTES;
+    const size_t first = records.size();
+    records.resize(first + read);
+    for (size_t i = 0; i < read; ++i) {
+        decode(bytes.data() + i * RECORD_BYTES, records[first + i]);
+    }
+    return read;
+}
+
+} // namespace
+
+SizePartitioner::SizePartitioner(size_t count) : partitions(count > 0 ? count : 1) {
+    paths = openSpill();
+}
+
+SizePartitioner::~SizePartitioner() {
+    for (auto& partition : partitions) {
+        if (partition.file) {
+            std::fclose(partition.file);
+        }
+    }
+    if (paths) {
+        std::fclose(paths);
+    }
+}
+
+size_t SizePartitioner::partitionOf(std::uint64_t size, unsigned level, size_t parts) {
+    // splitmix64 finalizer; the level changes the seed so a split separates what collided
+    std::uint64_t x = size + 0x9e3779b97f4a7c15ULL * (level + 1);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return static_cast<size_t>(x % parts);
+}
+
+void SizePartitioner::add(const WalkEntry& entry) {
+    SpilledFile record;
+    record.size = entry.size;
+    record.mtime = entry.mtime;
+    record.device = entry.device;
+    record.inode = entry.inode;
+    record.pathOffset = pathBytes;
+    record.pathLength = static_cast<std::uint32_t>(entry.path.size());
+    record.symlink = entry.symlink;
+
+    pathBuffer += entry.path;
+    pathBytes += entry.path.size();
+    if (pathBuffer.size() >= PATH_BUFFER_SIZE) {
+        flushPaths();
+    }
+    append(partitions[partitionOf(record.size, 0, partitions.size())], record);
+}
+
+void SizePartitioner::append(Partition& partition, const SpilledFile& record) {
+    encode(record, partition.buffer);
+    partition.records++;
+    if (partition.buffer.size() >= PARTITION_BUFFER_SIZE) {
+        flush(partition);
+    }
+}
+
+void SizePartitioner::flush(Partition& partition) {
+    if (partition.buffer.empty()) {
+        return;
+    }
+    if (!partition.file) {
+        partition.file = openSpill();
+    }
+    writeAll(partition.file, partition.buffer);
+    spilled += partition.buffer.size();
+    partition.buffer.clear();
+}
+
+void SizePartitioner::flushPaths() {
+    writeAll(paths, pathBuffer);
+    spilled += pathBuffer.size();
+    pathBuffer.clear();
+}
+
+void SizePartitioner::finish() {
+    for (auto& partition : partitions) {
+        flush(partition);
+    }
+    flushPaths();
+    std::fflush(paths);
+}
+
+bool SizePartitioner::split(size_t index, size_t parts) {
+    if (parts < 2 || partitions[index].records < 2 || !partitions[index].file) {
+        return false;
+    }
+    std::vector<SpilledFile> chunk;
+
+    // A single size cannot be separated by any hash
+    std::FILE* source = partitions[index].file;
+    std::fflush(source);
+    std::rewind(source);
+    bool mixed = false;
+    std::uint64_t firstSize = 0;
+    bool haveFirst = false;
+    while (!mixed && readRecords(source, chunk, SPLIT_CHUNK_RECORDS) > 0) {
+        for (const auto& record : chunk) {
+            if (!haveFirst) {
+                firstSize = record.size;
+                haveFirst = true;
+            } else if (record.size != firstSize) {
+                mixed = true;
+                break;
+            }
+        }
+        chunk.clear();
+    }
+    if (!mixed) {
+        return false;
+    }
+
+    const unsigned level = partitions[index].level + 1;
+    const size_t first = partitions.size();
+    partitions.resize(first + parts);
+    for (size_t i = first; i < partitions.size(); ++i) {
+        partitions[i].level = level;
+    }
+    std::rewind(partitions[index].file);
+    while (readRecords(partitions[index].file, chunk, SPLIT_CHUNK_RECORDS) > 0) {
+        for (const auto& record : chunk) {
+            append(partitions[first + partitionOf(record.size, level, parts)], record);
+        }
+        chunk.clear();
+    }
+    for (size_t i = first; i < partitions.size(); ++i) {
+        flush(partitions[i]);
+    }
+
+    std::fclose(partitions[index].file);
+    partitions[index].file = nullptr;
+    partitions[index].records = 0;
+    return true;
+}
+
+void SizePartitioner::read(size_t index, std::vector<SpilledFile>& records) {
+    Partition& partition = partitions[index];
+    records.clear();
+    if (!partition.file) {
+        return;
+    }
+    records.reserve(partition.records);
+    std::fflush(partition.file);
+    std::rewind(partition.file);
+    while (readRecords(partition.file, records, SPLIT_CHUNK_RECORDS) > 0) {
+    }
+    std::fclose(partition.file);
+    partition.file = nullptr;
+    partition.records = 0;
+}
+
+std::string SizePartitioner::path(const SpilledFile& record) {
+    std::string path(record.pathLength, '\0');
+    seekTo(paths, record.pathOffset);
+    if (std::fread(&path[0], 1, path.size(), paths) != path.size()) {
+        throw std::runtime_error("Unable to read a path back from the spill");
+    }
+    return path;
+}
@@ -0,0 +1,74 @@
+#ifndef SIZE_PARTITIONER_H
+#define SIZE_PARTITIONER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "directory_walker.h"
+
+// Compact record of one walked file; its path stays in the partitioner's path spill
+struct SpilledFile {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::uint64_t pathOffset = 0;
+    std::uint32_t pathLength = 0;
+    bool symlink = false;
+};
+
+// Walk records spilled to unnamed temporary files and split into partitions by a hash of
+// the file size. Every file of one size, and so every hard link of one inode, lands in the
+// same partition, so partitions can be deduplicated one at a time. Paths are kept apart
+// from the records and only read back for the files that are still candidates.
+class SizePartitioner {
+public:
+    explicit SizePartitioner(size_t partitions);
+    ~SizePartitioner();
+
+    SizePartitioner(const SizePartitioner&) = delete;
+    SizePartitioner& operator=(const SizePartitioner&) = delete;
+
+    // Append one walked file; throws std::runtime_error when the spill cannot be written
+    void add(const WalkEntry& entry);
+
+    // Flush the buffers; call once after the last add, before reading
+    void finish();
+
+    size_t partitionCount() const { return partitions.size(); }
+    size_t recordCount(size_t partition) const { return partitions[partition].records; }
+    // Bytes written to temporary files so far, records and paths
+    std::uintmax_t spilledBytes() const { return spilled; }
+
+    // Move the records of partition into parts new partitions appended at the end, using a
+    // different hash than the one that filled it; false, leaving it as is, when every record
+    // has the same size and no split could make it smaller
+    bool split(size_t partition, size_t parts);
+
+    // Records of partition in walk order; the partition is released afterwards
+    void read(size_t partition, std::vector<SpilledFile>& records);
+
+    std::string path(const SpilledFile& record);
+
+private:
+    struct Partition {
+        std::FILE* file = nullptr;
+        std::string buffer;
+        size_t records = 0;
+        unsigned level = 0;     // How many splits produced it; selects the hash seed
+    };
+
+    std::vector<Partition> partitions;
+    std::FILE* paths = nullptr;
+    std::string pathBuffer;
+    std::uint64_t pathBytes = 0;
+    std::uintmax_t spilled = 0;
+
+    static size_t partitionOf(std::uint64_t size, unsigned level, size_t parts);
+    void append(Partition& partition, const SpilledFile& record);
+    void flush(Partition& partition);
+    void flushPaths();
+};
+
+#endif // SIZE_PARTITIONER_H
@@ -0,0 +1,208 @@
+#include "stats_writer.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string number(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.6g", value);
+    return text;
+}
+
+// Derived figures of one stage; 0 when the stage took no measurable time
+struct StageRates {
+    double filesPerSecond = 0;
+    double bytesPerSecond = 0;
+    double utilization = 0;     // Busy time over the time its workers were available
+};
+
+StageRates ratesOf(const StageStatistics& stage) {
+    StageRates rates;
+    if (stage.seconds > 0) {
+        rates.filesPerSecond = static_cast<double>(stage.candidatesIn) / stage.seconds;
+        rates.bytesPerSecond = static_cast<double>(stage.bytesRead) / stage.seconds;
+        if (stage.workers > 0) {
+            rates.utilization = stage.busySeconds / (stage.seconds * static_cast<double>(stage.workers));
+        }
+    }
+    return rates;
+}
+
+// Prometheus label value: lower case with underscores, "Full hash" -> "full_hash"
+std::string stageLabel(const std::string& name) {
+    std::string label;
+    for (char c : name) {
+        if (c >= 'A' && c <= 'Z') {
+            label += static_cast<char>(c - 'A' + 'a');
+        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+            label += c;
+        } else {
+            label += '_';
+        }
+    }
+    return label;
+}
+
+std::string renderJson(const ScanStatistics& statistics) {
+    std::string out = "{";
+    out += "\"seconds\":" + number(statistics.seconds);
+    out += ",\"files_walked\":" + std::to_string(statistics.filesWalked);
+    out += ",\"bytes_walked\":" + std::to_string(statistics.bytesWalked);
+    out += ",\"duplicate_groups\":" + std::to_string(statistics.duplicateGroups);
+    out += ",\"duplicate_bytes\":" + std::to_string(statistics.duplicateBytes);
+    out += ",\"reclaimable_bytes\":" + std::to_string(statistics.reclaimableBytes);
+    out += ",\"links_collapsed\":" + std::to_string(statistics.linksCollapsed);
+    out += ",\"cache_hits\":" + std::to_string(statistics.cacheHits);
+    out += ",\"cache_bytes_saved\":" + std::to_string(statistics.cacheBytesSaved);
+    out += ",\"files_reused\":" + std::to_string(statistics.filesReused);
+    out += ",\"arena_bytes\":" + std::to_string(statistics.arenaBytes);
+    out += ",\"stages\":[";
+    for (size_t i = 0; i < statistics.stages.size(); ++i) {
+        const StageStatistics& stage = statistics.stages[i];
+        const StageRates rates = ratesOf(stage);
+        out += i == 0 ? "{" : ",{";
+        // Stage names are fixed ASCII, nothing to escape
+        out += "\"name\":\"" + stage.name + "\"";
+        out += ",\"candidates_in\":" + std::to_string(stage.candidatesIn);
+        out += ",\"candidates_removed\":" + std::to_string(stage.candidatesRemoved);
+        out += ",\"bytes_read\":" + std::to_string(stage.bytesRead);
+        out += ",\"bytes_skipped\":" + std::to_string(stage.bytesSkipped);
+        out += ",\"seconds\":" + number(stage.seconds);
+        out += ",\"busy_seconds\":" + number(stage.busySeconds);
+        out += ",\"workers\":" + std::to_string(stage.workers);
+        out += ",\"peak_queue_depth\":" + std::to_string(stage.peakQueueDepth);
+        out += ",\"files_per_second\":" + number(rates.filesPerSecond);
+        out += ",\"bytes_per_second\":" + number(rates.bytesPerSecond);
+        out += ",\"utilization\":" + number(rates.utilization);
+        out += "}";
+    }
+    out += "]}\n";
+    return out;
+}
+
+void appendMetric(std::string& out, const char* name, const char* help, const std::string& value) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " gauge\n";
+    out += name;
+    out += ' ' + value + '\n';
+}
+
+// One family with a sample per stage
+template <typename Field>
+void appendStageMetric(std::string& out, const ScanStatistics& statistics, const char* name, const char* help,
+                       Field field) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " gauge\n";
+    for (const auto& stage : statistics.stages) {
+        out += name;
+        out += "{stage=\"" + stageLabel(stage.name) + "\"} " + field(stage) + '\n';
+    }
+}
+
+std::string renderPrometheus(const ScanStatistics& statistics) {
+    std::string out;
+    const double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    char timestamp[32];
+    std::snprintf(timestamp, sizeof(timestamp), "%.3f", now);
+    appendMetric(out, "dff_last_scan_timestamp_seconds", "When the last scan finished.", timestamp);
+    appendMetric(out, "dff_scan_seconds", "Wall time of the last scan.", number(statistics.seconds));
+    appendMetric(out, "dff_files_walked", "Regular files found by the walk.", std::to_string(statistics.filesWalked));
+    appendMetric(out, "dff_bytes_walked", "Total size of the walked files.", std::to_string(statistics.bytesWalked));
+    appendMetric(out, "dff_duplicate_groups", "Groups of identical files.", std::to_string(statistics.duplicateGroups));
+    appendMetric(out, "dff_duplicate_bytes", "Size of every group member but the first.",
+                 std::to_string(statistics.duplicateBytes));
+    appendMetric(out, "dff_reclaimable_bytes", "Duplicate bytes counting each extra inode once.",
+                 std::to_string(statistics.reclaimableBytes));
+    appendMetric(out, "dff_cache_hits", "Digests taken from the hash cache.", std::to_string(statistics.cacheHits));
+    appendMetric(out, "dff_arena_bytes", "Most memory the scan arena held at once.",
+                 std::to_string(statistics.arenaBytes));
+
+    appendStageMetric(out, statistics, "dff_stage_seconds", "Wall time of the stage.",
+                      [](const StageStatistics& stage) { return number(stage.seconds); });
+    appendStageMetric(out, statistics, "dff_stage_busy_seconds", "Time the stage's workers spent working.",
+                      [](const StageStatistics& stage) { return number(stage.busySeconds); });
+    appendStageMetric(out, statistics, "dff_stage_workers", "Threads available to the stage.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.workers); });
+    appendStageMetric(out, statistics, "dff_stage_utilization", "Busy time over the workers' available time.",
+                      [](const StageStatistics& stage) { return number(ratesOf(stage).utilization); });
+    appendStageMetric(out, statistics, "dff_stage_candidates", "Files entering the stage.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.candidatesIn); });
+    appendStageMetric(out, statistics, "dff_stage_candidates_removed", "Files the stage ruled out.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.candidatesRemoved); });
+    appendStageMetric(out, statistics, "dff_stage_bytes_read", "Bytes the stage read from disk.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.bytesRead); });
+    appendStageMetric(out, statistics, "dff_stage_bytes_skipped", "Bytes never read because of the stage.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.bytesSkipped); });
+    appendStageMetric(out, statistics, "dff_stage_files_per_second", "Files entering the stage per second.",
+                      [](const StageStatistics& stage) { return number(ratesOf(stage).filesPerSecond); });
+    appendStageMetric(out, statistics, "dff_stage_bytes_per_second", "Bytes read per second.",
+                      [](const StageStatistics& stage) { return number(ratesOf(stage).bytesPerSecond); });
+    appendStageMetric(out, statistics, "dff_stage_peak_queue_depth", "Most reads waiting or running at once.",
+                      [](const StageStatistics& stage) { return std::to_string(stage.peakQueueDepth); });
+    return out;
+}
+
+} // namespace
+
+bool StatsWriter::parseFormat(const std::string& name, StatsFormat& format) {
+    if (name == "json") {
+        format = StatsFormat::JSON;
+    } else if (name == "prometheus" || name == "prom") {
+        format = StatsFormat::PROMETHEUS;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string StatsWriter::render(const ScanStatistics& statistics, StatsFormat format) {
+    return format == StatsFormat::JSON ? renderJson(statistics) : renderPrometheus(statistics);
+}
+
+bool StatsWriter::write(const std::string& path, const ScanStatistics& statistics, StatsFormat format) {
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        out << render(statistics, format);
+        out.close();
+        if (!out) {
+            std::cerr << "Unable to write statistics: " << tempPath << std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        std::cerr << "Unable to replace statistics " << path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+StageStatistics StatsWriter::actionStage(const ActionReport& report) {
+    StageStatistics stage;
+    stage.name = "Actions";
+    stage.candidatesIn = report.succeeded + report.failed;
+    stage.candidatesRemoved = report.failed;
+    stage.seconds = report.seconds;
+    stage.busySeconds = report.busySeconds;
+    stage.workers = report.workers;
+    return stage;
+}
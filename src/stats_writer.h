@@ -0,0 +1,29 @@
+#ifndef STATS_WRITER_H
+#define STATS_WRITER_H
+
+#include <string>
+#include "duplicate_handler.h"
+#include "file_scanner.h"
+
+enum class StatsFormat {
+    JSON,           // One object with the totals and a stages array
+    PROMETHEUS      // Text exposition format for the node_exporter textfile collector
+};
+
+// Dumps scan statistics for dashboards and scripts. Rates and utilization are derived
+// from each stage's counters and timers, so both formats report the same numbers.
+class StatsWriter {
+public:
+    static bool parseFormat(const std::string& name, StatsFormat& format);
+
+    static std::string render(const ScanStatistics& statistics, StatsFormat format);
+
+    // Write through a temporary file renamed over path, so a collector never reads half
+    // a dump; false with a message on stderr when it cannot be written
+    static bool write(const std::string& path, const ScanStatistics& statistics, StatsFormat format);
+
+    // The actions of a plan as one more pipeline stage
+    static StageStatistics actionStage(const ActionReport& report);
+};
+
+#endif // STATS_WRITER_H
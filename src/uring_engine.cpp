@@ -0,0 +1,427 @@
+#include "uring_engine.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define URING_ENGINE_ENABLED 1
+#endif
+#endif
+
+#ifdef URING_ENGINE_ENABLED
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+int uringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int uringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+} // namespace
+
+// Userspace view of the shared submission and completion rings
+struct UringHashEngine::Ring {
+    void* sqMapping = nullptr;
+    std::size_t sqMappingSize = 0;
+    void* cqMapping = nullptr;
+    std::size_t cqMappingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    std::size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned pendingSubmissions = 0;
+};
+
+UringHashEngine::UringHashEngine(unsigned queueDepth, std::size_t blockSize)
+    : depth(queueDepth > 0 ? queueDepth : 64), blockSize(blockSize) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    int fd = uringSetup(depth, &params);
+    if (fd < 0) {
+        return;
+    }
+
+    std::unique_ptr<Ring> newRing(new Ring());
+    newRing->sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    newRing->cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping) {
+        newRing->sqMappingSize = std::max(newRing->sqMappingSize, newRing->cqMappingSize);
+    }
+
+    newRing->sqMapping = ::mmap(nullptr, newRing->sqMappingSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (newRing->sqMapping == MAP_FAILED) {
+        ::close(fd);
+        return;
+    }
+    if (singleMapping) {
+        newRing->cqMapping = newRing->sqMapping;
+    } else {
+        newRing->cqMapping = ::mmap(nullptr, newRing->cqMappingSize, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (newRing->cqMapping == MAP_FAILED) {
+            ::munmap(newRing->sqMapping, newRing->sqMappingSize);
+            ::close(fd);
+            return;
+        }
+    }
+    newRing->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, newRing->sqesSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (!singleMapping) {
+            ::munmap(newRing->cqMapping, newRing->cqMappingSize);
+        }
+        ::munmap(newRing->sqMapping, newRing->sqMappingSize);
+        ::close(fd);
+        return;
+    }
+    newRing->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(newRing->sqMapping);
+    char* cq = static_cast<char*>(newRing->cqMapping);
+    newRing->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    newRing->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    newRing->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    newRing->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    newRing->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    newRing->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    newRing->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    newRing->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // The kernel may round the ring up; never keep more reads in flight than it has entries
+    depth = std::min(depth, params.sq_entries);
+
+    // One buffer per in-flight read; registering them lets the kernel skip per-read page pinning
+    std::vector<iovec> iovecs;
+    for (unsigned i = 0; i < depth; ++i) {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, 4096, blockSize) != 0) {
+            break;
+        }
+        buffers.push_back(static_cast<char*>(memory));
+        iovecs.push_back(iovec{ memory, blockSize });
+    }
+    depth = static_cast<unsigned>(buffers.size());
+    fixedBuffers = depth > 0 &&
+                   uringRegister(fd, IORING_REGISTER_BUFFERS, iovecs.data(), depth) == 0;
+
+    ring = newRing.release();
+    ringFd = depth > 0 ? fd : -1;
+    if (ringFd < 0) {
+        ::close(fd);
+    }
+}
+
+UringHashEngine::~UringHashEngine() {
+    if (ring) {
+        ::munmap(ring->sqes, ring->sqesSize);
+        if (ring->cqMapping != ring->sqMapping) {
+            ::munmap(ring->cqMapping, ring->cqMappingSize);
+        }
+        ::munmap(ring->sqMapping, ring->sqMappingSize);
+        delete ring;
+    }
+    if (ringFd >= 0) {
+        ::close(ringFd);
+    }
+    if (!readsLost) {
+        for (char* buffer : buffers) {
+            std::free(buffer);
+        }
+    }
+}
+
+bool UringHashEngine::isSupported() {
+    static const bool supported = [] {
+        UringHashEngine probe(2, 4096);
+        if (!probe.available()) {
+            return false;
+        }
+        // IORING_OP_READ needs Linux 5.6; the probe opcode itself is just as new
+        std::vector<char> storage(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* ops = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (uringRegister(probe.ringFd, IORING_REGISTER_PROBE, ops, 256) != 0) {
+            return false;
+        }
+        return ops->last_op >= IORING_OP_READ &&
+               (ops->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+    }();
+    return supported;
+}
+
+void UringHashEngine::queueRead(unsigned slot, int fd, std::uintmax_t offset) {
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    io_uring_sqe* sqe = &ring->sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = fixedBuffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = reinterpret_cast<std::uint64_t>(buffers[slot]);
+    sqe->len = static_cast<unsigned>(blockSize);
+    sqe->buf_index = static_cast<std::uint16_t>(slot);
+    sqe->user_data = slot;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    ring->pendingSubmissions++;
+}
+
+unsigned UringHashEngine::submitAndWait(unsigned waitFor) {
+    unsigned toSubmit = ring->pendingSubmissions;
+    if (toSubmit == 0 && waitFor == 0) {
+        return 0;
+    }
+    int result;
+    do {
+        result = uringEnter(ringFd, toSubmit, waitFor, waitFor > 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+    }
+    ring->pendingSubmissions -= std::min<unsigned>(ring->pendingSubmissions, static_cast<unsigned>(result));
+    return static_cast<unsigned>(result);
+}
+
+void UringHashEngine::drain(unsigned inFlight) {
+    while (inFlight > 0) {
+        int result = uringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (result < 0 && errno != EINTR) {
+            readsLost = true;
+            return;
+        }
+        unsigned head = *ring->cqHead;
+        unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+        inFlight -= std::min(inFlight, tail - head);
+        __atomic_store_n(ring->cqHead, tail, __ATOMIC_RELEASE);
+    }
+}
+
+void UringHashEngine::run(const std::vector<UringHashJob>& jobs, HashAlgorithm algorithm,
+                          WorkerPool& pool, const Callback& callback, const std::atomic<bool>* stop) {
+    if (!available()) {
+        throw std::runtime_error("io_uring is not available");
+    }
+
+    // Slot i owns buffer i and serves one file at a time
+    struct Slot {
+        size_t job = 0;
+        int fd = -1;
+        std::uintmax_t offset = 0;
+        std::unique_ptr<DigestStream> digest;
+        std::string error;      // Set by a worker whose update failed
+    };
+    std::vector<Slot> slots(depth);
+    std::vector<unsigned> freeSlots;
+    for (unsigned i = depth; i-- > 0;) {
+        freeSlots.push_back(i);
+    }
+
+    // Slots handed back by workers once their block is digested; finished marks a closed-out file
+    std::mutex recycleMutex;
+    std::condition_variable recycleReady;
+    std::vector<std::pair<unsigned, bool>> recycled;
+    auto handBack = [&](unsigned slot, bool finished) {
+        std::lock_guard<std::mutex> lock(recycleMutex);
+        recycled.emplace_back(slot, finished);
+        recycleReady.notify_one();
+    };
+
+    auto finishSlot = [&](unsigned slot, const std::string& error) {
+        Slot* state = &slots[slot];
+        pool.submit([&, slot, state, error](size_t workerIndex) {
+            Digest digest;
+            std::string failure = error;
+            if (failure.empty()) {
+                try {
+                    digest = state->digest->finish();
+                } catch (const std::exception& e) {
+                    failure = e.what();
+                }
+            }
+            callback(workerIndex, jobs[state->job].id, digest, std::move(failure));
+            handBack(slot, true);
+        });
+    };
+
+    size_t nextJob = 0;
+    size_t activeFiles = 0;
+    unsigned inFlight = 0;
+    std::vector<std::pair<unsigned, bool>> drained;
+
+    try {
+        while ((nextJob < jobs.size() && !(stop && stop->load(std::memory_order_relaxed))) || activeFiles > 0) {
+            // Start new files while slots are free
+            while (!freeSlots.empty() && nextJob < jobs.size() && !(stop && stop->load(std::memory_order_relaxed))) {
+                const UringHashJob& job = jobs[nextJob];
+                int fd = ::open(job.path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (fd < 0) {
+                    size_t jobId = job.id;
+                    std::string error = "Unable to open file: " + job.path;
+                    pool.submit([&callback, jobId, error](size_t workerIndex) {
+                        callback(workerIndex, jobId, Digest(), error);
+                    });
+                    nextJob++;
+                    continue;
+                }
+    #ifdef POSIX_FADV_SEQUENTIAL
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+                unsigned slot = freeSlots.back();
+                freeSlots.pop_back();
+                Slot& state = slots[slot];
+                state.job = nextJob++;
+                state.fd = fd;
+                state.offset = 0;
+                state.error.clear();
+                // Each slot keeps its hasher across files and only resets it
+                if (state.digest) {
+                    state.digest->reset();
+                } else {
+                    state.digest.reset(new DigestStream(algorithm));
+                }
+                activeFiles++;
+                queueRead(slot, fd, 0);
+                inFlight++;
+            }
+
+            // Block in the kernel only while reads are outstanding; otherwise wait for the workers
+            bool haveRecycled;
+            {
+                std::lock_guard<std::mutex> lock(recycleMutex);
+                haveRecycled = !recycled.empty();
+            }
+            if (inFlight > 0) {
+                submitAndWait(haveRecycled ? 0 : 1);
+            } else if (!haveRecycled && activeFiles > 0) {
+                std::unique_lock<std::mutex> lock(recycleMutex);
+                recycleReady.wait(lock, [&] { return !recycled.empty(); });
+            }
+
+            // Reap completions
+            unsigned head = *ring->cqHead;
+            unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                const io_uring_cqe& cqe = ring->cqes[head & *ring->cqMask];
+                unsigned slot = static_cast<unsigned>(cqe.user_data);
+                int res = cqe.res;
+                head++;
+                inFlight--;
+
+                Slot& state = slots[slot];
+                if (res == -EINTR || res == -EAGAIN) {
+                    queueRead(slot, state.fd, state.offset);
+                    inFlight++;
+                } else if (res < 0) {
+                    finishSlot(slot, "Failed to read file: " + jobs[state.job].path + ": " + std::strerror(-res));
+                } else if (res == 0) {
+                    finishSlot(slot, std::string());
+                } else {
+                    state.offset += static_cast<std::uintmax_t>(res);
+                    const char* data = buffers[slot];
+                    size_t length = static_cast<size_t>(res);
+                    Slot* owner = &state;
+                    pool.submit([&, slot, data, length, owner](size_t) {
+                        try {
+                            owner->digest->update(data, length);
+                        } catch (const std::exception& e) {
+                            owner->error = e.what();
+                        }
+                        handBack(slot, false);
+                    });
+                }
+            }
+            __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+
+            // Recycle digested buffers: read the next block, or close the file out
+            {
+                std::lock_guard<std::mutex> lock(recycleMutex);
+                drained.swap(recycled);
+            }
+            for (const auto& item : drained) {
+                unsigned slot = item.first;
+                Slot& state = slots[slot];
+                if (item.second) {
+                    ::close(state.fd);
+                    state.fd = -1;
+                    freeSlots.push_back(slot);
+                    activeFiles--;
+                } else if (!state.error.empty()) {
+                    finishSlot(slot, state.error);
+                } else if (stop && stop->load(std::memory_order_relaxed)) {
+                    finishSlot(slot, "Cancelled");
+                } else {
+                    queueRead(slot, state.fd, state.offset);
+                    inFlight++;
+                }
+            }
+            drained.clear();
+        }
+        submitAndWait(0);
+    } catch (...) {
+        // Reads still target the buffers and slot fds, and workers still use slots, recycled
+        // and handBack; none of them may go away under those
+        drain(inFlight);
+        pool.wait();
+        for (Slot& state : slots) {
+            if (state.fd >= 0) {
+                ::close(state.fd);
+            }
+        }
+        throw;
+    }
+    pool.wait();
+}
+
+#else // URING_ENGINE_ENABLED
+
+struct UringHashEngine::Ring {};
+
+UringHashEngine::UringHashEngine(unsigned queueDepth, std::size_t blockSize)
+    : depth(queueDepth), blockSize(blockSize) {}
+
+UringHashEngine::~UringHashEngine() = default;
+
+bool UringHashEngine::isSupported() {
+    return false;
+}
+
+void UringHashEngine::queueRead(unsigned, int, std::uintmax_t) {}
+
+unsigned UringHashEngine::submitAndWait(unsigned) {
+    return 0;
+}
+
+void UringHashEngine::run(const std::vector<UringHashJob>&, HashAlgorithm, WorkerPool&, const Callback&,
+                          const std::atomic<bool>*) {
+    throw std::runtime_error("io_uring is not available on this platform");
+}
+
+#endif // URING_ENGINE_ENABLED
@@ -0,0 +1,62 @@
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "hash_calculator.h"
+#include "worker_pool.h"
+
+// One file to hash through the io_uring engine
+struct UringHashJob {
+    size_t id;
+    std::string path;
+};
+
+// Linux io_uring read pipeline for bulk full hashing. Many files are read at once, one
+// block in flight per file, from a fixed pool of registered buffers. Completed blocks are
+// digested on the worker pool and their buffer is recycled for the next read of that file.
+class UringHashEngine {
+public:
+    // Runs on a pool worker once a job finishes; error is non-empty on failure
+    using Callback = std::function<void(size_t workerIndex, size_t jobId,
+                                        const Digest& digest, std::string error)>;
+
+    explicit UringHashEngine(unsigned queueDepth = 64, std::size_t blockSize = 256 * 1024);
+    ~UringHashEngine();
+
+    UringHashEngine(const UringHashEngine&) = delete;
+    UringHashEngine& operator=(const UringHashEngine&) = delete;
+
+    // False when the kernel (or a seccomp policy) refused io_uring; callers fall back
+    bool available() const { return ringFd >= 0; }
+
+    // Probe once per process whether io_uring with IORING_OP_READ works
+    static bool isSupported();
+
+    // Hash every job and return once all callbacks have run. Files are read to EOF, whatever
+    // size the walk saw. Once *stop is set no file is started and open ones end with an error.
+    // Throws when the ring fails, after every read and pool task using it has finished; jobs
+    // whose callback has not run are left for the caller, and the engine is unusable.
+    void run(const std::vector<UringHashJob>& jobs, HashAlgorithm algorithm,
+             WorkerPool& pool, const Callback& callback, const std::atomic<bool>* stop = nullptr);
+
+private:
+    struct Ring;
+    Ring* ring = nullptr;
+    int ringFd = -1;
+    unsigned depth;
+    std::size_t blockSize;
+    std::vector<char*> buffers;
+    bool fixedBuffers = false;
+    bool readsLost = false;     // A failed ring may still write into the buffers; never free them
+
+    void queueRead(unsigned slot, int fd, std::uintmax_t offset);
+    unsigned submitAndWait(unsigned waitFor);
+    // Wait for the reads still in the ring and discard their completions
+    void drain(unsigned inFlight);
+};
+
+#endif // URING_ENGINE_H
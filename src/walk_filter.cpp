@@ -0,0 +1,226 @@
+#include "walk_filter.h"
+#include <algorithm>
+#include <stdexcept>
+
+FilterPath FilterPath::split(std::string_view path, size_t rootLength) {
+    FilterPath split;
+    split.full = path;
+    size_t start = std::min(rootLength, path.size());
+    if (start < path.size() && path[start] == '/') {
+        start++;
+    }
+    split.relative = path.substr(start);
+    const size_t slash = path.rfind('/');
+    split.name = slash == std::string_view::npos ? path : path.substr(slash + 1);
+    return split;
+}
+
+void GlobSet::add(const std::string& pattern) {
+    std::string text = pattern;
+    while (text.size() > 1 && text.back() == '/') {
+        text.pop_back();
+    }
+    if (text.empty()) {
+        throw std::invalid_argument("Empty pattern");
+    }
+
+    Pattern compiled;
+    compiled.target = text[0] == '/' ? Target::FULL
+                    : text.find('/') != std::string::npos ? Target::RELATIVE : Target::NAME;
+    std::vector<Token>& tokens = compiled.tokens;
+    auto appendLiteral = [&tokens](char c) {
+        if (tokens.empty() || tokens.back().kind != Token::LITERAL) {
+            tokens.push_back(Token{ Token::LITERAL, std::string(), {} });
+        }
+        tokens.back().literal += c;
+    };
+
+    for (size_t i = 0; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c == '\\' && i + 1 < text.size()) {
+            appendLiteral(text[++i]);
+        } else if (c == '?') {
+            tokens.push_back(Token{ Token::ANY, std::string(), {} });
+        } else if (c == '*') {
+            size_t stars = 1;
+            while (i + 1 < text.size() && text[i + 1] == '*') {
+                ++i;
+                ++stars;
+            }
+            if (stars == 1) {
+                if (tokens.empty() || tokens.back().kind != Token::STAR) {
+                    tokens.push_back(Token{ Token::STAR, std::string(), {} });
+                }
+                continue;
+            }
+            // "**/" at the start of a component stands for any number of whole directories
+            const bool componentStart = i + 1 == stars || text[i - stars] == '/';
+            if (componentStart && i + 1 < text.size() && text[i + 1] == '/') {
+                ++i;
+                tokens.push_back(Token{ Token::GLOBSTAR_DIRECTORIES, std::string(), {} });
+            } else {
+                tokens.push_back(Token{ Token::GLOBSTAR, std::string(), {} });
+            }
+        } else if (c == '[') {
+            size_t j = i + 1;
+            const bool negate = j < text.size() && (text[j] == '!' || text[j] == '^');
+            if (negate) {
+                ++j;
+            }
+            Token token{ Token::CLASS, std::string(), {} };
+            // A ] right after the opening bracket is a member, not the end
+            for (bool first = true; j < text.size() && (first || text[j] != ']'); first = false) {
+                unsigned char low = static_cast<unsigned char>(text[j]);
+                if (low == '\\' && j + 1 < text.size()) {
+                    low = static_cast<unsigned char>(text[++j]);
+                }
+                unsigned char high = low;
+                if (j + 2 < text.size() && text[j + 1] == '-' && text[j + 2] != ']') {
+                    high = static_cast<unsigned char>(text[j + 2]);
+                    j += 2;
+                }
+                for (unsigned value = low; value <= high; ++value) {
+                    token.members.set(value);
+                }
+                ++j;
+            }
+            if (j >= text.size()) {
+                throw std::invalid_argument("Unterminated [ in pattern: " + pattern);
+            }
+            if (negate) {
+                token.members.flip();
+            }
+            token.members.reset('/');
+            tokens.push_back(std::move(token));
+            i = j;
+        } else {
+            appendLiteral(c);
+        }
+    }
+
+    if (compiled.target == Target::NAME) {
+        if (tokens.size() == 1 && tokens[0].kind == Token::LITERAL) {
+            storage.push_back(tokens[0].literal);
+            names.insert(storage.back());
+            return;
+        }
+        const bool suffix = tokens[0].kind == Token::STAR || tokens[0].kind == Token::GLOBSTAR;
+        if (suffix && (tokens.size() == 1 || (tokens.size() == 2 && tokens[1].kind == Token::LITERAL))) {
+            storage.push_back(tokens.size() == 2 ? tokens[1].literal : std::string());
+            suffixes.insert(storage.back());
+            if (std::find(suffixLengths.begin(), suffixLengths.end(), storage.back().size()) == suffixLengths.end()) {
+                suffixLengths.push_back(storage.back().size());
+            }
+            return;
+        }
+    } else {
+        pathTargets = true;
+    }
+    patterns.push_back(std::move(compiled));
+}
+
+bool GlobSet::matches(const FilterPath& path) const {
+    if (!names.empty() && names.count(path.name) > 0) {
+        return true;
+    }
+    for (size_t length : suffixLengths) {
+        if (path.name.size() >= length && suffixes.count(path.name.substr(path.name.size() - length)) > 0) {
+            return true;
+        }
+    }
+    for (const auto& pattern : patterns) {
+        const std::string_view text = pattern.target == Target::NAME ? path.name
+                                    : pattern.target == Target::RELATIVE ? path.relative : path.full;
+        if (matchTokens(pattern.tokens, 0, text, 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GlobSet::matchTokens(const std::vector<Token>& tokens, size_t token, std::string_view text, size_t position) {
+    for (; token < tokens.size(); ++token) {
+        const Token& current = tokens[token];
+        switch (current.kind) {
+            case Token::LITERAL:
+                if (text.compare(position, current.literal.size(), current.literal) != 0) {
+                    return false;
+                }
+                position += current.literal.size();
+                break;
+            case Token::ANY:
+                if (position >= text.size() || text[position] == '/') {
+                    return false;
+                }
+                position++;
+                break;
+            case Token::CLASS:
+                if (position >= text.size() || !current.members.test(static_cast<unsigned char>(text[position]))) {
+                    return false;
+                }
+                position++;
+                break;
+            case Token::STAR: {
+                size_t end = text.find('/', position);
+                end = end == std::string_view::npos ? text.size() : end;
+                if (token + 1 == tokens.size()) {
+                    return end == text.size();
+                }
+                for (size_t next = position; next <= end; ++next) {
+                    if (matchTokens(tokens, token + 1, text, next)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+            case Token::GLOBSTAR:
+                if (token + 1 == tokens.size()) {
+                    return true;
+                }
+                for (size_t next = position; next <= text.size(); ++next) {
+                    if (matchTokens(tokens, token + 1, text, next)) {
+                        return true;
+                    }
+                }
+                return false;
+            case Token::GLOBSTAR_DIRECTORIES:
+                if (matchTokens(tokens, token + 1, text, position)) {
+                    return true;
+                }
+                for (size_t next = position; next < text.size(); ++next) {
+                    if (text[next] == '/' && matchTokens(tokens, token + 1, text, next + 1)) {
+                        return true;
+                    }
+                }
+                return false;
+        }
+    }
+    return position == text.size();
+}
+
+WalkFilter::WalkFilter(const FilterRules& rules) : filterRules(rules) {
+    for (const auto& pattern : rules.includeGlobs) {
+        includes.add(pattern);
+    }
+    for (const auto& pattern : rules.excludeGlobs) {
+        excludes.add(pattern);
+    }
+    for (const auto& pattern : rules.excludeDirectories) {
+        excludedDirectories.add(pattern);
+    }
+    pathPatterns = includes.needsPath() || excludes.needsPath() || excludedDirectories.needsPath();
+}
+
+bool WalkFilter::skipsDirectory(const FilterPath& path) const {
+    return !excludedDirectories.empty() && excludedDirectories.matches(path);
+}
+
+bool WalkFilter::skipsFile(const FilterPath& path, std::uintmax_t size) const {
+    if (size < filterRules.minSize || (filterRules.maxSize > 0 && size > filterRules.maxSize)) {
+        return true;
+    }
+    if (!includes.empty() && !includes.matches(path)) {
+        return true;
+    }
+    return !excludes.empty() && excludes.matches(path);
+}
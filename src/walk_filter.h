@@ -0,0 +1,111 @@
+#ifndef WALK_FILTER_H
+#define WALK_FILTER_H
+
+#include <bitset>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// How the walk treats symbolic links
+enum class SymlinkPolicy {
+    FILES,      // Links to regular files are scanned as files, linked directories are not entered
+    NONE,       // Every link is skipped without being resolved
+    ALL         // Linked directories are entered too, each one once, by whichever path reaches it first
+};
+
+// What a scan leaves out. Patterns use * and ? within one path component, ** across
+// components, [a-z] and [!a] classes and \ to escape. A pattern without a slash matches the
+// entry's name at any depth, one with a slash the path below the scan root, and one
+// starting with a slash the whole path as walked. A trailing slash is ignored.
+struct FilterRules {
+    std::uintmax_t minSize = 0;     // Smaller files are skipped; 1 skips empty files
+    std::uintmax_t maxSize = 0;     // Larger files are skipped; 0 means no limit
+    std::vector<std::string> includeGlobs;          // When any is given, files must match one
+    std::vector<std::string> excludeGlobs;          // Files matching one are skipped
+    std::vector<std::string> excludeDirectories;    // Matching directories are never opened
+    bool sameFilesystem = false;    // Stay on the filesystem of each root
+    SymlinkPolicy symlinks = SymlinkPolicy::FILES;
+
+    // Whether anything is filtered or the walk changes at all
+    bool active() const {
+        return minSize > 0 || maxSize > 0 || !includeGlobs.empty() || !excludeGlobs.empty() ||
+               !excludeDirectories.empty() || sameFilesystem || symlinks != SymlinkPolicy::FILES;
+    }
+};
+
+// A walked path cut the three ways patterns look at it
+struct FilterPath {
+    std::string_view full;      // As walked, root included
+    std::string_view relative;  // Below the root
+    std::string_view name;      // Last component
+
+    // rootLength is the length of the root as given to the walk
+    static FilterPath split(std::string_view path, size_t rootLength);
+};
+
+// Glob patterns compiled once. Literal names and * followed by a literal suffix, the bulk
+// of real rules such as .git, node_modules or *.tmp, are answered by hash lookups; the rest
+// run as token lists.
+class GlobSet {
+public:
+    GlobSet() = default;
+    GlobSet(const GlobSet&) = delete;
+    GlobSet& operator=(const GlobSet&) = delete;
+
+    // Throws std::invalid_argument for an empty pattern or an unterminated class
+    void add(const std::string& pattern);
+    bool empty() const { return names.empty() && suffixes.empty() && patterns.empty(); }
+    // Whether some pattern looks beyond the name
+    bool needsPath() const { return pathTargets; }
+    bool matches(const FilterPath& path) const;
+
+private:
+    enum class Target { NAME, RELATIVE, FULL };
+    struct Token {
+        enum Kind { LITERAL, ANY, CLASS, STAR, GLOBSTAR, GLOBSTAR_DIRECTORIES } kind;
+        std::string literal;
+        std::bitset<256> members;
+    };
+    struct Pattern {
+        Target target;
+        std::vector<Token> tokens;
+    };
+
+    std::deque<std::string> storage;    // Owns the strings the views below point into
+    std::unordered_set<std::string_view> names;
+    std::unordered_set<std::string_view> suffixes;
+    std::vector<size_t> suffixLengths;  // Distinct lengths in suffixes
+    std::vector<Pattern> patterns;
+    bool pathTargets = false;
+
+    static bool matchTokens(const std::vector<Token>& tokens, size_t token, std::string_view text, size_t position);
+};
+
+// FilterRules compiled for the walker; shared read-only by every walker thread
+class WalkFilter {
+public:
+    // Throws std::invalid_argument for a malformed pattern
+    explicit WalkFilter(const FilterRules& rules);
+
+    WalkFilter(const WalkFilter&) = delete;
+    WalkFilter& operator=(const WalkFilter&) = delete;
+
+    const FilterRules& rules() const { return filterRules; }
+    // Whether a check needs more than the entry's name, so the walker must build the path first
+    bool needsPath() const { return pathPatterns; }
+
+    bool skipsDirectory(const FilterPath& path) const;
+    bool skipsFile(const FilterPath& path, std::uintmax_t size) const;
+
+private:
+    FilterRules filterRules;
+    GlobSet includes;
+    GlobSet excludes;
+    GlobSet excludedDirectories;
+    bool pathPatterns = false;
+};
+
+#endif // WALK_FILTER_H
@@ -0,0 +1,773 @@
+#include "watch_daemon.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+const size_t MAX_REQUEST_LENGTH = 64 * 1024;
+
+std::string joinPath(const std::string& directory, const std::string& name) {
+    std::string path = directory;
+    if (!path.empty() && path.back() != '/') {
+        path += '/';
+    }
+    path += name;
+    return path;
+}
+
+bool isUnder(const std::string& path, const std::string& directory) {
+    return path.size() > directory.size() && path.compare(0, directory.size(), directory) == 0 &&
+           (directory.back() == '/' || path[directory.size()] == '/');
+}
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int) {
+    stopRequested = 1;
+}
+
+const std::uint32_t WATCH_MASK = IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_DELETE | IN_DONT_FOLLOW | IN_EXCL_UNLINK | IN_ONLYDIR;
+#endif
+
+} // namespace
+
+WatchDaemon::WatchDaemon(const WatchOptions& options) : options(options) {}
+
+WatchDaemon::~WatchDaemon() {
+    // Runs whatever is still queued; the last task of a request signals wakeFd
+    pool.reset();
+#ifdef __linux__
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+    }
+    for (const auto& client : clients) {
+        ::close(client.fd);
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(options.socketPath.c_str());
+    }
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+    }
+#endif
+}
+
+#ifdef __linux__
+
+int WatchDaemon::run() {
+    // Unbounded queue: submitting a large size must never block the poll thread
+    pool = std::make_unique<WorkerPool>(options.scanOptions.threadCount, std::numeric_limits<size_t>::max());
+    if (options.scanOptions.filters.active()) {
+        filter = std::make_unique<WalkFilter>(options.scanOptions.filters);
+        for (const auto& root : options.roots) {
+            struct stat st;
+            rootDevices.push_back(::stat(root.c_str(), &st) == 0 ? static_cast<std::uint64_t>(st.st_dev) : 0);
+        }
+    }
+
+    inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        std::cerr << "Unable to start inotify: " << std::strerror(errno) << std::endl;
+        return 2;
+    }
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        std::cerr << "Unable to create eventfd: " << std::strerror(errno) << std::endl;
+        return 2;
+    }
+    // Watches go up before the scan so changes made while it runs are not lost
+    for (const auto& root : options.roots) {
+        if (!watchTree(root, false)) {
+            return 2;
+        }
+    }
+    initialScan();
+    if (!openSocket()) {
+        return 2;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = requestStop;
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cerr << "Watching " << watchPaths.size() << " directories with " << files.size() << " files in "
+              << groupCount << " duplicate groups; queries on " << options.socketPath << std::endl;
+
+    std::vector<pollfd> fds;
+    while (!stopRequested) {
+        fds.clear();
+        fds.push_back(pollfd{ inotifyFd, POLLIN, 0 });
+        fds.push_back(pollfd{ listenFd, POLLIN, 0 });
+        fds.push_back(pollfd{ wakeFd, POLLIN, 0 });
+        for (const auto& client : clients) {
+            fds.push_back(pollfd{ client.fd, POLLIN, 0 });
+        }
+
+        const int timeout = dirty.empty() ? -1 : static_cast<int>(options.debounceMs);
+        if (::poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Watch loop failed: " << std::strerror(errno) << std::endl;
+            return 2;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            handleEvents();
+        }
+        if (fds[2].revents & POLLIN) {
+            std::uint64_t count;
+            while (::read(wakeFd, &count, sizeof(count)) > 0) {
+            }
+            finishHashing();
+        }
+        // Only clients present when fds was built; finishHashing may have answered some already
+        const size_t polled = fds.size() - 3;
+        for (size_t i = 0; i < polled; ++i) {
+            if (clients[i].fd >= 0 && fds[i + 3].revents & (POLLIN | POLLHUP | POLLERR)) {
+                handleClient(clients[i]);
+            }
+        }
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const Client& client) { return client.fd < 0; }),
+                      clients.end());
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+                clients.push_back(Client{ fd, std::string(), nextClient++ });
+            }
+        }
+        processDirty(false);
+    }
+
+    std::cerr << "Watch stopped" << std::endl;
+    return 0;
+}
+
+bool WatchDaemon::initialScan() {
+    files.clear();
+    bySize.clear();
+    byContent.clear();
+    groupCount = 0;
+
+    // Every multi-file size needs full digests anyway, so a partial stage would only add reads
+    ScanOptions scanOptions = options.scanOptions;
+    scanOptions.partialHashWindow = 0;
+
+    FileScanner scanner;
+    scanner.setOptions(scanOptions);
+    scanner.setLogStream(std::cerr);
+    scanner.findDuplicates(options.roots, options.algorithm, options.recursive);
+
+    const FileTable& table = scanner.getScannedFiles();
+    for (size_t index = 0; index < table.size(); ++index) {
+        LiveFile file;
+        file.size = table.fileSize(index);
+        file.mtime = table.mtime(index);
+        file.device = table.device(index);
+        file.inode = table.inode(index);
+        file.digest = table.hash(index);
+        addFile(table.path(index), file);
+    }
+    return true;
+}
+
+bool WatchDaemon::watchTree(const std::string& root, bool markFiles) {
+    const Clock::time_point now = Clock::now();
+    std::vector<std::string> pending = { root };
+    while (!pending.empty()) {
+        std::string directory = std::move(pending.back());
+        pending.pop_back();
+
+        int wd = ::inotify_add_watch(inotifyFd, directory.c_str(), WATCH_MASK);
+        if (wd < 0) {
+            std::cerr << "Unable to watch " << directory << ": " << std::strerror(errno)
+                      << (errno == ENOSPC ? " (raise fs.inotify.max_user_watches)" : "") << std::endl;
+            if (directory == root) {
+                return false;
+            }
+            continue;
+        }
+        watchPaths[wd] = directory;
+        watchDescriptors[directory] = wd;
+        if (!options.recursive && !markFiles) {
+            continue;
+        }
+
+        DIR* dir = ::opendir(directory.c_str());
+        if (!dir) {
+            continue;
+        }
+        while (dirent* entry = ::readdir(dir)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (::fstatat(::dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+            }
+            if (type == DT_DIR) {
+                std::string child = joinPath(directory, name);
+                if (options.recursive && !skipsDirectory(child)) {
+                    pending.push_back(std::move(child));
+                }
+            } else if (markFiles && (type == DT_REG || type == DT_LNK)) {
+                dirty[joinPath(directory, name)] = now;
+            }
+        }
+        ::closedir(dir);
+    }
+    return true;
+}
+
+size_t WatchDaemon::rootLength(const std::string& path, size_t& root) const {
+    for (root = 0; root < options.roots.size(); ++root) {
+        if (path == options.roots[root] || isUnder(path, options.roots[root])) {
+            return options.roots[root].size();
+        }
+    }
+    root = 0;
+    return 0;
+}
+
+bool WatchDaemon::skipsDirectory(const std::string& path) const {
+    if (!filter) {
+        return false;
+    }
+    size_t root = 0;
+    if (filter->skipsDirectory(FilterPath::split(path, rootLength(path, root)))) {
+        return true;
+    }
+    struct stat st;
+    return filter->rules().sameFilesystem && ::stat(path.c_str(), &st) == 0 &&
+           static_cast<std::uint64_t>(st.st_dev) != rootDevices[root];
+}
+
+bool WatchDaemon::skipsFile(const std::string& path, const WalkEntry& entry) const {
+    if (!filter) {
+        return false;
+    }
+    size_t root = 0;
+    if (filter->skipsFile(FilterPath::split(path, rootLength(path, root)), entry.size)) {
+        return true;
+    }
+    if (filter->rules().sameFilesystem && entry.device != rootDevices[root]) {
+        return true;
+    }
+    struct stat st;
+    return filter->rules().symlinks == SymlinkPolicy::NONE && ::lstat(path.c_str(), &st) == 0 && S_ISLNK(st.st_mode);
+}
+
+void WatchDaemon::forgetTree(const std::string& directory) {
+    for (auto it = watchDescriptors.begin(); it != watchDescriptors.end();) {
+        if (it->first == directory || isUnder(it->first, directory)) {
+            ::inotify_rm_watch(inotifyFd, it->second);
+            watchPaths.erase(it->second);
+            it = watchDescriptors.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    std::vector<std::string> removed;
+    for (const auto& pair : files) {
+        if (isUnder(pair.first, directory)) {
+            removed.push_back(pair.first);
+        }
+    }
+    for (const auto& path : removed) {
+        removeFile(path);
+    }
+    for (auto it = dirty.begin(); it != dirty.end();) {
+        it = isUnder(it->first, directory) ? dirty.erase(it) : std::next(it);
+    }
+}
+
+bool WatchDaemon::openSocket() {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (options.socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << options.socketPath << std::endl;
+        return false;
+    }
+    std::memcpy(address.sun_path, options.socketPath.c_str(), options.socketPath.size() + 1);
+
+    // Replace a socket left behind by an earlier run, but never any other kind of file
+    struct stat st;
+    if (::lstat(options.socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        ::unlink(options.socketPath.c_str());
+    }
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 16) != 0) {
+        std::cerr << "Unable to listen on " << options.socketPath << ": " << std::strerror(errno) << std::endl;
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+void WatchDaemon::handleEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    bool overflow = false;
+    const Clock::time_point now = Clock::now();
+    while (true) {
+        ssize_t bytes = ::read(inotifyFd, buffer, sizeof(buffer));
+        if (bytes <= 0) {
+            break;
+        }
+        for (char* position = buffer; position < buffer + bytes;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            auto watch = watchPaths.find(event->wd);
+            if (watch == watchPaths.end()) {
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                watchDescriptors.erase(watch->second);
+                watchPaths.erase(watch);
+                continue;
+            }
+            if (event->len == 0) {
+                continue;
+            }
+
+            const std::string path = joinPath(watch->second, event->name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    forgetTree(path);
+                }
+                if ((event->mask & (IN_CREATE | IN_MOVED_TO)) && options.recursive && !skipsDirectory(path)) {
+                    watchTree(path, true);
+                }
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                dirty.erase(path);
+                removeFile(path);
+            } else {
+                dirty[path] = now;
+            }
+        }
+    }
+
+    if (overflow) {
+        // Events were dropped, so nothing short of a rescan is trustworthy, and directories
+        // created meanwhile have no watch yet: every watch is set up again before the scan
+        std::cerr << "inotify queue overflowed; rescanning" << std::endl;
+        dirty.clear();
+        for (const auto& watch : watchPaths) {
+            ::inotify_rm_watch(inotifyFd, watch.first);
+        }
+        watchPaths.clear();
+        watchDescriptors.clear();
+        for (const auto& root : options.roots) {
+            watchTree(root, false);
+        }
+        initialScan();
+    }
+}
+
+void WatchDaemon::handleClient(Client& client) {
+    char buffer[4096];
+    ssize_t bytes = ::recv(client.fd, buffer, sizeof(buffer), 0);
+    if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return;
+    }
+    if (bytes <= 0) {
+        ::close(client.fd);
+        client.fd = -1;
+        return;
+    }
+    client.buffer.append(buffer, static_cast<size_t>(bytes));
+    serveRequests(client);
+}
+
+void WatchDaemon::serveRequests(Client& client) {
+    size_t newline;
+    while (client.fd >= 0 && !client.waiting && (newline = client.buffer.find('\n')) != std::string::npos) {
+        std::string request = client.buffer.substr(0, newline);
+        client.buffer.erase(0, newline + 1);
+        if (!request.empty() && request.back() == '\r') {
+            request.pop_back();
+        }
+        std::string response;
+        if (!answer(client, request, response)) {
+            client.waiting = true;
+            break;
+        }
+        sendLine(client, response);
+    }
+    if (client.fd >= 0 && client.buffer.size() > MAX_REQUEST_LENGTH) {
+        ::close(client.fd);
+        client.fd = -1;
+    }
+}
+
+bool WatchDaemon::sendLine(Client& client, const std::string& line) {
+    const std::string response = line + "\n";
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t written = ::send(client.fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            ::close(client.fd);
+            client.fd = -1;
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+void WatchDaemon::finishHashing() {
+    std::vector<const HashRequest*> done;
+    {
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        done.swap(finished);
+    }
+    for (const HashRequest* key : done) {
+        auto it = hashing.find(key);
+        if (it == hashing.end()) {
+            continue;
+        }
+        std::unique_ptr<HashRequest> request = std::move(it->second);
+        hashing.erase(it);
+
+        for (size_t i = 0; i < request->jobs.size(); ++i) {
+            const HashJob& job = request->jobs[i];
+            if (i == request->queriedJob) {
+                continue;
+            }
+            if (!job.error.empty()) {
+                std::cerr << "Error hashing file " << job.path << ": " << job.error << std::endl;
+                continue;
+            }
+            // A file changed or replaced while it was hashed keeps waiting for its own update
+            auto file = files.find(job.path);
+            const LiveFile& stamp = request->stamps[i];
+            if (file != files.end() && file->second.digest.empty() && file->second.size == stamp.size &&
+                file->second.mtime == stamp.mtime && file->second.device == stamp.device &&
+                file->second.inode == stamp.inode) {
+                setDigest(job.path, job.digest);
+            }
+        }
+
+        if (request->client == 0) {
+            std::cerr << "Updated " << request->updated << " files, removed " << request->removed << "; "
+                      << groupCount << " duplicate groups" << std::endl;
+            continue;
+        }
+        for (auto& client : clients) {
+            if (client.id == request->client && client.fd >= 0) {
+                client.waiting = false;
+                if (sendLine(client, answerHashed(*request))) {
+                    serveRequests(client);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void WatchDaemon::processDirty(bool all) {
+    if (dirty.empty()) {
+        return;
+    }
+    const Clock::time_point cutoff = Clock::now() - std::chrono::milliseconds(options.debounceMs);
+    std::vector<std::string> ready;
+    for (auto it = dirty.begin(); it != dirty.end();) {
+        if (all || it->second <= cutoff) {
+            ready.push_back(it->first);
+            it = dirty.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (ready.empty()) {
+        return;
+    }
+
+    std::unordered_set<std::uintmax_t> sizes;
+    size_t updated = 0;
+    size_t removed = 0;
+    for (const auto& path : ready) {
+        WalkEntry entry;
+        // A file the filter skips is treated as gone
+        if (!DirectoryWalker::statFile(path, entry) || skipsFile(path, entry)) {
+            if (files.count(path) > 0) {
+                removeFile(path);
+                removed++;
+            }
+            continue;
+        }
+        auto it = files.find(path);
+        if (it != files.end() && it->second.size == entry.size && it->second.mtime == entry.mtime &&
+            it->second.device == entry.device && it->second.inode == entry.inode) {
+            continue;
+        }
+        LiveFile file;
+        file.size = entry.size;
+        file.mtime = entry.mtime;
+        file.device = entry.device;
+        file.inode = entry.inode;
+        addFile(path, file);
+        sizes.insert(entry.size);
+        updated++;
+    }
+
+    auto request = std::make_unique<HashRequest>();
+    request->updated = updated;
+    request->removed = removed;
+    addSizeJobs(*request, sizes, false);
+    if (!request->jobs.empty()) {
+        startHashing(std::move(request));
+    } else if (updated > 0 || removed > 0) {
+        std::cerr << "Updated " << updated << " files, removed " << removed << "; " << groupCount
+                  << " duplicate groups" << std::endl;
+    }
+}
+
+#else
+
+int WatchDaemon::run() {
+    std::cerr << "Watch mode requires Linux inotify" << std::endl;
+    return 2;
+}
+
+#endif
+
+bool WatchDaemon::answer(Client& client, const std::string& request, std::string& response) {
+    std::istringstream in(request);
+    std::string command;
+    in >> command;
+
+    if (command == "HAS") {
+        std::uintmax_t size = 0;
+        std::string hex;
+        Digest digest;
+        if (!(in >> size >> hex) || !Digest::fromHex(hex, digest)) {
+            response = "ERR usage: HAS <size> <hex digest>";
+            return true;
+        }
+        if (bySize.find(size) == bySize.end()) {
+            response = "NO";
+            return true;
+        }
+        auto pending = std::make_unique<HashRequest>();
+        pending->client = client.id;
+        pending->command = command;
+        pending->size = size;
+        pending->digest = digest;
+        // A file with a unique size is only hashed once someone asks about that size
+        addSizeJobs(*pending, { size }, true);
+        if (!pending->jobs.empty()) {
+            startHashing(std::move(pending));
+            return false;
+        }
+        response = answerHashed(*pending);
+        return true;
+    }
+    if (command == "CHECK") {
+        std::string path;
+        std::getline(in >> std::ws, path);
+        WalkEntry entry;
+        if (path.empty()) {
+            response = "ERR usage: CHECK <path>";
+            return true;
+        }
+        if (!DirectoryWalker::statFile(path, entry)) {
+            response = "ERR cannot read " + path;
+            return true;
+        }
+        if (bySize.find(entry.size) == bySize.end()) {
+            response = "NO";
+            return true;
+        }
+        auto pending = std::make_unique<HashRequest>();
+        pending->client = client.id;
+        pending->command = command;
+        pending->size = entry.size;
+        pending->queried = entry;
+        addSizeJobs(*pending, { entry.size }, true);
+        // The index digest stands in for a read when the queried path is indexed unchanged
+        auto known = files.find(path);
+        if (known != files.end() && !known->second.digest.empty() && known->second.size == entry.size &&
+            known->second.mtime == entry.mtime && known->second.device == entry.device &&
+            known->second.inode == entry.inode) {
+            pending->digest = known->second.digest;
+        } else {
+            pending->queriedJob = pending->jobs.size();
+            pending->jobs.emplace_back();
+            pending->jobs.back().path = path;
+            pending->stamps.emplace_back();
+        }
+        if (!pending->jobs.empty()) {
+            startHashing(std::move(pending));
+            return false;
+        }
+        response = answerHashed(*pending);
+        return true;
+    }
+    if (command == "STATS") {
+        response = "files=" + std::to_string(files.size()) + " groups=" + std::to_string(groupCount) +
+                   " pending=" + std::to_string(dirty.size()) + " hashing=" + std::to_string(hashing.size());
+        return true;
+    }
+    response = "ERR unknown command";
+    return true;
+}
+
+std::string WatchDaemon::answerHashed(const HashRequest& request) {
+    if (request.command == "HAS") {
+        const std::string* match = findContent(request.size, request.digest, 0, 0);
+        return match ? "YES " + *match : "NO";
+    }
+    Digest digest = request.digest;
+    if (request.queriedJob < request.jobs.size()) {
+        const HashJob& job = request.jobs[request.queriedJob];
+        if (!job.error.empty()) {
+            return "ERR " + job.error;
+        }
+        digest = job.digest;
+    }
+    // The queried file may be stored under another spelling of its path, or as a hard link
+    const WalkEntry& entry = request.queried;
+    const std::string* match = findContent(entry.size, digest, entry.device, entry.inode);
+    return match ? "YES " + *match : "NO";
+}
+
+void WatchDaemon::addFile(const std::string& path, const LiveFile& file) {
+    removeFile(path);
+    files[path] = file;
+    bySize[file.size].insert(path);
+    if (!file.digest.empty()) {
+        std::set<std::string>& members = byContent[ContentKey{ file.size, file.digest }];
+        members.insert(path);
+        if (members.size() == 2) {
+            groupCount++;
+        }
+    }
+}
+
+void WatchDaemon::removeFile(const std::string& path) {
+    auto it = files.find(path);
+    if (it == files.end()) {
+        return;
+    }
+    const LiveFile& file = it->second;
+    auto bucket = bySize.find(file.size);
+    if (bucket != bySize.end()) {
+        bucket->second.erase(path);
+        if (bucket->second.empty()) {
+            bySize.erase(bucket);
+        }
+    }
+    if (!file.digest.empty()) {
+        auto content = byContent.find(ContentKey{ file.size, file.digest });
+        if (content != byContent.end()) {
+            content->second.erase(path);
+            if (content->second.size() == 1) {
+                groupCount--;
+            } else if (content->second.empty()) {
+                byContent.erase(content);
+            }
+        }
+    }
+    files.erase(it);
+}
+
+void WatchDaemon::setDigest(const std::string& path, const Digest& digest) {
+    auto it = files.find(path);
+    if (it == files.end()) {
+        return;
+    }
+    LiveFile file = it->second;
+    file.digest = digest;
+    addFile(path, file);
+}
+
+void WatchDaemon::addSizeJobs(HashRequest& request, const std::unordered_set<std::uintmax_t>& sizes,
+                              bool includeSingles) {
+    for (std::uintmax_t size : sizes) {
+        auto bucket = bySize.find(size);
+        if (bucket == bySize.end() || (bucket->second.size() < 2 && !includeSingles)) {
+            continue;
+        }
+        for (const auto& path : bucket->second) {
+            const LiveFile& file = files[path];
+            if (file.digest.empty()) {
+                request.jobs.emplace_back();
+                request.jobs.back().path = path;
+                request.stamps.push_back(file);
+            }
+        }
+    }
+}
+
+void WatchDaemon::startHashing(std::unique_ptr<HashRequest> request) {
+    HashRequest* key = request.get();
+    hashing[key] = std::move(request);
+    // The request stays in hashing, and its jobs in place, until finishHashing takes it back
+    HashCalculator::calculateOnPool(*pool, key->jobs, options.algorithm, options.scanOptions.readBackend, [this, key] {
+        {
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            finished.push_back(key);
+        }
+#ifdef __linux__
+        const std::uint64_t one = 1;
+        ssize_t written = ::write(wakeFd, &one, sizeof(one));
+        (void)written;
+#endif
+    });
+}
+
+const std::string* WatchDaemon::findContent(std::uintmax_t size, const Digest& digest,
+                                             std::uint64_t device, std::uint64_t inode) {
+    auto content = byContent.find(ContentKey{ size, digest });
+    if (content == byContent.end()) {
+        return nullptr;
+    }
+    for (const auto& path : content->second) {
+        const LiveFile& file = files.at(path);
+        if (device == 0 || file.device != device || file.inode != inode) {
+            return &path;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,158 @@
+#ifndef WATCH_DAEMON_H
+#define WATCH_DAEMON_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "file_scanner.h"
+#include "worker_pool.h"
+
+struct WatchOptions {
+    std::vector<std::string> roots;
+    HashAlgorithm algorithm = HashAlgorithm::SHA256;
+    bool recursive = true;
+    ScanOptions scanOptions;
+    std::string socketPath;
+    // Quiet time after a file's last event before it is re-hashed
+    unsigned debounceMs = 500;
+};
+
+// Long-running watch mode. One initial scan fills an in-memory index of every file, then
+// inotify events keep it and the duplicate groups current: deletions and renames apply at
+// once, created and modified files are re-stat'ed and re-hashed in batches once they have
+// been quiet for the debounce interval. Clients query the index over a Unix socket with
+// one line per request:
+//
+//   HAS <size> <hex digest>   -> "YES <path>" or "NO"
+//   CHECK <path>              -> "YES <path>" or "NO"; hashes the given file unless no stored
+//                                file has its size
+//   STATS                     -> "files=N groups=N pending=N"
+//
+// Every file whose size is shared by another file carries a full digest, so HAS on such a
+// size is a pair of hash lookups. Whatever still needs hashing, for a query or after events,
+// is hashed on the worker pool while the poll thread keeps draining events and answering
+// other clients; a client's answer is sent once its files are done, and its later requests
+// wait until then. The scan's filter rules hold for events too: excluded directories get no
+// watch and skipped files stay out of the index. Linux only.
+class WatchDaemon {
+public:
+    explicit WatchDaemon(const WatchOptions& options);
+    ~WatchDaemon();
+
+    WatchDaemon(const WatchDaemon&) = delete;
+    WatchDaemon& operator=(const WatchDaemon&) = delete;
+
+    // Scan, then serve until SIGINT or SIGTERM; returns the process exit code
+    int run();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct LiveFile {
+        std::uintmax_t size = 0;
+        std::int64_t mtime = 0;
+        std::uint64_t device = 0;
+        std::uint64_t inode = 0;
+        Digest digest;
+    };
+
+    struct ContentKey {
+        std::uintmax_t size;
+        Digest digest;
+        bool operator==(const ContentKey& other) const { return size == other.size && digest == other.digest; }
+    };
+    struct ContentKeyHash {
+        size_t operator()(const ContentKey& key) const {
+            return DigestHash()(key.digest) ^ std::hash<std::uintmax_t>()(key.size);
+        }
+    };
+
+    struct Client {
+        int fd;
+        std::string buffer;
+        std::uint64_t id;
+        bool waiting = false;   // A request is being hashed; the rest of the buffer waits
+    };
+
+    // Files hashed on the pool for a query or for changed files. The jobs are owned here
+    // while the pool works on them; stamps say which index entry each digest is for.
+    struct HashRequest {
+        std::vector<HashJob> jobs;
+        std::vector<LiveFile> stamps;
+        std::uint64_t client = 0;       // Waiting for the answer; 0 when only the index is updated
+        std::string command;            // HAS or CHECK
+        std::uintmax_t size = 0;
+        Digest digest;                  // HAS: asked about; CHECK: the file's, when already known
+        WalkEntry queried;              // CHECK: the file asked about
+        size_t queriedJob = static_cast<size_t>(-1);   // CHECK: its job when it needs hashing
+        size_t updated = 0;             // Changed files behind an index update, for the log
+        size_t removed = 0;
+    };
+
+    WatchOptions options;
+    std::unique_ptr<WorkerPool> pool;
+
+    std::unordered_map<const HashRequest*, std::unique_ptr<HashRequest>> hashing;
+    std::mutex finishedMutex;
+    std::vector<const HashRequest*> finished;   // Done on the pool, not yet applied
+    int wakeFd = -1;                            // eventfd the pool signals when one is done
+
+    std::unordered_map<std::string, LiveFile> files;
+    std::unordered_map<std::uintmax_t, std::unordered_set<std::string>> bySize;
+    std::unordered_map<ContentKey, std::set<std::string>, ContentKeyHash> byContent;
+    size_t groupCount = 0;
+
+    // Files with events still inside the debounce interval, by time of the last event
+    std::unordered_map<std::string, Clock::time_point> dirty;
+
+    int inotifyFd = -1;
+    int listenFd = -1;
+    std::unordered_map<int, std::string> watchPaths;
+    std::unordered_map<std::string, int> watchDescriptors;
+    std::vector<Client> clients;
+    std::uint64_t nextClient = 1;
+
+    // options.scanOptions.filters compiled once; null when no rule is set
+    std::unique_ptr<WalkFilter> filter;
+    std::vector<std::uint64_t> rootDevices;     // Per root, for the same-filesystem rule
+
+    bool initialScan();
+    bool watchTree(const std::string& root, bool markFiles);
+    void forgetTree(const std::string& directory);
+    // Length of the root path lies under, as the filter's patterns expect it
+    size_t rootLength(const std::string& path, size_t& root) const;
+    bool skipsDirectory(const std::string& path) const;
+    bool skipsFile(const std::string& path, const WalkEntry& entry) const;
+    bool openSocket();
+
+    void handleEvents();
+    void processDirty(bool all);
+    void handleClient(Client& client);
+    // Answer the client's buffered requests in order until one has to wait for hashing
+    void serveRequests(Client& client);
+    bool sendLine(Client& client, const std::string& line);
+    // False when the answer waits for hashing and is sent by finishHashing
+    bool answer(Client& client, const std::string& request, std::string& response);
+    std::string answerHashed(const HashRequest& request);
+
+    void addFile(const std::string& path, const LiveFile& file);
+    void removeFile(const std::string& path);
+    void setDigest(const std::string& path, const Digest& digest);
+    // Add a full-hash job for every member without a digest in sizes that have more than one
+    // file, or in every given size with includeSingles
+    void addSizeJobs(HashRequest& request, const std::unordered_set<std::uintmax_t>& sizes, bool includeSingles);
+    void startHashing(std::unique_ptr<HashRequest> request);
+    // Store the digests of the requests the pool finished, for files that did not change
+    // meanwhile, and send the answers their clients wait for
+    void finishHashing();
+    // A stored file with this content that is not the given inode; device 0 excludes nothing
+    const std::string* findContent(std::uintmax_t size, const Digest& digest, std::uint64_t device, std::uint64_t inode);
+};
+
+#endif // WATCH_DAEMON_H
@@ -0,0 +1,74 @@
+#include "worker_pool.h"
+#include <iostream>
+
+WorkerPool::WorkerPool(size_t threadCount, size_t queueCapacity) {
+    if (threadCount == 0) {
+        threadCount = defaultThreadCount();
+    }
+    capacity = queueCapacity > 0 ? queueCapacity : threadCount * 64;
+
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&WorkerPool::workerLoop, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+size_t WorkerPool::defaultThreadCount() {
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    return hardwareThreads > 0 ? hardwareThreads : 1;
+}
+
+void WorkerPool::submit(Task task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    spaceAvailable.wait(lock, [this] { return tasks.size() < capacity; });
+    tasks.push_back(std::move(task));
+    lock.unlock();
+    taskAvailable.notify_one();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+}
+
+void WorkerPool::workerLoop(size_t workerIndex) {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            activeTasks++;
+        }
+        spaceAvailable.notify_one();
+
+        try {
+            task(workerIndex);
+        } catch (const std::exception& e) {
+            std::cerr << "Worker task failed: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeTasks--;
+            if (tasks.empty() && activeTasks == 0) {
+                allDone.notify_all();
+            }
+        }
+    }
+}
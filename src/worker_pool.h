@@ -0,0 +1,50 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size thread pool with a bounded task queue. Each task receives the index of the
+// worker running it so callers can keep per-worker result shards without locking.
+class WorkerPool {
+public:
+    using Task = std::function<void(size_t workerIndex)>;
+
+    // threadCount 0 means one worker per hardware thread
+    explicit WorkerPool(size_t threadCount = 0, size_t queueCapacity = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queue a task, blocking while the queue is full
+    void submit(Task task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    size_t size() const { return workers.size(); }
+
+    static size_t defaultThreadCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<Task> tasks;
+    size_t capacity;
+    size_t activeTasks = 0;
+    bool stopping = false;
+
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable spaceAvailable;
+    std::condition_variable allDone;
+
+    void workerLoop(size_t workerIndex);
+};
+
+#endif // WORKER_POOL_H
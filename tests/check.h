@@ -0,0 +1,39 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the unit tests: every failure is printed and counted, and main
+// returns checkResult() so ctest and make check see a non-zero exit
+inline int& failureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n";   \
+            failureCount()++;                                                                 \
+        }                                                                                     \
+    } while (0)
+
+// For checks inside loops: names the case that failed
+#define CHECK_CASE(condition, description)                                                    \
+    do {                                                                                      \
+        if (!(condition)) {                                                                   \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed for " \
+                      << description << "\n";                                                 \
+            failureCount()++;                                                                 \
+        }                                                                                     \
+    } while (0)
+
+inline int checkResult() {
+    if (failureCount() > 0) {
+        std::cerr << failureCount() << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif // TESTS_CHECK_H
@@ -0,0 +1,202 @@
+// ContentChunker: the two-bytes-per-step loop against a plain one-byte FastCDC loop, over
+// random and repetitive data fed in blocks of many sizes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "content_chunker.h"
+
+namespace {
+
+// The gear table and masks as documented in content_chunker.cpp; the table is pinned by
+// design, since changing it would change every chunk fingerprint
+std::vector<std::uint64_t> gearTable() {
+    std::vector<std::uint64_t> values(256);
+    std::uint64_t state = 0x2545f4914f6cdd1dULL;
+    for (auto& value : values) {
+        std::uint64_t x = (state += 0x9e3779b97f4a7c15ULL);
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        value = x ^ (x >> 31);
+    }
+    return values;
+}
+
+std::uint64_t spreadMask(unsigned bits) {
+    std::uint64_t mask = 0;
+    const unsigned step = bits > 0 && bits <= 31 ? 2 : 1;
+    for (unsigned i = 0; i < bits && i < 63; ++i) {
+        mask |= std::uint64_t{ 1 } << (62 - i * step);
+    }
+    return mask;
+}
+
+// Cut offsets before the end of data, one byte per step with no skipping ahead
+std::vector<std::size_t> referenceCuts(ChunkParams params, const std::vector<std::uint8_t>& data) {
+    params.averageSize = std::max<std::size_t>(params.averageSize, 1);
+    params.minSize = std::min(params.minSize, params.averageSize);
+    params.maxSize = std::max(params.maxSize, params.averageSize);
+    unsigned bits = 0;
+    for (std::size_t value = params.averageSize; value > 1; value >>= 1) {
+        bits++;
+    }
+    const std::uint64_t strictMask = spreadMask(bits + 2);
+    const std::uint64_t looseMask = spreadMask(bits > 2 ? bits - 2 : 1);
+    static const std::vector<std::uint64_t> gear = gearTable();
+
+    std::vector<std::size_t> cuts;
+    std::uint64_t hash = 0;
+    std::size_t position = 0;
+    auto cut = [&](std::size_t end) {
+        cuts.push_back(end);
+        hash = 0;
+        position = 0;
+    };
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        // The first minSize bytes of a chunk are skipped without hashing
+        if (position < params.minSize) {
+            position++;
+        } else {
+            const std::uint64_t mask = position < params.averageSize ? strictMask : looseMask;
+            hash = (hash << 1) + gear[data[i]];
+            position++;
+            if ((hash & mask) == 0) {
+                cut(i + 1);
+                continue;
+            }
+        }
+        if (position >= params.maxSize) {
+            cut(i + 1);
+        }
+    }
+    // A cut at the very end depends on whether more data follows, so it is left out
+    if (!cuts.empty() && cuts.back() == data.size()) {
+        cuts.pop_back();
+    }
+    return cuts;
+}
+
+// Cut offsets before the end of data as ContentChunker reports them, fed block by block
+template <typename BlockSize>
+std::vector<std::size_t> chunkerCuts(const ChunkParams& params, const std::vector<std::uint8_t>& data,
+                                     BlockSize blockSize) {
+    ContentChunker chunker(params);
+    std::vector<std::size_t> cuts;
+    std::size_t offset = 0;
+    while (offset < data.size()) {
+        const std::size_t blockEnd = std::min(data.size(), offset + std::max<std::size_t>(blockSize(), 1));
+        while (offset < blockEnd) {
+            bool cut = false;
+            const std::size_t used = chunker.next(data.data() + offset, blockEnd - offset, cut);
+            offset += used;
+            if (cut) {
+                cuts.push_back(offset);
+            } else if (used == 0) {
+                CHECK_CASE(used > 0, "a call that neither consumed nor cut at offset " + std::to_string(offset));
+                return cuts;
+            }
+        }
+    }
+    if (!cuts.empty() && cuts.back() == data.size()) {
+        cuts.pop_back();
+    }
+    return cuts;
+}
+
+std::string describe(const ChunkParams& params, const std::string& data, const std::string& blocks) {
+    return data + " data, chunks " + std::to_string(params.minSize) + "/" + std::to_string(params.averageSize) +
+           "/" + std::to_string(params.maxSize) + ", " + blocks + " blocks";
+}
+
+void checkParams(const ChunkParams& params, const std::string& name, const std::vector<std::uint8_t>& data,
+                 std::mt19937& random) {
+    const std::vector<std::size_t> expected = referenceCuts(params, data);
+    CHECK_CASE(expected.size() > data.size() / params.maxSize, describe(params, name, "reference"));
+    CHECK_CASE(chunkerCuts(params, data, [&] { return data.size(); }) == expected, describe(params, name, "whole"));
+    for (std::size_t size : { 1, 2, 3, 7, 64, 4095, 65537 }) {
+        CHECK_CASE(chunkerCuts(params, data, [size] { return size; }) == expected,
+                   describe(params, name, std::to_string(size) + "-byte"));
+    }
+    std::uniform_int_distribution<std::size_t> sizes(1, 3 * params.averageSize);
+    CHECK_CASE(chunkerCuts(params, data, [&] { return sizes(random); }) == expected,
+               describe(params, name, "random"));
+}
+
+void testEquivalence() {
+    std::mt19937 random(24);
+    std::vector<std::uint8_t> noise(1 << 20);
+    for (auto& byte : noise) {
+        byte = static_cast<std::uint8_t>(random());
+    }
+    // Long runs without any cut, so the maximum size decides, with random stretches between
+    std::vector<std::uint8_t> mixed(noise.begin(), noise.begin() + 300000);
+    mixed.insert(mixed.end(), 200000, 0);
+    for (int i = 0; i < 100000; ++i) {
+        mixed.push_back(static_cast<std::uint8_t>("abcabd"[i % 6]));
+    }
+    mixed.insert(mixed.end(), noise.begin() + 300000, noise.begin() + 500000);
+
+    std::vector<ChunkParams> paramSets = { ChunkParams::forAverage(256), ChunkParams::forAverage(1000),
+                                           ChunkParams::forAverage(4096), ChunkParams::forAverage(64 * 1024) };
+    ChunkParams noMinimum;
+    noMinimum.minSize = 0;
+    noMinimum.averageSize = 300;
+    noMinimum.maxSize = 1001;
+    paramSets.push_back(noMinimum);
+    ChunkParams tiny;
+    tiny.minSize = 1;
+    tiny.averageSize = 2;
+    tiny.maxSize = 3;
+    paramSets.push_back(tiny);
+    ChunkParams oddMinimum;
+    oddMinimum.minSize = 333;
+    oddMinimum.averageSize = 777;
+    oddMinimum.maxSize = 2049;
+    paramSets.push_back(oddMinimum);
+
+    for (const ChunkParams& params : paramSets) {
+        checkParams(params, "random", noise, random);
+        checkParams(params, "mixed", mixed, random);
+    }
+}
+
+// chunkFile reads through FileReader's own blocks and must land on the same cuts
+void testChunkFile() {
+    std::mt19937 random(7);
+    std::vector<std::uint8_t> data(3 << 20);
+    for (auto& byte : data) {
+        byte = static_cast<std::uint8_t>(random());
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "dff_test_content_chunker.bin").string();
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()),
+                                                static_cast<std::streamsize>(data.size()));
+
+    const ChunkParams params = ChunkParams::forAverage(8 * 1024);
+    const std::vector<Chunk> chunks = ContentChunker::chunkFile(path, HashAlgorithm::SHA256, params);
+    std::remove(path.c_str());
+
+    std::vector<std::size_t> cuts;
+    std::size_t offset = 0;
+    for (const Chunk& chunk : chunks) {
+        CHECK(chunk.length > 0);
+        CHECK(chunk.length <= params.maxSize);
+        offset += chunk.length;
+        cuts.push_back(offset);
+    }
+    CHECK(offset == data.size());
+    cuts.pop_back();
+    CHECK(cuts == referenceCuts(params, data));
+}
+
+} // namespace
+
+int main() {
+    testEquivalence();
+    testChunkFile();
+    return checkResult();
+}
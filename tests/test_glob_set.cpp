@@ -0,0 +1,225 @@
+// GlobSet: pattern syntax and the name, relative and full targets
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "walk_filter.h"
+
+namespace {
+
+const std::string ROOT = "/data";
+
+// Whether any of the patterns matches path, walked from ROOT
+bool matches(const std::vector<std::string>& patterns, const std::string& path, const std::string& root = ROOT) {
+    GlobSet set;
+    for (const auto& pattern : patterns) {
+        set.add(pattern);
+    }
+    return set.matches(FilterPath::split(path, root.size()));
+}
+
+struct Case {
+    const char* pattern;
+    const char* path;
+    bool expected;
+};
+
+void checkCases(const std::vector<Case>& cases) {
+    for (const Case& c : cases) {
+        CHECK_CASE(matches({ c.pattern }, c.path) == c.expected, std::string(c.pattern) + " on " + c.path);
+    }
+}
+
+void testSplit() {
+    FilterPath path = FilterPath::split("/data/a/b.txt", 5);
+    CHECK(path.full == "/data/a/b.txt");
+    CHECK(path.relative == "a/b.txt");
+    CHECK(path.name == "b.txt");
+
+    // A root given with its trailing slash
+    path = FilterPath::split("/data/a/b.txt", 6);
+    CHECK(path.relative == "a/b.txt");
+
+    path = FilterPath::split("/data", 5);
+    CHECK(path.relative.empty());
+    CHECK(path.name == "data");
+}
+
+void testNames() {
+    checkCases({
+        { "node_modules", "/data/node_modules", true },
+        { "node_modules", "/data/a/b/node_modules", true },
+        { "node_modules", "/data/node_modules_old", false },
+        { "*.tmp", "/data/x/a.tmp", true },
+        { "*.tmp", "/data/.tmp", true },
+        { "*.tmp", "/data/a.tmp.bak", false },
+        { "**.tmp", "/data/x/a.tmp", true },
+        { "*", "/data/anything", true },
+        { "a?c", "/data/abc", true },
+        { "a?c", "/data/ac", false },
+        { "*cache*", "/data/x/webcache.db", true },
+        { "*cache*", "/data/x/webcach.db", false },
+    });
+}
+
+void testLeadingGlobstar() {
+    checkCases({
+        // Zero or more whole directories below the root
+        { "**/build", "/data/build", true },
+        { "**/build", "/data/a/build", true },
+        { "**/build", "/data/a/b/c/build", true },
+        { "**/build", "/data/a/rebuild", false },
+        { "**/build", "/data/build/x", false },
+        { "**/*.o", "/data/x/y/main.o", true },
+        { "**/*.o", "/data/main.o", true },
+        { "**/*.o", "/data/x/main.oo", false },
+    });
+}
+
+void testMiddleGlobstar() {
+    checkCases({
+        { "photos/**/thumbs", "/data/photos/thumbs", true },
+        { "photos/**/thumbs", "/data/photos/2020/thumbs", true },
+        { "photos/**/thumbs", "/data/photos/2020/01/thumbs", true },
+        { "photos/**/thumbs", "/data/photos/2020/mythumbs", false },
+        { "photos/**/thumbs", "/data/photosX/thumbs", false },
+        { "photos/**/thumbs", "/data/other/photos/thumbs", false },
+        { "photos/**/thumbs", "/data/photos/thumbs/x", false },
+        // Not a whole component: crosses slashes like any other **
+        { "src/a**b", "/data/src/ab", true },
+        { "src/a**b", "/data/src/ax/yb", true },
+        { "src/a**b", "/data/src/ax/yc", false },
+        // * and ? stay within one component
+        { "src/*/main.c", "/data/src/x/main.c", true },
+        { "src/*/main.c", "/data/src/x/y/main.c", false },
+        { "x/a?b", "/data/x/a/b", false },
+    });
+}
+
+void testClasses() {
+    checkCases({
+        { "file[0-9].txt", "/data/file7.txt", true },
+        { "file[0-9].txt", "/data/fileA.txt", false },
+        { "file[!0-9].txt", "/data/fileA.txt", true },
+        { "file[!0-9].txt", "/data/file1.txt", false },
+        { "file[^0-9].txt", "/data/fileA.txt", true },
+        { "file[^0-9].txt", "/data/file1.txt", false },
+        { "file[!0-9].txt", "/data/file.txt", false },
+        // A negated class never matches the separator
+        { "d/f[!a]x", "/data/d/f/x", false },
+        { "d/f[!a]x", "/data/d/fbx", true },
+        // ] right after the bracket is a member
+        { "[]a]", "/data/]", true },
+        { "[]a]", "/data/a", true },
+        { "[]a]", "/data/b", false },
+        { "[!]a]", "/data/b", true },
+        { "[!]a]", "/data/]", false },
+        { "[a\\-z]", "/data/-", true },
+        { "[a\\-z]", "/data/m", false },
+    });
+}
+
+void testEscapes() {
+    checkCases({
+        { "\\*.txt", "/data/*.txt", true },
+        { "\\*.txt", "/data/a.txt", false },
+        { "what\\?", "/data/what?", true },
+        { "what\\?", "/data/whatx", false },
+        { "a\\[b]", "/data/a[b]", true },
+        { "a\\[b]", "/data/ab", false },
+        { "back\\\\slash", "/data/back\\slash", true },
+        { "logs/\\*", "/data/logs/*", true },
+        { "logs/\\*", "/data/logs/x", false },
+    });
+}
+
+void testTrailingSlash() {
+    checkCases({
+        { "build/", "/data/x/build", true },
+        { "build/", "/data/x/build2", false },
+        { "build//", "/data/build", true },
+        { "photos/thumbs/", "/data/photos/thumbs", true },
+        { "photos/thumbs/", "/data/x/photos/thumbs", false },
+    });
+    // The slash left after trimming does not turn a name into a path pattern
+    GlobSet set;
+    set.add("build/");
+    CHECK(!set.needsPath());
+}
+
+void testTargets() {
+    checkCases({
+        // A slash anywhere but the front anchors the pattern below the root
+        { "cache/tmp", "/data/cache/tmp", true },
+        { "cache/tmp", "/data/x/cache/tmp", false },
+        { "data/cache", "/data/data/cache", true },
+        { "data/cache", "/data/cache", false },
+        // A leading slash matches the whole path as walked
+        { "/data/cache", "/data/cache", true },
+        { "/data/cache", "/data/x/data/cache", false },
+        { "/data/*/snap", "/data/a/snap", true },
+        { "/data/*/snap", "/data/a/b/snap", false },
+        { "/data/**/snap", "/data/a/b/snap", true },
+        { "/cache", "/data/cache", false },
+    });
+    // The same relative pattern follows the root it is walked from
+    CHECK(matches({ "b/c" }, "/mnt/a/b/c", "/mnt/a"));
+    CHECK(!matches({ "b/c" }, "/mnt/a/b/c", "/mnt"));
+    CHECK(matches({ "/mnt/a/b/c" }, "/mnt/a/b/c", "/mnt"));
+
+    GlobSet names;
+    names.add("*.tmp");
+    names.add("node_modules");
+    CHECK(!names.needsPath());
+    GlobSet paths;
+    paths.add("*.tmp");
+    paths.add("/data/cache");
+    CHECK(paths.needsPath());
+}
+
+void testSets() {
+    // Fast-path names and suffixes and token patterns answer together
+    const std::vector<std::string> rules = { ".git", "*.tmp", "*.swp", "build/**/*.o", "/data/cache" };
+    CHECK(matches(rules, "/data/x/.git"));
+    CHECK(matches(rules, "/data/x/y.swp"));
+    CHECK(matches(rules, "/data/build/a/b.o"));
+    CHECK(matches(rules, "/data/cache"));
+    CHECK(!matches(rules, "/data/x/y.txt"));
+    CHECK(!matches(rules, "/data/src/a/b.o"));
+
+    GlobSet empty;
+    CHECK(empty.empty());
+    CHECK(!empty.matches(FilterPath::split("/data/x", 5)));
+}
+
+void testErrors() {
+    auto rejects = [](const std::string& pattern) {
+        GlobSet set;
+        try {
+            set.add(pattern);
+        } catch (const std::invalid_argument&) {
+            return true;
+        }
+        return false;
+    };
+    CHECK(rejects(""));
+    CHECK(rejects("[abc"));
+    CHECK(rejects("x[!"));
+    CHECK(!rejects("[]]"));
+}
+
+} // namespace
+
+int main() {
+    testSplit();
+    testNames();
+    testLeadingGlobstar();
+    testMiddleGlobstar();
+    testClasses();
+    testEscapes();
+    testTrailingSlash();
+    testTargets();
+    testSets();
+    testErrors();
+    return checkResult();
+}
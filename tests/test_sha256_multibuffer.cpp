@@ -0,0 +1,86 @@
+// Sha256MultiBuffer: every kernel this CPU can run against OpenSSL's SHA-256
+#include <openssl/evp.h>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "sha256_multibuffer.h"
+
+namespace {
+
+Digest opensslSha256(const std::vector<std::uint8_t>& message) {
+    Digest digest;
+    unsigned int length = 0;
+    EVP_Digest(message.data(), message.size(), digest.bytes.data(), &length, EVP_sha256(), nullptr);
+    digest.length = static_cast<std::uint8_t>(length);
+    return digest;
+}
+
+// Lengths around the one- and two-block padding boundaries and a few whole-block runs
+const std::vector<std::size_t> EDGE_LENGTHS = { 0, 1, 3, 55, 56, 57, 63, 64, 65, 111, 112, 119, 120,
+                                                127, 128, 129, 191, 192, 1000, 4095, 4096, 4097 };
+
+// Hash count messages of the given lengths in one call and compare each lane with OpenSSL
+void checkBatch(const std::string& kernel, const std::vector<std::size_t>& lengths, std::mt19937& random) {
+    std::vector<std::vector<std::uint8_t>> messages(lengths.size());
+    std::vector<const std::uint8_t*> pointers(lengths.size());
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        messages[i].resize(lengths[i]);
+        for (auto& byte : messages[i]) {
+            byte = static_cast<std::uint8_t>(random());
+        }
+        pointers[i] = messages[i].data();
+    }
+    std::vector<Digest> digests(lengths.size());
+    Sha256MultiBuffer::hash(pointers.data(), lengths.data(), lengths.size(), digests.data());
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        CHECK_CASE(digests[i] == opensslSha256(messages[i]),
+                   kernel + " lane " + std::to_string(i) + " of " + std::to_string(lengths.size()) + ", " +
+                       std::to_string(lengths[i]) + " bytes");
+    }
+}
+
+void testKernel(const std::string& kernel) {
+    if (!Sha256MultiBuffer::forceKernel(kernel.c_str())) {
+        std::cout << kernel << ": not supported here, skipped" << std::endl;
+        return;
+    }
+    CHECK(kernel == Sha256MultiBuffer::kernelName());
+    const size_t lanes = Sha256MultiBuffer::lanes();
+    CHECK(lanes == (kernel == "avx512" ? 16u : 8u));
+    std::mt19937 random(29);
+
+    // Every edge length in every lane position, alone and with a full batch
+    for (std::size_t length : EDGE_LENGTHS) {
+        checkBatch(kernel, { length }, random);
+        checkBatch(kernel, std::vector<std::size_t>(lanes, length), random);
+    }
+    // Partial and full batches of mixed lengths, so lanes finish after different blocks
+    std::uniform_int_distribution<std::size_t> edge(0, EDGE_LENGTHS.size() - 1);
+    std::uniform_int_distribution<std::size_t> any(0, 3000);
+    for (int round = 0; round < 200; ++round) {
+        std::vector<std::size_t> lengths(1 + round % lanes);
+        for (auto& length : lengths) {
+            length = round % 2 == 0 ? EDGE_LENGTHS[edge(random)] : any(random);
+        }
+        checkBatch(kernel, lengths, random);
+    }
+    std::cout << kernel << ": checked against OpenSSL" << std::endl;
+}
+
+} // namespace
+
+int main() {
+    const std::string selected = Sha256MultiBuffer::kernelName();
+    testKernel("avx512");
+    testKernel("avx2");
+
+    CHECK(Sha256MultiBuffer::forceKernel("none"));
+    CHECK(Sha256MultiBuffer::lanes() == 0);
+    CHECK(!Sha256MultiBuffer::forceKernel("sse9"));
+
+    CHECK(Sha256MultiBuffer::forceKernel(nullptr));
+    CHECK(selected == Sha256MultiBuffer::kernelName());
+    return checkResult();
+}